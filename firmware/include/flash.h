@@ -114,8 +114,26 @@ typedef enum
     FLASH_ERR_ZERO_LEN           = 0x7,    /**< Flash error zero length parameter has passed. */
     FLASH_ERR_CRC_CHECK          = 0x8,    /**< Flash error CRC verification has failed. */
     FLASH_ERR_UNKNOWN            = 0x9,    /**< Flash error undefined. */
+    FLASH_ERR_BUSY               = 0xA,    /**< Flash error job queue is full, or erase job in progress. */
+    FLASH_ERR_NOT_FOUND          = 0xB,    /**< Flash error key not found in the key/value store. */
+    FLASH_ERR_NO_SPACE           = 0xC,    /**< Flash error key/value store is full. */
 } FlashStatus_t;
 
+/** Number of flash jobs which can be queued with Flash_WriteBufferAsync and
+ *  Flash_EraseSectorAsync.
+ *  To change the number of jobs, update this define and rebuild the library. */
+#ifndef FLASH_JOB_QUEUE_SIZE
+#define FLASH_JOB_QUEUE_SIZE            4
+#endif    /* ifndef FLASH_JOB_QUEUE_SIZE */
+
+/**
+ * @brief Flash job completion callback.
+ *
+ * @param [in] status  Flash API status code of the job, see @ref FlashStatus_t
+ * @param [in] context Context pointer given when the job was queued
+ */
+typedef void (*FlashJobCallback_t)(FlashStatus_t status, void *context);
+
 /**
  * @brief Flash operational frequency values supported by the device.
  */
@@ -133,6 +151,25 @@ typedef enum
     FLASH_CLOCK_48MHZ     = 48000000UL,    /**< Flash Clock value of 48 MHz. */
 } FlashClockFrequency_t;
 
+/**
+ * @brief Flash operation counters.
+ *
+ * Counters are only kept when the flash library is built with FLASH_STATS
+ * defined. They allow the cost of a sequence of flash operations to be
+ * measured: number of erase and program operations (flash wear), words
+ * handled by the flash copier, and number of status reads done while
+ * waiting for the flash interface (time spent in flash operations).
+ */
+typedef struct
+{
+    uint32_t commands;              /**< Commands executed on the flash interface */
+    uint32_t sector_erases;         /**< Sector erase operations, including endurance retries */
+    uint32_t mass_erases;           /**< Mass erase operations */
+    uint32_t words_programmed;      /**< Words programmed */
+    uint32_t words_copied;          /**< Words read, compared or CRC'ed by the flash copier */
+    uint32_t busy_polls;            /**< Status reads while waiting for the flash interface or copier */
+} FlashStats_t;
+
 /**
  * @brief Initialize clock and access to flash.
  *
@@ -363,6 +400,98 @@ FlashStatus_t Flash_EraseSector(uint32_t addr, bool enb_endurance);
  */
 FlashStatus_t Flash_BlankCheck(uint32_t addr, unsigned int word_length);
 
+/**
+ * @brief Queue a write of a buffer of words to flash.
+ *
+ * The buffer is written one row at a time by Flash_ProcessJobs, so that
+ * interrupts are never disabled for longer than one row and the application
+ * runs between rows. Each row is verified with a CRC, as with
+ * Flash_WriteBuffer.
+ *
+ * @param [in] addr          Address of the first word in flash to be written.
+ * @param [in] word_length   Total number of words to be written.
+ * @param [in] words         Words to write, must remain valid until the
+ *                           callback is called.
+ * @param [in] enb_endurance Set to 0 for default flash endurance;<br>
+ *                           Set to 1 to enable higher endurance of flash.
+ * @param [in] callback      Function called when the job is completed, or
+ *                           NULL.
+ * @param [in] context       Pointer passed to the callback.
+ * @return Flash API status code. FLASH_ERR_NONE if the job is queued,
+ *         FLASH_ERR_BUSY if the job queue is full.
+ * @note addr must be word aligned.
+ */
+FlashStatus_t Flash_WriteBufferAsync(uint32_t addr, uint32_t word_length,
+                                     const uint32_t *words, bool enb_endurance,
+                                     FlashJobCallback_t callback, void *context);
+
+/**
+ * @brief Queue an erase of a flash sector.
+ *
+ * The erase is started by Flash_ProcessJobs, which returns while the flash
+ * interface is busy and completes the erase on a later call.
+ *
+ * @param [in] addr          An address within the flash sector to be erased.
+ * @param [in] enb_endurance Set to 0 for default flash endurance;<br>
+ *                           Set to 1 to enable two-stage erase iteration for
+ *                           higher endurance of flash.
+ * @param [in] callback      Function called when the job is completed, or
+ *                           NULL.
+ * @param [in] context       Pointer passed to the callback.
+ * @return Flash API status code. FLASH_ERR_NONE if the job is queued,
+ *         FLASH_ERR_BUSY if the job queue is full.
+ */
+FlashStatus_t Flash_EraseSectorAsync(uint32_t addr, bool enb_endurance,
+                                     FlashJobCallback_t callback, void *context);
+
+/**
+ * @brief Run the queued flash jobs.
+ *
+ * Writes one row, or starts or checks a sector erase, of the oldest queued
+ * job, then returns. The job callback is called from this function when the
+ * job is completed.
+ *
+ * @return True if flash jobs are still queued, false otherwise.
+ * @note To be called from the application main loop while jobs are queued.
+ *       While an erase job is in progress, the other flash library
+ *       functions return FLASH_ERR_BUSY for the flash instance being erased,
+ *       as they would terminate the ongoing flash command.
+ */
+bool Flash_ProcessJobs(void);
+
+/**
+ * @brief Check if an erase job is in progress on a flash instance.
+ *
+ * @param [in] addr An address within the flash instance.
+ * @return True if an erase job is in progress on the flash instance holding
+ *         addr, false otherwise. The other flash library functions return
+ *         FLASH_ERR_BUSY for this flash instance until the erase job is
+ *         completed by Flash_ProcessJobs.
+ */
+bool Flash_IsErasing(uint32_t addr);
+
+#ifdef FLASH_STATS
+
+/**
+ * @brief Get the flash operation counters.
+ *
+ * @param [out] stats Counters accumulated since startup or the last call to
+ *                    Flash_ResetStats
+ * @note Only available when the flash library is built with FLASH_STATS
+ *       defined.
+ */
+void Flash_GetStats(FlashStats_t *stats);
+
+/**
+ * @brief Clear the flash operation counters.
+ *
+ * @note Only available when the flash library is built with FLASH_STATS
+ *       defined.
+ */
+void Flash_ResetStats(void);
+
+#endif    /* ifdef FLASH_STATS */
+
 /** @} */ /* End of the FLASHg group */
 
 #ifdef __cplusplus
@@ -0,0 +1,110 @@
+/**
+ * @file flash_kvs_nvds.h
+ * @brief NVDS compatible interface to the flash key/value store
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef FLASH_KVS_NVDS_H_
+#define FLASH_KVS_NVDS_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif    /* ifdef __cplusplus */
+
+#include <flash_kvs.h>
+#include <nvds.h>
+
+/** @addtogroup FLASHg
+ *  @{
+ */
+
+/**
+ * @brief Convert a key/value store status to an NVDS status
+ * @param [in] status Flash API status code
+ * @return NVDS status
+ */
+static inline uint8_t Flash_KVS_NvdsStatus(FlashStatus_t status)
+{
+    switch (status)
+    {
+        case FLASH_ERR_NONE:
+        {
+            return NVDS_OK;
+        }
+
+        case FLASH_ERR_NOT_FOUND:
+        {
+            return NVDS_TAG_NOT_DEFINED;
+        }
+
+        case FLASH_ERR_NO_SPACE:
+        {
+            return NVDS_NO_SPACE_AVAILABLE;
+        }
+
+        case FLASH_ERR_BAD_LENGTH:
+        case FLASH_ERR_INVALID_PARAMS:
+        {
+            return NVDS_LENGTH_OUT_OF_RANGE;
+        }
+
+        default:
+        {
+            return NVDS_FAIL;
+        }
+    }
+}
+
+/**
+ * @brief Read a tag from the key/value store, as nvds_get does.
+ * @param [in]     tag       Tag to read
+ * @param [in,out] lengthPtr Size of the buffer; set to the length of the tag
+ * @param [out]    buf       Buffer to which the tag is copied
+ * @return NVDS_OK, NVDS_TAG_NOT_DEFINED or NVDS_LENGTH_OUT_OF_RANGE
+ */
+static inline uint8_t Flash_KVS_NvdsGet(uint8_t tag, nvds_tag_len_t *lengthPtr, uint8_t *buf)
+{
+    return Flash_KVS_NvdsStatus(Flash_KVS_Get(tag, buf, lengthPtr));
+}
+
+/**
+ * @brief Write a tag to the key/value store, as nvds_put does.
+ * @param [in] tag    Tag to write
+ * @param [in] length Length of the tag
+ * @param [in] buf    Contents of the tag
+ * @return NVDS_OK, NVDS_NO_SPACE_AVAILABLE, NVDS_LENGTH_OUT_OF_RANGE or
+ *         NVDS_FAIL
+ */
+static inline uint8_t Flash_KVS_NvdsPut(uint8_t tag, nvds_tag_len_t length, const uint8_t *buf)
+{
+    return Flash_KVS_NvdsStatus(Flash_KVS_Put(tag, buf, length));
+}
+
+/**
+ * @brief Remove a tag from the key/value store, as nvds_del does.
+ * @param [in] tag Tag to remove
+ * @return NVDS_OK, NVDS_TAG_NOT_DEFINED or NVDS_FAIL
+ */
+static inline uint8_t Flash_KVS_NvdsDel(uint8_t tag)
+{
+    return Flash_KVS_NvdsStatus(Flash_KVS_Delete(tag));
+}
+
+/** @} */ /* End of the FLASHg group */
+
+#ifdef __cplusplus
+}
+#endif    /* ifdef __cplusplus */
+
+#endif    /* FLASH_KVS_NVDS_H_ */
@@ -61,6 +61,25 @@ extern "C" {
   * helps you to debug an application running on the Arm Cortex-M33 core.
   * @{
   */
+/**
+ * @brief Transmit statistics, used to size the trace buffer from field data.
+ */
+typedef struct
+{
+    /** Number of bytes accepted into the transmit buffer */
+    uint32_t bytes_queued;
+
+    /** Number of bytes discarded because the transmit buffer was full */
+    uint32_t bytes_dropped;
+
+    /** Highest number of bytes held in the transmit buffer at any time */
+    uint32_t high_water;
+
+    /** Number of transfers handed to the transmitter (DMA transfers when
+     *  using DMA, characters otherwise) */
+    uint32_t transfers;
+} swmTrace_stats_t;
+
 #if (SWMTRACE_ENABLEMENT == SWMTRACE_ENABLED)
 
 /**
@@ -85,6 +104,14 @@ void swmTrace_init(const uint32_t *configuration, uint32_t size);
  */
 bool swmTrace_txInProgress(void);
 
+/**
+ * @brief Provides the transmit statistics collected since initialization.
+ * @param[out] stats Pointer to the structure receiving the statistics.
+ * @return True if the statistics are available; false if the selected trace
+ * mechanism does not collect them.
+ */
+bool swmTrace_getStats(swmTrace_stats_t *stats);
+
 /**
  * @brief This provides a printf-like implementation for all possible trace
  * mechanisms.
@@ -120,51 +147,111 @@ bool swmTrace_getch(char *ch);
  */
 void swmLog(uint32_t level, const char *sFormat, ...);
 
+/**
+ * @brief A logging method like swmLog, where the message belongs to a module
+ * which can have its own log level.
+ * @param[in] module The module of this log message, less than
+ * SWM_LOG_MODULE_COUNT.
+ * @param[in] level The level of this log message. Only messages which have a
+ * level equal to or higher than the level selected for the module are
+ * output; if no level has been selected for the module, the level selected
+ * for swmLog applies.
+ * @param[in] sFormat The format of the output string, as per printf.
+ */
+void swmLogModule(uint32_t module, uint32_t level, const char *sFormat, ...);
+
+/**
+ * @brief Overrides the log level of a module at run time.
+ * @param[in] module The module to configure, less than SWM_LOG_MODULE_COUNT.
+ * @param[in] level The new level for the module, one of the SWM_LOG_LEVEL_*
+ * or SWM_LOG_TEST_* values, or 0 to use the level selected for swmLog again.
+ */
+void swmTrace_setModuleLevel(uint32_t module, uint32_t level);
+
 #else /* SWMTRACE_ENABLEMENT == SWMTRACE_ENABLED */
 
-#define swmTrace_init(...)
+#define swmTrace_init(...)          ((void)0)
 #define swmTrace_txInProgress(...)  false
-#define swmTrace_printf(...)
-#define swmTrace_vprintf(...)
+#define swmTrace_getStats(...)      false
+#define swmTrace_printf(...)        ((void)0)
+#define swmTrace_vprintf(...)       ((void)0)
 #define swmTrace_getch(...)     false
-#define swmLog(...)
+#define swmLog(...)                 ((void)0)
+#define swmLogModule(...)           ((void)0)
+#define swmTrace_setModuleLevel(...) ((void)0)
 
 #endif /* SWMTRACE_ENABLEMENT == SWMTRACE_ENABLED */
 
+/**
+ * @brief Internal macro selecting the log function used by the shortcut
+ * macros. Translation units defining SWM_LOG_MODULE before including this
+ * file log through their module, so their level can be set on its own.
+ */
+#ifdef SWM_LOG_MODULE
+#define swmLogLevel_(level, ...)    swmLogModule(SWM_LOG_MODULE, level, __VA_ARGS__)
+#else
+#define swmLogLevel_(level, ...)    swmLog(level, __VA_ARGS__)
+#endif
+
 /**
  * @brief Shortcut macro for verbose logging.
+ * @note Compiled out when SWM_LOG_MIN_LEVEL is above SWM_LOG_LEVEL_VERBOSE.
  */
-#define swmLogVerbose(...)  swmLog(SWM_LOG_LEVEL_VERBOSE, __VA_ARGS__)
+#if (SWM_LOG_MIN_LEVEL <= SWM_LOG_LEVEL_VERBOSE)
+#define swmLogVerbose(...)  swmLogLevel_(SWM_LOG_LEVEL_VERBOSE, __VA_ARGS__)
+#else
+#define swmLogVerbose(...)  ((void)0)
+#endif
 
 /**
  * @brief Shortcut macro for informational logging.
+ * @note Compiled out when SWM_LOG_MIN_LEVEL is above SWM_LOG_LEVEL_INFO.
  */
-#define swmLogInfo(...)     swmLog(SWM_LOG_LEVEL_INFO, __VA_ARGS__)
+#if (SWM_LOG_MIN_LEVEL <= SWM_LOG_LEVEL_INFO)
+#define swmLogInfo(...)     swmLogLevel_(SWM_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define swmLogInfo(...)     ((void)0)
+#endif
 
 /**
  * @brief Shortcut macro for warnings.
+ * @note Compiled out when SWM_LOG_MIN_LEVEL is above SWM_LOG_LEVEL_WARNING.
  */
-#define swmLogWarn(...)     swmLog(SWM_LOG_LEVEL_WARNING, __VA_ARGS__)
+#if (SWM_LOG_MIN_LEVEL <= SWM_LOG_LEVEL_WARNING)
+#define swmLogWarn(...)     swmLogLevel_(SWM_LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define swmLogWarn(...)     ((void)0)
+#endif
 
 /**
  * @brief Shortcut macro for errors.
+ * @note Compiled out when SWM_LOG_MIN_LEVEL is above SWM_LOG_LEVEL_ERROR.
  */
-#define swmLogError(...)    swmLog(SWM_LOG_LEVEL_ERROR, __VA_ARGS__)
+#if (SWM_LOG_MIN_LEVEL <= SWM_LOG_LEVEL_ERROR)
+#define swmLogError(...)    swmLogLevel_(SWM_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define swmLogError(...)    ((void)0)
+#endif
 
 /**
  * @brief Shortcut macro for fatal errors.
+ * @note Compiled out when SWM_LOG_MIN_LEVEL is above SWM_LOG_LEVEL_FATAL.
  */
-#define swmLogFatal(...)    swmLog(SWM_LOG_LEVEL_FATAL, __VA_ARGS__)
+#if (SWM_LOG_MIN_LEVEL <= SWM_LOG_LEVEL_FATAL)
+#define swmLogFatal(...)    swmLogLevel_(SWM_LOG_LEVEL_FATAL, __VA_ARGS__)
+#else
+#define swmLogFatal(...)    ((void)0)
+#endif
 
 /**
  * @brief Shortcut macro for test PASS indicators.
  */
-#define swmLogTestPass(...)    swmLog(SWM_LOG_TEST_PASS, __VA_ARGS__)
+#define swmLogTestPass(...)    swmLogLevel_(SWM_LOG_TEST_PASS, __VA_ARGS__)
 
 /**
  * @brief Shortcut macro for test FAIL indicators.
  */
-#define swmLogTestFail(...)    swmLog(SWM_LOG_TEST_FAIL, __VA_ARGS__)
+#define swmLogTestFail(...)    swmLogLevel_(SWM_LOG_TEST_FAIL, __VA_ARGS__)
 
 /** @} */ /* End of the SWMTRACEg group */
 
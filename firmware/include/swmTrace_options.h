@@ -80,6 +80,29 @@
  */
 #define SWM_LOG_TEST_FAIL       (SWM_LOG_OPTIONS_BASE + 0x01000006U)
 
+/**
+ * @brief Define the lowest log level compiled into the application.
+ * @details
+ * Shortcut macros for levels below this one, such as swmLogVerbose and
+ * swmLogInfo, expand to an empty statement, so neither the call, the
+ * evaluation of its arguments nor the format string remain in the
+ * application. Levels at or above it are still filtered at run time.
+ * @note
+ * To change the threshold, define this for the application build, e.g.
+ *      -DSWM_LOG_MIN_LEVEL=SWM_LOG_LEVEL_WARNING
+ */
+#ifndef SWM_LOG_MIN_LEVEL
+#define SWM_LOG_MIN_LEVEL       SWM_LOG_LEVEL_VERBOSE
+#endif
+
+/**
+ * @brief Define the number of modules which can have their own log level,
+ * see swmLogModule.
+ * @note  To change the number of modules, update this define and rebuild the
+ * library.
+ */
+#define SWM_LOG_MODULE_COUNT    8
+
 
 /**
  * @brief Macro indicating time stamps should be excluded in the log messages.
@@ -93,6 +116,24 @@
  */
 #define SWM_LOG_TIME_STAMP_ON   (SWM_LOG_OPTIONS_BASE + 0x02000001U)
 
+/**
+ * @brief Macro indicating log messages are formatted on the target as text.
+ * This is the default.
+ */
+#define SWM_LOG_FORMAT_TEXT     (SWM_LOG_OPTIONS_BASE + 0x03000000U)
+
+/**
+ * @brief Macro indicating log messages are sent as deferred binary frames.
+ * @details
+ * Instead of formatting the message with vsnprintf, swmLog only sends the
+ * address of the format string followed by the raw argument values. The
+ * text is rebuilt on the host from the string table of the application ELF
+ * file, using the swmTrace_decode.py utility.
+ * @note
+ * Output of swmTrace_printf is not affected and is still sent as text.
+ */
+#define SWM_LOG_FORMAT_BINARY   (SWM_LOG_OPTIONS_BASE + 0x03000001U)
+
 
 /**
  * @brief Macro defining the base of the UART options.
@@ -136,4 +177,31 @@
  */
 #define SWM_UART_BAUD_RATE      (SWM_UART_OPTIONS_BASE + 0x08000000U)
 
+/**
+ * @brief Macro selecting to discard a new message which does not fit in the
+ * UART transmit buffer. This is the default.
+ */
+#define SWM_UART_OVERFLOW_DROP_NEWEST   (SWM_UART_OPTIONS_BASE + 0x03000000U)
+
+/**
+ * @brief Macro selecting to discard the oldest unsent messages to make room
+ * for a new message which does not fit in the UART transmit buffer.
+ * @note
+ * Only whole messages are discarded, so binary log frames stay intact. The
+ * message being transmitted is always completed; if discarding the messages
+ * queued behind it is not enough, or another producer is still writing its
+ * message, the new message is discarded instead.
+ */
+#define SWM_UART_OVERFLOW_DROP_OLDEST   (SWM_UART_OPTIONS_BASE + 0x03000001U)
+
+/**
+ * @brief Macro selecting to wait for room in the UART transmit buffer when a
+ * new message does not fit.
+ * @note
+ * Only messages logged from thread mode with interrupts enabled wait; the
+ * new message is discarded when called from an interrupt handler, as the
+ * transmitter could never make room.
+ */
+#define SWM_UART_OVERFLOW_BLOCK         (SWM_UART_OPTIONS_BASE + 0x03000002U)
+
 #endif /* SWMTRACE_OPTIONS_H_ */
@@ -24,15 +24,27 @@
 
 /**
  * @brief Define the size of the buffer we use to queue UART messages. (For
- * simplicity sake, this should be a power of 2)
+ * simplicity sake, this should be a power of 2, no larger than 64 KB)
  */
 #define UART_TX_BUFFER_SIZE                (1U << 9)
 #define UART_RX_BUFFER_SIZE                (1U << 7)
 
+/**
+ * @brief Define the maximum length of a single formatted message, including
+ * the terminating zero. Longer messages are truncated.
+ */
+#define UART_TX_LINE_SIZE                  (1U << 8)
+
 /** @brief Mask ensuring we bound the indices within the buffer limits. */
 #define UART_TX_BUFFER_MASK                (UART_TX_BUFFER_SIZE - 1)
 #define UART_RX_BUFFER_MASK                (UART_RX_BUFFER_SIZE - 1)
 
+/** @brief Mask of the reserved index in the transmit claim state. */
+#define TX_CLAIM_INDEX_MASK                0x0000FFFFU
+
+/** @brief Increment of the pending producer count in the transmit claim state. */
+#define TX_CLAIM_WRITER                    0x00010000U
+
 /** Define the baud rate the UART will run at */
 #define BAUD_RATE                       115200U
 
@@ -45,6 +57,15 @@ extern volatile uint32_t tx_r_ptr;
 /** @brief Transmit write pointer */
 extern volatile uint32_t tx_w_ptr;
 
+/**
+ * @brief Number of bytes from tx_r_ptr handed to the transmitter and not yet
+ * sent. The transmitter advances tx_r_ptr over these once they are sent.
+ */
+extern volatile uint32_t tx_in_flight;
+
+/** @brief Number of transfers handed to the transmitter */
+extern volatile uint32_t tx_transfers;
+
 /** @brief Flag indicating if a transmission is in progress */
 extern volatile bool     tx_in_progress;
 
@@ -73,6 +94,15 @@ void swmTrace_UART_init(bool enable_rx);
  */
 void swmTrace_send(void);
 
+/**
+ * @brief Starts the transmission of the queued data, unless a transmission
+ * is already in progress.
+ * @details
+ * The tx_in_progress flag is tested and set atomically, so only one caller
+ * ever becomes responsible for calling swmTrace_send.
+ */
+void swmTrace_start(void);
+
 /**
  * @brief Calculates the next index based on value, this accounts for the
  * wrap around of the circular buffer.
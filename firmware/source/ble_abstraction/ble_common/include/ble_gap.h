@@ -325,6 +325,10 @@ void GAPM_GenRandAddrCmd(enum random_addr_type rnd_type);
  * Prepare and send GAPM_RESOLV_ADDR_CMD to resolve a random address using array of
  * IRK exchanged and bonded with device during pairing operation.
  *
+ * @note The bond information of a peer device connecting with a resolvable
+ * private address is already looked up with BondList_ResolveRPA when
+ * GAPC_CONNECTION_REQ_IND is received, see GAPC_IsBonded.
+ *
  * @param [in] conidx Connection identifier
  * @param [in] peerAddr Resolvable random address to solve
  */
@@ -107,6 +107,30 @@ extern "C"
                                                                                                                            * UUID
                                                                                                                            * */
 
+/** Macros to define characteristics with 16, 32 and 128 bit UUID, whose
+ * value length varies
+ * attidx_char:  Characteristic attribute index
+ * attidx_val:   Value attribute index
+ * uuid          UUID
+ * perm          Permissions (see gattm_att_desc)
+ * length        Maximum length value (in bytes)
+ * data          Pointer to the data structure in the application
+ * callback      Function to transfer the data between the application and the GATTM
+ * value_length  Function returning the current length of the value, so that
+ *               reads only allocate and copy the bytes in use */
+#define CS_CHAR_VAR_UUID_16(attidx_char, attidx_val, uuid, perm, length, data, callback, value_length) \
+    { attidx_char, { CS_ATT_CHARACTERISTIC_128, PERM(RD, ENABLE), 0, 0 }, false, 0, NULL, NULL, NULL }, \
+    { attidx_val, { uuid, perm, length, PERM(RI, ENABLE) | PERM(UUID_LEN, UUID_16) }, false, length, data, callback, \
+      value_length }
+#define CS_CHAR_VAR_UUID_32(attidx_char, attidx_val, uuid, perm, length, data, callback, value_length) \
+    { attidx_char, { CS_ATT_CHARACTERISTIC_128, PERM(RD, ENABLE), 0, 0 }, false, 0, NULL, NULL, NULL }, \
+    { attidx_val, { uuid, perm, length, PERM(RI, ENABLE) | PERM(UUID_LEN, UUID_32) }, false, length, data, callback, \
+      value_length }
+#define CS_CHAR_VAR_UUID_128(attidx_char, attidx_val, uuid, perm, length, data, callback, value_length) \
+    { attidx_char, { CS_ATT_CHARACTERISTIC_128, PERM(RD, ENABLE), 0, 0 }, false, 0, NULL, NULL, NULL }, \
+    { attidx_val, { uuid, perm, length, PERM(RI, ENABLE) | PERM(UUID_LEN, UUID_128) }, false, length, data, callback, \
+      value_length }
+
 /** Macro to add to the characteristic a CCC
  * attidx   CCC attribute index
  * data     Pointer to the 2-byte CCC data value in the application
@@ -124,6 +148,27 @@ extern "C"
 #define CS_CHAR_USER_DESC(attidx, length, data, callback) \
     { attidx, { CS_ATT_CHAR_USER_DESC_128, PERM(RD, ENABLE), length, PERM(RI, ENABLE) }, false, length, data, callback }
 
+/** Maximum number of custom services in the handle index used to find the
+ * service owning a handle in read/write requests */
+#ifndef GATT_HDL_INDEX_MAX
+#define GATT_HDL_INDEX_MAX              32
+#endif    /* ifndef GATT_HDL_INDEX_MAX */
+
+/** Number of buffers used to reassemble prepared (long) writes, shared by
+ * all connections. Each attribute with prepared writes queued on a
+ * connection uses one buffer until the writes are executed, so the RAM used
+ * is about GATT_PREP_WRITE_BUF_COUNT * (GATT_PREP_WRITE_BUF_SIZE + 16)
+ * bytes. */
+#ifndef GATT_PREP_WRITE_BUF_COUNT
+#define GATT_PREP_WRITE_BUF_COUNT       2
+#endif    /* ifndef GATT_PREP_WRITE_BUF_COUNT */
+
+/** Size of a prepared write reassembly buffer (in bytes). Prepared writes to
+ * longer attributes are rejected. */
+#ifndef GATT_PREP_WRITE_BUF_SIZE
+#define GATT_PREP_WRITE_BUF_SIZE        512
+#endif    /* ifndef GATT_PREP_WRITE_BUF_SIZE */
+
 /** Macro to Find Minimum */
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 
@@ -143,6 +188,10 @@ struct att_db_desc
                         uint8_t *toData, const uint8_t *fromData, uint16_t lenData,
                         uint16_t operation, uint8_t hl_status);                         /**< Pointer to callback
                                                                                          * function */
+    uint16_t (*value_length)(uint8_t conidx, uint16_t attidx, uint16_t handle);         /**< Optional pointer to a
+                                                                                         * function returning the
+                                                                                         * current value length,
+                                                                                         * at most length */
 };
 
 /**
@@ -342,6 +391,17 @@ void GATTC_SendEvtCfm(uint8_t conidx, uint16_t handle);
  *
  * Handle a received read request indication from GATT controller.
  *
+ * The confirmation is allocated for the current value length, given by the
+ * value_length function of the attribute if set, otherwise its maximum
+ * length, and the value is copied (or produced by the attribute callback)
+ * directly into it. Reads at an offset (Read Blob) are served by the stack
+ * from this confirmation, without a new request.
+ *
+ * Requests for a handle outside the custom services, or for an attribute
+ * that cannot be read, are answered with an error status without calling
+ * the attribute callback function, so its hl_status argument is always
+ * GAP_ERR_NO_ERROR.
+ *
  * @param [in] msg_id  Kernel message identifier
  * @param [in] param   Pointer to constant message parameters
  *                     (in format of structure gattc_read_req_ind)
@@ -358,6 +418,27 @@ void GATTC_ReadReqInd(ke_msg_id_t const msg_id,
  *
  * Handle a received write request indication from GATT controller.
  *
+ * Prepared (long) writes are queued by the stack, which asks for the
+ * attribute information of each of them (see GATTC_AttInfoReqInd), and
+ * delivers them with their offset while it processes the execute write
+ * request. The abstraction reassembles them in a buffer holding the current
+ * value, checking each offset against the attribute length; an invalid one
+ * discards the buffer, and the stack aborts the execute write with its
+ * status. Once the last prepared write of the attribute is delivered, the
+ * complete value is written once, through the attribute callback function
+ * if any, and its status is returned in the execute write response.
+ *
+ * The stack does not report a cancelled execute write. Its prepared writes
+ * are discarded when the connection sends a request after an execute write,
+ * or disconnects. If the peer prepares writes to the same attribute again in
+ * the meantime, the new value is only written on that request or
+ * disconnection.
+ *
+ * Requests for a handle outside the custom services, for an attribute that
+ * cannot be written, or at an invalid offset, are answered with an error
+ * status without calling the attribute callback function, so its hl_status
+ * argument is always GAP_ERR_NO_ERROR.
+ *
  * @param [in] msg_id  Kernel message identifier
  * @param [in] param   Pointer to constant message parameters
  *                     (in format of structure gattc_write_req_ind)
@@ -377,6 +458,12 @@ void GATTC_WriteReqInd(ke_msg_id_t const msg_id,
  * to check if attribute modification is authorized by
  * profile/application or not and to get current attribute length.
  *
+ * Each prepared write reserves a reassembly buffer for the attribute on the
+ * connection, or counts one more write in the buffer already reserved.
+ * Attributes longer than GATT_PREP_WRITE_BUF_SIZE are rejected with
+ * ATT_ERR_INSUFF_RESOURCE, and ATT_ERR_PREPARE_QUEUE_FULL is returned when
+ * all the GATT_PREP_WRITE_BUF_COUNT buffers are in use.
+ *
  * @param [in] msg_id  Kernel message identifier
  * @param [in] param   Pointer to constant message parameters
  *                     (in format of structure gattc_read_req_ind)
@@ -388,6 +475,17 @@ void GATTC_AttInfoReqInd(ke_msg_id_t const msg_id,
                          struct gattc_read_req_ind const *param, ke_task_id_t const dest_id,
                          ke_task_id_t const src_id);
 
+/**
+ * @brief GATTC end the prepared writes of a connection
+ *
+ * Write the values of an execute write left incomplete, and discard the
+ * prepared writes which were not executed. Called when the connection is
+ * lost.
+ *
+ * @param [in] conidx Connection index
+ */
+void GATTC_PrepWriteFlush(uint8_t conidx);
+
 /**
  * @brief Handle GATTM messages
  *
@@ -41,7 +41,7 @@ typedef struct
     uint8_t csrk_exchanged;     /**< Non-zero if CSRK has been exchanged */
     uint8_t ltk[16];            /**< Long term key */
     uint16_t ediv;              /**< Encryption diversifier */
-    uint8_t reserved1[2];       /**< Reserved */
+    uint16_t seq;               /**< Bond list write sequence number */
     uint8_t addr[6];            /**< Peer address */
     uint8_t addr_type;          /**< Address type */
     uint8_t irk_exchanged;      /**< Non-zero if IRK has been exchanged */
@@ -65,15 +65,43 @@ typedef struct
 #define BOND_INFO_FLASH_SECTORS_COUNT      8        /**< Number of sectors for bond info */
 #endif    /* ifndef BOND_INFO_FLASH_SECTORS_COUNT */
 
-#if BOND_INFO_FLASH_SECTORS_COUNT < 1
-    #error "The number of flash sectors should be greater than 1"
-#endif    /* if BOND_INFO_FLASH_SECTORS_COUNT < 1 */
+#if BOND_INFO_FLASH_SECTORS_COUNT < 2
+    #error "The number of flash sectors should be at least 2"
+#endif    /* if BOND_INFO_FLASH_SECTORS_COUNT < 2 */
 
 #define FLASH_DATA_ARRAY_SECTOR_SIZE        256     /**< Size of each sector */
 
-/** For 8 sectors (2KB) there is about 28 bond elements */
-#define BONDLIST_MAX_SIZE               ((FLASH_DATA_ARRAY_SECTOR_SIZE * BOND_INFO_FLASH_SECTORS_COUNT) / \
-                                         sizeof(BondInfo_t))
+/** Number of bond info records per flash sector. Records do not cross sector
+ * boundaries, so that a sector can be erased on its own, and are followed by
+ * a sector marker and a check word per record. */
+#define BOND_INFO_PER_SECTOR            ((FLASH_DATA_ARRAY_SECTOR_SIZE - 4) / (sizeof(BondInfo_t) + 4))
+
+/** Number of bond info record slots in flash */
+#define BONDLIST_SLOT_COUNT             (BOND_INFO_PER_SECTOR * BOND_INFO_FLASH_SECTORS_COUNT)
+
+/** Flash address of a bond info record slot */
+#define BOND_INFO_SLOT_ADDR(slot)       (BOND_INFO_BASE                                                       \
+                                         + ((slot) / BOND_INFO_PER_SECTOR) * FLASH_DATA_ARRAY_SECTOR_SIZE \
+                                         + ((slot) % BOND_INFO_PER_SECTOR) * sizeof(BondInfo_t))
+
+/** One sector is always kept erased, to move the bonds of the oldest sector
+ * into it before erasing that one. For 8 sectors (2KB) there are 21 bond
+ * elements.
+ *
+ * @note The former layout packed the records across sector boundaries, which
+ *       held 28 bond elements in 8 sectors. When a bond list of the former
+ *       layout is converted by BondList_Init, the bonds beyond
+ *       BONDLIST_MAX_SIZE are dropped, and the conversion uses a static
+ *       buffer of BONDLIST_MAX_SIZE bond elements (1512 bytes for 8 sectors)
+ *       to hold the bonds of the sectors it erases when the flash has no
+ *       room left for them. */
+#define BONDLIST_MAX_SIZE               (BOND_INFO_PER_SECTOR * (BOND_INFO_FLASH_SECTORS_COUNT - 1))
+
+/** Number of resolvable private addresses for which the bond found by
+ * BondList_ResolveRPA is kept in RAM */
+#ifndef BONDLIST_RPA_CACHE_SIZE
+#define BONDLIST_RPA_CACHE_SIZE         8
+#endif    /* ifndef BONDLIST_RPA_CACHE_SIZE */
 
 /** Invalid bond info state */
 #define BOND_INFO_STATE_INVALID         0x00
@@ -88,7 +116,27 @@ typedef struct
 
 /**
  * @brief Bondlist functions
+ *
+ * The bond list is stored in flash as a log: new bonds are written to the
+ * next free slot and removed bonds are only marked as invalid, the sectors
+ * being erased in turn as the log wraps around. The bond state is an index
+ * which does not change when the bond is moved in flash. An index of the
+ * bond list is built in RAM on first use, so that searches do not need to
+ * scan the flash. Searches never write to flash: the flash is only updated
+ * by BondList_Init and by the functions adding or removing bonds.
+ */
+
+/**
+ * @brief Prepare the bond list stored in flash for use
+ *
+ * Builds the index of the bond list, converts the bond information stored
+ * with the former flash layout, which is not found by searches until then,
+ * and completes the flash updates interrupted by a reset.
+ *
+ * @return True if successful, false otherwise
+ * @note Called by the BLE abstraction once the stack is reset.
  */
+bool BondList_Init(void);
 
 /**
  * @brief Get the number of entries in the bond list stored to flash
@@ -107,6 +155,15 @@ uint8_t BondList_Size(void);
  */
 uint8_t BondList_GetIRKs(struct gap_sec_key *irks);
 
+/**
+ * @brief Get a bond list entry
+ *
+ * @param[in] index Index of the entry, from 0 to BondList_Size() - 1
+ * @return Pointer to the bond information in flash, NULL if index is out of
+ *         range
+ */
+const BondInfo_t * BondList_Get(uint8_t index);
+
 /**
  * @brief Search for the bond information matching specified IRK in flash
  *
@@ -116,6 +173,22 @@ uint8_t BondList_GetIRKs(struct gap_sec_key *irks);
  */
 const BondInfo_t * BondList_FindByIRK(const uint8_t *irk);
 
+/**
+ * @brief Search for the bond information whose IRK resolves a resolvable
+ * private address
+ *
+ * The address hash is computed with the ah() function of the Bluetooth Core
+ * specification for each bond which exchanged its IRK, in a single pass and
+ * without going through the Bluetooth stack. The most recently resolved
+ * addresses are kept in a cache of BONDLIST_RPA_CACHE_SIZE entries, so that
+ * a peer device reconnecting with the same address is found right away.
+ *
+ * @param[in] addr Resolvable private address of the peer device
+ * @return If found an entry in flash, return its address as a pointer to a const BondInfo_t element
+ *         NULL otherwise
+ */
+const BondInfo_t * BondList_ResolveRPA(const uint8_t *addr);
+
 /**
  * @brief Search for the bonding information for a peer device in flash matching specified
  * address and address type.
@@ -128,9 +201,11 @@ const BondInfo_t * BondList_FindByIRK(const uint8_t *irk);
 const BondInfo_t * BondList_FindByAddr(const uint8_t *addr, uint8_t addrType);
 
 /**
- * @brief Squeeze bond information together to make space for a new entry.
+ * @brief Make space for a new entry, erasing the oldest sectors once their
+ * bond information has been moved to the free sector.
  *
  * @return True if successful, false otherwise
+ * @note Called by BondList_Add when needed.
  */
 bool BondList_FlashDefrag(void);
 
@@ -29,6 +29,11 @@ extern "C"
  *  @{
  */
 
+/** Maximum number of message handlers that can be added with MsgHandler_Add */
+#ifndef MSG_HANDLER_MAX
+#define MSG_HANDLER_MAX                 64
+#endif    /* ifndef MSG_HANDLER_MAX */
+
 /** BLE abstraction message handler function type */
 typedef void (*MsgHandlerCallback_t)(ke_msg_id_t const msgid, void const *param,
                                      ke_task_id_t const dest_id, ke_task_id_t const src_id);
@@ -54,14 +59,16 @@ const struct ke_task_desc * MsgHandler_GetTaskAppDesc(void);
  * @param [in] callback A pointer to the callback function that should be called when an
  *                      event matching msg_id happens
  * @return True if it was able to add/register the handler, false otherwise
+ *         (duplicated handler, or MSG_HANDLER_MAX handlers already added)
  */
 bool MsgHandler_Add(ke_msg_id_t const msg_id, MsgHandlerCallback_t callback);
 
 /**
  * @brief Notify the callback functions associated with the msg_id
  *
- * This function searches the list of handlers added using MsgHandler_Add and
- * notify each one with matching msg_id. <br>
+ * This function looks up the handlers added using MsgHandler_Add for the
+ * msg_id and its task with a binary search, and notifies each of them in the
+ * order they were added. <br>
  * It also makes sure to call the BLE abstraction message handlers prior to
  * any application message handler
  *
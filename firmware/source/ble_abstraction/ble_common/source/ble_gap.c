@@ -625,6 +625,7 @@ void GAPM_MsgHandler(ke_msg_id_t const msg_id, void const *param,
             {
                 GAP_Initialize();
                 GATT_Initialize();
+                BondList_Init();
             }
             else if (p->operation == GAPM_SET_DEV_CONFIG
                      && p->status == GAP_ERR_NO_ERROR)
@@ -982,14 +983,18 @@ void GAPC_MsgHandler(ke_msg_id_t const msg_id, void const *param,
             memcpy(&gap_env.connection[conidx], p,
                    sizeof(struct gapc_connection_req_ind));
             gap_env.bondInfo[conidx].state = BOND_INFO_STATE_INVALID;
-            if (!GAP_IsAddrPrivateResolvable(p->peer_addr.addr, p->peer_addr_type))
+            const BondInfo_t *bondInfo;
+            if (GAP_IsAddrPrivateResolvable(p->peer_addr.addr, p->peer_addr_type))
             {
-                const BondInfo_t *bondInfo = BondList_FindByAddr(p->peer_addr.addr,
-                                                                 p->peer_addr_type);
-                if (bondInfo)    /* Found bond info. Copy it into environment variable */
-                {
-                    memcpy(&gap_env.bondInfo[conidx], bondInfo, sizeof(BondInfo_t));
-                }
+                bondInfo = BondList_ResolveRPA(p->peer_addr.addr);
+            }
+            else
+            {
+                bondInfo = BondList_FindByAddr(p->peer_addr.addr, p->peer_addr_type);
+            }
+            if (bondInfo)    /* Found bond info. Copy it into environment variable */
+            {
+                memcpy(&gap_env.bondInfo[conidx], bondInfo, sizeof(BondInfo_t));
             }
         }
         break;
@@ -1005,6 +1010,9 @@ void GAPC_MsgHandler(ke_msg_id_t const msg_id, void const *param,
                 BondList_Remove(gap_env.bondInfo[conidx].state);
             }
             gap_env.connection[conidx].conhdl = GAP_INVALID_CONHDL;
+
+            /* Write or discard the prepared writes left by the peer */
+            GATTC_PrepWriteFlush(conidx);
         }
         break;
 
@@ -1144,42 +1152,38 @@ void WhiteList_ResolveList_Update(void)
     bdaddrwl = malloc(sizeof(struct gap_bdaddr) * nb);
     rl_devinfo = malloc(sizeof(struct gap_ral_dev_info) * nb);
 
-    /* Array to store bonding information */
-    const BondInfo_t *list = (BondInfo_t *)BOND_INFO_BASE;
-
     /* Counter for number of devices on white list */
     whitelist_info.device_num = 0;
 
     /* Iterate through the bond list and add information (addresses and address
      * types) of bonded devices to white list and resolvable list */
-    for (unsigned int i = 0; i < BONDLIST_MAX_SIZE; i++)
+    for (unsigned int i = 0; i < nb; i++)
     {
-        /* If there is bond info copy the contents to the white list and
-         * resolvable list*/
-        if ((list[i].state != BOND_INFO_STATE_EMPTY) &&
-            (list[i].state != BOND_INFO_STATE_INVALID))
+        /* Copy the bond info contents to the white list and resolvable list */
+        const BondInfo_t *bond = BondList_Get(i);
+        if (bond != NULL)
         {
-            memcpy(bdaddrwl[whitelist_info.device_num].addr.addr, list[i].addr, sizeof(list[i].addr));
-            bdaddrwl[whitelist_info.device_num].addr_type = list[i].addr_type;
+            memcpy(bdaddrwl[whitelist_info.device_num].addr.addr, bond->addr, sizeof(bond->addr));
+            bdaddrwl[whitelist_info.device_num].addr_type = bond->addr_type;
 
             /* Add to the resolvable list if the address is resolvable. */
-            if (GAPM_IsIRKValid(&list[i]) != 0)
+            if (GAPM_IsIRKValid(bond) != 0)
             {
-                memcpy(rl_devinfo[whitelist_info.device_num].addr.addr.addr, list[i].addr, sizeof(list[i].addr));
-                memcpy(rl_devinfo[whitelist_info.device_num].peer_irk, list[i].irk, sizeof(list[i].irk));
+                memcpy(rl_devinfo[whitelist_info.device_num].addr.addr.addr, bond->addr, sizeof(bond->addr));
+                memcpy(rl_devinfo[whitelist_info.device_num].peer_irk, bond->irk, sizeof(bond->irk));
                 memcpy(rl_devinfo[whitelist_info.device_num].local_irk, gap_env.deviceConfig.irk.key,
                        sizeof(gap_env.deviceConfig.irk.key));
                 rl_devinfo[whitelist_info.device_num].priv_mode = PRIV_TYPE_NETWORK;
-                rl_devinfo[whitelist_info.device_num].addr.addr_type = list[i].addr_type;
+                rl_devinfo[whitelist_info.device_num].addr.addr_type = bond->addr_type;
             }
             else
             {
                 /* No IRK exchanged, fill irk with zeros, set device privacy mode */
-                memcpy(rl_devinfo[whitelist_info.device_num].addr.addr.addr, list[i].addr, sizeof(list[i].addr));
-                memset(rl_devinfo[whitelist_info.device_num].peer_irk, 0, sizeof(list[i].irk));
+                memcpy(rl_devinfo[whitelist_info.device_num].addr.addr.addr, bond->addr, sizeof(bond->addr));
+                memset(rl_devinfo[whitelist_info.device_num].peer_irk, 0, sizeof(bond->irk));
                 memset(rl_devinfo[whitelist_info.device_num].local_irk, 0, sizeof(gap_env.deviceConfig.irk.key));
                 rl_devinfo[whitelist_info.device_num].priv_mode = PRIV_TYPE_DEVICE;
-                rl_devinfo[whitelist_info.device_num].addr.addr_type = list[i].addr_type;
+                rl_devinfo[whitelist_info.device_num].addr.addr_type = bond->addr_type;
             }
 
             /* Update the amount of devices in the white list */
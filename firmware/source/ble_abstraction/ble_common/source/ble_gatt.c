@@ -26,9 +26,322 @@ static GATT_Env_t gatt_env;
 /** Service attribute database ID */
 uint8_t svc_att_db_idx;
 
+/** Handle range of an added custom service */
+typedef struct
+{
+    uint16_t start_hdl;                     /**< Service start handle */
+    uint16_t svc_idx;                       /**< Index in the custom service database */
+    const struct att_db_desc *att_db;       /**< Service attribute database */
+    uint16_t att_db_len;                    /**< Service attribute database length */
+} GATT_HdlRange_t;
+
+/** Handle ranges of the added custom services, sorted by start handle. Built
+ * as GATTM_ADD_SVC_RSP messages arrive and only read afterwards. */
+static GATT_HdlRange_t gatt_hdl_index[GATT_HDL_INDEX_MAX];
+
+/** Number of entries in gatt_hdl_index */
+static uint16_t gatt_hdl_index_len;
+
+/** Prepared write reassembly buffer */
+typedef struct
+{
+    bool in_use;                                /**< Buffer allocated to a connection */
+    bool delivered;                             /**< Writes delivered by an execute write */
+    uint8_t conidx;                             /**< Connection index */
+    uint16_t handle;                            /**< Attribute handle */
+    uint16_t attnum;                            /**< Attribute index in its service */
+    uint16_t pending;                           /**< Writes prepared and not delivered yet */
+    uint16_t length;                            /**< End of the delivered data */
+    const struct att_db_desc *att;              /**< Attribute description */
+    uint8_t value[GATT_PREP_WRITE_BUF_SIZE];    /**< Value being reassembled */
+} GATT_PrepWrite_t;
+
+/** Prepared write reassembly buffers, shared by all connections */
+static GATT_PrepWrite_t gatt_prep_write[GATT_PREP_WRITE_BUF_COUNT];
+
+/** Connections with an execute write under way, or ended without a request
+ * since, as a bit mask */
+static uint32_t gatt_prep_write_exec;
+
 void GATT_Initialize(void)
 {
     memset(&gatt_env, 0, sizeof(GATT_Env_t));
+    gatt_hdl_index_len = 0;
+
+    for (uint8_t i = 0; i < GATT_PREP_WRITE_BUF_COUNT; i++)
+    {
+        gatt_prep_write[i].in_use = false;
+    }
+    gatt_prep_write_exec = 0;
+}
+
+/**
+ * @brief Add a custom service to the handle index
+ *
+ * Insert the handle range of a service in the sorted handle index, replacing
+ * any previous entry for the same custom service database index.
+ *
+ * @param [in] svc_idx   Index in the custom service database
+ * @param [in] start_hdl Service start handle
+ */
+static void GATT_HdlIndexAdd(uint16_t svc_idx, uint16_t start_hdl)
+{
+    uint16_t i;
+
+    /* Remove any previous entry for this service */
+    for (i = 0; i < gatt_hdl_index_len; i++)
+    {
+        if (gatt_hdl_index[i].svc_idx == svc_idx)
+        {
+            gatt_hdl_index_len--;
+            memmove(&gatt_hdl_index[i], &gatt_hdl_index[i + 1],
+                    (gatt_hdl_index_len - i) * sizeof(GATT_HdlRange_t));
+            break;
+        }
+    }
+
+    if (gatt_hdl_index_len >= GATT_HDL_INDEX_MAX)
+    {
+        return;
+    }
+
+    /* Insert keeping the index sorted by start handle */
+    for (i = gatt_hdl_index_len; i > 0 && gatt_hdl_index[i - 1].start_hdl > start_hdl; i--)
+    {
+        gatt_hdl_index[i] = gatt_hdl_index[i - 1];
+    }
+
+    gatt_hdl_index[i].start_hdl = start_hdl;
+    gatt_hdl_index[i].svc_idx = svc_idx;
+    gatt_hdl_index[i].att_db = gatt_env.cust_svc_db[svc_idx].cust_svc_att_db;
+    gatt_hdl_index[i].att_db_len = gatt_env.cust_svc_db[svc_idx].cust_svc_att_db_len;
+    gatt_hdl_index_len++;
+}
+
+/**
+ * @brief Find the custom service owning a handle
+ *
+ * Binary search the handle index for the service with the highest start
+ * handle below the handle. Does not modify any state, so it can be used for
+ * any connection.
+ *
+ * @param [in] handle Attribute handle
+ * @return Pointer to the service handle range, or NULL if the handle is not
+ *         above the start handle of any custom service
+ */
+static const GATT_HdlRange_t * GATT_HdlIndexFind(uint16_t handle)
+{
+    uint16_t low = 0;
+    uint16_t high = gatt_hdl_index_len;
+
+    while (low < high)
+    {
+        uint16_t mid = (low + high) / 2;
+        if (gatt_hdl_index[mid].start_hdl < handle)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return (low > 0) ? &gatt_hdl_index[low - 1] : NULL;
+}
+
+/**
+ * @brief Find the prepared write buffer of an attribute
+ *
+ * @param [in] conidx Connection index
+ * @param [in] handle Attribute handle
+ * @return Pointer to the reassembly buffer, or NULL if no prepared write is
+ *         pending for the attribute on this connection
+ */
+static GATT_PrepWrite_t * GATT_PrepWriteFind(uint8_t conidx, uint16_t handle)
+{
+    for (uint8_t i = 0; i < GATT_PREP_WRITE_BUF_COUNT; i++)
+    {
+        if (gatt_prep_write[i].in_use && (gatt_prep_write[i].conidx == conidx)
+            && (gatt_prep_write[i].handle == handle))
+        {
+            return &gatt_prep_write[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Commit a reassembled value to its attribute
+ *
+ * Write the value from its start to the end of the delivered data, in one
+ * go, using the attribute callback function if any, and release the buffer.
+ *
+ * @param [in] prep Reassembly buffer
+ * @return Status of the write, as returned by the attribute callback if any
+ */
+static uint8_t GATT_PrepWriteCommit(GATT_PrepWrite_t *prep)
+{
+    const struct att_db_desc *att = prep->att;
+    uint8_t status = GAP_ERR_NO_ERROR;
+
+    if (att->callback != NULL)
+    {
+        status = att->callback(prep->conidx, prep->attnum, prep->handle,
+                               att->data, prep->value, prep->length,
+                               GATTC_WRITE_REQ_IND, GAP_ERR_NO_ERROR);
+    }
+    else
+    {
+        memcpy(att->data, prep->value, prep->length);
+    }
+
+    prep->in_use = false;
+    return status;
+}
+
+/**
+ * @brief End the execute write of a connection
+ *
+ * The stack does not report the end of an execute write, nor a cancelled
+ * one, so this is called on the first request of the connection following
+ * an execute write. Values left incomplete are committed, and the prepared
+ * writes which were not delivered, cancelled by the peer, are discarded.
+ *
+ * @param [in] conidx Connection index
+ */
+static void GATT_PrepWriteEnd(uint8_t conidx)
+{
+    for (uint8_t i = 0; i < GATT_PREP_WRITE_BUF_COUNT; i++)
+    {
+        GATT_PrepWrite_t *prep = &gatt_prep_write[i];
+
+        if (prep->in_use && (prep->conidx == conidx))
+        {
+            if (prep->delivered)
+            {
+                GATT_PrepWriteCommit(prep);
+            }
+            prep->in_use = false;
+        }
+    }
+    gatt_prep_write_exec &= ~(1U << conidx);
+}
+
+/**
+ * @brief Reserve a prepared write buffer for an attribute
+ *
+ * Count one more prepared write in the buffer already reserved for the
+ * attribute, or reserve a buffer from the pool.
+ *
+ * @param [in] conidx Connection index
+ * @param [in] handle Attribute handle
+ * @param [in] attnum Attribute index in its service
+ * @param [in] att    Attribute description
+ * @return GAP_ERR_NO_ERROR, ATT_ERR_INSUFF_RESOURCE if the attribute does not
+ *         fit in a buffer or ATT_ERR_PREPARE_QUEUE_FULL if all buffers are
+ *         used
+ */
+static uint8_t GATT_PrepWritePrepare(uint8_t conidx, uint16_t handle, uint16_t attnum,
+                                     const struct att_db_desc *att)
+{
+    GATT_PrepWrite_t *prep = GATT_PrepWriteFind(conidx, handle);
+
+    if (prep == NULL)
+    {
+        if (att->length > GATT_PREP_WRITE_BUF_SIZE)
+        {
+            return ATT_ERR_INSUFF_RESOURCE;
+        }
+
+        for (uint8_t i = 0; (i < GATT_PREP_WRITE_BUF_COUNT) && (prep == NULL); i++)
+        {
+            if (!gatt_prep_write[i].in_use)
+            {
+                prep = &gatt_prep_write[i];
+            }
+        }
+
+        if (prep == NULL)
+        {
+            return ATT_ERR_PREPARE_QUEUE_FULL;
+        }
+
+        prep->in_use = true;
+        prep->delivered = false;
+        prep->conidx = conidx;
+        prep->handle = handle;
+        prep->attnum = attnum;
+        prep->pending = 0;
+        prep->length = 0;
+        prep->att = att;
+    }
+
+    prep->pending++;
+    return GAP_ERR_NO_ERROR;
+}
+
+/**
+ * @brief Reassemble a prepared write delivered by an execute write
+ *
+ * Copy the data in the reassembly buffer, which holds the current value from
+ * the first delivered write, and commit the value once the last prepared
+ * write of the attribute is delivered.
+ *
+ * @param [in] prep  Reassembly buffer
+ * @param [in] param Write request indication
+ * @return Status of the write, as returned by the attribute callback on
+ *         commit if any
+ */
+static uint8_t GATT_PrepWriteDeliver(GATT_PrepWrite_t *prep,
+                                     struct gattc_write_req_ind const *param)
+{
+    const struct att_db_desc *att = prep->att;
+
+    gatt_prep_write_exec |= 1U << prep->conidx;
+
+    /* The stack stops the execute write at the first error */
+    if (param->offset > att->length)
+    {
+        prep->in_use = false;
+        return ATT_ERR_INVALID_OFFSET;
+    }
+    if ((param->offset + param->length) > att->length)
+    {
+        prep->in_use = false;
+        return ATT_ERR_INVALID_ATTRIBUTE_VAL_LEN;
+    }
+
+    if (!prep->delivered)
+    {
+        prep->delivered = true;
+        if (att->data != NULL)
+        {
+            memcpy(prep->value, att->data, att->length);
+        }
+        else
+        {
+            memset(prep->value, 0, att->length);
+        }
+    }
+
+    memcpy(&prep->value[param->offset], param->value, param->length);
+    if ((param->offset + param->length) > prep->length)
+    {
+        prep->length = param->offset + param->length;
+    }
+
+    if (--prep->pending == 0)
+    {
+        return GATT_PrepWriteCommit(prep);
+    }
+    return GAP_ERR_NO_ERROR;
+}
+
+void GATTC_PrepWriteFlush(uint8_t conidx)
+{
+    GATT_PrepWriteEnd(conidx);
 }
 
 const GATT_Env_t * GATT_GetEnv(void)
@@ -145,6 +458,7 @@ void GATTM_MsgHandler(ke_msg_id_t const msg_id, void const *param,
                 if (gatt_env.addedSvcCount <= gatt_env.max_cust_svc)
                 {
                     gatt_env.cust_svc_db[gatt_env.addedSvcCount - 1].cust_svc_start_hdl = p->start_hdl;
+                    GATT_HdlIndexAdd(gatt_env.addedSvcCount - 1, p->start_hdl);
                 }
             }
         }
@@ -275,6 +589,7 @@ void GATTC_MsgHandler(ke_msg_id_t const msg_id, void const *param,
             }
         }
         break;
+
     }
 }
 
@@ -285,57 +600,60 @@ void GATTC_ReadReqInd(ke_msg_id_t const msg_id,
     /* Retrieve the index of environment structure representing peer device */
     signed int conidx = KE_IDX_GET(src_id);
     struct gattc_read_cfm *cfm;
-    uint8_t length = 0;
+    uint16_t length = 0;
     uint8_t status = GAP_ERR_NO_ERROR;
-    uint16_t attnum;
-    static uint16_t read_start_hdl = 0;
+    uint16_t attnum = 0;
+    const struct att_db_desc *att_db = NULL;
 
-    /* Find read_start_handle for particular param->handle */
-    for (int i = ((gatt_env.max_cust_svc) - 1); i >= 0; i--)
+    /* A request following an execute write ends it */
+    if (gatt_prep_write_exec & (1U << conidx))
     {
-        if ((param->handle) > gatt_env.cust_svc_db[i].cust_svc_start_hdl)
-        {
-            read_start_hdl = gatt_env.cust_svc_db[i].cust_svc_start_hdl;
-            gatt_env.att_db = gatt_env.cust_svc_db[i].cust_svc_att_db;
-            gatt_env.att_db_len = gatt_env.cust_svc_db[i].cust_svc_att_db_len;
-            break;
-        }
+        GATT_PrepWriteEnd(conidx);
     }
 
-    attnum = (param->handle - read_start_hdl);
+    /* Find the custom service owning param->handle */
+    const GATT_HdlRange_t *svc = GATT_HdlIndexFind(param->handle);
 
-    if (param->handle <= read_start_hdl)
+    if (svc == NULL)
     {
         status = ATT_ERR_INVALID_HANDLE;
     }
-    else if ((attnum >= gatt_env.att_db_len)
-             || !(gatt_env.att_db[attnum].att.perm
+    else if (((attnum = param->handle - svc->start_hdl) >= svc->att_db_len)
+             || !(svc->att_db[attnum].att.perm
                   & (PERM(RD, ENABLE) | PERM(NTF, ENABLE))))
     {
         status = ATT_ERR_READ_NOT_PERMITTED;
     }
     else
     {
-        length = gatt_env.att_db[attnum].length;
+        att_db = svc->att_db;
+        length = att_db[attnum].length;
+
+        /* Only allocate and copy the bytes in use for variable length values */
+        if (att_db[attnum].value_length != NULL)
+        {
+            length = MIN(att_db[attnum].value_length(conidx, attnum, param->handle), length);
+        }
     }
 
-    /* Allocate and build message */
+    /* Allocate and build message, the value is then written in place */
     cfm = KE_MSG_ALLOC_DYN(GATTC_READ_CFM, KE_BUILD_ID(TASK_GATTC, conidx),
                            TASK_APP, gattc_read_cfm, length);
 
     /* Copy the requested attribute value, using the callback function */
-    if (gatt_env.att_db[attnum].callback != NULL)
+    if (att_db == NULL)
     {
-        status = gatt_env.att_db[attnum].callback(conidx, attnum,
-                                                  param->handle, cfm->value, gatt_env.att_db[attnum].data,
-                                                  length, GATTC_READ_REQ_IND, status);
+        /* Invalid handle or attribute, nothing to copy */
+    }
+    else if (att_db[attnum].callback != NULL)
+    {
+        status = att_db[attnum].callback(conidx, attnum,
+                                         param->handle, cfm->value, att_db[attnum].data,
+                                         length, GATTC_READ_REQ_IND, status);
     }
     else    /* No callback function has been set for this attribute, just do a memcpy */
     {
-        if (status == GAP_ERR_NO_ERROR)
-        {
-            memcpy(cfm->value, gatt_env.att_db[attnum].data, length);
-        }
+        memcpy(cfm->value, att_db[attnum].data, length);
     }
 
     cfm->handle = param->handle;
@@ -355,55 +673,65 @@ void GATTC_WriteReqInd(ke_msg_id_t const msg_id,
     struct gattc_write_cfm *cfm = KE_MSG_ALLOC(GATTC_WRITE_CFM,
                                                KE_BUILD_ID(TASK_GATTC, conidx), TASK_APP, gattc_write_cfm);
     uint8_t status = GAP_ERR_NO_ERROR;
-    uint16_t attnum;
-    static uint16_t write_start_hdl = 0;
+    uint16_t attnum = 0;
+    const struct att_db_desc *att_db = NULL;
 
-    /* Find write_start_handle for particular param->handle */
-    for (int i = ((gatt_env.max_cust_svc) - 1); i >= 0; i--)
+    /* Writes to an attribute with prepared writes pending are delivered by
+     * an execute write; other requests following an execute write end it */
+    GATT_PrepWrite_t *prep = GATT_PrepWriteFind(conidx, param->handle);
+    if ((prep == NULL) && (gatt_prep_write_exec & (1U << conidx)))
     {
-        if ((param->handle) > gatt_env.cust_svc_db[i].cust_svc_start_hdl)
-        {
-            write_start_hdl = gatt_env.cust_svc_db[i].cust_svc_start_hdl;
-            gatt_env.att_db = gatt_env.cust_svc_db[i].cust_svc_att_db;
-            gatt_env.att_db_len = gatt_env.cust_svc_db[i].cust_svc_att_db_len;
-            break;
-        }
+        GATT_PrepWriteEnd(conidx);
     }
 
-    attnum = (param->handle - write_start_hdl);
+    /* Find the custom service owning param->handle */
+    const GATT_HdlRange_t *svc = GATT_HdlIndexFind(param->handle);
 
     /* Verify the correctness of the write request. Set the attribute index if
      * the request is valid */
-    if (param->offset)
-    {
-        status = ATT_ERR_INVALID_OFFSET;
-    }
-    else if (param->handle <= write_start_hdl)
+    if (svc == NULL)
     {
         status = ATT_ERR_INVALID_HANDLE;
     }
-    else if ((attnum >= gatt_env.att_db_len)
-             || !(gatt_env.att_db[attnum].att.perm
+    else if (((attnum = param->handle - svc->start_hdl) >= svc->att_db_len)
+             || !(svc->att_db[attnum].att.perm
                   & (PERM(WRITE_REQ, ENABLE) | PERM(WRITE_COMMAND, ENABLE))))
     {
         status = ATT_ERR_WRITE_NOT_PERMITTED;
     }
+    else if ((prep == NULL) && (param->offset != 0))
+    {
+        /* Only prepared writes have an offset */
+        status = ATT_ERR_INVALID_OFFSET;
+    }
+    else
+    {
+        att_db = svc->att_db;
+    }
 
     /* Copy the requested attribute value, using the callback function */
-    if (gatt_env.att_db[attnum].callback != NULL)
+    if (att_db == NULL)
+    {
+        /* Invalid request, nothing to copy */
+    }
+    else if (prep != NULL)
+    {
+        /* The value is committed with the last prepared write of the
+         * attribute, so the callback status is reported in the execute
+         * write response */
+        status = GATT_PrepWriteDeliver(prep, param);
+    }
+    else if (att_db[attnum].callback != NULL)
     {
-        status = gatt_env.att_db[attnum].callback(conidx, attnum,
-                                                  param->handle, gatt_env.att_db[attnum].data, param->value,
-                                                  MIN(param->length, gatt_env.att_db[attnum].length),
-                                                  GATTC_WRITE_REQ_IND, status);
+        status = att_db[attnum].callback(conidx, attnum,
+                                         param->handle, att_db[attnum].data, param->value,
+                                         MIN(param->length, att_db[attnum].length),
+                                         GATTC_WRITE_REQ_IND, status);
     }
     else    /* No callback function has been set for this attribute, just do a memcpy */
     {
-        if (status == GAP_ERR_NO_ERROR)
-        {
-            memcpy(gatt_env.att_db[attnum].data, param->value,
-                   MIN(param->length, gatt_env.att_db[attnum].length));
-        }
+        memcpy(att_db[attnum].data, param->value,
+               MIN(param->length, att_db[attnum].length));
     }
 
     cfm->handle = param->handle;
@@ -420,37 +748,32 @@ void GATTC_AttInfoReqInd(ke_msg_id_t const msg_id,
     /* Retrieve peer device index */
     signed int conidx = KE_IDX_GET(src_id);
     uint8_t status = GAP_ERR_NO_ERROR;
-    uint8_t length = 0;
+    uint16_t length = 0;
     uint16_t attnum;
-    static uint16_t att_info_start_hdl = 0;
 
-    /* Find att_info_start_handle for particular param->handle */
-    for (int i = ((gatt_env.max_cust_svc) - 1); i >= 0; i--)
+    /* A request following an execute write ends it */
+    if (gatt_prep_write_exec & (1U << conidx))
     {
-        if ((param->handle) > gatt_env.cust_svc_db[i].cust_svc_start_hdl)
-        {
-            att_info_start_hdl = gatt_env.cust_svc_db[i].cust_svc_start_hdl;
-            gatt_env.att_db = gatt_env.cust_svc_db[i].cust_svc_att_db;
-            gatt_env.att_db_len = gatt_env.cust_svc_db[i].cust_svc_att_db_len;
-            break;
-        }
+        GATT_PrepWriteEnd(conidx);
     }
 
-    attnum = (param->handle - att_info_start_hdl);
+    /* Find the custom service owning param->handle */
+    const GATT_HdlRange_t *svc = GATT_HdlIndexFind(param->handle);
 
-    if (param->handle <= att_info_start_hdl)
+    if (svc == NULL)
     {
         status = ATT_ERR_INVALID_OFFSET;
     }
-    else if ((attnum >= gatt_env.att_db_len)
-             || !(gatt_env.att_db[attnum].att.perm & PERM(WRITE_REQ, ENABLE)))
+    else if (((attnum = param->handle - svc->start_hdl) >= svc->att_db_len)
+             || !(svc->att_db[attnum].att.perm & PERM(WRITE_REQ, ENABLE)))
 
     {
         status = ATT_ERR_WRITE_NOT_PERMITTED;
     }
     else
     {
-        length = gatt_env.att_db[attnum].length;
+        length = svc->att_db[attnum].length;
+        status = GATT_PrepWritePrepare(conidx, param->handle, attnum, &svc->att_db[attnum]);
     }
 
     /* Attribute Information confirmation message to inform if peer
@@ -18,164 +18,1120 @@
 
 #include <string.h>
 #include <flash_rom.h>
-#include <stdlib.h>
 
 #define FLASH_ERASED_WORD_VALUE       0xFFFFFFFF
 
-BondInfo_t *BONDLIST = (BondInfo_t *)BOND_INFO_BASE;
+/** Number of words in a bond info record */
+#define BOND_INFO_WORDS               (sizeof(BondInfo_t) / 4)
 
-uint8_t BondList_Size(void)
+/** Slot value of a bond state which is not in use */
+#define BOND_INFO_SLOT_NONE           0xFFFF
+
+/** Sequence number of a record which has not been programmed */
+#define BOND_INFO_SEQ_EMPTY           0xFFFF
+
+/** Flash address of the first word of a sector */
+#define BOND_INFO_SECTOR_ADDR(sector) (BOND_INFO_BASE + (sector) * FLASH_DATA_ARRAY_SECTOR_SIZE)
+
+/** Value written after the last slot of a sector before its first record,
+ * telling the sector apart from one holding the former layout */
+#define BOND_INFO_SECTOR_MARK         0x424F4E44
+
+/** Flash address of the marker of a sector */
+#define BOND_INFO_MARK_ADDR(sector)   (BOND_INFO_SECTOR_ADDR(sector) + BOND_INFO_PER_SECTOR * sizeof(BondInfo_t))
+
+/** Flash address of the check word of a slot, which follows the marker */
+#define BOND_INFO_CHECK_ADDR(slot)    (BOND_INFO_MARK_ADDR((slot) / BOND_INFO_PER_SECTOR) + 4 \
+                                       + ((slot) % BOND_INFO_PER_SECTOR) * 4)
+
+/** Check word of an invalidated record */
+#define BOND_INFO_CHECK_CLEARED       0x00000000
+
+/** Number of records of the former layout, which were packed across sector
+ * boundaries with the state of record i set to i + 1 */
+#define BOND_INFO_LEGACY_COUNT        ((FLASH_DATA_ARRAY_SECTOR_SIZE * BOND_INFO_FLASH_SECTORS_COUNT) \
+                                       / sizeof(BondInfo_t))
+
+/** Bond list index, built from the flash contents on first use */
+static struct
 {
-    uint8_t size = 0;
+    bool built;                               /**< True once the index is built */
+    bool legacy;                              /**< True if sectors hold the former layout */
+    bool repaired;                            /**< True once the flash is in line with the index */
+    uint8_t count;                            /**< Number of valid bonds */
+    uint16_t tail;                            /**< Slot at which the next record is written */
+    uint16_t open;                            /**< Sector written to, the next one being erased */
+    uint16_t seq;                             /**< Sequence number of the newest record */
+    uint16_t slot[BONDLIST_MAX_SIZE];         /**< Slot of each bond state (state - 1) */
+    uint16_t addrHash[BONDLIST_MAX_SIZE];     /**< Hash of the peer address and type */
+    uint16_t irkHash[BONDLIST_MAX_SIZE];      /**< Hash of the IRK */
+    uint8_t rpaNext;                          /**< Cache entry replaced next */
+    struct
+    {
+        uint16_t state;                       /**< Bond state, invalid if the entry is not used */
+        uint8_t addr[GAP_BD_ADDR_LEN];        /**< Resolvable private address */
+    } rpaCache[BONDLIST_RPA_CACHE_SIZE];      /**< Recently resolved addresses */
+} bondIndex;
 
-    for (uint32_t i = 0; i < BONDLIST_MAX_SIZE; i++)
+/** Bonds of the former layout held in RAM while their sectors are erased */
+static BondInfo_t bondMigrate[BONDLIST_MAX_SIZE];
+
+/** Size of an AES block */
+#define AES_BLOCK_LEN                 16
+
+/** Number of AES-128 rounds */
+#define AES_ROUNDS                    10
+
+/** Multiplication by x in GF(2^8) */
+#define AES_XTIME(x)                  ((uint8_t)(((x) << 1) ^ ((((x) >> 7) & 1) * 0x1b)))
+
+/** AES S-box */
+static const uint8_t aesSbox[256] =
+{
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+/**
+ * @brief Get the bond info record stored in a slot
+ *
+ * @param[in] slot Slot number
+ * @return Pointer to the record in flash
+ */
+static inline const BondInfo_t * BondList_Slot(uint16_t slot)
+{
+    return (const BondInfo_t *)BOND_INFO_SLOT_ADDR(slot);
+}
+
+/**
+ * @brief Check if flash words are erased
+ *
+ * @param[in] addr  Address of the first word
+ * @param[in] words Number of words to check
+ * @return True if all the words are erased
+ */
+static bool BondList_IsErased(uint32_t addr, uint32_t words)
+{
+    const uint32_t *word = (const uint32_t *)addr;
+
+    for (uint32_t i = 0; i < words; i++)
+    {
+        if (word[i] != FLASH_ERASED_WORD_VALUE)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Compare two sequence numbers, taking wrap around into account
+ *
+ * @return True if sequence number a is newer than b
+ */
+static inline bool BondList_SeqNewer(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b) > 0;
+}
+
+/**
+ * @brief Compute a 16-bit hash of a byte array
+ *
+ * @param[in] data Bytes to hash
+ * @param[in] len  Number of bytes
+ * @param[in] seed Extra byte included in the hash
+ * @return Hash value
+ */
+static uint16_t BondList_Hash(const uint8_t *data, uint8_t len, uint8_t seed)
+{
+    uint32_t hash = 2166136261U ^ seed;
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
+/**
+ * @brief Compute the check word of a bond info record
+ *
+ * The check word is written once the record is complete, so that a record
+ * interrupted by a reset, or left partly erased, is never seen as valid.
+ *
+ * @param[in] info Bond info record
+ * @return Check word, neither erased nor cleared
+ */
+static uint32_t BondList_Check(const BondInfo_t *info)
+{
+    const uint8_t *data = (const uint8_t *)info;
+    uint32_t hash = 2166136261U;
+
+    for (uint8_t i = 0; i < sizeof(BondInfo_t); i++)
+    {
+        hash = (hash ^ data[i]) * 16777619U;
+    }
+    if ((hash == FLASH_ERASED_WORD_VALUE) || (hash == BOND_INFO_CHECK_CLEARED))
+    {
+        hash = 1;
+    }
+    return hash;
+}
+
+/**
+ * @brief Encrypt a block with AES-128
+ *
+ * The round keys are computed along with the rounds, so that no key
+ * expansion needs to be stored for each IRK.
+ *
+ * @param[in]     key   Key, most significant byte first
+ * @param[in,out] block Block to encrypt, most significant byte first
+ */
+static void BondList_Encrypt(const uint8_t *key, uint8_t *block)
+{
+    uint8_t roundKey[AES_BLOCK_LEN];
+    uint8_t state[AES_BLOCK_LEN];
+    uint8_t rcon = 0x01;
+
+    memcpy(roundKey, key, AES_BLOCK_LEN);
+    for (uint8_t i = 0; i < AES_BLOCK_LEN; i++)
+    {
+        block[i] ^= roundKey[i];
+    }
+
+    for (uint8_t round = 1; round <= AES_ROUNDS; round++)
+    {
+        /* SubBytes and ShiftRows */
+        for (uint8_t col = 0; col < 4; col++)
+        {
+            for (uint8_t row = 0; row < 4; row++)
+            {
+                state[4 * col + row] = aesSbox[block[4 * ((col + row) & 3) + row]];
+            }
+        }
+
+        /* MixColumns, except for the last round */
+        if (round < AES_ROUNDS)
+        {
+            for (uint8_t col = 0; col < 16; col += 4)
+            {
+                uint8_t a0 = state[col];
+                uint8_t a1 = state[col + 1];
+                uint8_t a2 = state[col + 2];
+                uint8_t a3 = state[col + 3];
+                uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+
+                state[col]     = a0 ^ all ^ AES_XTIME(a0 ^ a1);
+                state[col + 1] = a1 ^ all ^ AES_XTIME(a1 ^ a2);
+                state[col + 2] = a2 ^ all ^ AES_XTIME(a2 ^ a3);
+                state[col + 3] = a3 ^ all ^ AES_XTIME(a3 ^ a0);
+            }
+        }
+
+        /* Next round key */
+        roundKey[0] ^= aesSbox[roundKey[13]] ^ rcon;
+        roundKey[1] ^= aesSbox[roundKey[14]];
+        roundKey[2] ^= aesSbox[roundKey[15]];
+        roundKey[3] ^= aesSbox[roundKey[12]];
+        for (uint8_t i = 4; i < AES_BLOCK_LEN; i++)
+        {
+            roundKey[i] ^= roundKey[i - 4];
+        }
+        rcon = AES_XTIME(rcon);
+
+        /* AddRoundKey */
+        for (uint8_t i = 0; i < AES_BLOCK_LEN; i++)
+        {
+            block[i] = state[i] ^ roundKey[i];
+        }
+    }
+}
+
+/**
+ * @brief Check if an IRK resolves a resolvable private address
+ *
+ * Computes the random address hash function ah(irk, prand) of the Bluetooth
+ * Core specification and compares it with the hash part of the address.
+ *
+ * @param[in] irk  Identity resolving key, least significant byte first
+ * @param[in] addr Resolvable private address, least significant byte first
+ * @return True if the address was generated from the IRK
+ */
+static bool BondList_IrkResolves(const uint8_t *irk, const uint8_t *addr)
+{
+    uint8_t key[AES_BLOCK_LEN];
+    uint8_t block[AES_BLOCK_LEN] = { 0 };
+
+    /* The AES input and output are most significant byte first, while keys
+     * and addresses are stored least significant byte first */
+    for (uint8_t i = 0; i < AES_BLOCK_LEN; i++)
+    {
+        key[i] = irk[AES_BLOCK_LEN - 1 - i];
+    }
+
+    /* prand is in the upper 3 bytes of the address, padded with zeros */
+    block[AES_BLOCK_LEN - 3] = addr[5];
+    block[AES_BLOCK_LEN - 2] = addr[4];
+    block[AES_BLOCK_LEN - 1] = addr[3];
+
+    BondList_Encrypt(key, block);
+
+    /* The hash is the lower 3 bytes of the result */
+    return (block[AES_BLOCK_LEN - 1] == addr[0]) && (block[AES_BLOCK_LEN - 2] == addr[1])
+           && (block[AES_BLOCK_LEN - 3] == addr[2]);
+}
+
+/**
+ * @brief Record the slot of a bond in the index
+ *
+ * @param[in] state Bond state
+ * @param[in] slot  Slot holding the bond information
+ */
+static void BondList_IndexSet(uint16_t state, uint16_t slot)
+{
+    const BondInfo_t *info = BondList_Slot(slot);
+
+    bondIndex.slot[state - 1] = slot;
+    bondIndex.addrHash[state - 1] = BondList_Hash(info->addr, GAP_BD_ADDR_LEN, info->addr_type);
+    bondIndex.irkHash[state - 1] = BondList_Hash(info->irk, GAP_KEY_LEN, 0);
+}
+
+/**
+ * @brief Check if a sector holds records of the former layout
+ *
+ * Sectors of the current layout are marked before their first record is
+ * written, so a sector which is neither marked nor blank holds the former
+ * layout.
+ *
+ * @param[in] sector Sector number
+ * @return True if the sector holds records of the former layout
+ */
+static bool BondList_SectorLegacy(uint16_t sector)
+{
+    return (*(const uint32_t *)BOND_INFO_MARK_ADDR(sector) != BOND_INFO_SECTOR_MARK)
+           && !BondList_IsErased(BOND_INFO_SECTOR_ADDR(sector), DATA_SECTOR_LEN_WORDS);
+}
+
+/**
+ * @brief Check if a slot holds a valid bond info record
+ *
+ * @param[in] slot Slot number
+ * @return True if the record is complete and has not been invalidated
+ */
+static bool BondList_SlotValid(uint16_t slot)
+{
+    const BondInfo_t *info = BondList_Slot(slot);
+
+    return (*(const uint32_t *)BOND_INFO_MARK_ADDR(slot / BOND_INFO_PER_SECTOR) == BOND_INFO_SECTOR_MARK)
+           && BOND_INFO_STATE_VALID(info->state)
+           && (*(const uint32_t *)BOND_INFO_CHECK_ADDR(slot) == BondList_Check(info));
+}
+
+/**
+ * @brief Check if a slot holds a record which was completely written
+ *
+ * @param[in] slot Slot number
+ * @return True if the record is valid or was invalidated
+ */
+static bool BondList_SlotWritten(uint16_t slot)
+{
+    uint32_t mark = *(const uint32_t *)BOND_INFO_MARK_ADDR(slot / BOND_INFO_PER_SECTOR);
+    uint32_t check = *(const uint32_t *)BOND_INFO_CHECK_ADDR(slot);
+
+    return BondList_SlotValid(slot)
+           || ((mark == BOND_INFO_SECTOR_MARK) && (check == BOND_INFO_CHECK_CLEARED)
+               && (BondList_Slot(slot)->state == BOND_INFO_STATE_INVALID));
+}
+
+/**
+ * @brief Check if a slot is blank
+ *
+ * @param[in] slot Slot number
+ * @return True if the record and its check word are erased
+ */
+static bool BondList_SlotBlank(uint16_t slot)
+{
+    return BondList_IsErased(BOND_INFO_SLOT_ADDR(slot), BOND_INFO_WORDS)
+           && BondList_IsErased(BOND_INFO_CHECK_ADDR(slot), 1);
+}
+
+/**
+ * @brief Invalidate a bond info record
+ *
+ * The check word is cleared first, so that a reset leaves the record
+ * invalid whichever bits of the state are cleared. The state is cleared
+ * too, so that the record is never taken for one of the former layout if a
+ * reset interrupts the erase of its sector.
+ *
+ * @param[in] slot Slot number
+ * @return True if successful, false otherwise
+ */
+static bool BondList_Invalidate(uint16_t slot)
+{
+    return ((*(const uint32_t *)BOND_INFO_CHECK_ADDR(slot) == BOND_INFO_CHECK_CLEARED)
+            || (Flash_WriteWord(BOND_INFO_CHECK_ADDR(slot), BOND_INFO_CHECK_CLEARED, 0) == FLASH_ERR_NONE))
+           && ((BondList_Slot(slot)->state == BOND_INFO_STATE_INVALID)
+               || (Flash_WriteWord(BOND_INFO_SLOT_ADDR(slot), BOND_INFO_STATE_INVALID, 0) == FLASH_ERR_NONE));
+}
+
+/**
+ * @brief Erase a sector of the current layout
+ *
+ * The records which are not blank are invalidated first, as a reset during
+ * the erase leaves some of their words in place.
+ *
+ * @param[in] sector Sector number
+ * @return True if successful, false otherwise
+ */
+static bool BondList_EraseSector(uint16_t sector)
+{
+    uint16_t first = sector * BOND_INFO_PER_SECTOR;
+
+    for (uint16_t slot = first; slot < (first + BOND_INFO_PER_SECTOR); slot++)
+    {
+        if (!BondList_SlotBlank(slot) && !BondList_Invalidate(slot))
+        {
+            return false;
+        }
+    }
+    return Flash_EraseSector(BOND_INFO_SECTOR_ADDR(sector), 0) == FLASH_ERR_NONE;
+}
+
+/**
+ * @brief Find a blank slot in the tail sector
+ *
+ * @return True if bondIndex.tail is a blank slot, false if the rest of the
+ *         tail sector is not blank
+ */
+static bool BondList_TailBlank(void)
+{
+    bondIndex.tail %= BONDLIST_SLOT_COUNT;
+
+    uint16_t sectorEnd = (bondIndex.tail / BOND_INFO_PER_SECTOR + 1) * BOND_INFO_PER_SECTOR;
+
+    while (bondIndex.tail < sectorEnd)
+    {
+        if (BondList_SlotBlank(bondIndex.tail))
+        {
+            return true;
+        }
+        bondIndex.tail++;
+    }
+    return false;
+}
+
+/**
+ * @brief Write a bond info record at the tail
+ *
+ * The sector is marked before its first record is written, and the check
+ * word of the record is written last, so that a record interrupted by a
+ * reset is never seen as valid.
+ *
+ * @param[in] bond_info Bond information to write
+ * @param[in] state     Bond state
+ * @return True if successful, false otherwise
+ */
+static bool BondList_Program(const BondInfo_t *bond_info, uint16_t state)
+{
+    BondInfo_t record;
+
+    if (!BondList_TailBlank())
+    {
+        return false;
+    }
+
+    uint32_t addr = BOND_INFO_SLOT_ADDR(bondIndex.tail);
+    uint32_t mark = BOND_INFO_MARK_ADDR(bondIndex.tail / BOND_INFO_PER_SECTOR);
+
+    if (BondList_IsErased(mark, 1)
+        && (Flash_WriteWord(mark, BOND_INFO_SECTOR_MARK, 0) != FLASH_ERR_NONE))
     {
-        if (BOND_INFO_STATE_VALID(BONDLIST[i].state))
+        return false;
+    }
+
+    memcpy(&record, bond_info, sizeof(BondInfo_t));
+    record.state = state;
+    if (++bondIndex.seq == BOND_INFO_SEQ_EMPTY)
+    {
+        bondIndex.seq++;
+    }
+    record.seq = bondIndex.seq;
+
+    if ((Flash_WriteBuffer(addr, BOND_INFO_WORDS, (uint32_t *)&record, 0) != FLASH_ERR_NONE)
+        || (Flash_WriteWord(BOND_INFO_CHECK_ADDR(bondIndex.tail), BondList_Check(&record),
+                            0) != FLASH_ERR_NONE))
+    {
+        /* Skip the partly written slot */
+        bondIndex.tail++;
+        return false;
+    }
+
+    BondList_IndexSet(state, bondIndex.tail);
+    bondIndex.tail++;
+    return true;
+}
+
+/**
+ * @brief Check if a slot holds the current copy of a bond
+ *
+ * @param[in] slot Slot number
+ * @return True if the slot holds a valid bond which is in the index
+ */
+static inline bool BondList_SlotLive(uint16_t slot)
+{
+    uint16_t state = BondList_Slot(slot)->state;
+
+    return BOND_INFO_STATE_VALID(state) && (bondIndex.slot[state - 1] == slot);
+}
+
+/**
+ * @brief Find a blank slot outside of a sector
+ *
+ * The blank slots left in the tail sector are used first, then those of the
+ * other sectors. If there are none, which only happens when a reset
+ * interrupted a previous move, a sector holding no valid bond is erased.
+ *
+ * @param[in] sector Sector which is not to be written
+ * @return True if bondIndex.tail is a blank slot outside of the sector
+ */
+static bool BondList_FindRoom(uint16_t sector)
+{
+    if (BondList_TailBlank() && ((bondIndex.tail / BOND_INFO_PER_SECTOR) != sector))
+    {
+        return true;
+    }
+
+    for (uint16_t slot = 0; slot < BONDLIST_SLOT_COUNT; slot++)
+    {
+        if (((slot / BOND_INFO_PER_SECTOR) != sector) && BondList_SlotBlank(slot))
+        {
+            bondIndex.tail = slot;
+            return true;
+        }
+    }
+
+    for (uint16_t other = 0; other < BOND_INFO_FLASH_SECTORS_COUNT; other++)
+    {
+        uint16_t first = other * BOND_INFO_PER_SECTOR;
+        uint16_t live = 0;
+
+        for (uint16_t slot = first; slot < (first + BOND_INFO_PER_SECTOR); slot++)
+        {
+            live += BondList_SlotLive(slot) ? 1 : 0;
+        }
+
+        if ((other != sector) && (live == 0))
+        {
+            bondIndex.tail = first;
+            return BondList_EraseSector(other);
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Erase a sector, copying its valid bonds to other sectors first
+ *
+ * The bonds are copied to the blank slots left in the sector written to, or
+ * to other blank slots if there are not enough of them. The sector is only
+ * erased once each of its bonds has a newer copy in flash, so a reset at any
+ * point does not lose a bond: the older copy is dropped when the index is
+ * built again.
+ *
+ * @param[in] sector Sector number
+ * @return True if successful, false otherwise
+ */
+static bool BondList_Reclaim(uint16_t sector)
+{
+    uint16_t first = sector * BOND_INFO_PER_SECTOR;
+
+    for (uint16_t slot = first; slot < (first + BOND_INFO_PER_SECTOR); slot++)
+    {
+        /* Only move the current copy of each bond */
+        if (BondList_SlotLive(slot)
+            && (!BondList_FindRoom(sector)
+                || !BondList_Program(BondList_Slot(slot), BondList_Slot(slot)->state)))
         {
-            size++;
+            return false;
         }
     }
-    return (size);
+
+    if (BondList_IsErased(BOND_INFO_SECTOR_ADDR(sector), DATA_SECTOR_LEN_WORDS))
+    {
+        return true;
+    }
+    return BondList_EraseSector(sector);
+}
+
+/**
+ * @brief Build the bond list index from the flash contents
+ *
+ * Only reads the flash: the older copy of a bond found twice is left in
+ * place, as are sectors holding the former layout, whose records are not
+ * indexed until BondList_Repair converts them.
+ */
+static void BondList_IndexBuild(void)
+{
+    uint16_t newest = BOND_INFO_SLOT_NONE;
+
+    memset(&bondIndex, 0, sizeof(bondIndex));
+    for (uint16_t i = 0; i < BONDLIST_MAX_SIZE; i++)
+    {
+        bondIndex.slot[i] = BOND_INFO_SLOT_NONE;
+    }
+
+    for (uint16_t slot = 0; slot < BONDLIST_SLOT_COUNT; slot++)
+    {
+        const BondInfo_t *info = BondList_Slot(slot);
+
+        if (BondList_SectorLegacy(slot / BOND_INFO_PER_SECTOR))
+        {
+            bondIndex.legacy = true;
+            continue;
+        }
+
+        /* Records interrupted by a reset are skipped */
+        if (BondList_SlotWritten(slot)
+            && ((newest == BOND_INFO_SLOT_NONE) || BondList_SeqNewer(info->seq, bondIndex.seq)))
+        {
+            newest = slot;
+            bondIndex.seq = info->seq;
+        }
+
+        if (!BondList_SlotValid(slot))
+        {
+            continue;
+        }
+
+        /* A bond can be found twice if a reset occurred while its sector was
+         * being erased: keep the newest copy */
+        uint16_t current = bondIndex.slot[info->state - 1];
+        if (current == BOND_INFO_SLOT_NONE)
+        {
+            BondList_IndexSet(info->state, slot);
+            bondIndex.count++;
+        }
+        else if (BondList_SeqNewer(info->seq, BondList_Slot(current)->seq))
+        {
+            BondList_IndexSet(info->state, slot);
+        }
+    }
+
+    if (newest != BOND_INFO_SLOT_NONE)
+    {
+        bondIndex.tail = (newest + 1) % BONDLIST_SLOT_COUNT;
+        bondIndex.open = newest / BOND_INFO_PER_SECTOR;
+    }
+    bondIndex.built = true;
+}
+
+/**
+ * @brief Get the bond list index, building it if needed
+ */
+static inline void BondList_Index(void)
+{
+    if (!bondIndex.built)
+    {
+        BondList_IndexBuild();
+    }
+}
+
+/**
+ * @brief Check if a record of the former layout holds a bond to be converted
+ *
+ * Records partly erased by an interrupted conversion, and those already
+ * converted, are skipped. As the current layout holds fewer bonds, only the
+ * first ones are converted.
+ *
+ * @param[in] i Record number in the former layout
+ * @return True if the record holds a bond which is to be converted
+ */
+static bool BondList_LegacyPending(uint16_t i)
+{
+    const BondInfo_t *legacy = (const BondInfo_t *)BOND_INFO_BASE;
+    uint16_t rank = 0;
+
+    for (uint16_t j = 0; j <= i; j++)
+    {
+        uint32_t offset = j * sizeof(BondInfo_t);
+        bool pending = (legacy[j].state == (j + 1))
+                       && BondList_SectorLegacy(offset / FLASH_DATA_ARRAY_SECTOR_SIZE)
+                       && BondList_SectorLegacy((offset + sizeof(BondInfo_t) - 1)
+                                                / FLASH_DATA_ARRAY_SECTOR_SIZE)
+                       && (BondList_FindByAddr(legacy[j].addr, legacy[j].addr_type) == NULL);
+
+        if (j == i)
+        {
+            return pending && ((bondIndex.count + rank) < BONDLIST_MAX_SIZE);
+        }
+        rank += pending ? 1 : 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the records of the former layout overlapping a sector
+ *
+ * @param[in]  sector Sector number
+ * @param[out] first  First record overlapping the sector
+ * @return Number of the record following the last one overlapping the sector
+ */
+static uint16_t BondList_LegacyRange(uint16_t sector, uint16_t *first)
+{
+    uint16_t end = ((sector + 1) * FLASH_DATA_ARRAY_SECTOR_SIZE + sizeof(BondInfo_t) - 1)
+                   / sizeof(BondInfo_t);
+
+    *first = (sector * FLASH_DATA_ARRAY_SECTOR_SIZE) / sizeof(BondInfo_t);
+    return (end < BOND_INFO_LEGACY_COUNT) ? end : BOND_INFO_LEGACY_COUNT;
+}
+
+/**
+ * @brief Find a blank slot for a converted record
+ *
+ * @return True if bondIndex.tail is a blank slot outside of the sectors
+ *         holding the former layout
+ */
+static bool BondList_LegacyRoom(void)
+{
+    for (uint16_t slot = 0; slot < BONDLIST_SLOT_COUNT; slot++)
+    {
+        if (!BondList_SectorLegacy(slot / BOND_INFO_PER_SECTOR) && BondList_SlotBlank(slot))
+        {
+            bondIndex.tail = slot;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Write a converted record, with the first free bond state
+ *
+ * @param[in] bond_info Bond information of the former layout
+ * @return True if successful, false otherwise
+ */
+static bool BondList_LegacyConvert(const BondInfo_t *bond_info)
+{
+    uint16_t state;
+
+    for (state = 1; bondIndex.slot[state - 1] != BOND_INFO_SLOT_NONE; state++)
+    {
+    }
+
+    if (!BondList_LegacyRoom() || !BondList_Program(bond_info, state))
+    {
+        return false;
+    }
+    bondIndex.count++;
+    return true;
+}
+
+/**
+ * @brief Erase a sector holding the former layout
+ *
+ * The records overlapping the sector are invalidated first, so that a record
+ * partly erased by a reset is not taken for a bond.
+ *
+ * @param[in] sector Sector number
+ * @return True if successful, false otherwise
+ */
+static bool BondList_LegacyErase(uint16_t sector)
+{
+    const BondInfo_t *legacy = (const BondInfo_t *)BOND_INFO_BASE;
+    uint16_t first;
+    uint16_t end = BondList_LegacyRange(sector, &first);
+
+    for (uint16_t i = first; i < end; i++)
+    {
+        if ((legacy[i].state != BOND_INFO_STATE_INVALID)
+            && BondList_SectorLegacy((i * sizeof(BondInfo_t)) / FLASH_DATA_ARRAY_SECTOR_SIZE)
+            && (Flash_WriteWord((uint32_t)&legacy[i], BOND_INFO_STATE_INVALID, 0) != FLASH_ERR_NONE))
+        {
+            return false;
+        }
+    }
+    return Flash_EraseSector(BOND_INFO_SECTOR_ADDR(sector), 0) == FLASH_ERR_NONE;
+}
+
+/**
+ * @brief Convert the records of the former layout
+ *
+ * The sectors are freed one at a time: the bonds of a sector are copied to
+ * blank slots of the current layout, then the sector is erased, so that a
+ * reset at any point does not lose a bond and the conversion resumes on next
+ * boot. Only when there are not enough blank slots for the bonds of any
+ * sector, which happens when the former layout used all of them, are the
+ * bonds of the sector holding the fewest kept in a static buffer while it
+ * is erased (those of all the sectors, if they still do not fit). Bonds
+ * beyond BONDLIST_MAX_SIZE are dropped.
+ *
+ * @return True if successful, false otherwise
+ */
+static bool BondList_Migrate(void)
+{
+    const BondInfo_t *legacy = (const BondInfo_t *)BOND_INFO_BASE;
+    uint16_t first;
+    uint16_t end;
+
+    for (;;)
+    {
+        uint16_t room = 0;
+        uint16_t fewest = UINT16_MAX;
+        int16_t best = -1;
+
+        for (uint16_t slot = 0; slot < BONDLIST_SLOT_COUNT; slot++)
+        {
+            room += (!BondList_SectorLegacy(slot / BOND_INFO_PER_SECTOR)
+                     && BondList_SlotBlank(slot)) ? 1 : 0;
+        }
+
+        /* Find the sector holding the fewest bonds, starting from the end
+         * where the former layout left the fewest records */
+        for (int16_t sector = BOND_INFO_FLASH_SECTORS_COUNT - 1; sector >= 0; sector--)
+        {
+            uint16_t pending = 0;
+
+            if (!BondList_SectorLegacy(sector))
+            {
+                continue;
+            }
+
+            end = BondList_LegacyRange(sector, &first);
+            for (uint16_t i = first; i < end; i++)
+            {
+                pending += BondList_LegacyPending(i) ? 1 : 0;
+            }
+            if (pending < fewest)
+            {
+                best = sector;
+                fewest = pending;
+            }
+        }
+
+        if (best < 0)
+        {
+            return true;
+        }
+
+        if (fewest <= room)
+        {
+            end = BondList_LegacyRange(best, &first);
+            for (uint16_t i = first; i < end; i++)
+            {
+                if (BondList_LegacyPending(i) && !BondList_LegacyConvert(&legacy[i]))
+                {
+                    return false;
+                }
+            }
+
+            if (!BondList_LegacyErase(best))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        /* Back up the bonds while erasing. At most BONDLIST_MAX_SIZE - count
+         * bonds are pending, see BondList_LegacyPending. */
+        bool all = (fewest > (room + BOND_INFO_PER_SECTOR));
+        uint8_t count = 0;
+        bool result = true;
+
+        end = BondList_LegacyRange(best, &first);
+        for (uint16_t i = 0; i < BOND_INFO_LEGACY_COUNT; i++)
+        {
+            if ((all || ((i >= first) && (i < end))) && BondList_LegacyPending(i))
+            {
+                memcpy(&bondMigrate[count++], &legacy[i], sizeof(BondInfo_t));
+            }
+        }
+
+        for (uint16_t sector = 0; (sector < BOND_INFO_FLASH_SECTORS_COUNT) && result; sector++)
+        {
+            if ((all || (sector == best)) && BondList_SectorLegacy(sector))
+            {
+                result = BondList_LegacyErase(sector);
+            }
+        }
+
+        for (uint8_t i = 0; (i < count) && result; i++)
+        {
+            result = BondList_LegacyConvert(&bondMigrate[i]);
+        }
+
+        if (!result)
+        {
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Bring the flash contents in line with the bond list index
+ *
+ * Converts the records of the former layout, invalidates the older copy of
+ * the bonds found twice and finishes erasing the sector following the one
+ * written to, as a reset can leave them. Called before writing to the bond
+ * list, so that searches never write to flash.
+ *
+ * @return True if successful, false otherwise
+ */
+static bool BondList_Repair(void)
+{
+    BondList_Index();
+    if ((Flash_IsErasing != NULL) && Flash_IsErasing(BOND_INFO_BASE))
+    {
+        return false;
+    }
+    if (bondIndex.repaired)
+    {
+        return true;
+    }
+
+    if (bondIndex.legacy)
+    {
+        if (!BondList_Migrate())
+        {
+            return false;
+        }
+        BondList_IndexBuild();
+    }
+
+    for (uint16_t slot = 0; slot < BONDLIST_SLOT_COUNT; slot++)
+    {
+        if (BondList_SlotValid(slot) && !BondList_SlotLive(slot) && !BondList_Invalidate(slot))
+        {
+            return false;
+        }
+    }
+
+    /* The sector following the one written to is kept erased. If there is
+     * no room to move its bonds, they are left in place and
+     * BondList_FlashDefrag tries again when more room is needed. */
+    BondList_Reclaim((bondIndex.open + 1) % BOND_INFO_FLASH_SECTORS_COUNT);
+    bondIndex.repaired = true;
+    return true;
+}
+
+bool BondList_Init(void)
+{
+    bondIndex.built = false;
+    return BondList_Repair();
+}
+
+uint8_t BondList_Size(void)
+{
+    BondList_Index();
+    return (bondIndex.count);
 }
 
 uint8_t BondList_GetIRKs(struct gap_sec_key *irks)
 {
     uint8_t numKeys = 0;
+
+    BondList_Index();
     for (uint32_t i = 0; i < BONDLIST_MAX_SIZE; i++)
     {
-        if (BOND_INFO_STATE_VALID(BONDLIST[i].state))
+        if (bondIndex.slot[i] != BOND_INFO_SLOT_NONE)
         {
-            memcpy(&irks[numKeys++], BONDLIST[i].irk, GAP_KEY_LEN);
+            memcpy(&irks[numKeys++], BondList_Slot(bondIndex.slot[i])->irk, GAP_KEY_LEN);
         }
     }
     return (numKeys);
 }
 
-const BondInfo_t * BondList_FindByIRK(const uint8_t *irk)
+const BondInfo_t * BondList_Get(uint8_t index)
 {
-    for (uint8_t i = 0; i < BONDLIST_MAX_SIZE; i++)
+    BondList_Index();
+    for (uint32_t i = 0; i < BONDLIST_MAX_SIZE; i++)
     {
-        /* If bond info is valid and address match */
-        if ((BOND_INFO_STATE_VALID(BONDLIST[i].state))
-            && (memcmp(BONDLIST[i].irk, irk, GAP_KEY_LEN) == 0))
+        if ((bondIndex.slot[i] != BOND_INFO_SLOT_NONE) && (index-- == 0))
         {
-            return &BONDLIST[i];
+            return BondList_Slot(bondIndex.slot[i]);
         }
     }
     return NULL;
 }
 
-const BondInfo_t * BondList_FindByAddr(const uint8_t *addr, uint8_t addrType)
+const BondInfo_t * BondList_FindByIRK(const uint8_t *irk)
 {
-    for (uint8_t i = 0; i < BONDLIST_MAX_SIZE; i++)
+    uint16_t hash = BondList_Hash(irk, GAP_KEY_LEN, 0);
+
+    BondList_Index();
+    for (uint32_t i = 0; i < BONDLIST_MAX_SIZE; i++)
     {
-        /* If bond info is valid and address match */
-        if ((BOND_INFO_STATE_VALID(BONDLIST[i].state))
-            && (BONDLIST[i].addr_type == addrType)
-            && (memcmp(BONDLIST[i].addr, addr, GAP_BD_ADDR_LEN) == 0))
+        /* If bond info is valid and IRK match */
+        if ((bondIndex.slot[i] != BOND_INFO_SLOT_NONE) && (bondIndex.irkHash[i] == hash)
+            && (memcmp(BondList_Slot(bondIndex.slot[i])->irk, irk, GAP_KEY_LEN) == 0))
         {
-            return &BONDLIST[i];
+            return BondList_Slot(bondIndex.slot[i]);
         }
     }
     return NULL;
 }
 
-bool BondList_FlashDefrag(void)
+const BondInfo_t * BondList_ResolveRPA(const uint8_t *addr)
 {
-    uint32_t flash_status = 0;
+    BondList_Index();
 
-    /* Allocate temporary memory to back up Flash before erasing the sector */
-    BondInfo_t *flashTemp = malloc(sizeof(BondInfo_t) * (BondList_Size()));
-    if (!flashTemp)
+    /* Only addresses with the two most significant bits set to 0b01 are
+     * resolvable */
+    if ((addr[GAP_BD_ADDR_LEN - 1] & 0xc0) != 0x40)
     {
-        return false;    /* Malloc failed. Not enough heap */
+        return NULL;
     }
 
-    /* Copy/squeeze valid entries together into temp buffer in RAM */
-    uint8_t copied = 0;
-    for (uint8_t i = 0; i < BONDLIST_MAX_SIZE; i++)
+    /* Entries are cleared when their bond is removed */
+    for (uint8_t i = 0; i < BONDLIST_RPA_CACHE_SIZE; i++)
     {
-        if (BOND_INFO_STATE_VALID(BONDLIST[i].state))
+        if ((bondIndex.rpaCache[i].state != BOND_INFO_STATE_INVALID)
+            && (memcmp(bondIndex.rpaCache[i].addr, addr, GAP_BD_ADDR_LEN) == 0))
         {
-            /* Read bond_info entry from Flash */
-            memcpy(&flashTemp[copied], &BONDLIST[i], sizeof(BondInfo_t));
-
-            /* Update STATE field with new index */
-            flashTemp[copied].state = copied + 1;
-            copied++;
+            return BondList_Slot(bondIndex.slot[bondIndex.rpaCache[i].state - 1]);
         }
     }
 
-    if (!BondList_RemoveAll())    /* Error erasing Flash */
+    for (uint32_t i = 0; i < BONDLIST_MAX_SIZE; i++)
     {
-        /* Free temporary memory used to back up Flash (if any) */
-        free(flashTemp);
-        return false;
+        if (bondIndex.slot[i] == BOND_INFO_SLOT_NONE)
+        {
+            continue;
+        }
+
+        const BondInfo_t *info = BondList_Slot(bondIndex.slot[i]);
+
+        /* Without an IRK, the address of the peer device cannot be resolved */
+        if ((info->irk_exchanged != 0) && BondList_IrkResolves(info->irk, addr))
+        {
+            bondIndex.rpaCache[bondIndex.rpaNext].state = i + 1;
+            memcpy(bondIndex.rpaCache[bondIndex.rpaNext].addr, addr, GAP_BD_ADDR_LEN);
+            bondIndex.rpaNext = (bondIndex.rpaNext + 1) % BONDLIST_RPA_CACHE_SIZE;
+            return info;
+        }
     }
+    return NULL;
+}
 
-    /* Write bond info back to Flash */
-    flash_status = Flash_WriteBuffer((uint32_t)BONDLIST,
-                                     (copied * sizeof(BondInfo_t)) / 4, (uint32_t *)flashTemp, 0)
-                   == FLASH_ERR_NONE;
+const BondInfo_t * BondList_FindByAddr(const uint8_t *addr, uint8_t addrType)
+{
+    uint16_t hash = BondList_Hash(addr, GAP_BD_ADDR_LEN, addrType);
 
-    /* Free temporary memory used to back up Flash (if any) */
-    free(flashTemp);
-    return flash_status;
+    BondList_Index();
+    for (uint32_t i = 0; i < BONDLIST_MAX_SIZE; i++)
+    {
+        /* If bond info is valid and address match */
+        if ((bondIndex.slot[i] != BOND_INFO_SLOT_NONE) && (bondIndex.addrHash[i] == hash)
+            && (BondList_Slot(bondIndex.slot[i])->addr_type == addrType)
+            && (memcmp(BondList_Slot(bondIndex.slot[i])->addr, addr, GAP_BD_ADDR_LEN) == 0))
+        {
+            return BondList_Slot(bondIndex.slot[i]);
+        }
+    }
+    return NULL;
 }
 
-uint16_t BondList_Add(BondInfo_t *bond_info)
+bool BondList_FlashDefrag(void)
 {
-    if (BondList_Size() >= BONDLIST_MAX_SIZE)
+    if (!BondList_Repair())
     {
-        return BOND_INFO_STATE_INVALID;
+        return false;
     }
 
-    /* If there is free space at least in the end of the reserved flash
-     * area (i.e. we don't need to squeeze entries together) */
-    if (BONDLIST[BONDLIST_MAX_SIZE - 1].state == BOND_INFO_STATE_EMPTY)
+    /* On entering a new sector, erase the one after it, which holds the
+     * oldest records, moving its bonds to the new sector first. As there are
+     * fewer bonds than slots outside of the erased sector, a blank slot is
+     * found before going all the way around. */
+    for (uint16_t i = 0; i <= BOND_INFO_FLASH_SECTORS_COUNT; i++)
     {
-        BondInfo_t bond_info_to_write;
-        memcpy(&bond_info_to_write, bond_info, sizeof(BondInfo_t));
+        bool blank = BondList_TailBlank();
+        uint16_t sector;
 
-        /* Search for the first available position in Flash */
-        for (uint8_t i = 0; i < BONDLIST_MAX_SIZE; i++)
+        bondIndex.tail %= BONDLIST_SLOT_COUNT;
+        sector = bondIndex.tail / BOND_INFO_PER_SECTOR;
+        if (sector != bondIndex.open)
         {
-            if (BONDLIST[i].state == BOND_INFO_STATE_EMPTY)
+            bondIndex.open = sector;
+            if (!BondList_Reclaim((sector + 1) % BOND_INFO_FLASH_SECTORS_COUNT))
             {
-                bond_info_to_write.state = i + 1;    /* Update STATE field with new index */
-                if (Flash_WriteBuffer((uint32_t)&BONDLIST[i],
-                                      sizeof(BondInfo_t) / 4, (uint32_t *)&bond_info_to_write,
-                                      0) != FLASH_ERR_NONE)
-                {
-                    return BOND_INFO_STATE_INVALID;
-                }
-                return bond_info_to_write.state;
+                return false;
             }
         }
-    }
-    else    /* Need to squeeze the bond info together to make space for a new entry */
-    {
-        if (BondList_FlashDefrag())
+        else if (blank)
         {
-            return BondList_Add(bond_info);
+            return true;
         }
     }
-    return BOND_INFO_STATE_INVALID;
+    return false;
+}
+
+uint16_t BondList_Add(BondInfo_t *bond_info)
+{
+    uint16_t state;
+
+    /* Repairing the flash may convert bonds of the former layout */
+    if (!BondList_Repair() || (bondIndex.count >= BONDLIST_MAX_SIZE))
+    {
+        return BOND_INFO_STATE_INVALID;
+    }
+
+    /* Use the first free bond state */
+    for (state = 1; bondIndex.slot[state - 1] != BOND_INFO_SLOT_NONE; state++)
+    {
+    }
+
+    if (!BondList_FlashDefrag() || !BondList_Program(bond_info, state))
+    {
+        return BOND_INFO_STATE_INVALID;
+    }
+    bondIndex.count++;
+    return state;
 }
 
 bool BondList_Remove(uint16_t bond_info_state_index)
 {
     bool result = false;
-    if (BOND_INFO_STATE_VALID(bond_info_state_index) &&
-        BOND_INFO_STATE_VALID(BONDLIST[bond_info_state_index - 1].state))
+
+    if (BondList_Repair() && BOND_INFO_STATE_VALID(bond_info_state_index) &&
+        (bondIndex.slot[bond_info_state_index - 1] != BOND_INFO_SLOT_NONE))
     {
-        /* Flash address where the bonding information will be invalidated */
-        uint32_t *addr = (uint32_t *)&BONDLIST[bond_info_state_index - 1];
+        /* Invalidate the old bonding information stored in Flash, including
+         * the older copies left by a move which could not be completed */
+        result = true;
+        for (uint16_t slot = 0; (slot < BONDLIST_SLOT_COUNT) && result; slot++)
+        {
+            if (BondList_SlotValid(slot) && (BondList_Slot(slot)->state == bond_info_state_index))
+            {
+                result = BondList_Invalidate(slot);
+            }
+        }
+        if (result)
+        {
+            bondIndex.slot[bond_info_state_index - 1] = BOND_INFO_SLOT_NONE;
+            bondIndex.count--;
 
-        /* Invalidate the state for the old bonding information stored in
-         * Flash by clearing the first word. */
-        result = (Flash_WriteWord((unsigned int)addr, BOND_INFO_STATE_INVALID,
-                                  0) == FLASH_ERR_NONE);
+            /* The bond state may be given to another bond */
+            for (uint8_t i = 0; i < BONDLIST_RPA_CACHE_SIZE; i++)
+            {
+                if (bondIndex.rpaCache[i].state == bond_info_state_index)
+                {
+                    bondIndex.rpaCache[i].state = BOND_INFO_STATE_INVALID;
+                }
+            }
+        }
     }
     return result;
 }
@@ -185,15 +1141,25 @@ bool BondList_RemoveAll(void)
     uint32_t i;
     uint32_t sector_start_addr;
 
+    if ((Flash_IsErasing != NULL) && Flash_IsErasing(BOND_INFO_BASE))
+    {
+        return false;
+    }
+
+    /* The index is built again on next use */
+    bondIndex.built = false;
+
     for (i = 0; i < BOND_INFO_FLASH_SECTORS_COUNT; i++)
     {
-        sector_start_addr = (uint32_t)(BONDLIST) + (i * FLASH_DATA_ARRAY_SECTOR_SIZE);
+        sector_start_addr = BOND_INFO_SECTOR_ADDR(i);
         if (Flash_BlankCheck(sector_start_addr, DATA_SECTOR_LEN_WORDS) == FLASH_ERR_NONE)
         {
             continue;    /* Skip sector already erased to preserve flash */
         }
 
-        if (Flash_EraseSector(sector_start_addr, 0) != FLASH_ERR_NONE)
+        /* The records are invalidated first, so that a reset during the
+         * erase does not leave parts of them which would be taken for bonds */
+        if (!(BondList_SectorLegacy(i) ? BondList_LegacyErase(i) : BondList_EraseSector(i)))
         {
             return false;    /* Couldn't erase sector */
         }
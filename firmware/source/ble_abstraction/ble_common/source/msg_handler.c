@@ -15,20 +15,24 @@
  */
 
 #include <msg_handler.h>
-#include <stdlib.h>
+#include <string.h>
 #include <ble_gap.h>
 #include <ble_gatt.h>
 #include <rwip_task.h>
 #include <co_utils.h>
 
+/** Message handler table entry */
 typedef struct MsgHandler
 {
-    uint16_t msg_id;
-    MsgHandlerCallback_t callback;
-    struct MsgHandler *next;
+    uint16_t msg_id;                  /**< Message or task identifier */
+    uint16_t order;                   /**< Registration order */
+    MsgHandlerCallback_t callback;    /**< Handler callback */
 } MsgHandler_t;
 
-static MsgHandler_t *listHead = NULL;
+/* Handler table, kept sorted by msg_id; handlers with the same msg_id are in
+ * registration order */
+static MsgHandler_t handlers[MSG_HANDLER_MAX];
+static uint16_t handlerCount = 0;
 static struct
 {
     ke_msg_func_t gapc_handler;
@@ -64,51 +68,90 @@ const struct ke_task_desc * MsgHandler_GetTaskAppDesc(void)
     return &TASK_DESC_APP;
 }
 
-bool MsgHandler_Add(ke_msg_id_t const msg_id, MsgHandlerCallback_t callback)
+/**
+ * @brief Find the first handler table entry with a msg_id not less than the
+ *        one given, using a binary search
+ *
+ * @param [in] msg_id A message or task identifier
+ * @return Index of the entry, or handlerCount if there is none
+ */
+static uint16_t MsgHandler_LowerBound(uint16_t msg_id)
 {
-    if (callback == NULL)
-    {
-        return false;
-    }
+    uint16_t low = 0;
+    uint16_t high = handlerCount;
 
-    MsgHandler_t *newElem = (MsgHandler_t *)malloc(sizeof(MsgHandler_t));
-    if (!newElem)    /* malloc failed: insufficient memory */
+    while (low < high)
     {
-        return false;
+        uint16_t mid = (low + high) / 2;
+        if (handlers[mid].msg_id < msg_id)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
     }
+    return low;
+}
 
-    newElem->msg_id = msg_id;
-    newElem->callback = callback;
-    newElem->next = NULL;
+/**
+ * @brief Find the first handler for msg_id registered after a given one
+ *
+ * @param [in] msg_id A message or task identifier
+ * @param [in] order  Registration order of the last handler called
+ * @param [out] end   End of the range of handlers for msg_id
+ * @return Index of the entry, equal to end if there is none
+ */
+static uint16_t MsgHandler_Next(uint16_t msg_id, int32_t order, uint16_t *end)
+{
+    uint16_t index = MsgHandler_LowerBound(msg_id);
 
-    if (!listHead)    /* If list is empty, newElem will be the new head */
+    while ((index < handlerCount) && (handlers[index].msg_id == msg_id) &&
+           ((int32_t)handlers[index].order <= order))
     {
-        listHead = newElem;
+        index++;
     }
-    else
+    *end = index;
+    while ((*end < handlerCount) && (handlers[*end].msg_id == msg_id))
     {
-        MsgHandler_t *tmp = listHead;
+        (*end)++;
+    }
+    return index;
+}
 
-        /* Advance to the end of the list. Stops if find duplicate element */
-        while (tmp->next && (tmp->msg_id != msg_id || tmp->callback != callback))
-        {
-            tmp = tmp->next;
-        }
-        if (tmp->msg_id == msg_id && tmp->callback == callback)    /* found a duplicated handler */
+bool MsgHandler_Add(ke_msg_id_t const msg_id, MsgHandlerCallback_t callback)
+{
+    if (callback == NULL || handlerCount >= MSG_HANDLER_MAX)
+    {
+        return false;
+    }
+
+    /* Stops if find duplicate element, otherwise inserts after the handlers
+     * already registered for the same msg_id */
+    uint16_t index = MsgHandler_LowerBound(msg_id);
+    while (index < handlerCount && handlers[index].msg_id == msg_id)
+    {
+        if (handlers[index].callback == callback)    /* found a duplicated handler */
         {
-            free(newElem);
             return false;
         }
-        tmp->next = newElem;    /* Insert newElem at the end of the list */
+        index++;
     }
 
+    memmove(&handlers[index + 1], &handlers[index],
+            (handlerCount - index) * sizeof(MsgHandler_t));
+    handlers[index].msg_id = msg_id;
+    handlers[index].order = handlerCount;
+    handlers[index].callback = callback;
+    handlerCount++;
+
     return true;
 }
 
 int MsgHandler_Notify(ke_msg_id_t const msg_id, void const *param,
                       ke_task_id_t const dest_id, ke_task_id_t const src_id)
 {
-    MsgHandler_t *tmp = listHead;
     uint8_t task_id = KE_IDX_GET(msg_id);
 
     /* First notify abstraction layer handlers */
@@ -139,16 +182,45 @@ int MsgHandler_Notify(ke_msg_id_t const msg_id, void const *param,
         break;
     }
 
-    /* Notify subscribed application/profile handlers */
-    while (tmp)
+    /* Notify subscribed application/profile handlers, registered for this
+     * message ID or for all messages of this task type, in registration
+     * order */
+    int32_t last = -1;
+    uint16_t count = handlerCount;
+    uint16_t msgEnd;
+    uint16_t taskEnd = 0;
+    uint16_t msgIndex = MsgHandler_Next(msg_id, last, &msgEnd);
+    uint16_t taskIndex = 0;
+    if (task_id != msg_id)
     {
-        /* If message ID matches or the handler should be called for all
-         * messages of this task type */
-        if ((tmp->msg_id == msg_id) || (tmp->msg_id == task_id))
+        taskIndex = MsgHandler_Next(task_id, last, &taskEnd);
+    }
+
+    while (msgIndex < msgEnd || taskIndex < taskEnd)
+    {
+        MsgHandler_t *elem;
+        if (taskIndex >= taskEnd ||
+            (msgIndex < msgEnd && handlers[msgIndex].order < handlers[taskIndex].order))
+        {
+            elem = &handlers[msgIndex++];
+        }
+        else
+        {
+            elem = &handlers[taskIndex++];
+        }
+        last = elem->order;
+        elem->callback(msg_id, param, dest_id, src_id);
+
+        /* A handler added by the callback moves the table entries */
+        if (count != handlerCount)
         {
-            tmp->callback(msg_id, param, dest_id, src_id);
+            count = handlerCount;
+            msgIndex = MsgHandler_Next(msg_id, last, &msgEnd);
+            if (task_id != msg_id)
+            {
+                taskIndex = MsgHandler_Next(task_id, last, &taskEnd);
+            }
         }
-        tmp = tmp->next;
     }
     return KE_MSG_CONSUMED;
 }
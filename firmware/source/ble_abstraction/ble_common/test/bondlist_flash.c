@@ -0,0 +1,76 @@
+/**
+ * @file bondlist_flash.c
+ * @brief Flash library side of the bond list test
+ *
+ * Fills the jump table of the test rom_vect.h with the flash library
+ * functions, which run on the flash simulator of the flash library tests.
+ * Sector erases go through a wrapper counting them, to check the wear of
+ * the bond list sectors.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <hw.h>
+#include <flash.h>
+#include <rom_vect.h>
+#include "bondlist_flash.h"
+
+/** Size of a data flash sector */
+#define TEST_SECTOR_SIZE                (DATA_SECTOR_LEN_WORDS * 4)
+
+static uint32_t sectorErases[FLASH0_DATA_SIZE / TEST_SECTOR_SIZE];
+
+/**
+ * @brief Erase a sector, counting the erases of the data flash sectors
+ */
+static FlashStatus_t Test_EraseSector(uint32_t addr, bool enb_endurance)
+{
+    if ((addr >= FLASH0_DATA_BASE) && (addr <= FLASH0_DATA_TOP))
+    {
+        sectorErases[(addr - FLASH0_DATA_BASE) / TEST_SECTOR_SIZE]++;
+    }
+    return Flash_EraseSector(addr, enb_endurance);
+}
+
+void * const bondlist_rom[BONDLIST_ROM_COUNT] =
+{
+    [BONDLIST_ROM_INITIALIZE]     = Flash_Initialize,
+    [BONDLIST_ROM_WRITEWORD]      = Flash_WriteWord,
+    [BONDLIST_ROM_READWORD]       = Flash_ReadWord,
+    [BONDLIST_ROM_WRITEDOUBLE]    = Flash_WriteDouble,
+    [BONDLIST_ROM_READDOUBLE]     = Flash_ReadDouble,
+    [BONDLIST_ROM_WRITEBUFFER]    = Flash_WriteBuffer,
+    [BONDLIST_ROM_READBUFFER]     = Flash_ReadBuffer,
+    [BONDLIST_ROM_ERASEFLASHBANK] = Flash_EraseFlashBank,
+    [BONDLIST_ROM_ERASECHIP]      = Flash_EraseChip,
+    [BONDLIST_ROM_ERASESECTOR]    = Test_EraseSector,
+    [BONDLIST_ROM_BLANKCHECK]     = Flash_BlankCheck
+};
+
+uint32_t Test_SectorErases(uint32_t addr)
+{
+    return sectorErases[(addr - FLASH0_DATA_BASE) / TEST_SECTOR_SIZE];
+}
+
+bool Test_EraseAsync(uint32_t addr)
+{
+    return (Flash_EraseSectorAsync(addr, false, NULL, NULL) == FLASH_ERR_NONE)
+           && Flash_ProcessJobs() && Flash_IsErasing(addr);
+}
+
+void Test_RunJobs(void)
+{
+    while (Flash_ProcessJobs())
+    {
+    }
+}
@@ -0,0 +1,48 @@
+/**
+ * @file bondlist_flash.h
+ * @brief Flash library side of the bond list test
+ *
+ * The bond list is built against the ROM flash functions, whose types
+ * conflict with those of the flash library, so the flash library and its
+ * simulator are driven from bondlist_flash.c through these functions.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef BONDLIST_FLASH_H_
+#define BONDLIST_FLASH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Number of erases of a data flash sector of instance 0 through the
+ *        jump table since the start of the test
+ * @param [in] addr Address of the sector
+ * @return Number of erases
+ */
+uint32_t Test_SectorErases(uint32_t addr);
+
+/**
+ * @brief Queue an erase job of the flash library and start it
+ * @param [in] addr Address of the sector
+ * @return True if the erase is in progress
+ */
+bool Test_EraseAsync(uint32_t addr);
+
+/**
+ * @brief Run the queued flash jobs to completion
+ */
+void Test_RunJobs(void);
+
+#endif    /* BONDLIST_FLASH_H_ */
@@ -0,0 +1,800 @@
+/**
+ * @file bondlist_test.c
+ * @brief Power loss, conversion and wear tests of the bond list on the flash
+ *        simulator
+ *
+ * Usage: bondlist_test [-b] [operations] [seed]
+ *   -b           print the cost of BondList_ResolveRPA per bond checked,
+ *                and of an address found in its cache
+ *
+ * The bond list runs its ROM flash functions through a jump table holding
+ * the flash library functions, on the flash simulator of the flash library
+ * tests. A sequence of bond additions and removals is applied, and each
+ * operation is replayed from the same flash contents with the power cut at
+ * each of its flash array operations in turn, and again at each array
+ * operation of the BondList_Init which follows. After each cut, the bond
+ * list must hold, for each peer, the bond it had before the operation, or
+ * for the peer of the operation only, the bond it has after it. Bond lists
+ * of the former layout are then converted, with and without power cuts, and
+ * the erases of the bond list sectors are counted over a long sequence.
+ * The resolution of private addresses is checked against the AES-128 vector
+ * of FIPS-197 and the ah() sample data of the Bluetooth Core specification.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "flash_sim.h"
+#include "bondlist_flash.h"
+
+/* Built in, to check the bond list against its index */
+#include "../source/bondlist.c"
+
+/** Peers bonded by the tests, more than the bond list holds */
+#define TEST_PEERS                      (BONDLIST_MAX_SIZE + 3)
+
+/** Size of the bond list in flash */
+#define TEST_SIZE                       (BOND_INFO_FLASH_SECTORS_COUNT * FLASH_DATA_ARRAY_SECTOR_SIZE)
+
+/** Number of bonds kept by the wear test */
+#define TEST_WEAR_BONDS                 12
+
+/** Number of address resolutions of each benchmark */
+#define BENCH_RESOLUTIONS               20000
+
+/** IRK of the ah() sample data, least significant byte first */
+static const uint8_t sampleIrk[GAP_KEY_LEN] =
+{
+    0x9b, 0x7d, 0x39, 0x0a, 0xa6, 0x10, 0x10, 0x34,
+    0x05, 0xad, 0xc8, 0x57, 0xa3, 0x34, 0x02, 0xec
+};
+
+/** Resolvable private address of the ah() sample data: hash 0x0dfbaa and
+ *  prand 0x708194, least significant byte first */
+static const uint8_t sampleRpa[GAP_BD_ADDR_LEN] = { 0xaa, 0xfb, 0x0d, 0x94, 0x81, 0x70 };
+
+static unsigned int failures;
+
+#define CHECK(expr)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(expr))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+/** Expected contents of the bond list */
+struct model
+{
+    bool bonded[TEST_PEERS];
+    BondInfo_t bond[TEST_PEERS];
+};
+
+/** Operation applied to the bond list */
+struct op
+{
+    uint8_t peer;
+    bool add;
+    BondInfo_t bond;
+};
+
+static uint32_t seed;
+static uint32_t generation;
+static uint32_t before[TEST_SIZE / 4];
+static uint32_t torn[TEST_SIZE / 4];
+
+static uint32_t Test_Rand(void)
+{
+    seed = seed * 1103515245U + 12345U;
+    return seed >> 8;
+}
+
+/**
+ * @brief Restart the flash interface and the bond list after a power cycle
+ * @return Result of BondList_Init
+ */
+static bool Test_Boot(void)
+{
+    CHECK(Flash_Initialize(0, FLASH_CLOCK_16MHZ) == FLASH_ERR_NONE);
+    CHECK(Flash_Initialize(1, FLASH_CLOCK_16MHZ) == FLASH_ERR_NONE);
+    return BondList_Init();
+}
+
+static void Test_Save(uint32_t *image)
+{
+    memcpy(image, (const void *)BOND_INFO_BASE, TEST_SIZE);
+}
+
+static void Test_Restore(const uint32_t *image)
+{
+    Sim_FlashPoke(BOND_INFO_BASE, image, TEST_SIZE / 4);
+}
+
+/**
+ * @brief Generate the bond information of a peer, which changes each time
+ *        the peer bonds again
+ */
+static void Test_Bond(uint8_t peer, BondInfo_t *bond)
+{
+    uint8_t *keys[4] = { bond->ltk, bond->csrk, bond->irk, bond->rand };
+    uint8_t lens[4] = { sizeof(bond->ltk), sizeof(bond->csrk), sizeof(bond->irk), sizeof(bond->rand) };
+
+    memset(bond, 0, sizeof(*bond));
+    generation++;
+    bond->pairing_lvl = 1 + peer % 4;
+    bond->csrk_exchanged = peer & 1;
+    bond->irk_exchanged = 1;
+    bond->ediv = (uint16_t)generation;
+    bond->addr[0] = peer;
+    bond->addr[1] = 0x5A;
+    bond->addr[5] = 0xC0;
+    bond->addr_type = peer & 1;
+    for (int k = 0; k < 4; k++)
+    {
+        for (int i = 0; i < lens[k]; i++)
+        {
+            keys[k][i] = (uint8_t)Test_Rand();
+        }
+    }
+}
+
+/**
+ * @brief Check a bond in the bond list holds the expected information
+ */
+static bool Test_Same(const BondInfo_t *found, const BondInfo_t *expected)
+{
+    BondInfo_t a = *found;
+
+    a.state = 0;
+    a.seq = 0;
+    return memcmp(&a, expected, sizeof(a)) == 0;
+}
+
+/**
+ * @brief Check the bond of a peer
+ * @return True if the peer is bonded with the expected information, or not
+ *         bonded when expected is NULL
+ */
+static bool Test_PeerIs(uint8_t peer, const BondInfo_t *expected, const BondInfo_t *found)
+{
+    if (expected == NULL)
+    {
+        return found == NULL;
+    }
+    return (found != NULL) && Test_Same(found, expected);
+}
+
+/**
+ * @brief Check the bond list holds the model, or the model updated by an
+ *        operation
+ * @return True if the bond list holds the model updated by the operation
+ */
+static bool Test_Matches(const struct model *m, const struct op *op, unsigned int step)
+{
+    bool applied = false;
+    uint8_t count = 0;
+
+    for (uint8_t peer = 0; peer < TEST_PEERS; peer++)
+    {
+        uint8_t addr[GAP_BD_ADDR_LEN] = { peer, 0x5A, 0, 0, 0, 0xC0 };
+        const BondInfo_t *found = BondList_FindByAddr(addr, peer & 1);
+
+        count += (found != NULL) ? 1 : 0;
+        if (Test_PeerIs(peer, m->bonded[peer] ? &m->bond[peer] : NULL, found))
+        {
+            continue;
+        }
+        if ((op != NULL) && (peer == op->peer)
+            && Test_PeerIs(peer, op->add ? &op->bond : NULL, found))
+        {
+            applied = true;
+            continue;
+        }
+        printf("peer %u lost after a power cut at step %u\n", peer, step);
+        failures++;
+    }
+    CHECK(BondList_Size() == count);
+    return applied;
+}
+
+static void Test_Apply(struct model *m, const struct op *op)
+{
+    m->bonded[op->peer] = op->add;
+    m->bond[op->peer] = op->bond;
+}
+
+static bool Test_Run(const struct op *op)
+{
+    if (op->add)
+    {
+        return BondList_Add((BondInfo_t *)&op->bond) != BOND_INFO_STATE_INVALID;
+    }
+
+    const BondInfo_t *found = BondList_FindByAddr(op->bond.addr, op->bond.addr_type);
+
+    return (found != NULL) && BondList_Remove(found->state);
+}
+
+static void Test_Next(const struct model *m, struct op *op)
+{
+    uint8_t count = 0;
+
+    for (uint8_t peer = 0; peer < TEST_PEERS; peer++)
+    {
+        count += m->bonded[peer] ? 1 : 0;
+    }
+
+    /* Keep the bond list around half full */
+    op->add = (count == 0)
+              || ((count < BONDLIST_MAX_SIZE) && ((Test_Rand() % BONDLIST_MAX_SIZE) >= count));
+    do
+    {
+        op->peer = Test_Rand() % TEST_PEERS;
+    } while (m->bonded[op->peer] == op->add);
+
+    if (op->add)
+    {
+        Test_Bond(op->peer, &op->bond);
+    }
+    else
+    {
+        op->bond = m->bond[op->peer];
+    }
+}
+
+/**
+ * @brief Recover from a power cut, then cut the power again at each array
+ *        operation of the recovery
+ * @param [in] m    Model before the operation
+ * @param [in] op   Operation interrupted
+ * @param [in] step Array operation interrupted
+ */
+static void Test_Recover(const struct model *m, const struct op *op, unsigned int step)
+{
+    static sigjmp_buf env;
+    uint32_t ops;
+
+    Test_Save(torn);
+    Sim_SetPowerCut(0, NULL);
+    CHECK(Test_Boot());
+    ops = Sim_ArrayOps();
+    Test_Matches(m, op, step);
+
+    for (volatile uint32_t n = 1; n <= ops; n++)
+    {
+        Test_Restore(torn);
+        Sim_SetPowerCut(n, &env);
+        if (sigsetjmp(env, 1) == 0)
+        {
+            Test_Boot();
+        }
+        Sim_SetPowerCut(0, NULL);
+        CHECK(Test_Boot());
+        Test_Matches(m, op, step);
+    }
+}
+
+/**
+ * @brief Add and remove random bonds, cutting the power at each array
+ *        operation
+ * @param [in] count Number of operations
+ */
+static void Test_PowerLoss(unsigned int count)
+{
+    static sigjmp_buf env;
+    static struct model m;
+    static struct op op;
+    unsigned long cuts = 0;
+
+    memset(&m, 0, sizeof(m));
+    CHECK(BondList_RemoveAll());
+    Sim_ResetStats();
+    CHECK(Test_Boot());
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t ops;
+
+        Test_Next(&m, &op);
+        Test_Save(before);
+
+        /* Reference run, counting the array operations */
+        Sim_SetPowerCut(0, NULL);
+        CHECK(Test_Run(&op));
+        ops = Sim_ArrayOps();
+
+        for (volatile uint32_t n = 1; n <= ops; n++)
+        {
+            Test_Restore(before);
+            CHECK(Test_Boot());
+            Sim_SetPowerCut(n, &env);
+            if (sigsetjmp(env, 1) == 0)
+            {
+                Test_Run(&op);
+            }
+            Sim_SetPowerCut(0, NULL);
+            Test_Recover(&m, &op, n);
+            cuts++;
+        }
+
+        /* Continue from the result of a power cut at the last step */
+        CHECK(Test_Boot());
+        if (!Test_Matches(&m, &op, 0))
+        {
+            CHECK(Test_Run(&op));
+        }
+        Test_Apply(&m, &op);
+        Test_Matches(&m, NULL, 0);
+    }
+    printf("power loss: %u operations, %lu power cuts, %u sector erases\n",
+           count, cuts, Sim_Stats()->sector_erases);
+}
+
+/**
+ * @brief Remove all the bonds, cutting the power at each array operation
+ *
+ * Any of the bonds may be left, but those left must be whole.
+ */
+static void Test_RemoveAllCut(void)
+{
+    static sigjmp_buf env;
+    static struct model m;
+    uint32_t ops;
+
+    memset(&m, 0, sizeof(m));
+    CHECK(BondList_RemoveAll());
+    CHECK(Test_Boot());
+    for (uint8_t peer = 0; peer < BONDLIST_MAX_SIZE; peer++)
+    {
+        Test_Bond(peer, &m.bond[peer]);
+        m.bonded[peer] = true;
+        CHECK(BondList_Add(&m.bond[peer]) != BOND_INFO_STATE_INVALID);
+    }
+    Test_Save(before);
+
+    Sim_SetPowerCut(0, NULL);
+    CHECK(BondList_RemoveAll());
+    ops = Sim_ArrayOps();
+    CHECK(Test_Boot());
+    CHECK(BondList_Size() == 0);
+
+    for (volatile uint32_t n = 1; n <= ops; n++)
+    {
+        Test_Restore(before);
+        CHECK(Test_Boot());
+        Sim_SetPowerCut(n, &env);
+        if (sigsetjmp(env, 1) == 0)
+        {
+            BondList_RemoveAll();
+        }
+        Sim_SetPowerCut(0, NULL);
+        CHECK(Test_Boot());
+
+        uint8_t count = 0;
+        for (uint8_t peer = 0; peer < TEST_PEERS; peer++)
+        {
+            uint8_t addr[GAP_BD_ADDR_LEN] = { peer, 0x5A, 0, 0, 0, 0xC0 };
+            const BondInfo_t *found = BondList_FindByAddr(addr, peer & 1);
+
+            if (found != NULL)
+            {
+                CHECK(m.bonded[peer] && Test_Same(found, &m.bond[peer]));
+                count++;
+            }
+        }
+        CHECK(BondList_Size() == count);
+        CHECK(BondList_RemoveAll());
+        CHECK(Test_Boot());
+        CHECK(BondList_Size() == 0);
+    }
+}
+
+/**
+ * @brief Write a bond list of the former layout, packed across the sector
+ *        boundaries with the state of record i set to i + 1
+ * @param [in]  count Number of bonds
+ * @param [out] bonds Bonds written
+ */
+static void Test_Legacy(uint8_t count, BondInfo_t *bonds)
+{
+    uint32_t image[TEST_SIZE / 4];
+    BondInfo_t *legacy = (BondInfo_t *)image;
+
+    memset(image, 0xFF, sizeof(image));
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Test_Bond(i, &bonds[i]);
+        legacy[i] = bonds[i];
+        legacy[i].state = i + 1;
+        legacy[i].seq = 0xFFFF;
+    }
+    Test_Restore(image);
+}
+
+/**
+ * @brief Check the bonds converted from the former layout
+ *
+ * The first BONDLIST_MAX_SIZE bonds are kept whole, and the others dropped.
+ *
+ * @param [in] count Number of bonds of the former layout
+ * @param [in] bonds Bonds of the former layout
+ */
+static void Test_LegacyCheck(uint8_t count, const BondInfo_t *bonds)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const BondInfo_t *bond = BondList_FindByAddr(bonds[i].addr, bonds[i].addr_type);
+
+        if (i < BONDLIST_MAX_SIZE)
+        {
+            CHECK((bond != NULL) && Test_Same(bond, &bonds[i]));
+        }
+        else
+        {
+            CHECK(bond == NULL);
+        }
+    }
+    CHECK(BondList_Size() == ((count < BONDLIST_MAX_SIZE) ? count : BONDLIST_MAX_SIZE));
+
+    /* No sector of the former layout is left */
+    for (uint16_t sector = 0; sector < BOND_INFO_FLASH_SECTORS_COUNT; sector++)
+    {
+        CHECK(!BondList_SectorLegacy(sector));
+    }
+}
+
+/**
+ * @brief Convert bond lists of the former layout
+ *
+ * The records beyond BONDLIST_MAX_SIZE, which are dropped, free the last
+ * sectors, so the bonds of each sector fit in the sectors already freed and
+ * no bond is lost whenever the power is cut. The power is cut at each array
+ * operation of the conversion up to 10 bonds, and at every fourth one above.
+ */
+static void Test_Migrate(void)
+{
+    static const uint8_t counts[] = { 0, 1, 4, 10, 22, 28 };
+    static sigjmp_buf env;
+    static BondInfo_t bonds[BOND_INFO_LEGACY_COUNT];
+    static uint32_t legacy[TEST_SIZE / 4];
+    unsigned long cuts = 0;
+
+    for (unsigned int c = 0; c < sizeof(counts); c++)
+    {
+        uint8_t count = counts[c];
+        uint32_t ops;
+
+        Test_Legacy(count, bonds);
+        Test_Save(legacy);
+        Sim_SetPowerCut(0, NULL);
+        CHECK(Test_Boot());
+        ops = Sim_ArrayOps();
+        Test_LegacyCheck(count, bonds);
+
+        /* The converted bond list is used as any other */
+        if (count < BONDLIST_MAX_SIZE)
+        {
+            BondInfo_t bond;
+
+            Test_Bond(TEST_PEERS - 1, &bond);
+            CHECK(BondList_Add(&bond) != BOND_INFO_STATE_INVALID);
+            CHECK(BondList_Size() == (count + 1));
+        }
+
+        for (volatile uint32_t n = 1; n <= ops; n += (count > 10) ? 4 : 1)
+        {
+            Test_Restore(legacy);
+            Sim_SetPowerCut(n, &env);
+            if (sigsetjmp(env, 1) == 0)
+            {
+                Test_Boot();
+            }
+            Sim_SetPowerCut(0, NULL);
+            CHECK(Test_Boot());
+            Test_LegacyCheck(count, bonds);
+            cuts++;
+        }
+    }
+    printf("conversion: %lu power cuts\n", cuts);
+}
+
+/**
+ * @brief Check the bond list sectors are worn evenly
+ * @param [in] count Number of operations
+ */
+static void Test_Wear(unsigned int count)
+{
+    static struct model m;
+    static struct op op;
+    uint32_t erases[BOND_INFO_FLASH_SECTORS_COUNT];
+    uint32_t adds = 0;
+    uint32_t least = UINT32_MAX;
+    uint32_t most = 0;
+    uint32_t total = 0;
+
+    memset(&m, 0, sizeof(m));
+    CHECK(BondList_RemoveAll());
+    CHECK(Test_Boot());
+    for (uint16_t sector = 0; sector < BOND_INFO_FLASH_SECTORS_COUNT; sector++)
+    {
+        erases[sector] = Test_SectorErases(BOND_INFO_SECTOR_ADDR(sector));
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint8_t bonded = 0;
+
+        for (uint8_t peer = 0; peer < TEST_PEERS; peer++)
+        {
+            bonded += m.bonded[peer] ? 1 : 0;
+        }
+        do
+        {
+            op.peer = Test_Rand() % TEST_PEERS;
+        } while ((bonded >= TEST_WEAR_BONDS) ? !m.bonded[op.peer] : m.bonded[op.peer]);
+
+        op.add = !m.bonded[op.peer];
+        if (op.add)
+        {
+            Test_Bond(op.peer, &op.bond);
+            adds++;
+        }
+        else
+        {
+            op.bond = m.bond[op.peer];
+        }
+        CHECK(Test_Run(&op));
+        Test_Apply(&m, &op);
+    }
+    Test_Matches(&m, NULL, 0);
+
+    for (uint16_t sector = 0; sector < BOND_INFO_FLASH_SECTORS_COUNT; sector++)
+    {
+        erases[sector] = Test_SectorErases(BOND_INFO_SECTOR_ADDR(sector)) - erases[sector];
+        least = (erases[sector] < least) ? erases[sector] : least;
+        most = (erases[sector] > most) ? erases[sector] : most;
+        total += erases[sector];
+    }
+
+    /* Each sector is erased once per turn of the log, and the bonds moved
+     * out of the sector erased take at most a third of the slots */
+    CHECK((most - least) <= 1);
+    CHECK((total * BOND_INFO_PER_SECTOR) <= (adds * 3 / 2 + BONDLIST_SLOT_COUNT));
+    printf("wear: %u bonds added, %u sector erases, %u to %u per sector\n",
+           adds, total, least, most);
+}
+
+/**
+ * @brief Check the bond list is not written while an erase job of the flash
+ *        library is in progress
+ */
+static void Test_Erasing(void)
+{
+    BondInfo_t bond;
+    const BondInfo_t *found;
+
+    CHECK(BondList_RemoveAll());
+    CHECK(Test_Boot());
+    Test_Bond(0, &bond);
+    CHECK(BondList_Add(&bond) != BOND_INFO_STATE_INVALID);
+    found = BondList_FindByAddr(bond.addr, bond.addr_type);
+    CHECK(found != NULL);
+
+    CHECK(Test_EraseAsync(FLASH0_DATA_BASE + 0x10000));
+    Sim_SetPowerCut(0, NULL);
+    CHECK(BondList_Add(&bond) == BOND_INFO_STATE_INVALID);
+    CHECK(!BondList_Remove(found->state));
+    CHECK(!BondList_RemoveAll());
+    CHECK(BondList_FindByAddr(bond.addr, bond.addr_type) == found);
+    CHECK(Sim_ArrayOps() == 0);
+
+    Test_RunJobs();
+    CHECK(BondList_Remove(found->state));
+    CHECK(BondList_Size() == 0);
+}
+
+/**
+ * @brief Check the AES-128 block cipher against the example of FIPS-197
+ *        appendix C.1
+ */
+static void Test_Aes(void)
+{
+    static const uint8_t expected[AES_BLOCK_LEN] =
+    {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+        0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+    };
+    uint8_t key[AES_BLOCK_LEN];
+    uint8_t block[AES_BLOCK_LEN];
+
+    for (uint8_t i = 0; i < AES_BLOCK_LEN; i++)
+    {
+        key[i] = i;
+        block[i] = i * 0x11;
+    }
+    BondList_Encrypt(key, block);
+    CHECK(memcmp(block, expected, AES_BLOCK_LEN) == 0);
+}
+
+/**
+ * @brief Check the random address hash function ah() against the sample
+ *        data of the Bluetooth Core specification
+ */
+static void Test_Ah(void)
+{
+    uint8_t addr[GAP_BD_ADDR_LEN];
+
+    CHECK(BondList_IrkResolves(sampleIrk, sampleRpa));
+
+    /* Any change of the hash or of prand makes the address unresolvable */
+    for (uint8_t i = 0; i < GAP_BD_ADDR_LEN; i++)
+    {
+        memcpy(addr, sampleRpa, GAP_BD_ADDR_LEN);
+        addr[i] ^= 0x01;
+        CHECK(!BondList_IrkResolves(sampleIrk, addr));
+    }
+}
+
+/**
+ * @brief Add bonds with random IRKs, the last one with the IRK of the ah()
+ *        sample data
+ * @param [in] count Number of bonds
+ */
+static void Test_IrkBonds(uint8_t count)
+{
+    BondInfo_t bond;
+
+    CHECK(BondList_RemoveAll());
+    CHECK(Test_Boot());
+    for (uint8_t peer = 0; peer < count; peer++)
+    {
+        Test_Bond(peer, &bond);
+        if (peer == (count - 1))
+        {
+            memcpy(bond.irk, sampleIrk, GAP_KEY_LEN);
+        }
+        CHECK(BondList_Add(&bond) != BOND_INFO_STATE_INVALID);
+    }
+}
+
+/**
+ * @brief Check BondList_ResolveRPA finds the bond whose IRK resolves an
+ *        address, and its cache follows the removal of bonds
+ */
+static void Test_ResolveRPA(void)
+{
+    uint8_t addr[GAP_BD_ADDR_LEN];
+    const BondInfo_t *bond;
+    const BondInfo_t *found;
+
+    Test_IrkBonds(BONDLIST_MAX_SIZE);
+    bond = BondList_Get(BONDLIST_MAX_SIZE - 1);
+    CHECK((bond != NULL) && (memcmp(bond->irk, sampleIrk, GAP_KEY_LEN) == 0));
+
+    /* Resolved, then found in the cache */
+    found = BondList_ResolveRPA(sampleRpa);
+    CHECK(found == bond);
+    bool cached = false;
+    for (uint8_t i = 0; i < BONDLIST_RPA_CACHE_SIZE; i++)
+    {
+        cached |= (bondIndex.rpaCache[i].state == bond->state)
+                  && (memcmp(bondIndex.rpaCache[i].addr, sampleRpa, GAP_BD_ADDR_LEN) == 0);
+    }
+    CHECK(cached);
+    CHECK(BondList_ResolveRPA(sampleRpa) == bond);
+
+    /* Only resolvable private addresses are resolved */
+    memcpy(addr, sampleRpa, GAP_BD_ADDR_LEN);
+    addr[GAP_BD_ADDR_LEN - 1] |= 0xc0;
+    CHECK(BondList_ResolveRPA(addr) == NULL);
+    addr[0] ^= 0x01;
+    addr[GAP_BD_ADDR_LEN - 1] = sampleRpa[GAP_BD_ADDR_LEN - 1];
+    CHECK(BondList_ResolveRPA(addr) == NULL);
+
+    /* The cache entry of a removed bond is cleared */
+    CHECK(BondList_Remove(bond->state));
+    CHECK(BondList_ResolveRPA(sampleRpa) == NULL);
+
+    /* A bond without an IRK is not resolved */
+    BondInfo_t noIrk;
+    Test_Bond(0, &noIrk);
+    noIrk.addr[0] = TEST_PEERS;
+    memcpy(noIrk.irk, sampleIrk, GAP_KEY_LEN);
+    noIrk.irk_exchanged = 0;
+    CHECK(BondList_Add(&noIrk) != BOND_INFO_STATE_INVALID);
+    CHECK(BondList_ResolveRPA(sampleRpa) == NULL);
+}
+
+/**
+ * @brief Time address resolutions
+ * @return Host time of a resolution, in nanoseconds
+ */
+static double Bench_Resolve(const uint8_t *addr)
+{
+    struct timespec start, end;
+    const BondInfo_t *volatile found;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned int i = 0; i < BENCH_RESOLUTIONS; i++)
+    {
+        found = BondList_ResolveRPA(addr);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)found;
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_RESOLUTIONS;
+}
+
+/**
+ * @brief Print the cost of BondList_ResolveRPA for a growing number of bonds
+ */
+static void Bench(void)
+{
+    static const uint8_t counts[] = { 1, 4, 8, 16, BONDLIST_MAX_SIZE };
+    uint8_t addr[GAP_BD_ADDR_LEN];
+
+    /* An address resolved by none of the bonds checks all of them */
+    memcpy(addr, sampleRpa, GAP_BD_ADDR_LEN);
+    addr[0] ^= 0x01;
+
+    printf("%-10s %12s %12s %12s\n", "bonds", "miss ns", "per bond ns", "cached ns");
+    for (unsigned int i = 0; i < sizeof(counts); i++)
+    {
+        double miss;
+
+        Test_IrkBonds(counts[i]);
+        miss = Bench_Resolve(addr);
+        CHECK(BondList_ResolveRPA(sampleRpa) != NULL);
+        printf("%-10u %12.1f %12.1f %12.1f\n", counts[i], miss, miss / counts[i],
+               Bench_Resolve(sampleRpa));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool bench = (argc > 1) && (strcmp(argv[1], "-b") == 0);
+    unsigned int count;
+
+    if (bench)
+    {
+        argc--;
+        argv++;
+    }
+    count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 40;
+    seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+    Sim_Init();
+    CHECK(Test_Boot());
+
+    if (bench)
+    {
+        Bench();
+        return failures ? 1 : 0;
+    }
+
+    Test_Aes();
+    Test_Ah();
+    Test_ResolveRPA();
+    Test_Erasing();
+    Test_PowerLoss(count);
+    Test_RemoveAllCut();
+    Test_Migrate();
+    Test_Wear(count * 50);
+
+    printf("bondlist_test: %s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,879 @@
+/**
+ * @file gatt_test.c
+ * @brief Host test and benchmark of the BLE abstraction GATT layer
+ *
+ * Usage: gatt_test [-b]
+ *   -b           print the cost of the read and write request handlers, and
+ *                of the former backward scan of the custom services, for
+ *                4 to 64 services
+ *
+ * ble_gatt.c is built against kernel stubs which keep the last message
+ * sent. Custom services are added as by the samples, with gaps between
+ * their handle ranges for the services of the stack, and the requests for
+ * every handle are checked against the service and attribute expected to
+ * own it. Prepare and execute write sequences are then replayed as the
+ * stack delivers them: in order, with invalid offsets, and cancelled.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ble_gatt.h>
+
+/** Largest number of custom services */
+#define TEST_SVC_MAX                    64
+
+/** Largest number of attributes of a service: the service, and three
+ *  characteristics with their value */
+#define TEST_ATT_MAX                    7
+
+/** Length of the attribute values */
+#define TEST_VALUE_LEN                  8
+
+/** First handle of the custom services, after the GAP and GATT services */
+#define TEST_FIRST_HDL                  0x0010
+
+/** Size of the parameters of a kernel message */
+#define TEST_MSG_SIZE                   (ATT_MAX_VALUE + 16)
+
+/** Number of requests of each benchmark */
+#define BENCH_REQUESTS                  1000000
+
+static unsigned int failures;
+
+#define CHECK(expr)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(expr))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+/* Last kernel message allocated and sent */
+static struct
+{
+    ke_msg_id_t id;
+    ke_task_id_t dest_id;
+    uint16_t len;
+    unsigned int sent;
+    union
+    {
+        uint32_t align;
+        uint8_t param[TEST_MSG_SIZE];
+    };
+} msg;
+
+void *ke_msg_alloc(ke_msg_id_t const id, ke_task_id_t const dest_id,
+                   ke_task_id_t const src_id, uint16_t const param_len)
+{
+    if (param_len > TEST_MSG_SIZE)
+    {
+        printf("ke_msg_alloc: %u bytes for message 0x%04x\n", param_len, id);
+        exit(1);
+    }
+    msg.id = id;
+    msg.dest_id = dest_id;
+    msg.len = param_len;
+    memset(msg.param, 0, param_len);
+    return msg.param;
+}
+
+void ke_msg_send(void const *param_ptr)
+{
+    msg.sent++;
+}
+
+/* Last call of an attribute callback */
+static struct
+{
+    unsigned int count;
+    uint8_t conidx;
+    uint16_t attidx;
+    uint16_t handle;
+    uint16_t length;
+    uint16_t operation;
+    uint8_t hl_status;
+} cb;
+
+static uint8_t Test_Callback(uint8_t conidx, uint16_t attidx, uint16_t handle,
+                             uint8_t *toData, const uint8_t *fromData,
+                             uint16_t lenData, uint16_t operation, uint8_t hl_status)
+{
+    cb.count++;
+    cb.conidx = conidx;
+    cb.attidx = attidx;
+    cb.handle = handle;
+    cb.length = lenData;
+    cb.operation = operation;
+    cb.hl_status = hl_status;
+    memcpy(toData, fromData, lenData);
+    return ATT_ERR_NO_ERROR;
+}
+
+/* Custom services, with the number of attributes of each */
+static struct att_db_desc svcDb[TEST_SVC_MAX][TEST_ATT_MAX];
+static uint16_t svcLen[TEST_SVC_MAX];
+static cust_svc_desc custSvcDb[TEST_SVC_MAX];
+static uint16_t discSvcCount[APP_MAX_NB_CON];
+static uint8_t values[TEST_SVC_MAX][TEST_ATT_MAX][TEST_VALUE_LEN];
+static uint16_t svcCount;
+
+/**
+ * Adds count custom services with one to three characteristics, readable,
+ * writable or both, and returns the handle after the last one.
+ */
+static uint16_t Test_AddServices(uint16_t count)
+{
+    uint16_t handle = TEST_FIRST_HDL;
+
+    GATT_Initialize();
+    GATTM_ResetServiceAttributeDatabaseID();
+    GATT_SetEnvData(discSvcCount, custSvcDb, count);
+    memset(svcDb, 0, sizeof(svcDb));
+    memset(custSvcDb, 0, sizeof(custSvcDb));
+    svcCount = count;
+
+    for (uint16_t s = 0; s < count; s++)
+    {
+        struct att_db_desc *att = svcDb[s];
+        uint16_t chars = 1 + s % 3;
+
+        att[0].is_service = true;
+        att[0].att.perm = PERM(SVC_UUID_LEN, UUID_128);
+        for (uint16_t c = 0; c < chars; c++)
+        {
+            struct att_db_desc *decl = &att[1 + 2 * c];
+            struct att_db_desc *value = &att[2 + 2 * c];
+            static const uint16_t perms[] = {
+                PERM(RD, ENABLE) | PERM(WRITE_REQ, ENABLE),
+                PERM(RD, ENABLE) | PERM(NTF, ENABLE),
+                PERM(WRITE_REQ, ENABLE) | PERM(WRITE_COMMAND, ENABLE)
+            };
+
+            decl->att_idx = 1 + 2 * c;
+            decl->att.perm = PERM(RD, ENABLE);
+            value->att_idx = 2 + 2 * c;
+            value->att.perm = perms[(s + c) % 3];
+            value->att.max_len = TEST_VALUE_LEN;
+            value->length = TEST_VALUE_LEN;
+            value->data = values[s][2 + 2 * c];
+            value->callback = Test_Callback;
+        }
+        svcLen[s] = 1 + 2 * chars;
+
+        msg.sent = 0;
+        GATTM_AddAttributeDatabase(att, svcLen[s]);
+        CHECK((msg.sent == 1) && (msg.id == GATTM_ADD_SVC_REQ));
+    }
+
+    /* The stack adds the services in order, some of them after services of
+     * its own */
+    for (uint16_t s = 0; s < count; s++)
+    {
+        struct gattm_add_svc_rsp rsp = { handle, ATT_ERR_NO_ERROR };
+
+        GATTM_MsgHandler(GATTM_ADD_SVC_RSP, &rsp, TASK_APP, TASK_GATTM);
+        CHECK(GATTM_GetHandle(s, 0) == handle);
+        handle += svcLen[s] + ((s % 4 == 3) ? 4 : 0);
+    }
+    CHECK(GATTM_GetServiceAddedCount() == count);
+    return handle;
+}
+
+/** Finds the expected owner of a handle, as the attribute index, or -1 */
+static int Test_Owner(uint16_t handle, uint16_t *svc)
+{
+    for (int s = svcCount - 1; s >= 0; s--)
+    {
+        if (handle > custSvcDb[s].cust_svc_start_hdl)
+        {
+            *svc = s;
+            return handle - custSvcDb[s].cust_svc_start_hdl;
+        }
+    }
+    return -1;
+}
+
+static void Test_Read(uint8_t conidx, uint16_t handle)
+{
+    struct gattc_read_req_ind req = { handle };
+    uint16_t s = 0;
+    int attnum = Test_Owner(handle, &s);
+    uint8_t status = ATT_ERR_NO_ERROR;
+    const struct gattc_read_cfm *cfm = (const struct gattc_read_cfm *)msg.param;
+
+    if (attnum < 0)
+    {
+        status = ATT_ERR_INVALID_HANDLE;
+    }
+    else if ((attnum >= svcLen[s]) ||
+             !(svcDb[s][attnum].att.perm & (PERM(RD, ENABLE) | PERM(NTF, ENABLE))))
+    {
+        status = ATT_ERR_READ_NOT_PERMITTED;
+    }
+    else
+    {
+        memset(values[s][attnum], handle, TEST_VALUE_LEN);
+    }
+
+    msg.sent = 0;
+    cb.count = 0;
+    GATTC_MsgHandler(GATTC_READ_REQ_IND, &req, TASK_APP, KE_BUILD_ID(TASK_GATTC, conidx));
+
+    CHECK((msg.sent == 1) && (msg.id == GATTC_READ_CFM));
+    CHECK(msg.dest_id == KE_BUILD_ID(TASK_GATTC, conidx));
+    CHECK((cfm->handle == handle) && (cfm->status == status));
+    if (status != ATT_ERR_NO_ERROR)
+    {
+        /* Errors are answered without calling the attribute callback */
+        CHECK((cb.count == 0) && (cfm->length == 0));
+        return;
+    }
+    if (svcDb[s][attnum].callback == NULL)
+    {
+        /* Characteristic declaration, handled by the stack */
+        CHECK((cb.count == 0) && (cfm->length == svcDb[s][attnum].length));
+        return;
+    }
+
+    CHECK((cb.count == 1) && (cb.hl_status == GAP_ERR_NO_ERROR));
+    CHECK((cb.conidx == conidx) && (cb.attidx == attnum) && (cb.handle == handle));
+    CHECK(cb.operation == GATTC_READ_REQ_IND);
+    CHECK((cfm->length == TEST_VALUE_LEN) && (cfm->value[0] == (uint8_t)handle));
+}
+
+static void Test_Write(uint8_t conidx, uint16_t handle)
+{
+    union
+    {
+        struct gattc_write_req_ind ind;
+        uint8_t buffer[sizeof(struct gattc_write_req_ind) + TEST_VALUE_LEN];
+    } req = { { handle, 0, TEST_VALUE_LEN } };
+    uint16_t s = 0;
+    int attnum = Test_Owner(handle, &s);
+    uint8_t status = ATT_ERR_NO_ERROR;
+    const struct gattc_write_cfm *cfm = (const struct gattc_write_cfm *)msg.param;
+
+    if (attnum < 0)
+    {
+        status = ATT_ERR_INVALID_HANDLE;
+    }
+    else if ((attnum >= svcLen[s]) ||
+             !(svcDb[s][attnum].att.perm &
+               (PERM(WRITE_REQ, ENABLE) | PERM(WRITE_COMMAND, ENABLE))))
+    {
+        status = ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+    memset(req.ind.value, ~handle, TEST_VALUE_LEN);
+
+    msg.sent = 0;
+    cb.count = 0;
+    GATTC_MsgHandler(GATTC_WRITE_REQ_IND, &req, TASK_APP, KE_BUILD_ID(TASK_GATTC, conidx));
+
+    CHECK((msg.sent == 1) && (msg.id == GATTC_WRITE_CFM));
+    CHECK((cfm->handle == handle) && (cfm->status == status));
+    if (status != ATT_ERR_NO_ERROR)
+    {
+        CHECK(cb.count == 0);
+        return;
+    }
+
+    CHECK((cb.count == 1) && (cb.hl_status == GAP_ERR_NO_ERROR));
+    CHECK((cb.conidx == conidx) && (cb.attidx == attnum) && (cb.handle == handle));
+    CHECK((cb.operation == GATTC_WRITE_REQ_IND) && (cb.length == TEST_VALUE_LEN));
+    CHECK(values[s][attnum][TEST_VALUE_LEN - 1] == (uint8_t)~handle);
+}
+
+static void Test_AttInfo(uint8_t conidx, uint16_t handle)
+{
+    struct gattc_att_info_req_ind req = { handle };
+    uint16_t s = 0;
+    int attnum = Test_Owner(handle, &s);
+    uint8_t status = ATT_ERR_NO_ERROR;
+    const struct gattc_att_info_cfm *cfm = (const struct gattc_att_info_cfm *)msg.param;
+
+    if (attnum < 0)
+    {
+        status = ATT_ERR_INVALID_OFFSET;
+    }
+    else if ((attnum >= svcLen[s]) ||
+             !(svcDb[s][attnum].att.perm & PERM(WRITE_REQ, ENABLE)))
+    {
+        status = ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+
+    msg.sent = 0;
+    GATTC_MsgHandler(GATTC_ATT_INFO_REQ_IND, &req, TASK_APP, KE_BUILD_ID(TASK_GATTC, conidx));
+
+    CHECK((msg.sent == 1) && (msg.id == GATTC_ATT_INFO_CFM));
+    CHECK((cfm->handle == handle) && (cfm->status == status));
+    CHECK(cfm->length == ((status == ATT_ERR_NO_ERROR) ? TEST_VALUE_LEN : 0));
+}
+
+static void Test_Lookup(void)
+{
+    static const uint16_t counts[] = { 1, 2, 3, 4, 5, 8, 15, 16, 31, 33, 63, 64 };
+
+    for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        uint16_t end = Test_AddServices(counts[i]);
+
+        for (uint16_t handle = 0; handle < end + 4; handle++)
+        {
+            uint8_t conidx = handle % APP_MAX_NB_CON;
+            Test_Read(conidx, handle);
+            Test_Write(conidx, handle);
+            Test_AttInfo(conidx, handle);
+
+            /* Release the prepared write buffer reserved by the request */
+            GATTC_PrepWriteFlush(conidx);
+        }
+    }
+}
+
+/* Attributes written with prepared writes: a long value with a callback, a
+ * value without one, and a value too long for a reassembly buffer */
+#define PREP_LONG_LEN                   100
+#define PREP_PLAIN_LEN                  64
+#define PREP_HUGE_LEN                   (GATT_PREP_WRITE_BUF_SIZE + 1)
+#define PREP_LONG_ATT                   2
+#define PREP_PLAIN_ATT                  4
+#define PREP_HUGE_ATT                   6
+
+/** Payload of a prepare write request with the default ATT MTU */
+#define PREP_FRAGMENT                   18
+
+static uint8_t prepLong[PREP_LONG_LEN];
+static uint8_t prepPlain[PREP_PLAIN_LEN];
+static uint8_t prepHuge[PREP_HUGE_LEN];
+static uint16_t prepStartHdl;
+
+/* Calls of the callback of the long value, and the status it returns */
+static struct
+{
+    unsigned int count;
+    uint16_t length;
+    uint8_t hl_status;
+    uint8_t value[PREP_HUGE_LEN];
+    uint8_t status;
+} prepCb;
+
+static uint8_t Prep_Callback(uint8_t conidx, uint16_t attidx, uint16_t handle,
+                             uint8_t *toData, const uint8_t *fromData,
+                             uint16_t lenData, uint16_t operation, uint8_t hl_status)
+{
+    if (operation == GATTC_WRITE_REQ_IND)
+    {
+        prepCb.count++;
+        prepCb.length = lenData;
+        prepCb.hl_status = hl_status;
+        memcpy(prepCb.value, fromData, lenData);
+        if (prepCb.status != ATT_ERR_NO_ERROR)
+        {
+            return prepCb.status;
+        }
+    }
+    memcpy(toData, fromData, lenData);
+    return ATT_ERR_NO_ERROR;
+}
+
+static const struct att_db_desc prepDb[] = {
+    { 0, { { 0 }, PERM(SVC_UUID_LEN, UUID_128), 0, 0 }, true, 0, NULL, NULL },
+    { 1, { { 0 }, PERM(RD, ENABLE), 0, 0 }, false, 0, NULL, NULL },
+    { 2, { { 0 }, PERM(RD, ENABLE) | PERM(WRITE_REQ, ENABLE), PREP_LONG_LEN, 0 },
+      false, PREP_LONG_LEN, prepLong, Prep_Callback },
+    { 3, { { 0 }, PERM(RD, ENABLE), 0, 0 }, false, 0, NULL, NULL },
+    { 4, { { 0 }, PERM(RD, ENABLE) | PERM(WRITE_REQ, ENABLE), PREP_PLAIN_LEN, 0 },
+      false, PREP_PLAIN_LEN, prepPlain, NULL },
+    { 5, { { 0 }, PERM(RD, ENABLE), 0, 0 }, false, 0, NULL, NULL },
+    { 6, { { 0 }, PERM(WRITE_REQ, ENABLE), PREP_HUGE_LEN, 0 },
+      false, PREP_HUGE_LEN, prepHuge, Prep_Callback }
+};
+
+/** Adds the service of the prepared write attributes, with their values
+ *  filled with the given byte */
+static void Prep_Setup(uint8_t fill)
+{
+    struct gattm_add_svc_rsp rsp = { TEST_FIRST_HDL, ATT_ERR_NO_ERROR };
+
+    GATT_Initialize();
+    GATTM_ResetServiceAttributeDatabaseID();
+    memset(custSvcDb, 0, sizeof(custSvcDb));
+    GATT_SetEnvData(discSvcCount, custSvcDb, 1);
+    GATTM_AddAttributeDatabase(prepDb, sizeof(prepDb) / sizeof(prepDb[0]));
+    GATTM_MsgHandler(GATTM_ADD_SVC_RSP, &rsp, TASK_APP, TASK_GATTM);
+    prepStartHdl = TEST_FIRST_HDL;
+
+    memset(prepLong, fill, sizeof(prepLong));
+    memset(prepPlain, fill, sizeof(prepPlain));
+    memset(&prepCb, 0, sizeof(prepCb));
+}
+
+/** Sends the attribute information request of a prepare write request */
+static uint8_t Prep_Prepare(uint8_t conidx, uint16_t attnum)
+{
+    struct gattc_att_info_req_ind req = { prepStartHdl + attnum };
+    const struct gattc_att_info_cfm *cfm = (const struct gattc_att_info_cfm *)msg.param;
+
+    msg.sent = 0;
+    GATTC_MsgHandler(GATTC_ATT_INFO_REQ_IND, &req, TASK_APP, KE_BUILD_ID(TASK_GATTC, conidx));
+    CHECK((msg.sent == 1) && (msg.id == GATTC_ATT_INFO_CFM));
+    CHECK(cfm->length == prepDb[attnum].length);
+    return cfm->status;
+}
+
+/** Sends a write request indication, as for a write request or an executed
+ *  prepared write, with value bytes counting from the offset */
+static uint8_t Prep_Write(uint8_t conidx, uint16_t attnum, uint16_t offset,
+                          uint16_t length)
+{
+    union
+    {
+        struct gattc_write_req_ind ind;
+        uint8_t buffer[sizeof(struct gattc_write_req_ind) + PREP_HUGE_LEN];
+    } req = { { prepStartHdl + attnum, offset, length } };
+    const struct gattc_write_cfm *cfm = (const struct gattc_write_cfm *)msg.param;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        req.ind.value[i] = (uint8_t)(offset + i);
+    }
+
+    msg.sent = 0;
+    GATTC_MsgHandler(GATTC_WRITE_REQ_IND, &req, TASK_APP, KE_BUILD_ID(TASK_GATTC, conidx));
+    CHECK((msg.sent == 1) && (msg.id == GATTC_WRITE_CFM));
+    CHECK(cfm->handle == prepStartHdl + attnum);
+    return cfm->status;
+}
+
+/** Sends a read request indication, returning its status */
+static uint8_t Prep_Read(uint8_t conidx, uint16_t attnum)
+{
+    struct gattc_read_req_ind req = { prepStartHdl + attnum };
+    const struct gattc_read_cfm *cfm = (const struct gattc_read_cfm *)msg.param;
+
+    msg.sent = 0;
+    GATTC_MsgHandler(GATTC_READ_REQ_IND, &req, TASK_APP, KE_BUILD_ID(TASK_GATTC, conidx));
+    CHECK((msg.sent == 1) && (msg.id == GATTC_READ_CFM));
+    return cfm->status;
+}
+
+/** Checks that value holds the bytes written by Prep_Write from start to
+ *  end, and the fill byte elsewhere */
+static bool Prep_Check(const uint8_t *value, uint16_t length, uint16_t start,
+                       uint16_t end, uint8_t fill)
+{
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (value[i] != (((i >= start) && (i < end)) ? (uint8_t)i : fill))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Prepares and executes a write of the bytes from start to end of an
+ *  attribute, in fragments, returning the status of the last one */
+static uint8_t Prep_LongWrite(uint8_t conidx, uint16_t attnum, uint16_t start,
+                              uint16_t end)
+{
+    uint8_t status = ATT_ERR_NO_ERROR;
+
+    for (uint16_t offset = start; offset < end; offset += PREP_FRAGMENT)
+    {
+        CHECK(Prep_Prepare(conidx, attnum) == ATT_ERR_NO_ERROR);
+    }
+    for (uint16_t offset = start; offset < end; offset += PREP_FRAGMENT)
+    {
+        /* Nothing is written before the last fragment */
+        CHECK(prepCb.count == 0);
+        status = Prep_Write(conidx, attnum, offset, MIN(PREP_FRAGMENT, end - offset));
+    }
+    return status;
+}
+
+static void Test_PrepWriteInOrder(void)
+{
+    /* A whole long value reaches the callback once, and the status of the
+     * callback is returned for the last fragment */
+    Prep_Setup(0xAA);
+    CHECK(Prep_LongWrite(1, PREP_LONG_ATT, 0, PREP_LONG_LEN) == ATT_ERR_NO_ERROR);
+    CHECK((prepCb.count == 1) && (prepCb.length == PREP_LONG_LEN));
+    CHECK(prepCb.hl_status == GAP_ERR_NO_ERROR);
+    CHECK(Prep_Check(prepCb.value, PREP_LONG_LEN, 0, PREP_LONG_LEN, 0xAA));
+    CHECK(Prep_Check(prepLong, PREP_LONG_LEN, 0, PREP_LONG_LEN, 0xAA));
+    CHECK(Prep_Read(1, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+
+    Prep_Setup(0xAA);
+    prepCb.status = ATT_ERR_APP_ERROR;
+    CHECK(Prep_LongWrite(1, PREP_LONG_ATT, 0, PREP_LONG_LEN) == ATT_ERR_APP_ERROR);
+    CHECK(prepCb.count == 1);
+    CHECK(Prep_Check(prepLong, PREP_LONG_LEN, 0, 0, 0xAA));
+
+    /* A write from an offset keeps the bytes before it */
+    Prep_Setup(0xAA);
+    CHECK(Prep_LongWrite(0, PREP_LONG_ATT, 30, 70) == ATT_ERR_NO_ERROR);
+    CHECK((prepCb.count == 1) && (prepCb.length == 70));
+    CHECK(Prep_Check(prepCb.value, 70, 30, 70, 0xAA));
+
+    /* Without a callback, the attribute is only written on the last
+     * fragment */
+    Prep_Setup(0x55);
+    CHECK(Prep_Prepare(2, PREP_PLAIN_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(2, PREP_PLAIN_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(2, PREP_PLAIN_ATT, 0, 40) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Check(prepPlain, PREP_PLAIN_LEN, 0, 0, 0x55));
+    CHECK(Prep_Write(2, PREP_PLAIN_ATT, 40, 24) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Check(prepPlain, PREP_PLAIN_LEN, 0, PREP_PLAIN_LEN, 0x55));
+
+    /* A queue for two attributes, executed in order, and another connection
+     * preparing writes meanwhile */
+    Prep_Setup(0x11);
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(0, PREP_PLAIN_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_LONG_ATT, 0, PREP_FRAGMENT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_LONG_ATT, PREP_FRAGMENT, PREP_FRAGMENT) == ATT_ERR_NO_ERROR);
+    CHECK((prepCb.count == 1) && (prepCb.length == 2 * PREP_FRAGMENT));
+    CHECK(Prep_Prepare(1, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_PLAIN_ATT, 0, 8) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Check(prepPlain, PREP_PLAIN_LEN, 0, 8, 0x11));
+    CHECK(Prep_Write(1, PREP_LONG_ATT, 50, 10) == ATT_ERR_NO_ERROR);
+    CHECK((prepCb.count == 2) && (prepCb.length == 60));
+    CHECK(Prep_Check(prepCb.value, 50, 0, 2 * PREP_FRAGMENT, 0x11));
+    CHECK((prepCb.value[50] == 50) && (prepCb.value[59] == 59));
+
+    /* Writes at offset 0 without prepared writes are write requests */
+    CHECK(Prep_Write(0, PREP_LONG_ATT, 0, 4) == ATT_ERR_NO_ERROR);
+    CHECK((prepCb.count == 3) && (prepCb.length == 4));
+}
+
+static void Test_PrepWriteOffset(void)
+{
+    /* An offset past the end of the attribute, or data going past it, fails
+     * the execute write without writing anything */
+    Prep_Setup(0xAA);
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_LONG_ATT, 0, PREP_FRAGMENT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_LONG_ATT, PREP_LONG_LEN + 1, 1) == ATT_ERR_INVALID_OFFSET);
+    CHECK(prepCb.count == 0);
+    CHECK(Prep_Read(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Check(prepLong, PREP_LONG_LEN, 0, 0, 0xAA));
+
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_LONG_ATT, 0, PREP_FRAGMENT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_LONG_ATT, PREP_LONG_LEN - 10, PREP_FRAGMENT) ==
+          ATT_ERR_INVALID_ATTRIBUTE_VAL_LEN);
+    CHECK(prepCb.count == 0);
+    CHECK(Prep_Check(prepLong, PREP_LONG_LEN, 0, 0, 0xAA));
+
+    /* An offset at the end of the attribute is valid */
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(0, PREP_LONG_ATT, PREP_LONG_LEN, 0) == ATT_ERR_NO_ERROR);
+    CHECK((prepCb.count == 1) && (prepCb.length == PREP_LONG_LEN));
+
+    /* Writes at an offset need prepared writes */
+    CHECK(Prep_Write(0, PREP_LONG_ATT, 1, 1) == ATT_ERR_INVALID_OFFSET);
+    CHECK(prepCb.count == 1);
+
+    /* Attributes longer than a buffer, and queues needing more buffers than
+     * the pool has, are rejected when the writes are prepared */
+    CHECK(Prep_Prepare(0, PREP_HUGE_ATT) == ATT_ERR_INSUFF_RESOURCE);
+    for (uint8_t conidx = 0; conidx < GATT_PREP_WRITE_BUF_COUNT; conidx++)
+    {
+        CHECK(Prep_Prepare(conidx, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    }
+    CHECK(Prep_Prepare(0, PREP_PLAIN_ATT) == ATT_ERR_PREPARE_QUEUE_FULL);
+    CHECK(Prep_Prepare(0, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    GATTC_PrepWriteFlush(0);
+    CHECK(Prep_Prepare(0, PREP_PLAIN_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(prepCb.count == 1);
+}
+
+static void Test_PrepWriteCancel(void)
+{
+    /* A cancelled queue is discarded by the end of the next execute write,
+     * and never reaches the attribute */
+    Prep_Setup(0xAA);
+    CHECK(Prep_Prepare(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(3, PREP_PLAIN_ATT, 0, 8) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(3, PREP_PLAIN_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(3, PREP_PLAIN_ATT, 8, 8) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Check(prepPlain, PREP_PLAIN_LEN, 0, 16, 0xAA));
+    CHECK(Prep_Read(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(prepCb.count == 0);
+    CHECK(Prep_Check(prepLong, PREP_LONG_LEN, 0, 0, 0xAA));
+
+    /* The buffers are free again */
+    for (uint8_t conidx = 0; conidx < GATT_PREP_WRITE_BUF_COUNT; conidx++)
+    {
+        CHECK(Prep_Prepare(conidx, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+        GATTC_PrepWriteFlush(conidx);
+    }
+
+    /* A queue cancelled, then prepared again for the same attribute, is
+     * written once with the new value, on the next request */
+    Prep_Setup(0xAA);
+    CHECK(Prep_Prepare(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_LongWrite(3, PREP_LONG_ATT, 20, 56) == ATT_ERR_NO_ERROR);
+    CHECK(prepCb.count == 0);
+    CHECK(Prep_Read(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK((prepCb.count == 1) && (prepCb.length == 56));
+    CHECK(Prep_Check(prepCb.value, 56, 20, 56, 0xAA));
+    CHECK(Prep_Check(prepLong, PREP_LONG_LEN, 20, 56, 0xAA));
+
+    /* Or on disconnection, while a cancelled queue is dropped */
+    Prep_Setup(0xAA);
+    CHECK(Prep_Prepare(3, PREP_PLAIN_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Prepare(3, PREP_LONG_ATT) == ATT_ERR_NO_ERROR);
+    CHECK(Prep_Write(3, PREP_LONG_ATT, 0, PREP_FRAGMENT) == ATT_ERR_NO_ERROR);
+    CHECK(prepCb.count == 0);
+    GATTC_PrepWriteFlush(3);
+    CHECK((prepCb.count == 1) && (prepCb.length == PREP_FRAGMENT));
+    CHECK(Prep_Check(prepPlain, PREP_PLAIN_LEN, 0, 0, 0xAA));
+    GATTC_PrepWriteFlush(3);
+    CHECK(prepCb.count == 1);
+}
+
+/* Former read and write request handlers, finding the service of a handle
+ * with a backward scan of the custom services */
+static const struct att_db_desc *ref_att_db;
+static uint16_t ref_att_db_len;
+
+static void Ref_ReadReqInd(ke_msg_id_t const msg_id,
+                           struct gattc_read_req_ind const *param, ke_task_id_t const dest_id,
+                           ke_task_id_t const src_id)
+{
+    signed int conidx = KE_IDX_GET(src_id);
+    struct gattc_read_cfm *cfm;
+    uint8_t length = 0;
+    uint8_t status = GAP_ERR_NO_ERROR;
+    uint16_t attnum;
+    static uint16_t read_start_hdl = 0;
+
+    for (int i = (svcCount - 1); i >= 0; i--)
+    {
+        if ((param->handle) > custSvcDb[i].cust_svc_start_hdl)
+        {
+            read_start_hdl = custSvcDb[i].cust_svc_start_hdl;
+            ref_att_db = custSvcDb[i].cust_svc_att_db;
+            ref_att_db_len = custSvcDb[i].cust_svc_att_db_len;
+            break;
+        }
+    }
+
+    attnum = (param->handle - read_start_hdl);
+
+    if (param->handle <= read_start_hdl)
+    {
+        status = ATT_ERR_INVALID_HANDLE;
+    }
+    else if ((attnum >= ref_att_db_len)
+             || !(ref_att_db[attnum].att.perm
+                  & (PERM(RD, ENABLE) | PERM(NTF, ENABLE))))
+    {
+        status = ATT_ERR_READ_NOT_PERMITTED;
+    }
+    else
+    {
+        length = ref_att_db[attnum].length;
+    }
+
+    cfm = KE_MSG_ALLOC_DYN(GATTC_READ_CFM, KE_BUILD_ID(TASK_GATTC, conidx),
+                           TASK_APP, gattc_read_cfm, length);
+
+    if (ref_att_db[attnum].callback != NULL)
+    {
+        status = ref_att_db[attnum].callback(conidx, attnum,
+                                             param->handle, cfm->value, ref_att_db[attnum].data,
+                                             length, GATTC_READ_REQ_IND, status);
+    }
+    else
+    {
+        if (status == GAP_ERR_NO_ERROR)
+        {
+            memcpy(cfm->value, ref_att_db[attnum].data, length);
+        }
+    }
+
+    cfm->handle = param->handle;
+    cfm->length = length;
+    cfm->status = status;
+
+    ke_msg_send(cfm);
+}
+
+static void Ref_WriteReqInd(ke_msg_id_t const msg_id,
+                            struct gattc_write_req_ind const *param, ke_task_id_t const dest_id,
+                            ke_task_id_t const src_id)
+{
+    signed int conidx = KE_IDX_GET(src_id);
+    struct gattc_write_cfm *cfm = KE_MSG_ALLOC(GATTC_WRITE_CFM,
+                                               KE_BUILD_ID(TASK_GATTC, conidx), TASK_APP, gattc_write_cfm);
+    uint8_t status = GAP_ERR_NO_ERROR;
+    uint16_t attnum;
+    static uint16_t write_start_hdl = 0;
+
+    for (int i = (svcCount - 1); i >= 0; i--)
+    {
+        if ((param->handle) > custSvcDb[i].cust_svc_start_hdl)
+        {
+            write_start_hdl = custSvcDb[i].cust_svc_start_hdl;
+            ref_att_db = custSvcDb[i].cust_svc_att_db;
+            ref_att_db_len = custSvcDb[i].cust_svc_att_db_len;
+            break;
+        }
+    }
+
+    attnum = (param->handle - write_start_hdl);
+
+    if (param->offset)
+    {
+        status = ATT_ERR_INVALID_OFFSET;
+    }
+    else if (param->handle <= write_start_hdl)
+    {
+        status = ATT_ERR_INVALID_HANDLE;
+    }
+    else if ((attnum >= ref_att_db_len)
+             || !(ref_att_db[attnum].att.perm
+                  & (PERM(WRITE_REQ, ENABLE) | PERM(WRITE_COMMAND, ENABLE))))
+    {
+        status = ATT_ERR_WRITE_NOT_PERMITTED;
+    }
+
+    if (ref_att_db[attnum].callback != NULL)
+    {
+        status = ref_att_db[attnum].callback(conidx, attnum,
+                                             param->handle, ref_att_db[attnum].data, param->value,
+                                             MIN(param->length, ref_att_db[attnum].length),
+                                             GATTC_WRITE_REQ_IND, status);
+    }
+    else
+    {
+        if (status == GAP_ERR_NO_ERROR)
+        {
+            memcpy(ref_att_db[attnum].data, param->value,
+                   MIN(param->length, ref_att_db[attnum].length));
+        }
+    }
+
+    cfm->handle = param->handle;
+    cfm->status = status;
+
+    ke_msg_send(cfm);
+}
+
+/* Value handles of the readable and of the writable characteristics */
+static uint16_t benchReadHdl[TEST_SVC_MAX * 3];
+static uint16_t benchWriteHdl[TEST_SVC_MAX * 3];
+static uint16_t benchReadCount;
+static uint16_t benchWriteCount;
+
+typedef void (*Bench_Handler_t)(ke_msg_id_t const msg_id, void const *param,
+                                ke_task_id_t const dest_id, ke_task_id_t const src_id);
+
+/** Returns the average cost of a request, for handles taken in turn */
+static double Bench_Requests(Bench_Handler_t handler, ke_msg_id_t msg_id,
+                             const uint16_t *handles, uint16_t count)
+{
+    union
+    {
+        struct gattc_write_req_ind ind;
+        uint8_t buffer[sizeof(struct gattc_write_req_ind) + TEST_VALUE_LEN];
+    } req = { { 0, 0, TEST_VALUE_LEN } };
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned int i = 0; i < BENCH_REQUESTS; i++)
+    {
+        /* The read request only has the handle, the first member of both */
+        req.ind.handle = handles[i % count];
+        handler(msg_id, &req, TASK_APP, KE_BUILD_ID(TASK_GATTC, 0));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+           BENCH_REQUESTS;
+}
+
+static void Bench(void)
+{
+    static const uint16_t counts[] = { 4, 8, 16, 32, 64 };
+
+    printf("%-10s %10s %10s %10s %10s\n", "services", "read ns", "scan ns",
+           "write ns", "scan ns");
+    for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        Test_AddServices(counts[i]);
+        benchReadCount = 0;
+        benchWriteCount = 0;
+        for (uint16_t s = 0; s < svcCount; s++)
+        {
+            for (uint16_t attnum = 2; attnum < svcLen[s]; attnum += 2)
+            {
+                uint16_t handle = custSvcDb[s].cust_svc_start_hdl + attnum;
+                if (svcDb[s][attnum].att.perm & PERM(RD, ENABLE))
+                {
+                    benchReadHdl[benchReadCount++] = handle;
+                }
+                if (svcDb[s][attnum].att.perm & PERM(WRITE_REQ, ENABLE))
+                {
+                    benchWriteHdl[benchWriteCount++] = handle;
+                }
+            }
+        }
+
+        printf("%-10u %10.1f %10.1f %10.1f %10.1f\n", counts[i],
+               Bench_Requests((Bench_Handler_t)GATTC_ReadReqInd, GATTC_READ_REQ_IND,
+                              benchReadHdl, benchReadCount),
+               Bench_Requests((Bench_Handler_t)Ref_ReadReqInd, GATTC_READ_REQ_IND,
+                              benchReadHdl, benchReadCount),
+               Bench_Requests((Bench_Handler_t)GATTC_WriteReqInd, GATTC_WRITE_REQ_IND,
+                              benchWriteHdl, benchWriteCount),
+               Bench_Requests((Bench_Handler_t)Ref_WriteReqInd, GATTC_WRITE_REQ_IND,
+                              benchWriteHdl, benchWriteCount));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc == 2) && (strcmp(argv[1], "-b") == 0))
+    {
+        Bench();
+        return 0;
+    }
+    if (argc != 1)
+    {
+        fprintf(stderr, "usage: %s [-b]\n", argv[0]);
+        return 2;
+    }
+
+    Test_Lookup();
+    Test_PrepWriteInOrder();
+    Test_PrepWriteOffset();
+    Test_PrepWriteCancel();
+
+    printf("gatt_test: %s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
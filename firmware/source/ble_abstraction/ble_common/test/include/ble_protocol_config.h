@@ -0,0 +1,35 @@
+/**
+ * @file ble_protocol_config.h
+ * @brief Host replacement of the BLE protocol configuration of the samples
+ *
+ * Provides the stack configuration and the connection and activity counts
+ * used by the BLE abstraction, without the baseband headers of ble.h which
+ * cannot be built on the host.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef BLE_PROTOCOL_CONFIG_H
+#define BLE_PROTOCOL_CONFIG_H
+
+#include <rwip_config.h>
+#include <co_bt.h>
+#include <gap.h>
+
+/* Number of connections, activities and profiles, as in the
+ * ble_peripheral_server sample */
+#define APP_MAX_NB_CON                  10
+#define APP_MAX_NB_ACTIVITY             11
+#define APP_MAX_NB_PROFILES             8
+
+#endif    /* BLE_PROTOCOL_CONFIG_H */
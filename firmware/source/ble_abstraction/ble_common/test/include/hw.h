@@ -0,0 +1,44 @@
+/**
+ * @file hw.h
+ * @brief Host replacement of the device header, used to build the BLE
+ *        abstraction against the BLE stack headers
+ *
+ * Provides the memory map used by the bond list header, and the flash
+ * registers used by the ROM flash functions, without the Cortex-M33 core
+ * support which cannot be built on the host.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef HW_H
+#define HW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* CMSIS qualifiers and keywords */
+#define __I                             volatile const
+#define __O                             volatile
+#define __IO                            volatile
+#define __IM                            volatile const
+#define __OM                            volatile
+#define __IOM                           volatile
+#define __STATIC_INLINE                 static inline
+#define __WEAK                          __attribute__((weak))
+
+#include <montana_vectors.h>
+#include <montana_hw.h>
+#include <montana_map.h>
+
+#endif    /* HW_H */
@@ -0,0 +1,62 @@
+/**
+ * @file rom_vect.h
+ * @brief Host replacement of the ROM jump table, used to run the ROM flash
+ *        functions called by the bond list on the flash simulator
+ *
+ * The entries of the jump table are read from bondlist_rom, which
+ * bondlist_flash.c fills with the flash library functions run by the flash
+ * simulator of the flash library tests.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef ROMVECT_H_
+#define ROMVECT_H_
+
+/** Entries of the jump table, in the order of the ROM */
+typedef enum
+{
+    BONDLIST_ROM_INITIALIZE,
+    BONDLIST_ROM_WRITEWORD,
+    BONDLIST_ROM_READWORD,
+    BONDLIST_ROM_WRITEDOUBLE,
+    BONDLIST_ROM_READDOUBLE,
+    BONDLIST_ROM_WRITEBUFFER,
+    BONDLIST_ROM_READBUFFER,
+    BONDLIST_ROM_ERASEFLASHBANK,
+    BONDLIST_ROM_ERASECHIP,
+    BONDLIST_ROM_ERASESECTOR,
+    BONDLIST_ROM_BLANKCHECK,
+    BONDLIST_ROM_COUNT
+} BondListRom_t;
+
+/** Jump table, see bondlist_flash.c */
+extern void * const bondlist_rom[BONDLIST_ROM_COUNT];
+
+/* Program ROM flash library version, not read by the test */
+#define FLASHVERSION_BASEADDR               0x00000018U
+
+/* Flash library functions */
+#define ROMVECT_FLASH_INITIALIZE            (&bondlist_rom[BONDLIST_ROM_INITIALIZE])
+#define ROMVECT_FLASH_WRITEWORD             (&bondlist_rom[BONDLIST_ROM_WRITEWORD])
+#define ROMVECT_FLASH_READWORD              (&bondlist_rom[BONDLIST_ROM_READWORD])
+#define ROMVECT_FLASH_WRITEDOUBLE           (&bondlist_rom[BONDLIST_ROM_WRITEDOUBLE])
+#define ROMVECT_FLASH_READDOUBLE            (&bondlist_rom[BONDLIST_ROM_READDOUBLE])
+#define ROMVECT_FLASH_WRITEBUFFER           (&bondlist_rom[BONDLIST_ROM_WRITEBUFFER])
+#define ROMVECT_FLASH_READBUFFER            (&bondlist_rom[BONDLIST_ROM_READBUFFER])
+#define ROMVECT_FLASH_ERASEFLASHBANK        (&bondlist_rom[BONDLIST_ROM_ERASEFLASHBANK])
+#define ROMVECT_FLASH_ERASECHIP             (&bondlist_rom[BONDLIST_ROM_ERASECHIP])
+#define ROMVECT_FLASH_ERASESECTOR           (&bondlist_rom[BONDLIST_ROM_ERASESECTOR])
+#define ROMVECT_FLASH_BLANKCHECK            (&bondlist_rom[BONDLIST_ROM_BLANKCHECK])
+
+#endif    /* ROMVECT_H_ */
@@ -0,0 +1,524 @@
+/**
+ * @file msg_handler_test.c
+ * @brief Host test and benchmark of the BLE abstraction message handler
+ *
+ * Usage: msg_handler_test [-b]
+ *   -b           print the cost of a notification of the handler table and
+ *                of the former linked list, for the handlers of the
+ *                ble_peripheral_server sample and for a full table
+ *
+ * msg_handler.c is built into the test, so that its table can be emptied
+ * between the cases. The former linked list dispatcher is kept here as the
+ * reference: for random registrations, including duplicates and handlers
+ * for whole tasks, both have to call the same handlers in the same order,
+ * including handlers added by a callback during a notification.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../source/msg_handler.c"
+
+/** Number of calls recorded for a notification */
+#define TEST_CALLS                      256
+
+/** Number of rounds of random registrations */
+#define TEST_ROUNDS                     500
+
+/** Number of notifications of each benchmarked message */
+#define BENCH_NOTIFY                    1000000
+
+static unsigned int failures;
+
+#define CHECK(expr)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(expr))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+/* Calls of the last notification, by callback number; the abstraction
+ * layer handlers are recorded as the negated task identifier */
+static int calls[TEST_CALLS];
+static unsigned int callCount;
+
+static void Record(int id)
+{
+    if (callCount < TEST_CALLS)
+    {
+        calls[callCount] = id;
+    }
+    callCount++;
+}
+
+/* Abstraction layer handlers */
+void GAPC_MsgHandler(ke_msg_id_t const msg_id, void const *param,
+                     ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    Record(-TASK_ID_GAPC);
+}
+
+void GAPM_MsgHandler(ke_msg_id_t const msg_id, void const *param,
+                     ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    Record(-TASK_ID_GAPM);
+}
+
+void GATTC_MsgHandler(ke_msg_id_t const msg_id, void const *param,
+                      ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    Record(-TASK_ID_GATTC);
+}
+
+void GATTM_MsgHandler(ke_msg_id_t const msg_id, void const *param,
+                      ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    Record(-TASK_ID_GATTM);
+}
+
+/* Application handlers, each recording its own number */
+#define CALLBACK(n)                                                           \
+    static void Callback##n(ke_msg_id_t const msg_id, void const *param,      \
+                            ke_task_id_t const dest_id,                       \
+                            ke_task_id_t const src_id)                        \
+    {                                                                         \
+        Record(n);                                                            \
+    }
+#define CALLBACK8(n)                                                          \
+    CALLBACK(n##0) CALLBACK(n##1) CALLBACK(n##2) CALLBACK(n##3)               \
+    CALLBACK(n##4) CALLBACK(n##5) CALLBACK(n##6) CALLBACK(n##7)
+#define CALLBACK_REF8(n)                                                      \
+    Callback##n##0, Callback##n##1, Callback##n##2, Callback##n##3,           \
+    Callback##n##4, Callback##n##5, Callback##n##6, Callback##n##7
+
+CALLBACK8(1) CALLBACK8(2) CALLBACK8(3) CALLBACK8(4)
+CALLBACK8(5) CALLBACK8(6) CALLBACK8(7) CALLBACK8(8) CALLBACK8(9)
+
+static const MsgHandlerCallback_t callbacks[] = {
+    CALLBACK_REF8(1), CALLBACK_REF8(2), CALLBACK_REF8(3), CALLBACK_REF8(4),
+    CALLBACK_REF8(5), CALLBACK_REF8(6), CALLBACK_REF8(7), CALLBACK_REF8(8),
+    CALLBACK_REF8(9)
+};
+
+#define TEST_CALLBACKS                  (sizeof(callbacks) / sizeof(callbacks[0]))
+
+/* Former dispatcher, a linked list in registration order */
+typedef struct RefHandler
+{
+    uint16_t msg_id;
+    MsgHandlerCallback_t callback;
+    struct RefHandler *next;
+} RefHandler_t;
+
+static RefHandler_t *refHead = NULL;
+
+static bool Ref_Add(ke_msg_id_t const msg_id, MsgHandlerCallback_t callback)
+{
+    if (callback == NULL)
+    {
+        return false;
+    }
+
+    RefHandler_t *newElem = (RefHandler_t *)malloc(sizeof(RefHandler_t));
+    if (!newElem)
+    {
+        return false;
+    }
+
+    newElem->msg_id = msg_id;
+    newElem->callback = callback;
+    newElem->next = NULL;
+
+    if (!refHead)
+    {
+        refHead = newElem;
+    }
+    else
+    {
+        RefHandler_t *tmp = refHead;
+
+        while (tmp->next && (tmp->msg_id != msg_id || tmp->callback != callback))
+        {
+            tmp = tmp->next;
+        }
+        if (tmp->msg_id == msg_id && tmp->callback == callback)
+        {
+            free(newElem);
+            return false;
+        }
+        tmp->next = newElem;
+    }
+
+    return true;
+}
+
+static int Ref_Notify(ke_msg_id_t const msg_id, void const *param,
+                      ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    RefHandler_t *tmp = refHead;
+    uint8_t task_id = KE_IDX_GET(msg_id);
+
+    switch (task_id)
+    {
+        case TASK_ID_GAPC:
+        {
+            GAPC_MsgHandler(msg_id, param, dest_id, src_id);
+        }
+        break;
+
+        case TASK_ID_GAPM:
+        {
+            GAPM_MsgHandler(msg_id, param, dest_id, src_id);
+        }
+        break;
+
+        case TASK_ID_GATTC:
+        {
+            GATTC_MsgHandler(msg_id, param, dest_id, src_id);
+        }
+        break;
+
+        case TASK_ID_GATTM:
+        {
+            GATTM_MsgHandler(msg_id, param, dest_id, src_id);
+        }
+        break;
+    }
+
+    while (tmp)
+    {
+        if ((tmp->msg_id == msg_id) || (tmp->msg_id == task_id))
+        {
+            tmp->callback(msg_id, param, dest_id, src_id);
+        }
+        tmp = tmp->next;
+    }
+    return KE_MSG_CONSUMED;
+}
+
+static void Test_Reset(void)
+{
+    while (refHead != NULL)
+    {
+        RefHandler_t *next = refHead->next;
+        free(refHead);
+        refHead = next;
+    }
+    handlerCount = 0;
+}
+
+/** Registers a handler in both dispatchers, which have to agree */
+static void Test_Add(ke_msg_id_t msg_id, MsgHandlerCallback_t callback)
+{
+    bool added = MsgHandler_Add(msg_id, callback);
+    CHECK(added == Ref_Add(msg_id, callback));
+}
+
+/** Notifies a message with both dispatchers, which have to call the same
+ *  handlers in the same order */
+static void Test_Notify(ke_msg_id_t msg_id, int line)
+{
+    int expected[TEST_CALLS];
+    unsigned int expectedCount;
+
+    callCount = 0;
+    Ref_Notify(msg_id, NULL, TASK_APP, TASK_GAPM);
+    expectedCount = callCount;
+    memcpy(expected, calls, sizeof(expected));
+
+    callCount = 0;
+    CHECK(MsgHandler_Notify(msg_id, NULL, TASK_APP, TASK_GAPM) == KE_MSG_CONSUMED);
+
+    if ((callCount != expectedCount) ||
+        (memcmp(calls, expected, (callCount < TEST_CALLS ? callCount : TEST_CALLS) *
+                sizeof(calls[0])) != 0))
+    {
+        printf("%s:%d: message 0x%04x: %u calls, %u expected\n", __FILE__, line,
+               msg_id, callCount, expectedCount);
+        failures++;
+    }
+}
+
+/* Identifiers of the random registrations: messages of the abstraction
+ * layer tasks and of the application, the tasks themselves, and message 0,
+ * whose identifier is also the one of task 0 */
+static const ke_msg_id_t testIds[] = {
+    GAPM_CMP_EVT, GAPM_PROFILE_ADDED_IND, GAPC_CONNECTION_REQ_IND,
+    GAPC_DISCONNECT_IND, GATTC_CMP_EVT, GATTC_WRITE_REQ_IND,
+    GATTM_ADD_SVC_RSP, TASK_FIRST_MSG(TASK_ID_APP) + 1,
+    TASK_FIRST_MSG(TASK_ID_APP) + 2, TASK_FIRST_MSG(TASK_ID_BASS) + 1,
+    TASK_ID_GAPM, TASK_ID_GAPC, TASK_ID_GATTC, TASK_ID_APP, TASK_ID_BASS,
+    0
+};
+
+#define TEST_IDS                        (sizeof(testIds) / sizeof(testIds[0]))
+
+/* Messages notified after the registrations, including ones without any
+ * handler */
+static const ke_msg_id_t testMessages[] = {
+    GAPM_CMP_EVT, GAPM_PROFILE_ADDED_IND, GAPM_ACTIVITY_CREATED_IND,
+    GAPC_CONNECTION_REQ_IND, GAPC_DISCONNECT_IND, GAPC_BOND_IND,
+    GATTC_CMP_EVT, GATTC_WRITE_REQ_IND, GATTC_READ_REQ_IND,
+    GATTM_ADD_SVC_RSP, TASK_FIRST_MSG(TASK_ID_APP) + 1,
+    TASK_FIRST_MSG(TASK_ID_APP) + 2, TASK_FIRST_MSG(TASK_ID_APP) + 3,
+    TASK_FIRST_MSG(TASK_ID_BASS) + 1, TASK_FIRST_MSG(TASK_ID_DISS) + 1, 0
+};
+
+#define TEST_MESSAGES                   (sizeof(testMessages) / sizeof(testMessages[0]))
+
+static void Test_Random(void)
+{
+    srand(1);
+    for (unsigned int round = 0; round < TEST_ROUNDS; round++)
+    {
+        /* Few callbacks per round, so that duplicates are frequent */
+        unsigned int count = 1 + rand() % (MSG_HANDLER_MAX - 1);
+        unsigned int choices = 2 + rand() % 12;
+
+        Test_Reset();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            Test_Add(testIds[rand() % TEST_IDS], callbacks[rand() % choices]);
+        }
+        for (unsigned int i = 0; i < TEST_MESSAGES; i++)
+        {
+            Test_Notify(testMessages[i], __LINE__);
+        }
+    }
+}
+
+static void Test_Bound(void)
+{
+    Test_Reset();
+    CHECK(!MsgHandler_Add(GAPM_CMP_EVT, NULL));
+
+    /* The table holds MSG_HANDLER_MAX handlers, then rejects new ones
+     * without losing any */
+    for (unsigned int i = 0; i < MSG_HANDLER_MAX; i++)
+    {
+        ke_msg_id_t msg_id = testIds[i % TEST_IDS];
+        MsgHandlerCallback_t callback = callbacks[i / TEST_IDS];
+        CHECK(MsgHandler_Add(msg_id, callback));
+        Ref_Add(msg_id, callback);
+    }
+    CHECK(handlerCount == MSG_HANDLER_MAX);
+    CHECK(!MsgHandler_Add(GATTC_READ_REQ_IND, callbacks[TEST_CALLBACKS - 1]));
+    CHECK(!MsgHandler_Add(TASK_ID_APP, callbacks[TEST_CALLBACKS - 1]));
+    CHECK(handlerCount == MSG_HANDLER_MAX);
+    for (unsigned int i = 0; i < TEST_MESSAGES; i++)
+    {
+        Test_Notify(testMessages[i], __LINE__);
+    }
+}
+
+/* Handlers registering other handlers during a notification, in the
+ * dispatcher under test */
+static bool (*addHandler)(ke_msg_id_t const msg_id, MsgHandlerCallback_t callback);
+
+static void Callback_AddMessage(ke_msg_id_t const msg_id, void const *param,
+                                ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    Record(1);
+    addHandler(msg_id, callbacks[3]);
+    addHandler(TASK_FIRST_MSG(TASK_ID_APP) + 1, callbacks[4]);
+}
+
+static void Callback_AddTask(ke_msg_id_t const msg_id, void const *param,
+                             ke_task_id_t const dest_id, ke_task_id_t const src_id)
+{
+    Record(2);
+    addHandler(KE_IDX_GET(msg_id), callbacks[5]);
+    addHandler(KE_IDX_GET(msg_id), callbacks[0]);
+}
+
+static void Test_AddFromCallback(void)
+{
+    static const ke_msg_id_t messages[] = {
+        GAPM_CMP_EVT, GAPC_DISCONNECT_IND, GAPM_CMP_EVT,
+        TASK_FIRST_MSG(TASK_ID_APP) + 1, GAPM_CMP_EVT
+    };
+    int expected[TEST_CALLS];
+    unsigned int expectedCount;
+
+    for (unsigned int i = 0; i < sizeof(messages) / sizeof(messages[0]); i++)
+    {
+        /* Rebuild the same history in both dispatchers, as the handlers
+         * added by a callback depend on the dispatcher notifying */
+        Test_Reset();
+        addHandler = Ref_Add;
+        Ref_Add(GAPM_CMP_EVT, callbacks[0]);
+        Ref_Add(TASK_ID_GAPM, Callback_AddMessage);
+        Ref_Add(GAPM_CMP_EVT, Callback_AddTask);
+        Ref_Add(TASK_ID_GAPC, Callback_AddTask);
+        Ref_Add(GAPM_CMP_EVT, callbacks[1]);
+        for (unsigned int j = 0; j <= i; j++)
+        {
+            callCount = 0;
+            Ref_Notify(messages[j], NULL, TASK_APP, TASK_GAPM);
+        }
+        expectedCount = callCount;
+        memcpy(expected, calls, sizeof(expected));
+
+        addHandler = MsgHandler_Add;
+        MsgHandler_Add(GAPM_CMP_EVT, callbacks[0]);
+        MsgHandler_Add(TASK_ID_GAPM, Callback_AddMessage);
+        MsgHandler_Add(GAPM_CMP_EVT, Callback_AddTask);
+        MsgHandler_Add(TASK_ID_GAPC, Callback_AddTask);
+        MsgHandler_Add(GAPM_CMP_EVT, callbacks[1]);
+        for (unsigned int j = 0; j <= i; j++)
+        {
+            callCount = 0;
+            MsgHandler_Notify(messages[j], NULL, TASK_APP, TASK_GAPM);
+        }
+
+        CHECK(callCount == expectedCount);
+        CHECK(memcmp(calls, expected, callCount * sizeof(calls[0])) == 0);
+    }
+}
+
+/* Handlers of the ble_peripheral_server sample, with the battery and
+ * device information profiles, in registration order */
+static const struct
+{
+    ke_msg_id_t msg_id;
+    unsigned int callback;
+} benchHandlers[] = {
+    /* Profiles */
+    { TASK_ID_DISS, 0 }, { GAPM_PROFILE_ADDED_IND, 0 },
+    { TASK_ID_BASS, 1 }, { GAPM_PROFILE_ADDED_IND, 1 },
+    { GAPC_DISCONNECT_IND, 1 }, { TASK_FIRST_MSG(TASK_ID_BASS) + 50, 1 },
+    /* Custom service */
+    { GATTM_ADD_SVC_RSP, 2 }, { TASK_FIRST_MSG(TASK_ID_APP) + 60, 2 },
+    { TASK_FIRST_MSG(TASK_ID_APP) + 61, 2 }, { GATTC_CMP_EVT, 2 },
+    /* Configuration */
+    { GAPM_CMP_EVT, 3 }, { GAPM_PROFILE_ADDED_IND, 3 },
+    { GATTM_ADD_SVC_RSP, 3 },
+    /* Activities */
+    { GAPM_CMP_EVT, 4 }, { GAPM_ACTIVITY_CREATED_IND, 4 },
+    { GAPM_ACTIVITY_STOPPED_IND, 4 },
+    /* Connections */
+    { GAPM_CMP_EVT, 5 }, { GAPC_CONNECTION_REQ_IND, 5 },
+    { GAPC_DISCONNECT_IND, 5 }, { GAPM_ADDR_SOLVED_IND, 5 },
+    { GAPC_GET_DEV_INFO_REQ_IND, 5 }, { GAPC_PARAM_UPDATE_REQ_IND, 5 },
+    /* Pairing */
+    { GAPC_BOND_REQ_IND, 6 }, { GAPC_BOND_IND, 6 },
+    { GAPC_ENCRYPT_REQ_IND, 6 }, { GAPC_ENCRYPT_IND, 6 },
+    /* Application timers */
+    { TASK_FIRST_MSG(TASK_ID_APP) + 1, 7 },
+    { TASK_FIRST_MSG(TASK_ID_APP) + 2, 8 },
+    { TASK_FIRST_MSG(TASK_ID_APP) + 3, 9 },
+    { TASK_FIRST_MSG(TASK_ID_APP) + 4, 10 }
+};
+
+#define BENCH_HANDLERS                  (sizeof(benchHandlers) / sizeof(benchHandlers[0]))
+
+/* Messages of a connection, with the share of each in the mix */
+static const struct
+{
+    const char *name;
+    ke_msg_id_t msg_id;
+    unsigned int share;
+} benchMessages[] = {
+    { "LED timer", TASK_FIRST_MSG(TASK_ID_APP) + 1, 20 },
+    { "notification timer", TASK_FIRST_MSG(TASK_ID_APP) + 60, 20 },
+    { "GATTC_CMP_EVT", GATTC_CMP_EVT, 20 },
+    { "GATTC_WRITE_REQ_IND", GATTC_WRITE_REQ_IND, 10 },
+    { "GATTC_READ_REQ_IND", GATTC_READ_REQ_IND, 10 },
+    { "BASS level timer", TASK_FIRST_MSG(TASK_ID_BASS) + 50, 10 },
+    { "GAPC_PARAM_UPDATE", GAPC_PARAM_UPDATE_REQ_IND, 5 },
+    { "GAPM_CMP_EVT", GAPM_CMP_EVT, 5 }
+};
+
+#define BENCH_MESSAGES                  (sizeof(benchMessages) / sizeof(benchMessages[0]))
+
+/** Returns the average cost of a notification of a message, in ns */
+static double Bench_Notify(int (*notify)(ke_msg_id_t const, void const *,
+                                         ke_task_id_t const, ke_task_id_t const),
+                           ke_msg_id_t msg_id)
+{
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned int i = 0; i < BENCH_NOTIFY; i++)
+    {
+        callCount = 0;
+        notify(msg_id, NULL, TASK_APP, TASK_GAPM);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) /
+           BENCH_NOTIFY;
+}
+
+static void Bench_Table(const char *title)
+{
+    double table_mix = 0;
+    double list_mix = 0;
+
+    printf("%s, %u handlers\n", title, handlerCount);
+    printf("  %-20s %10s %10s\n", "message", "table ns", "list ns");
+    for (unsigned int i = 0; i < BENCH_MESSAGES; i++)
+    {
+        double table_ns = Bench_Notify(MsgHandler_Notify, benchMessages[i].msg_id);
+        double list_ns = Bench_Notify(Ref_Notify, benchMessages[i].msg_id);
+        printf("  %-20s %10.1f %10.1f\n", benchMessages[i].name, table_ns, list_ns);
+        table_mix += table_ns * benchMessages[i].share / 100;
+        list_mix += list_ns * benchMessages[i].share / 100;
+    }
+    printf("  %-20s %10.1f %10.1f\n", "mix", table_mix, list_mix);
+}
+
+static void Bench(void)
+{
+    Test_Reset();
+    for (unsigned int i = 0; i < BENCH_HANDLERS; i++)
+    {
+        Test_Add(benchHandlers[i].msg_id, callbacks[benchHandlers[i].callback]);
+    }
+    Bench_Table("ble_peripheral_server");
+
+    /* Fill the table with handlers of other application messages */
+    for (unsigned int i = 0; handlerCount < MSG_HANDLER_MAX; i++)
+    {
+        Test_Add(TASK_FIRST_MSG(TASK_ID_APP) + 100 + i, callbacks[i % TEST_CALLBACKS]);
+    }
+    Bench_Table("Full table");
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc == 2) && (strcmp(argv[1], "-b") == 0))
+    {
+        Bench();
+        return 0;
+    }
+    if (argc != 1)
+    {
+        fprintf(stderr, "usage: %s [-b]\n", argv[0]);
+        return 2;
+    }
+
+    Test_Random();
+    Test_Bound();
+    Test_AddFromCallback();
+    Test_Reset();
+
+    printf("msg_handler_test: %s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
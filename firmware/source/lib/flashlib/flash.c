@@ -36,9 +36,23 @@ const uint32_t freq_map[FREQ_MAP_NUM] =
     [FLASH_DELAY_FOR_SYSCLK_48MHZ] = FLASH_CLOCK_48MHZ,
 };
 
+#ifdef FLASH_STATS
+/* Flash operation counters */
+FlashStats_t flash_stats;
+#endif    /* ifdef FLASH_STATS */
+
 /* Flash interfaces array constants */
 extern const struct interface *ifcs[FLASH_INSTANCE_NUM];
 
+/* Last region found by Sys_Flash_GetAddrInfo, as
+ * ((instance << 4) | region) + 1, or 0 if none. A single byte is used so
+ * that it is updated atomically when flash functions are called from
+ * interrupt handlers. */
+static uint8_t last_region_hit;
+
+/* Check that a flash interface can be used, see Flash_JobSanity */
+static FlashStatus_t Flash_JobSanity(FLASH_Type *flash);
+
 void Sys_Flash_WriteWordOperation(FLASH_Type *flash, uint32_t addr,
                                   uint32_t word,
                                   uint32_t cmd_prg_type)
@@ -58,6 +72,7 @@ void Sys_Flash_WriteWordOperation(FLASH_Type *flash, uint32_t addr,
 
     /* Execute a program operation */
     Sys_Flash_ExecuteCommand(flash, cmd_prg_type);
+    FLASH_STATS_ADD(words_programmed, 1);
 
     /* Restore IF_CTRL */
     Sys_Flash_ApplyIFCTRL(flash, backup_IF_CTRL);
@@ -84,6 +99,7 @@ void Sys_Flash_WriteDoubleOperation(FLASH_Type *flash, uint32_t addr,
 
     /* Execute a program operation */
     Sys_Flash_ExecuteCommand(flash, cmd_prg_type);
+    FLASH_STATS_ADD(words_programmed, 2);
 
     /* Restore IF_CTRL */
     Sys_Flash_ApplyIFCTRL(flash, backup_IF_CTRL);
@@ -239,6 +255,7 @@ FlashStatus_t Sys_Flash_WriteSequentialData(FLASH_Type *flash, uint32_t addr,
     {
         /* Read final CRC value calculated for the words written */
         *crc = CRC->FINAL;
+        FLASH_STATS_ADD(words_programmed, word_length);
     }
 
     /* Restore CRC peripheral registers */
@@ -263,6 +280,7 @@ void Sys_Flash_EraseMass(FLASH_Type *flash)
     Sys_Flash_ApplyRetryLevel(flash, FLASH_RETRY_4);
 
     Sys_Flash_ExecuteCommand(flash, CMD_MASS_ERASE);
+    FLASH_STATS_ADD(mass_erases, 1);
 
     /* Restore IF_CTRL */
     Sys_Flash_ApplyIFCTRL(flash, backup_IF_CTRL);
@@ -281,6 +299,7 @@ void Sys_Flash_EraseSectorOperation(FLASH_Type *flash, uint32_t addr,
 
     flash->ADDR = addr;
     Sys_Flash_ExecuteCommand(flash, CMD_SECTOR_ERASE);
+    FLASH_STATS_ADD(sector_erases, 1);
 
     /* Restore IF_CTRL */
     Sys_Flash_ApplyIFCTRL(flash, backup_IF_CTRL);
@@ -440,6 +459,7 @@ FlashStatus_t Sys_Flash_Copier_CRC_Calculate(FLASH_Type *flash, uint32_t addr,
     flash->COPY_WORD_CNT = word_length;
     flash->COPY_CFG = (COPY_MODE | COPY_TO_CRC);
     flash->COPY_CTRL = COPY_START;
+    FLASH_STATS_ADD(words_copied, word_length);
     Sys_Flash_Copier_WaitBusy(flash);
     if ((flash->COPY_CTRL & (0x1U << FLASH_COPY_CTRL_ERROR_Pos)) != COPY_ERROR)
     {
@@ -492,6 +512,7 @@ FlashStatus_t Sys_Flash_Copier_VerifyEmpty(FLASH_Type *flash, uint32_t addr,
     flash->DATA[1] = 0xFFFFFFFF;
 
     flash->COPY_CTRL = COPY_START;
+    FLASH_STATS_ADD(words_copied, word_length);
 
     Sys_Flash_Copier_WaitBusy(flash);
 
@@ -523,6 +544,7 @@ FlashStatus_t Sys_Flash_Copier_Copy(FLASH_Type *flash, uint32_t src_addr,
     flash->COPY_WORD_CNT = word_length;
     flash->COPY_CFG = (COPY_MODE);
     flash->COPY_CTRL = COPY_START;
+    FLASH_STATS_ADD(words_copied, word_length);
     Sys_Flash_Copier_WaitBusy(flash);
     if ((flash->COPY_CTRL & (0x1U << FLASH_COPY_CTRL_ERROR_Pos)) != COPY_ERROR)
     {
@@ -679,6 +701,30 @@ FlashStatus_t Sys_Flash_CalculateEnableRegions(struct region_descriptor *region,
     return r;
 }
 
+/**
+ * @brief Check if an address is in a flash region, and fill in the info
+ *        object if it is
+ * @param [in] addr flash address
+ * @param [in] i    flash instance
+ * @param [in] rno  region number within the flash instance
+ * @param [out] info C pointer to info data type filled in if the address is
+ *              in the region
+ * @return True if the address is in the region
+ */
+static inline bool Sys_Flash_AddrInRegion(uint32_t addr, unsigned int i,
+                                          unsigned int rno, struct info *info)
+{
+    const struct region_descriptor *region = &ifcs[i]->regions[rno];
+
+    if (addr >= region->base && addr <= region->top)
+    {
+        info->flash = &FLASH[i];
+        info->region = (struct region_descriptor *)region;
+        return true;
+    }
+    return false;
+}
+
 FlashStatus_t Sys_Flash_GetAddrInfo(uint32_t addr, struct info *info)
 {
     FlashStatus_t r;
@@ -695,24 +741,22 @@ FlashStatus_t Sys_Flash_GetAddrInfo(uint32_t addr, struct info *info)
         r = Flash_FlashAddrParamSanity(addr);
         if (r == FLASH_ERR_NONE)
         {
-            /* Assign a default value before searching for the address */
-            bool found = false;
-
-            for (unsigned int i = 0; i < FLASH_INSTANCE_NUM; i++)
+            /* Successive accesses are usually in the same region: try the
+             * last region found first */
+            uint8_t hit = last_region_hit;
+            bool found = (hit != 0) &&
+                         Sys_Flash_AddrInRegion(addr, (hit - 1U) >> 4,
+                                                (hit - 1U) & 0xFU, info);
+
+            for (unsigned int i = 0; (found == false) && (i < FLASH_INSTANCE_NUM); i++)
             {
-                if (found == false)
+                for (unsigned int rno = 0; rno < ifcs[i]->total_regions;  rno++)
                 {
-                    for (unsigned int rno = 0; rno < ifcs[i]->total_regions;  rno++)
+                    if (Sys_Flash_AddrInRegion(addr, i, rno, info))
                     {
-                        if (addr >= ifcs[i]->regions[rno].base &&
-                            addr <= ifcs[i]->regions[rno].top)
-                        {
-                            info->flash = &FLASH[i];
-                            info->region = (struct region_descriptor *)
-                                           &ifcs[i]->regions[rno];
-                            found = true;
-                            break;
-                        }
+                        last_region_hit = (uint8_t)(((i << 4) | rno) + 1U);
+                        found = true;
+                        break;
                     }
                 }
             }
@@ -738,7 +782,7 @@ FlashStatus_t Flash_WriteWord(uint32_t addr, uint32_t word,
     if (r == FLASH_ERR_NONE)
     {
         /* Check if input parameters are valid for operation */
-        r = Flash_Interface_Sanity(info.flash);
+        r = Flash_JobSanity(info.flash);
         if (r == FLASH_ERR_NONE)
         {
             /* Calculate new write access configuration */
@@ -775,7 +819,7 @@ FlashStatus_t Flash_WriteBuffer(uint32_t addr, uint32_t word_length,
     r = Sys_Flash_GetAddrInfo(addr, &info);
     if (r == FLASH_ERR_NONE)
     {
-        r = Flash_Interface_Sanity(info.flash);
+        r = Flash_JobSanity(info.flash);
         if (r == FLASH_ERR_NONE)
         {
             /* Check if input parameters are valid for operation */
@@ -823,7 +867,7 @@ FlashStatus_t Flash_EraseFlashBank(uint32_t num)
     else
     {
         /* Check if input parameters are valid for operation */
-        r = Flash_Interface_Sanity(ifcs[num]->flash);
+        r = Flash_JobSanity(ifcs[num]->flash);
         if (r == FLASH_ERR_NONE)
         {
             /* For Mass Erase Enable all Code and Data Regions,
@@ -864,7 +908,7 @@ FlashStatus_t Flash_EraseSector(uint32_t addr, bool enb_endurance)
     r = Sys_Flash_GetAddrInfo(addr, &info);
     if (r == FLASH_ERR_NONE)
     {
-        r = Flash_Interface_Sanity(info.flash);
+        r = Flash_JobSanity(info.flash);
         if (r == FLASH_ERR_NONE)
         {
             uint32_t mask;
@@ -910,7 +954,7 @@ FlashStatus_t Flash_ReadWord(uint32_t addr, uint32_t *word)
     r = Sys_Flash_GetAddrInfo(addr, &info);
     if (r == FLASH_ERR_NONE)
     {
-        r = Flash_Interface_Sanity(info.flash);
+        r = Flash_JobSanity(info.flash);
         if (r == FLASH_ERR_NONE)
         {
             r = Flash_PointerParamSanity(word);
@@ -932,7 +976,7 @@ FlashStatus_t Flash_ReadDouble(uint32_t addr, uint32_t *word)
     r = Sys_Flash_GetAddrInfo(addr, &info);
     if (r == FLASH_ERR_NONE)
     {
-        r = Flash_Interface_Sanity(info.flash);
+        r = Flash_JobSanity(info.flash);
         if (r == FLASH_ERR_NONE)
         {
             r = Flash_PointerParamSanity(word);
@@ -968,7 +1012,7 @@ FlashStatus_t Flash_WriteDouble(uint32_t addr, const uint32_t *word,
     if (r == FLASH_ERR_NONE)
     {
         /* Check if flash is ready for operation */
-        r = Flash_Interface_Sanity(info.flash);
+        r = Flash_JobSanity(info.flash);
         if (r == FLASH_ERR_NONE)
         {
             r = Flash_PointerParamSanity(word);
@@ -1047,11 +1091,11 @@ FlashStatus_t Flash_BlankCheck(uint32_t addr, unsigned int word_length)
             r = Sys_Flash_GetAddrInfo(n_addr_start, &info);
             if (r == FLASH_ERR_NONE)
             {
-                r = Flash_Interface_Sanity(info.flash);
+                r = Flash_JobSanity(info.flash);
                 if (r == FLASH_ERR_NONE)
                 {
-                    uint32_t n_addr_end = ((uint32_t)&fa[words_copied] +
-                                           (word_length << 2)) - 1;
+                    uint32_t n_addr_end = (n_addr_start +
+                                           ((word_length - words_copied) << 2)) - 1;
                     /* Make sure that we copy only until maximum address of
                      * this region
                      */
@@ -1097,11 +1141,11 @@ FlashStatus_t Flash_ReadBuffer(uint32_t flash_address, uint32_t dram_address,
             r = Sys_Flash_GetAddrInfo(n_addr_start, &info);
             if (r == FLASH_ERR_NONE)
             {
-                r = Flash_Interface_Sanity(info.flash);
+                r = Flash_JobSanity(info.flash);
                 if (r == FLASH_ERR_NONE)
                 {
-                    uint32_t n_addr_end = ((uint32_t)&fa[words_copied] +
-                                           (word_length << 2)) - 1;
+                    uint32_t n_addr_end = (n_addr_start +
+                                           ((word_length - words_copied) << 2)) - 1;
 
                     /* Make sure that we copy only until maximum address of
                      * this region
@@ -1130,3 +1174,367 @@ FlashStatus_t Flash_ReadBuffer(uint32_t flash_address, uint32_t dram_address,
     }
     return r;
 }
+
+/**
+ * @brief Type of a queued flash job
+ */
+enum flash_job_type
+{
+    FLASH_JOB_WRITE,                  /**< Write a buffer of words */
+    FLASH_JOB_ERASE                   /**< Erase a sector */
+};
+
+/**
+ * @brief Queued flash job
+ */
+struct flash_job
+{
+    enum flash_job_type type;         /**< Type of job */
+    uint32_t addr;                    /**< Next address to write, or address in the sector to erase */
+    uint32_t word_length;             /**< Number of words left to write */
+    const uint32_t *words;            /**< Next words to write */
+    bool enb_endurance;               /**< Endurance mode of the job */
+    FlashJobCallback_t callback;      /**< Completion callback */
+    void *context;                    /**< Completion callback context */
+};
+
+/**
+ * @brief Flash job queue, and state of the sector erase in progress
+ */
+static struct
+{
+    struct flash_job job[FLASH_JOB_QUEUE_SIZE];    /**< Queued jobs */
+    uint8_t head;                     /**< Index of the oldest job, which is run */
+    uint8_t count;                    /**< Number of queued jobs */
+    bool erasing;                     /**< True while an erase pulse is in progress */
+    struct info info;                 /**< Flash region of the sector being erased */
+    uint32_t retry;                   /**< Retry level of the erase pulse */
+    uint32_t lock_config;             /**< Write access configuration to restore */
+    uint32_t if_ctrl;                 /**< IF_CTRL to restore after the erase pulse */
+    uint32_t delay_reg3;              /**< Delay control 3 register to restore */
+} flash_jobs;
+
+/**
+ * @brief Check sanity of a flash interface used by a synchronous function
+ *
+ * Same as Flash_Interface_Sanity, except that the flash interface is also
+ * reported as busy while an erase job is in progress on it, as any command
+ * would terminate the erase pulse.
+ *
+ * @param [in] flash pointer to the flash interface structure
+ * @return Flash API status code @see FlashStatus_t
+ */
+static FlashStatus_t Flash_JobSanity(FLASH_Type *flash)
+{
+    FlashStatus_t r = Flash_Interface_Sanity(flash);
+
+    if ((r == FLASH_ERR_NONE) && flash_jobs.erasing && (flash_jobs.info.flash == flash))
+    {
+        r = FLASH_ERR_BUSY;
+    }
+    return r;
+}
+
+/**
+ * @brief Add a job to the flash job queue
+ * @param [in] job Job to queue
+ * @return Flash API status code @see FlashStatus_t
+ */
+static FlashStatus_t Flash_JobQueue(const struct flash_job *job)
+{
+    FlashStatus_t r = FLASH_ERR_BUSY;
+    uint32_t irq = __get_PRIMASK();
+
+    /* Jobs can be queued from interrupt handlers */
+    __set_PRIMASK(PRIMASK_DISABLE_INTERRUPTS);
+    if (flash_jobs.count < FLASH_JOB_QUEUE_SIZE)
+    {
+        flash_jobs.job[(flash_jobs.head + flash_jobs.count) % FLASH_JOB_QUEUE_SIZE] = *job;
+        flash_jobs.count++;
+        r = FLASH_ERR_NONE;
+    }
+    __set_PRIMASK(irq);
+
+    return r;
+}
+
+/**
+ * @brief Remove the oldest job from the queue and call its callback
+ * @param [in] r Flash API status code of the job
+ */
+static void Flash_JobComplete(FlashStatus_t r)
+{
+    const struct flash_job *job = &flash_jobs.job[flash_jobs.head];
+    FlashJobCallback_t callback = job->callback;
+    void *context = job->context;
+    uint32_t irq = __get_PRIMASK();
+
+    /* Free the entry first, so that the callback can queue another job */
+    __set_PRIMASK(PRIMASK_DISABLE_INTERRUPTS);
+    flash_jobs.head = (flash_jobs.head + 1) % FLASH_JOB_QUEUE_SIZE;
+    flash_jobs.count--;
+    __set_PRIMASK(irq);
+
+    if (callback != NULL)
+    {
+        callback(r, context);
+    }
+}
+
+/**
+ * @brief Write the words of a write job up to the end of the current row
+ * @param [in] job Write job
+ */
+static void Flash_JobWriteRow(struct flash_job *job)
+{
+    struct info info;
+    FlashStatus_t r = Sys_Flash_GetAddrInfo(job->addr, &info);
+
+    if (r == FLASH_ERR_NONE)
+    {
+        uint32_t row_len = info.region->attr->row_word_len;
+        uint32_t words = row_len - ((job->addr >> 2) % row_len);
+        if (words > job->word_length)
+        {
+            words = job->word_length;
+        }
+
+        /* Interrupts are only disabled while this row is written, and the
+         * row is verified with a CRC */
+        r = Flash_WriteBuffer(job->addr, words, job->words, job->enb_endurance);
+        if (r == FLASH_ERR_NONE)
+        {
+            job->addr += words << 2;
+            job->words += words;
+            job->word_length -= words;
+        }
+    }
+
+    if ((r != FLASH_ERR_NONE) || (job->word_length == 0))
+    {
+        Flash_JobComplete(r);
+    }
+}
+
+/**
+ * @brief Start an erase pulse on the sector of an erase job, without
+ *        waiting for it to complete
+ * @param [in] addr Address within the sector to erase
+ */
+static void Flash_JobErasePulse(uint32_t addr)
+{
+    FLASH_Type *flash = flash_jobs.info.flash;
+
+    /* Backup flash control register */
+    flash_jobs.if_ctrl = flash->IF_CTRL;
+
+    Sys_Flash_ExecutePrecondFlashSectorErase(flash);
+
+    /* Apply flash retry level */
+    Sys_Flash_ApplyRetryLevel(flash, flash_jobs.retry);
+
+    flash->ADDR = addr;
+
+    /* The busy flag is checked by the next calls to Flash_ProcessJobs */
+    flash->CMD_CTRL = CMD_SECTOR_ERASE & FLASH_CMD_CTRL_COMMAND_Mask;
+    FLASH_STATS_ADD(commands, 1);
+    FLASH_STATS_ADD(sector_erases, 1);
+
+    flash_jobs.erasing = true;
+}
+
+/**
+ * @brief Start, or check the completion of, the erase of an erase job
+ *
+ * Same sequence as Flash_EraseSector, except that the flash interface is not
+ * polled until the erase pulse is completed.
+ *
+ * @param [in] job Erase job
+ */
+static void Flash_JobErase(const struct flash_job *job)
+{
+    FlashStatus_t r;
+
+    if (!flash_jobs.erasing)
+    {
+        uint32_t mask;
+
+        /* Check if a flash region exists at this address */
+        r = Sys_Flash_GetAddrInfo(job->addr, &flash_jobs.info);
+        if (r == FLASH_ERR_NONE)
+        {
+            r = Flash_Interface_Sanity(flash_jobs.info.flash);
+        }
+        if (r == FLASH_ERR_NONE)
+        {
+            /* Calculate new write access configuration */
+            r = Sys_Flash_CalculateEnableRegions
+                    (flash_jobs.info.region, job->addr,
+                    flash_jobs.info.region->attr->sector_len, &mask);
+        }
+        if (r != FLASH_ERR_NONE)
+        {
+            Flash_JobComplete(r);
+            return;
+        }
+
+        FLASH_Type *flash = flash_jobs.info.flash;
+
+        /* Read previous write access configuration, and write the new one */
+        flash_jobs.lock_config = flash_jobs.info.region->attr->Read_lock_config(flash);
+        flash_jobs.info.region->attr->Write_lock_config(flash, mask);
+
+        if (job->enb_endurance)
+        {
+            flash_jobs.retry = FLASH_RETRY_1;
+        }
+        else
+        {
+            /* Write T_ERASE = T_ERASE*4 before performing a quick erase
+             * using single FLASH_RETRY_4 pulse */
+            flash_jobs.delay_reg3 = Sys_Flash_ReadRegDelayCTRL3(flash);
+            Sys_Flash_WriteRegDelayCTRL3(flash, flash_jobs.delay_reg3 * 4);
+            flash_jobs.retry = FLASH_RETRY_4;
+        }
+
+        Flash_JobErasePulse(job->addr);
+        return;
+    }
+
+    FLASH_Type *flash = flash_jobs.info.flash;
+    uint32_t sector_len = flash_jobs.info.region->attr->sector_len;
+
+    if (Sys_Flash_IF_ReadBusy(flash))
+    {
+        /* Erase pulse still in progress */
+        return;
+    }
+    flash_jobs.erasing = false;
+
+    /* Restore IF_CTRL */
+    Sys_Flash_ApplyIFCTRL(flash, flash_jobs.if_ctrl);
+
+    if (job->enb_endurance)
+    {
+        /* Verify Read (VREAD1=1) is used after each pulse but the 4th one,
+         * see Sys_Flash_EraseSectorEND */
+        r = Sys_Flash_Copier_VerifyEmpty(flash, job->addr, sector_len,
+                                         flash_jobs.retry < FLASH_RETRY_4);
+        if ((r != FLASH_ERR_NONE) && (flash_jobs.retry < FLASH_RETRY_4))
+        {
+            flash_jobs.retry += (0x1U << FLASH_IF_CTRL_RETRY_Pos);
+            Flash_JobErasePulse(job->addr);
+            return;
+        }
+    }
+    else
+    {
+        /* Restore flash delay control 3 register */
+        Sys_Flash_WriteRegDelayCTRL3(flash, flash_jobs.delay_reg3);
+
+        r = Sys_Flash_Copier_VerifyEmpty(flash, job->addr, sector_len, false);
+    }
+
+    /* Restore previous write access */
+    flash_jobs.info.region->attr->Write_lock_config(flash, flash_jobs.lock_config);
+
+    Flash_JobComplete(r);
+}
+
+FlashStatus_t Flash_WriteBufferAsync(uint32_t addr, uint32_t word_length,
+                                     const uint32_t *words, bool enb_endurance,
+                                     FlashJobCallback_t callback, void *context)
+{
+    FlashStatus_t r;
+    struct info info;
+
+    /* Check the parameters now, so that errors are returned to the caller */
+    r = Sys_Flash_GetAddrInfo(addr, &info);
+    if (r == FLASH_ERR_NONE)
+    {
+        r = Flash_WriteBufferParamSanity(words, word_length);
+        if (r == FLASH_ERR_NONE)
+        {
+            uint32_t mask;
+            r = Sys_Flash_CalculateEnableRegions(info.region, addr, word_length,
+                                                 &mask);
+            if (r == FLASH_ERR_NONE)
+            {
+                const struct flash_job job =
+                {
+                    .type = FLASH_JOB_WRITE,
+                    .addr = addr,
+                    .word_length = word_length,
+                    .words = words,
+                    .enb_endurance = enb_endurance,
+                    .callback = callback,
+                    .context = context
+                };
+                r = Flash_JobQueue(&job);
+            }
+        }
+    }
+    return r;
+}
+
+FlashStatus_t Flash_EraseSectorAsync(uint32_t addr, bool enb_endurance,
+                                     FlashJobCallback_t callback, void *context)
+{
+    FlashStatus_t r;
+    struct info info;
+
+    /* Check if a flash region exists at this address */
+    r = Sys_Flash_GetAddrInfo(addr, &info);
+    if (r == FLASH_ERR_NONE)
+    {
+        const struct flash_job job =
+        {
+            .type = FLASH_JOB_ERASE,
+            .addr = addr,
+            .enb_endurance = enb_endurance,
+            .callback = callback,
+            .context = context
+        };
+        r = Flash_JobQueue(&job);
+    }
+    return r;
+}
+
+bool Flash_IsErasing(uint32_t addr)
+{
+    struct info info;
+
+    return flash_jobs.erasing && (Sys_Flash_GetAddrInfo(addr, &info) == FLASH_ERR_NONE)
+           && (info.flash == flash_jobs.info.flash);
+}
+
+bool Flash_ProcessJobs(void)
+{
+    if (flash_jobs.count > 0)
+    {
+        struct flash_job *job = &flash_jobs.job[flash_jobs.head];
+
+        if (job->type == FLASH_JOB_WRITE)
+        {
+            Flash_JobWriteRow(job);
+        }
+        else
+        {
+            Flash_JobErase(job);
+        }
+    }
+    return (flash_jobs.count > 0);
+}
+
+#ifdef FLASH_STATS
+void Flash_GetStats(FlashStats_t *stats)
+{
+    *stats = flash_stats;
+}
+
+void Flash_ResetStats(void)
+{
+    flash_stats = (FlashStats_t){ 0 };
+}
+
+#endif    /* ifdef FLASH_STATS */
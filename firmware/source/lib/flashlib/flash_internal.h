@@ -26,6 +26,20 @@ extern "C"
 #include <flash.h>
 #include <flash_hw.h>
 
+#ifdef FLASH_STATS
+
+/** Flash operation counters, see Flash_GetStats */
+extern FlashStats_t flash_stats;
+
+/** Add a value to a flash operation counter */
+#define FLASH_STATS_ADD(counter, value)           (flash_stats.counter += (value))
+
+#else    /* ifdef FLASH_STATS */
+
+#define FLASH_STATS_ADD(counter, value)
+
+#endif    /* ifdef FLASH_STATS */
+
 /** Total number of lock/unlock regions in NVR region */
 #define NVR_UNLOCK_FLASH_REGION_NUM               0x8U
 
@@ -361,7 +375,10 @@ __STATIC_FORCEINLINE bool Sys_Flash_IF_ReadSeqReq(const FLASH_Type *flash)
  */
 __STATIC_FORCEINLINE void Sys_Flash_IF_WaitSeqReq(const FLASH_Type *flash)
 {
-    while (Sys_Flash_IF_ReadSeqReq(flash) == 0);
+    while (Sys_Flash_IF_ReadSeqReq(flash) == 0)
+    {
+        FLASH_STATS_ADD(busy_polls, 1);
+    }
 }
 
 /**
@@ -387,7 +404,7 @@ __STATIC_FORCEINLINE void Sys_Flash_IF_WaitBusy(const FLASH_Type *flash)
 {
     while (Sys_Flash_IF_ReadBusy(flash))
     {
-        /* Do nothing */
+        FLASH_STATS_ADD(busy_polls, 1);
     }
 }
 
@@ -408,7 +425,10 @@ __STATIC_FORCEINLINE bool Sys_Flash_Copier_ReadBusy(const FLASH_Type *flash)
  */
 __STATIC_FORCEINLINE void Sys_Flash_Copier_WaitBusy(const FLASH_Type *flash)
 {
-    while (Sys_Flash_Copier_ReadBusy(flash));
+    while (Sys_Flash_Copier_ReadBusy(flash))
+    {
+        FLASH_STATS_ADD(busy_polls, 1);
+    }
 }
 
 /** @} */ /* End of the FLASHPOLL group */
@@ -448,6 +468,7 @@ __STATIC_FORCEINLINE void Sys_Flash_TerminateCommand(FLASH_Type *flash)
 __STATIC_FORCEINLINE void Sys_Flash_ExecuteCommand(FLASH_Type *flash, uint32_t cmd)
 {
     flash->CMD_CTRL = cmd & FLASH_CMD_CTRL_COMMAND_Mask;
+    FLASH_STATS_ADD(commands, 1);
 
     Sys_Flash_IF_WaitBusy(flash);
 }
@@ -490,6 +511,7 @@ __STATIC_FORCEINLINE void Sys_Flash_EndOperationWaitIdle(FLASH_Type *flash)
 __STATIC_FORCEINLINE void Sys_Flash_ExecuteSeqCommand(FLASH_Type *flash, uint32_t cmd)
 {
     flash->CMD_CTRL = cmd & FLASH_CMD_CTRL_COMMAND_Mask;
+    FLASH_STATS_ADD(commands, 1);
     /** Warning: Do not wait for busy when issuing a command
      * for sequential operation as busy will not be cleared
      * until the sequential operation is completed by END
@@ -0,0 +1,768 @@
+/**
+ * @file flash_kvs.c
+ * @brief Key/value store in data flash, built on the flash library
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <flash_kvs.h>
+#include <string.h>
+
+/*
+ * Record layout, word aligned:
+ *   word 0 : key (bits 0-7), length (bits 8-15), checksum (bits 16-31)
+ *   word 1 : sequence number
+ *   word 2+: value, padded with 0xFF
+ * Word 0 is written last. If a record could not be written, a marker
+ * holding its own offset follows the words which were written, and the next
+ * record follows the marker.
+ */
+
+#define KVS_ERASED_WORD               0xFFFFFFFFU
+
+/** Marker following the words of a record which could not be written */
+#define KVS_MARKER(offset)            (0xA500005AU | ((uint32_t)(offset) << 8))
+
+/** Length of a record marking a key as deleted */
+#define KVS_LENGTH_DELETED            0xFF
+
+/** Size of the store in bytes */
+#define KVS_SIZE                      (FLASH_KVS_SECTOR_COUNT * FLASH_KVS_SECTOR_SIZE)
+
+/** Size of a record in bytes */
+#define KVS_RECORD_SIZE(len)          (((len) == KVS_LENGTH_DELETED) ? 8U : FLASH_KVS_RECORD_SIZE(len))
+
+/** Number of words of the largest record */
+#define KVS_RECORD_MAX_WORDS          (FLASH_KVS_RECORD_SIZE(FLASH_KVS_VALUE_MAX) / 4)
+
+/** Offset of the start of a sector */
+#define KVS_SECTOR_START(sector)      ((uint32_t)(sector) * FLASH_KVS_SECTOR_SIZE)
+
+#if KVS_SIZE > 0x10000
+    #error "The key/value store must not exceed 64KB"
+#endif    /* if KVS_SIZE > 0x10000 */
+
+/**
+ * @brief State of a record in flash
+ */
+typedef enum
+{
+    KVS_RECORD_VALID,                 /**< Complete record */
+    KVS_RECORD_BLANK,                 /**< Erased, free space up to the end of the sector */
+    KVS_RECORD_END                    /**< Incomplete or not enough room for a record */
+} KVS_RecordState_t;
+
+/**
+ * @brief Header fields of a record
+ */
+typedef struct
+{
+    uint8_t key;                      /**< Key */
+    uint8_t length;                   /**< Length of the value, KVS_LENGTH_DELETED if deleted */
+    uint32_t seq;                     /**< Sequence number */
+} KVS_Header_t;
+
+/** Key/value store index, built from the flash contents on first use */
+static struct
+{
+    bool built;                       /**< True once the index is built */
+    bool overflow;                    /**< True if some keys in flash are not in the index */
+    uint16_t open;                    /**< Sector written to, the next one being erased */
+    uint16_t head;                    /**< Offset at which the next record is written */
+    uint16_t count;                   /**< Number of keys in the index */
+    uint32_t used;                    /**< Size of the records of the keys in the index */
+    uint32_t seq;                     /**< Sequence number of the newest record */
+    struct
+    {
+        uint8_t key;                  /**< Key, 0 if the entry is not used */
+        uint8_t length;               /**< Length of the value */
+        uint16_t offset;              /**< Offset of the current record of the key */
+    } entry[FLASH_KVS_MAX_KEYS];      /**< Open addressing hash table */
+} kvs;
+
+/**
+ * @brief Get a word of the store
+ * @param [in] offset Offset of the word
+ * @return Pointer to the word in flash
+ */
+static inline const uint32_t * KVS_Word(uint32_t offset)
+{
+    return (const uint32_t *)(FLASH_KVS_BASE + offset);
+}
+
+/**
+ * @brief Compute the checksum of a record (Fletcher-16)
+ * @param [in] header Header fields of the record
+ * @param [in] value  Value of the record
+ * @return Checksum
+ */
+static uint16_t KVS_Checksum(const KVS_Header_t *header, const uint8_t *value)
+{
+    uint8_t bytes[6] =
+    {
+        header->key, header->length,
+        (uint8_t)header->seq, (uint8_t)(header->seq >> 8),
+        (uint8_t)(header->seq >> 16), (uint8_t)(header->seq >> 24)
+    };
+    uint8_t len = (header->length == KVS_LENGTH_DELETED) ? 0 : header->length;
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+
+    for (uint32_t i = 0; i < (sizeof(bytes) + len); i++)
+    {
+        sum1 = (sum1 + ((i < sizeof(bytes)) ? bytes[i] : value[i - sizeof(bytes)])) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (uint16_t)((sum2 << 8) | sum1);
+}
+
+/**
+ * @brief Check if a range of the store is erased
+ * @param [in] offset Offset of the first word
+ * @param [in] end    Offset following the last word
+ * @return True if all the words are erased
+ */
+static bool KVS_IsErased(uint32_t offset, uint32_t end)
+{
+    for (; offset < end; offset += 4)
+    {
+        if (*KVS_Word(offset) != KVS_ERASED_WORD)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Read and check the record at an offset
+ * @param [in]  offset Offset of the record
+ * @param [in]  end    Offset following the sector of the record
+ * @param [out] header Header fields of the record, if it is valid
+ * @return State of the record
+ */
+static KVS_RecordState_t KVS_Record(uint32_t offset, uint32_t end, KVS_Header_t *header)
+{
+    if ((offset + 8) > end)
+    {
+        return KVS_RECORD_END;
+    }
+
+    uint32_t word0 = KVS_Word(offset)[0];
+    if (word0 == KVS_ERASED_WORD)
+    {
+        /* Records are written from their second word onwards, so a reset
+         * while writing leaves words programmed after the first one */
+        return KVS_IsErased(offset, end) ? KVS_RECORD_BLANK : KVS_RECORD_END;
+    }
+
+    header->key = (uint8_t)word0;
+    header->length = (uint8_t)(word0 >> 8);
+    header->seq = KVS_Word(offset)[1];
+
+    if ((header->key < FLASH_KVS_KEY_MIN) || (header->key > FLASH_KVS_KEY_MAX)
+        || ((header->length > FLASH_KVS_VALUE_MAX) && (header->length != KVS_LENGTH_DELETED))
+        || ((offset + KVS_RECORD_SIZE(header->length)) > end)
+        || ((word0 >> 16) != KVS_Checksum(header, (const uint8_t *)KVS_Word(offset + 8))))
+    {
+        return KVS_RECORD_END;
+    }
+    return KVS_RECORD_VALID;
+}
+
+/**
+ * @brief Find the next record of a sector, skipping records which could not
+ *        be written
+ * @param [in,out] offset Offset from which to look; set to the offset of the
+ *                        record, or where free space starts in the sector
+ * @param [in]     end    Offset following the sector
+ * @param [out]    header Header fields of the record, if one is found
+ * @return KVS_RECORD_VALID if a record is found; KVS_RECORD_BLANK if the
+ *         rest of the sector is erased; KVS_RECORD_END otherwise
+ */
+static KVS_RecordState_t KVS_Next(uint32_t *offset, uint32_t end, KVS_Header_t *header)
+{
+    KVS_RecordState_t state = KVS_Record(*offset, end, header);
+
+    while (state == KVS_RECORD_END)
+    {
+        uint32_t marker = *offset + 4;
+
+        while ((marker < end) && (*KVS_Word(marker) != KVS_MARKER(marker)))
+        {
+            marker += 4;
+        }
+        if (marker >= end)
+        {
+            break;
+        }
+        *offset = marker + 4;
+        state = KVS_Record(*offset, end, header);
+    }
+    return state;
+}
+
+/**
+ * @brief Mark the end of the words written from an offset by a record which
+ *        could not be written, so that the next record can follow them
+ * @param [in] offset Offset of the record
+ * @param [in] end    Offset following the sector
+ * @return Offset at which the next record can be written
+ */
+static uint32_t KVS_Skip(uint32_t offset, uint32_t end)
+{
+    uint32_t last = end;
+
+    while ((last > offset) && (*KVS_Word(last - 4) == KVS_ERASED_WORD))
+    {
+        last -= 4;
+    }
+
+    if (last == offset)
+    {
+        return offset;
+    }
+    if ((last == end)
+        || (Flash_WriteWord(FLASH_KVS_BASE + last, KVS_MARKER(last), 0) != FLASH_ERR_NONE))
+    {
+        return end;
+    }
+    return last + 4;
+}
+
+/**
+ * @brief Find the index entry of a key
+ * @param [in] key Key
+ * @return Entry of the key, or the empty entry where it would be added;
+ *         FLASH_KVS_MAX_KEYS if the key is not found and the index is full
+ */
+static uint32_t KVS_Find(uint8_t key)
+{
+    uint32_t i = (key * 167U) & (FLASH_KVS_MAX_KEYS - 1);
+
+    for (uint32_t n = 0; n < FLASH_KVS_MAX_KEYS; n++)
+    {
+        if ((kvs.entry[i].key == key) || (kvs.entry[i].key == 0))
+        {
+            return i;
+        }
+        i = (i + 1) & (FLASH_KVS_MAX_KEYS - 1);
+    }
+    return FLASH_KVS_MAX_KEYS;
+}
+
+/**
+ * @brief Remove an entry from the index, moving back the following
+ *        entries of the same probe sequence
+ * @param [in] i Entry to remove
+ */
+static void KVS_IndexRemove(uint32_t i)
+{
+    uint32_t j = i;
+
+    kvs.used -= KVS_RECORD_SIZE(kvs.entry[i].length);
+    kvs.count--;
+
+    for (;;)
+    {
+        kvs.entry[i].key = 0;
+        do
+        {
+            j = (j + 1) & (FLASH_KVS_MAX_KEYS - 1);
+            if (kvs.entry[j].key == 0)
+            {
+                return;
+            }
+
+            /* Entry j can move to i if its home position is not in (i, j] */
+            uint32_t home = (kvs.entry[j].key * 167U) & (FLASH_KVS_MAX_KEYS - 1);
+            if (((j - home) & (FLASH_KVS_MAX_KEYS - 1)) >= ((j - i) & (FLASH_KVS_MAX_KEYS - 1)))
+            {
+                break;
+            }
+        }
+        while (true);
+
+        kvs.entry[i] = kvs.entry[j];
+        i = j;
+    }
+}
+
+/**
+ * @brief Record the current record of a key in the index
+ * @param [in] header Header fields of the record
+ * @param [in] offset Offset of the record
+ * @return True if successful, false if the index is full
+ */
+static bool KVS_IndexSet(const KVS_Header_t *header, uint32_t offset)
+{
+    uint32_t i = KVS_Find(header->key);
+
+    if (i == FLASH_KVS_MAX_KEYS)
+    {
+        return false;
+    }
+
+    if (kvs.entry[i].key != 0)
+    {
+        if (header->length == KVS_LENGTH_DELETED)
+        {
+            KVS_IndexRemove(i);
+            return true;
+        }
+        kvs.used -= KVS_RECORD_SIZE(kvs.entry[i].length);
+    }
+    else if (header->length == KVS_LENGTH_DELETED)
+    {
+        return true;
+    }
+    else
+    {
+        kvs.count++;
+    }
+
+    kvs.entry[i].key = header->key;
+    kvs.entry[i].length = header->length;
+    kvs.entry[i].offset = (uint16_t)offset;
+    kvs.used += KVS_RECORD_SIZE(header->length);
+    return true;
+}
+
+/**
+ * @brief Check if a record is the current record of its key
+ * @param [in] header Header fields of the record
+ * @param [in] offset Offset of the record
+ * @return True if the record is in the index
+ */
+static bool KVS_IsLive(const KVS_Header_t *header, uint32_t offset)
+{
+    uint32_t i = KVS_Find(header->key);
+
+    return (i < FLASH_KVS_MAX_KEYS) && (kvs.entry[i].key == header->key)
+           && (kvs.entry[i].offset == offset);
+}
+
+/**
+ * @brief Write words to the store, one row at a time
+ *
+ * No sequential write crosses the end of a row, so a write never starts on
+ * the last word of a row and continues into the next one.
+ *
+ * @param [in] addr   Address of the first word
+ * @param [in] words  Words to write
+ * @param [in] length Number of words
+ * @return Flash API status code
+ */
+static FlashStatus_t KVS_WriteWords(uint32_t addr, const uint32_t *words, uint32_t length)
+{
+    FlashStatus_t r = FLASH_ERR_NONE;
+
+    while ((r == FLASH_ERR_NONE) && (length > 0))
+    {
+        uint32_t count = DATA_ROW_LEN_WORDS - ((addr >> 2) % DATA_ROW_LEN_WORDS);
+        if (count > length)
+        {
+            count = length;
+        }
+
+        r = Flash_WriteBuffer(addr, count, words, 0);
+        addr += count << 2;
+        words += count;
+        length -= count;
+    }
+    return r;
+}
+
+/**
+ * @brief Write a record at the head of the log, in the open sector
+ *
+ * The record is written with its first word last. If writing fails, the
+ * words written are skipped.
+ *
+ * @param [in] key    Key
+ * @param [in] value  Value, read before anything is written
+ * @param [in] length Length of the value, KVS_LENGTH_DELETED to delete the key
+ * @return True if successful, false otherwise
+ */
+static bool KVS_Program(uint8_t key, const void *value, uint8_t length)
+{
+    uint32_t record[KVS_RECORD_MAX_WORDS];
+    uint32_t size = KVS_RECORD_SIZE(length);
+    uint32_t addr = FLASH_KVS_BASE + kvs.head;
+    KVS_Header_t header = { key, length, kvs.seq + 1 };
+
+    if ((kvs.head + size) > KVS_SECTOR_START(kvs.open + 1))
+    {
+        return false;
+    }
+
+    memset(record, 0xFF, size);
+    if (length != KVS_LENGTH_DELETED)
+    {
+        memcpy(&record[2], value, length);
+    }
+    record[1] = header.seq;
+    record[0] = key | ((uint32_t)length << 8)
+                | ((uint32_t)KVS_Checksum(&header, (const uint8_t *)&record[2]) << 16);
+
+    kvs.seq = header.seq;
+    if ((KVS_WriteWords(addr + 4, &record[1], (size / 4) - 1) != FLASH_ERR_NONE)
+        || (Flash_WriteWord(addr, record[0], 0) != FLASH_ERR_NONE))
+    {
+        kvs.head = KVS_Skip(kvs.head, KVS_SECTOR_START(kvs.open + 1));
+        return false;
+    }
+
+    KVS_IndexSet(&header, kvs.head);
+    kvs.head += size;
+    return true;
+}
+
+/**
+ * @brief Check if a sector is erased
+ * @param [in] sector Sector number
+ * @return True if the whole sector is erased
+ */
+static inline bool KVS_SectorIsErased(uint32_t sector)
+{
+    return KVS_IsErased(KVS_SECTOR_START(sector), KVS_SECTOR_START(sector + 1));
+}
+
+/**
+ * @brief Write a record at the head of the log, moving on to the following
+ *        sector if it is erased and the open sector is full
+ * @param [in] key    Key
+ * @param [in] value  Value
+ * @param [in] length Length of the value, KVS_LENGTH_DELETED to delete the key
+ * @param [in] avoid  Sector which must not be moved to
+ * @return True if successful, false otherwise
+ */
+static bool KVS_Write(uint8_t key, const void *value, uint8_t length, uint32_t avoid)
+{
+    for (uint32_t n = 0; n < FLASH_KVS_SECTOR_COUNT; n++)
+    {
+        if ((kvs.head + KVS_RECORD_SIZE(length)) <= KVS_SECTOR_START(kvs.open + 1))
+        {
+            if (KVS_Program(key, value, length))
+            {
+                return true;
+            }
+        }
+        else
+        {
+            uint32_t next = (kvs.open + 1) % FLASH_KVS_SECTOR_COUNT;
+
+            if ((next == avoid) || !KVS_SectorIsErased(next))
+            {
+                return false;
+            }
+            kvs.open = next;
+            kvs.head = KVS_SECTOR_START(next);
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Erase a sector, moving the current values it holds to the head of
+ *        the log first
+ * @param [in] sector Sector number
+ * @return True if successful, false otherwise
+ */
+static bool KVS_Reclaim(uint32_t sector)
+{
+    uint32_t end = KVS_SECTOR_START(sector + 1);
+    uint32_t offset;
+    KVS_Header_t header;
+
+    for (offset = KVS_SECTOR_START(sector); KVS_Next(&offset, end, &header) == KVS_RECORD_VALID;
+         offset += KVS_RECORD_SIZE(header.length))
+    {
+        if (KVS_IsLive(&header, offset)
+            && !KVS_Write(header.key, KVS_Word(offset + 8), header.length, sector))
+        {
+            return false;
+        }
+    }
+
+    if (KVS_SectorIsErased(sector))
+    {
+        return true;
+    }
+    return Flash_EraseSector(FLASH_KVS_BASE + KVS_SECTOR_START(sector), 0) == FLASH_ERR_NONE;
+}
+
+/**
+ * @brief Erase the two sectors following the open one, reclaiming them in
+ *        log order. Both are erased except after a reset, so this normally
+ *        reclaims a single sector, after the log moved to a new one.
+ * @return True if successful, false otherwise
+ */
+static bool KVS_Compact(void)
+{
+    for (uint32_t n = 0; n < (2 * FLASH_KVS_SECTOR_COUNT); n++)
+    {
+        uint32_t sector = (kvs.open + 1) % FLASH_KVS_SECTOR_COUNT;
+
+        if (KVS_SectorIsErased(sector))
+        {
+            sector = (sector + 1) % FLASH_KVS_SECTOR_COUNT;
+            if (KVS_SectorIsErased(sector))
+            {
+                return true;
+            }
+        }
+
+        if (!KVS_Reclaim(sector))
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Build the index from the flash contents
+ * @return Flash API status code
+ */
+static FlashStatus_t KVS_IndexBuild(void)
+{
+    KVS_RecordState_t state;
+    bool found = false;
+    uint32_t offset;
+    uint32_t end;
+    KVS_Header_t header;
+
+    memset(&kvs, 0, sizeof(kvs));
+
+    /* Find the newest record, in the sector being written to */
+    for (uint32_t sector = 0; sector < FLASH_KVS_SECTOR_COUNT; sector++)
+    {
+        end = KVS_SECTOR_START(sector + 1);
+        for (offset = KVS_SECTOR_START(sector); KVS_Next(&offset, end, &header) == KVS_RECORD_VALID;
+             offset += KVS_RECORD_SIZE(header.length))
+        {
+            if (!found || ((int32_t)(header.seq - kvs.seq) > 0))
+            {
+                found = true;
+                kvs.seq = header.seq;
+                kvs.open = sector;
+            }
+        }
+    }
+
+    /* Find where free space starts in that sector, skipping a record which
+     * a reset interrupted */
+    end = KVS_SECTOR_START(kvs.open + 1);
+    for (offset = KVS_SECTOR_START(kvs.open);
+         (state = KVS_Next(&offset, end, &header)) == KVS_RECORD_VALID;
+         offset += KVS_RECORD_SIZE(header.length))
+    {
+    }
+    kvs.head = (state == KVS_RECORD_BLANK) ? offset : KVS_Skip(offset, end);
+
+    /* Apply the records from the oldest sector, following the open one, to
+     * the newest, so that each record replaces the previous ones of its key */
+    for (uint32_t n = 1; n <= FLASH_KVS_SECTOR_COUNT; n++)
+    {
+        uint32_t sector = (kvs.open + n) % FLASH_KVS_SECTOR_COUNT;
+
+        end = KVS_SECTOR_START(sector + 1);
+        for (offset = KVS_SECTOR_START(sector); KVS_Next(&offset, end, &header) == KVS_RECORD_VALID;
+             offset += KVS_RECORD_SIZE(header.length))
+        {
+            if (!KVS_IndexSet(&header, offset))
+            {
+                kvs.overflow = true;
+            }
+        }
+    }
+
+    /* The keys which are not in the index would be lost when reclaiming
+     * their sectors: the store is kept as it is, for reading only */
+    if (kvs.overflow)
+    {
+        kvs.built = true;
+        return FLASH_ERR_NO_SPACE;
+    }
+
+    /* The two sectors following the open one are kept erased: finish
+     * reclaiming them if a reset occurred before it was done. If this
+     * fails, the index is built again on next use, to try again. */
+    if (!KVS_Compact())
+    {
+        return FLASH_ERR_UNKNOWN;
+    }
+    kvs.built = true;
+    return FLASH_ERR_NONE;
+}
+
+/**
+ * @brief Get the index, building it if needed
+ * @return Flash API status code. FLASH_ERR_NO_SPACE if the index does not
+ *         hold all the keys in flash; the indexed keys can still be read.
+ */
+static inline FlashStatus_t KVS_Index(void)
+{
+    if (!kvs.built)
+    {
+        return Flash_KVS_Init();
+    }
+    return kvs.overflow ? FLASH_ERR_NO_SPACE : FLASH_ERR_NONE;
+}
+
+/**
+ * @brief Append a record to the log, then reclaim the oldest sector if the
+ *        log moved to a new one
+ * @param [in] key    Key
+ * @param [in] value  Value
+ * @param [in] length Length of the value, KVS_LENGTH_DELETED to delete the key
+ * @return Flash API status code
+ */
+static FlashStatus_t KVS_Append(uint8_t key, const void *value, uint8_t length)
+{
+    if (!KVS_Write(key, value, length, FLASH_KVS_SECTOR_COUNT) || !KVS_Compact())
+    {
+        return FLASH_ERR_UNKNOWN;
+    }
+    return FLASH_ERR_NONE;
+}
+
+FlashStatus_t Flash_KVS_Init(void)
+{
+    /* Building the index can finish reclaiming a sector */
+    if (Flash_IsErasing(FLASH_KVS_BASE))
+    {
+        return FLASH_ERR_BUSY;
+    }
+    return KVS_IndexBuild();
+}
+
+FlashStatus_t Flash_KVS_Get(uint8_t key, void *value, uint8_t *length)
+{
+    FlashStatus_t r;
+    uint32_t i;
+
+    r = KVS_Index();
+    if ((r != FLASH_ERR_NONE) && (r != FLASH_ERR_NO_SPACE))
+    {
+        return r;
+    }
+    i = KVS_Find(key);
+    if ((i == FLASH_KVS_MAX_KEYS) || (kvs.entry[i].key != key) || (key == 0))
+    {
+        return FLASH_ERR_NOT_FOUND;
+    }
+
+    if (*length < kvs.entry[i].length)
+    {
+        *length = kvs.entry[i].length;
+        return FLASH_ERR_BAD_LENGTH;
+    }
+
+    *length = kvs.entry[i].length;
+    memcpy(value, KVS_Word(kvs.entry[i].offset + 8), kvs.entry[i].length);
+    return FLASH_ERR_NONE;
+}
+
+FlashStatus_t Flash_KVS_Put(uint8_t key, const void *value, uint8_t length)
+{
+    FlashStatus_t r;
+    uint32_t i;
+    uint32_t used;
+
+    if ((key < FLASH_KVS_KEY_MIN) || (key > FLASH_KVS_KEY_MAX) || (length > FLASH_KVS_VALUE_MAX))
+    {
+        return FLASH_ERR_INVALID_PARAMS;
+    }
+
+    r = KVS_Index();
+    if (r != FLASH_ERR_NONE)
+    {
+        return r;
+    }
+    if (Flash_IsErasing(FLASH_KVS_BASE))
+    {
+        return FLASH_ERR_BUSY;
+    }
+    i = KVS_Find(key);
+    if (i == FLASH_KVS_MAX_KEYS)
+    {
+        return FLASH_ERR_NO_SPACE;
+    }
+
+    used = kvs.used + KVS_RECORD_SIZE(length);
+    if (kvs.entry[i].key == key)
+    {
+        /* Skip writing the same value again */
+        if ((kvs.entry[i].length == length)
+            && (memcmp(KVS_Word(kvs.entry[i].offset + 8), value, length) == 0))
+        {
+            return FLASH_ERR_NONE;
+        }
+        used -= KVS_RECORD_SIZE(kvs.entry[i].length);
+    }
+    else if (kvs.count >= (FLASH_KVS_MAX_KEYS - 1))
+    {
+        /* Keep an empty entry, so that searches end */
+        return FLASH_ERR_NO_SPACE;
+    }
+
+    if (used > FLASH_KVS_CAPACITY)
+    {
+        return FLASH_ERR_NO_SPACE;
+    }
+    return KVS_Append(key, value, length);
+}
+
+FlashStatus_t Flash_KVS_Delete(uint8_t key)
+{
+    FlashStatus_t r;
+    uint32_t i;
+
+    r = KVS_Index();
+    if (r != FLASH_ERR_NONE)
+    {
+        return r;
+    }
+    if (Flash_IsErasing(FLASH_KVS_BASE))
+    {
+        return FLASH_ERR_BUSY;
+    }
+    i = KVS_Find(key);
+    if ((i == FLASH_KVS_MAX_KEYS) || (kvs.entry[i].key != key) || (key == 0))
+    {
+        return FLASH_ERR_NOT_FOUND;
+    }
+    return KVS_Append(key, NULL, KVS_LENGTH_DELETED);
+}
+
+FlashStatus_t Flash_KVS_Format(void)
+{
+    if (Flash_IsErasing(FLASH_KVS_BASE))
+    {
+        return FLASH_ERR_BUSY;
+    }
+
+    /* The index is built again on next use */
+    kvs.built = false;
+
+    for (uint32_t sector = 0; sector < FLASH_KVS_SECTOR_COUNT; sector++)
+    {
+        if (!KVS_IsErased(KVS_SECTOR_START(sector), KVS_SECTOR_START(sector + 1))
+            && (Flash_EraseSector(FLASH_KVS_BASE + KVS_SECTOR_START(sector), 0) != FLASH_ERR_NONE))
+        {
+            return FLASH_ERR_UNKNOWN;
+        }
+    }
+    return FLASH_ERR_NONE;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file flash_kvs.h
+ * @brief Key/value store in data flash, built on the flash library
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef FLASH_KVS_H_
+#define FLASH_KVS_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif    /* ifdef __cplusplus */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <flash.h>
+
+/** @addtogroup FLASHg
+ *  @{
+ */
+
+/**
+ * @brief Flash key/value store
+ *
+ * Values are stored as records appended to a log spread over
+ * FLASH_KVS_SECTOR_COUNT data flash sectors. Updating a value appends a new
+ * record, and deleting it appends an empty one, so that a sector is only
+ * erased when the log wraps around to it: all the sectors are erased in turn.
+ * Two sectors are always kept erased; when the log enters one of them, the
+ * values still in use in the oldest sector are copied to the head of the
+ * log, then that sector is erased. Each call to Flash_KVS_Put or
+ * Flash_KVS_Delete therefore erases at most one sector, and a reset during
+ * this never requires rewriting a sector in place.
+ *
+ * A record is only valid once its first word, written last, holds a
+ * checksum of the record, so a reset while writing never leaves a partial
+ * value: the previous value of the key is kept. An index of the keys is
+ * built in RAM from the flash contents on first use.
+ *
+ * The store is not written while an erase job (see Flash_ProcessJobs) is in
+ * progress on its flash instance: the functions which could write to it
+ * return FLASH_ERR_BUSY then.
+ */
+
+/** User application can override the location and size of the key/value
+ * store by defining the following symbols. The default is 8 data flash
+ * sectors (2KB) following the bond list. */
+#ifndef FLASH_KVS_BASE
+#define FLASH_KVS_BASE                  (FLASH_BOND_INFO_TOP + 1)    /**< Start address of the store */
+#endif    /* ifndef FLASH_KVS_BASE */
+
+#ifndef FLASH_KVS_SECTOR_COUNT
+#define FLASH_KVS_SECTOR_COUNT          8       /**< Number of data flash sectors used by the store */
+#endif    /* ifndef FLASH_KVS_SECTOR_COUNT */
+
+#ifndef FLASH_KVS_MAX_KEYS
+#define FLASH_KVS_MAX_KEYS              32      /**< Size of the RAM index, a power of 2 */
+#endif    /* ifndef FLASH_KVS_MAX_KEYS */
+
+#ifndef FLASH_KVS_VALUE_MAX
+#define FLASH_KVS_VALUE_MAX             64      /**< Maximum length of a value in bytes */
+#endif    /* ifndef FLASH_KVS_VALUE_MAX */
+
+#if FLASH_KVS_SECTOR_COUNT < 4
+    #error "The key/value store needs at least 4 flash sectors"
+#endif    /* if FLASH_KVS_SECTOR_COUNT < 4 */
+
+#if (FLASH_KVS_MAX_KEYS & (FLASH_KVS_MAX_KEYS - 1)) != 0
+    #error "FLASH_KVS_MAX_KEYS must be a power of 2"
+#endif    /* if (FLASH_KVS_MAX_KEYS & (FLASH_KVS_MAX_KEYS - 1)) != 0 */
+
+#if FLASH_KVS_VALUE_MAX > 248
+    #error "FLASH_KVS_VALUE_MAX must fit in a data flash sector with its header"
+#endif    /* if FLASH_KVS_VALUE_MAX > 248 */
+
+/** Size of a flash sector used by the store, in bytes */
+#define FLASH_KVS_SECTOR_SIZE           (DATA_SECTOR_LEN_WORDS * 4)
+
+/** Size of a record holding a value of the specified length, in bytes */
+#define FLASH_KVS_RECORD_SIZE(len)      (8 + (((len) + 3) & ~3U))
+
+/** Total size of the values which can be stored, record headers included.
+ * Besides the two erased sectors, one sector worth of free space ensures
+ * that reclaiming a sector always frees more room than it uses. */
+#define FLASH_KVS_CAPACITY              ((FLASH_KVS_SECTOR_COUNT - 3) * \
+                                         (FLASH_KVS_SECTOR_SIZE - FLASH_KVS_RECORD_SIZE(FLASH_KVS_VALUE_MAX)))
+
+/** Smallest valid key */
+#define FLASH_KVS_KEY_MIN               0x01
+
+/** Largest valid key */
+#define FLASH_KVS_KEY_MAX               0xFE
+
+/**
+ * @brief Build the index of the key/value store.
+ *
+ * Reads the flash contents, completes a sector erase interrupted by a reset
+ * if needed, and builds the RAM index. Called on first use by the other
+ * functions; can be called at startup so that this is done in advance.
+ *
+ * @return Flash API status code. FLASH_ERR_NO_SPACE if the flash contents
+ *         hold more keys than FLASH_KVS_MAX_KEYS; only the oldest keys are
+ *         indexed then, and the store is read only so that the other keys
+ *         are kept: Flash_KVS_Put and Flash_KVS_Delete return
+ *         FLASH_ERR_NO_SPACE until Flash_KVS_Format is called.
+ */
+FlashStatus_t Flash_KVS_Init(void);
+
+/**
+ * @brief Read a value from the key/value store.
+ *
+ * @param [in]     key    Key of the value, from FLASH_KVS_KEY_MIN to
+ *                        FLASH_KVS_KEY_MAX
+ * @param [out]    value  Buffer to which the value is copied
+ * @param [in,out] length Size of the buffer; set to the length of the value
+ * @return Flash API status code. FLASH_ERR_NOT_FOUND if the key is not in
+ *         the store, FLASH_ERR_BAD_LENGTH if the value does not fit in the
+ *         buffer.
+ */
+FlashStatus_t Flash_KVS_Get(uint8_t key, void *value, uint8_t *length);
+
+/**
+ * @brief Write a value to the key/value store.
+ *
+ * Nothing is written if the value is not changed.
+ *
+ * @param [in] key    Key of the value, from FLASH_KVS_KEY_MIN to
+ *                    FLASH_KVS_KEY_MAX
+ * @param [in] value  Value to write
+ * @param [in] length Length of the value, up to FLASH_KVS_VALUE_MAX
+ * @return Flash API status code. FLASH_ERR_NO_SPACE if there are already
+ *         FLASH_KVS_MAX_KEYS keys, or the values would exceed
+ *         FLASH_KVS_CAPACITY.
+ */
+FlashStatus_t Flash_KVS_Put(uint8_t key, const void *value, uint8_t length);
+
+/**
+ * @brief Remove a value from the key/value store.
+ *
+ * @param [in] key Key of the value
+ * @return Flash API status code. FLASH_ERR_NOT_FOUND if the key is not in
+ *         the store.
+ */
+FlashStatus_t Flash_KVS_Delete(uint8_t key);
+
+/**
+ * @brief Erase all the values of the key/value store.
+ *
+ * @return Flash API status code
+ */
+FlashStatus_t Flash_KVS_Format(void);
+
+/** @} */ /* End of the FLASHg group */
+
+#ifdef __cplusplus
+}
+#endif    /* ifdef __cplusplus */
+
+#endif    /* FLASH_KVS_H_ */
@@ -351,6 +351,21 @@ __STATIC_INLINE const short Flash_ReadVersion(void)
     return (*((uint32_t *)FLASHVERSION_BASEADDR) & 0xFFFF);
 }
 
+/**
+ * @brief Check if an erase job of the flash library is in progress
+ *
+ * The ROM functions terminate an erase job started by Flash_ProcessJobs
+ * instead of reporting it, so code using them checks this function first
+ * when the application may queue flash library jobs.
+ *
+ * @param [in] addr An address within the flash instance
+ * @return True if an erase job is in progress on the flash instance
+ * @note Provided by the flash library. Declared weak, so that it is NULL
+ *       when the application is not linked with the flash library, in
+ *       which case no erase job can be in progress.
+ */
+__WEAK bool Flash_IsErasing(uint32_t addr);
+
 /** @} */ /* End of the FLASHROM group */
 /** @} */ /* End of the FLASH group */
 
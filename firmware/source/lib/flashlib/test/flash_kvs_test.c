@@ -0,0 +1,328 @@
+/**
+ * @file flash_kvs_test.c
+ * @brief Power loss tests of the flash key/value store on the flash simulator
+ *
+ * A sequence of writes and deletes is applied to the store. Each operation
+ * is then replayed from the same flash contents with the power cut at each
+ * of its flash array operations in turn, and again at each array operation
+ * of the recovery which follows. After each cut, the store must initialize
+ * and hold, for each key, the value it had before the operation, or for the
+ * key of the operation only, the value it has after it.
+ *
+ * Usage: flash_kvs_test [operations] [seed]
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "flash_sim.h"
+
+/* Built in, to check the store against its internal state */
+#include "../flash_kvs.c"
+
+/** Keys used by the power loss test */
+#define TEST_KEYS                       12
+
+/** Length of a deleted key in the model */
+#define TEST_DELETED                    (-1)
+
+static unsigned int failures;
+
+#define CHECK(expr)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(expr))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+/** Expected contents of the store */
+struct model
+{
+    int length[TEST_KEYS + 1];
+    uint8_t value[TEST_KEYS + 1][FLASH_KVS_VALUE_MAX];
+};
+
+/** Operation applied to the store */
+struct op
+{
+    uint8_t key;
+    int length;
+    uint8_t value[FLASH_KVS_VALUE_MAX];
+};
+
+static uint32_t seed;
+static uint32_t before[KVS_SIZE / 4];
+static uint32_t torn[KVS_SIZE / 4];
+
+static uint32_t Test_Rand(void)
+{
+    seed = seed * 1103515245U + 12345U;
+    return seed >> 8;
+}
+
+/**
+ * @brief Restart the flash library after a power cycle
+ */
+static void Test_Boot(void)
+{
+    CHECK(Flash_Initialize(0, FLASH_CLOCK_16MHZ) == FLASH_ERR_NONE);
+    CHECK(Flash_Initialize(1, FLASH_CLOCK_16MHZ) == FLASH_ERR_NONE);
+}
+
+static void Test_Save(uint32_t *image)
+{
+    memcpy(image, (const void *)FLASH_KVS_BASE, KVS_SIZE);
+}
+
+static void Test_Restore(const uint32_t *image)
+{
+    Sim_FlashPoke(FLASH_KVS_BASE, image, KVS_SIZE / 4);
+}
+
+static bool Test_KeyIs(uint8_t key, int length, const uint8_t *value)
+{
+    uint8_t buf[FLASH_KVS_VALUE_MAX];
+    uint8_t len = sizeof(buf);
+    FlashStatus_t r = Flash_KVS_Get(key, buf, &len);
+
+    if (length == TEST_DELETED)
+    {
+        return r == FLASH_ERR_NOT_FOUND;
+    }
+    return (r == FLASH_ERR_NONE) && (len == length) && (memcmp(buf, value, len) == 0);
+}
+
+/**
+ * @brief Check the store holds the model, or the model updated by an
+ *        operation
+ * @return True if the store holds the model updated by the operation
+ */
+static bool Test_Matches(const struct model *m, const struct op *op, unsigned int step)
+{
+    bool applied = false;
+
+    for (uint8_t key = 1; key <= TEST_KEYS; key++)
+    {
+        if (Test_KeyIs(key, m->length[key], m->value[key]))
+        {
+            continue;
+        }
+        if ((op != NULL) && (key == op->key) && Test_KeyIs(key, op->length, op->value))
+        {
+            applied = true;
+            continue;
+        }
+        printf("key %u lost after a power cut at step %u\n", key, step);
+        failures++;
+    }
+    return applied;
+}
+
+static void Test_Apply(struct model *m, const struct op *op)
+{
+    m->length[op->key] = op->length;
+    if (op->length != TEST_DELETED)
+    {
+        memcpy(m->value[op->key], op->value, op->length);
+    }
+}
+
+static FlashStatus_t Test_Run(const struct op *op)
+{
+    if (op->length == TEST_DELETED)
+    {
+        return Flash_KVS_Delete(op->key);
+    }
+    return Flash_KVS_Put(op->key, op->value, (uint8_t)op->length);
+}
+
+static void Test_Next(const struct model *m, struct op *op)
+{
+    op->key = 1 + Test_Rand() % TEST_KEYS;
+    if ((m->length[op->key] != TEST_DELETED) && ((Test_Rand() % 6) == 0))
+    {
+        op->length = TEST_DELETED;
+        return;
+    }
+    op->length = Test_Rand() % (FLASH_KVS_VALUE_MAX + 1);
+    for (int i = 0; i < op->length; i++)
+    {
+        op->value[i] = (uint8_t)Test_Rand();
+    }
+}
+
+/**
+ * @brief Recover from a power cut, then cut the power again at each array
+ *        operation of the recovery
+ * @param [in] m    Model before the operation
+ * @param [in] op   Operation interrupted
+ * @param [in] step Array operation interrupted
+ */
+static void Test_Recover(const struct model *m, const struct op *op, unsigned int step)
+{
+    static sigjmp_buf env;
+    uint32_t ops;
+
+    Test_Save(torn);
+    Test_Boot();
+    Sim_SetPowerCut(0, NULL);
+    CHECK(Flash_KVS_Init() == FLASH_ERR_NONE);
+    ops = Sim_ArrayOps();
+    Test_Matches(m, op, step);
+
+    for (volatile uint32_t n = 1; n <= ops; n++)
+    {
+        Test_Restore(torn);
+        Test_Boot();
+        Sim_SetPowerCut(n, &env);
+        if (sigsetjmp(env, 1) == 0)
+        {
+            Flash_KVS_Init();
+        }
+        Sim_SetPowerCut(0, NULL);
+        Test_Boot();
+        CHECK(Flash_KVS_Init() == FLASH_ERR_NONE);
+        Test_Matches(m, op, step);
+    }
+}
+
+/**
+ * @brief Apply random operations, cutting the power at each array operation
+ * @param [in] count Number of operations
+ */
+static void Test_PowerLoss(unsigned int count)
+{
+    static sigjmp_buf env;
+    static struct model m;
+    static struct op op;
+    unsigned long cuts = 0;
+
+    for (int key = 0; key <= TEST_KEYS; key++)
+    {
+        m.length[key] = TEST_DELETED;
+    }
+    CHECK(Flash_KVS_Format() == FLASH_ERR_NONE);
+    CHECK(Flash_KVS_Init() == FLASH_ERR_NONE);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t ops;
+
+        Test_Next(&m, &op);
+        Test_Save(before);
+
+        /* Reference run, counting the array operations */
+        Sim_SetPowerCut(0, NULL);
+        CHECK(Test_Run(&op) == FLASH_ERR_NONE);
+        ops = Sim_ArrayOps();
+
+        for (volatile uint32_t n = 1; n <= ops; n++)
+        {
+            Test_Restore(before);
+            CHECK(Flash_KVS_Init() == FLASH_ERR_NONE);
+            Sim_SetPowerCut(n, &env);
+            if (sigsetjmp(env, 1) == 0)
+            {
+                Test_Run(&op);
+            }
+            Sim_SetPowerCut(0, NULL);
+            Test_Recover(&m, &op, n);
+            cuts++;
+        }
+
+        /* Continue from the result of a power cut at the last step */
+        Test_Boot();
+        CHECK(Flash_KVS_Init() == FLASH_ERR_NONE);
+        if (!Test_Matches(&m, &op, 0))
+        {
+            CHECK(Test_Run(&op) == FLASH_ERR_NONE);
+        }
+        Test_Apply(&m, &op);
+        Test_Matches(&m, NULL, 0);
+    }
+    printf("power loss: %u operations, %lu power cuts, %u sector erases\n",
+           count, cuts, Sim_Stats()->sector_erases);
+}
+
+/**
+ * @brief Check a store holding more keys than the index is kept read only
+ */
+static void Test_Overflow(void)
+{
+    uint8_t value[4] = { 1, 2, 3, 4 };
+    uint32_t record[3];
+    KVS_Header_t header = { 0, sizeof(value), 0 };
+
+    CHECK(Flash_KVS_Format() == FLASH_ERR_NONE);
+    for (uint8_t key = 1; key < FLASH_KVS_MAX_KEYS; key++)
+    {
+        value[0] = key;
+        CHECK(Flash_KVS_Put(key, value, sizeof(value)) == FLASH_ERR_NONE);
+    }
+    value[0] = FLASH_KVS_MAX_KEYS;
+    CHECK(Flash_KVS_Put(FLASH_KVS_MAX_KEYS, value, sizeof(value)) == FLASH_ERR_NO_SPACE);
+
+    /* Add two keys behind the store's back, as a build with a larger index
+     * would have done */
+    for (uint8_t key = 0xF0; key < 0xF2; key++)
+    {
+        header.key = key;
+        header.seq = kvs.seq + 1;
+        value[0] = key;
+        memcpy(&record[2], value, sizeof(value));
+        record[1] = header.seq;
+        record[0] = key | ((uint32_t)header.length << 8)
+                    | ((uint32_t)KVS_Checksum(&header, value) << 16);
+        CHECK((kvs.head + sizeof(record)) <= KVS_SECTOR_START(kvs.open + 1));
+        Sim_FlashPoke(FLASH_KVS_BASE + kvs.head, record, 3);
+        kvs.head += sizeof(record);
+        kvs.seq++;
+    }
+
+    Test_Save(before);
+    Sim_ResetStats();
+    CHECK(Flash_KVS_Init() == FLASH_ERR_NO_SPACE);
+    value[0] = 1;
+    CHECK(Test_KeyIs(1, sizeof(value), value));
+    CHECK(Flash_KVS_Put(1, value, 2) == FLASH_ERR_NO_SPACE);
+    CHECK(Flash_KVS_Delete(1) == FLASH_ERR_NO_SPACE);
+    CHECK(Sim_Stats()->sector_erases == 0);
+    CHECK(Sim_Stats()->word_programs == 0);
+    CHECK(memcmp(before, (const void *)FLASH_KVS_BASE, KVS_SIZE) == 0);
+
+    /* Formatting makes the store usable again */
+    CHECK(Flash_KVS_Format() == FLASH_ERR_NONE);
+    CHECK(Flash_KVS_Put(1, value, 2) == FLASH_ERR_NONE);
+    CHECK(Test_KeyIs(1, 2, value));
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 60;
+
+    seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+    Sim_Init();
+    Test_Boot();
+
+    Test_Overflow();
+    Test_PowerLoss(count);
+
+    printf("flash_kvs_test: %s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1130 @@
+/**
+ * @file flash_sim.c
+ * @brief Host simulator of the flash interface, CRC and DMA peripherals
+ *
+ * Memories are mapped at their device addresses. The flash arrays are
+ * mapped read only, and changed by the model through a second, writable
+ * mapping. The peripheral registers are also backed by a shared memory
+ * object, mapped without access rights at the device address: each access
+ * raises SIGSEGV, where the model updates the status registers and opens
+ * the page for a single step of the faulting instruction. The SIGTRAP that
+ * follows the instruction closes the page again, and applies a register
+ * write to the model.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <hw.h>
+#include "flash_sim.h"
+
+/* Simulated address ranges */
+#define SIM_FLASH_BASE                  FLASH0_NVR0_BASE
+#define SIM_FLASH_SIZE                  ((FLASH1_DATA_TOP + 1) - SIM_FLASH_BASE)
+#define SIM_DRAM_BASE                   DRAM_BASE
+#define SIM_DRAM_SIZE                   ((BB_DRAM_TOP + 1) - SIM_DRAM_BASE)
+#define SIM_PERIPH_BASE                 SYSCTRL_BASE
+#define SIM_PERIPH_SIZE                 0x2000U
+
+/* Flash geometry, in bytes */
+#define SIM_CODE_SECTOR                 0x800U
+#define SIM_CODE_ROW                    0x200U
+#define SIM_CODE_LOCK_REGION            0x16000U
+#define SIM_DATA_SECTOR                 0x100U
+#define SIM_DATA_ROW                    0x80U
+#define SIM_DATA_LOCK_REGION            0x5000U
+#define SIM_NVR_LOCK_REGION             0x100U
+
+/* IF_STATUS bits holding the write unlock state */
+#define SIM_MAIN_UNLOCK_MASK            0xFFFU
+#define SIM_NVR_UNLOCK_MASK             (0xFFU << FLASH_IF_STATUS_NVR0_W_UNLOCK_Pos)
+
+/* Delay register 3 value applied when DELAY_CTRL is written */
+#define SIM_DELAY3_DEFAULT              0x100U
+
+/* Number of DMA channels */
+#define SIM_DMA_NUM                     4
+
+/* x86 trap flag, and write bit of the page fault error code */
+#define SIM_EFLAGS_TF                   0x100
+#define SIM_PF_WRITE                    0x2
+
+/**
+ * @brief Flash region which holds an address
+ */
+struct sim_region
+{
+    uint32_t unlock;                /**< IF_STATUS write unlock bit */
+    uint32_t sector;                /**< Sector size */
+    uint32_t row;                   /**< Row size */
+};
+
+/**
+ * @brief Model state of a flash interface
+ */
+struct sim_flash
+{
+    bool seq;                       /**< Sequential programming active */
+    uint32_t seq_cmd;               /**< Sequential programming command */
+    uint64_t busy_until;            /**< End of the current command */
+    uint64_t req_time;              /**< Time new sequential data is requested */
+    uint64_t copy_until;            /**< End of the current copier operation */
+    bool copy_error;                /**< Last copier operation failed */
+    uint32_t unlock;                /**< Write unlock bits of IF_STATUS */
+};
+
+static SimTiming_t sim_timing =
+{
+    .reg_access   = 62,
+    .command      = 1000,
+    .program_word = 8000,
+    .erase_pulse  = 900000,
+    .mass_erase   = 20000000,
+    .copy_word    = 125,
+    .crc_word     = 62,
+    .dma_word     = 125,
+};
+
+static SimStats_t sim_stats;
+static struct sim_flash sim_flash[2];
+static uint32_t sim_dma_status[SIM_DMA_NUM];
+
+/* Writable views of the flash arrays and of the peripheral registers */
+static uint8_t *sim_array;
+static uint8_t *sim_regs;
+static uint8_t sim_ecc[SIM_FLASH_SIZE / 4];
+
+/* Firmware view of the peripheral registers */
+static void *sim_periph = (void *)SIM_PERIPH_BASE;
+
+/* Register access being single stepped */
+static volatile bool sim_trap_pending;
+static volatile bool sim_trap_write;
+static volatile uint32_t sim_trap_off;
+
+/* Power cut injection */
+static uint32_t sim_cut_step;
+static uint32_t sim_array_ops;
+static sigjmp_buf *sim_cut_env;
+static uint32_t sim_random = 0x2545F491U;
+
+static uint32_t sim_dram_used;
+static uint32_t sim_primask;
+static const SimDevice_t *sim_device;
+
+/* ----------------------------------------------------------------------------
+ * Core intrinsics used by the firmware
+ * ------------------------------------------------------------------------- */
+uint32_t __get_PRIMASK(void)
+{
+    return sim_primask;
+}
+
+void __set_PRIMASK(uint32_t primask)
+{
+    sim_primask = primask;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq)
+{
+    (void)irq;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helpers
+ * ------------------------------------------------------------------------- */
+static volatile uint32_t * Sim_Reg(uint32_t addr)
+{
+    return (volatile uint32_t *)(sim_regs + (addr - SIM_PERIPH_BASE));
+}
+
+static FLASH_Type * Sim_FlashRegs(unsigned int inst)
+{
+    return (FLASH_Type *)(sim_regs + (FLASH0_BASE - SIM_PERIPH_BASE) +
+                          inst * (FLASH1_BASE - FLASH0_BASE));
+}
+
+static CRC_Type * Sim_CrcRegs(void)
+{
+    return (CRC_Type *)(sim_regs + (CRC_BASE - SIM_PERIPH_BASE));
+}
+
+static DMA_Type * Sim_DmaRegs(unsigned int ch)
+{
+    return (DMA_Type *)(sim_regs + (DMA0_BASE - SIM_PERIPH_BASE) +
+                        ch * (DMA1_BASE - DMA0_BASE));
+}
+
+static uint32_t * Sim_ArrayWord(uint32_t addr)
+{
+    return (uint32_t *)(sim_array + (addr - SIM_FLASH_BASE));
+}
+
+static uint32_t Sim_Random(void)
+{
+    sim_random ^= sim_random << 13;
+    sim_random ^= sim_random >> 17;
+    sim_random ^= sim_random << 5;
+    return sim_random;
+}
+
+static void Sim_Elapse(uint64_t ns)
+{
+    sim_stats.time_ns += ns;
+}
+
+/* Stand-in for the ECC bits of a word programmed with ECC enabled */
+static uint8_t Sim_Ecc(uint32_t word)
+{
+    return (uint8_t)((word ^ (word >> 6) ^ (word >> 12) ^ (word >> 18) ^
+                      (word >> 24) ^ (word >> 30)) & 0x3FU);
+}
+
+/**
+ * @brief Find the region of a flash instance holding an address
+ * @return True if the address belongs to the instance
+ */
+static bool Sim_Region(unsigned int inst, uint32_t addr, struct sim_region *region)
+{
+    uint32_t code = inst ? FLASH1_CODE_BASE : FLASH0_CODE_BASE;
+    uint32_t data = inst ? FLASH1_DATA_BASE : FLASH0_DATA_BASE;
+    uint32_t nvr  = inst ? FLASH1_NVR0_BASE : FLASH0_NVR0_BASE;
+
+    if (addr >= code && addr < code + 4 * SIM_CODE_LOCK_REGION)
+    {
+        region->unlock = 0x1U << ((addr - code) / SIM_CODE_LOCK_REGION +
+                                  FLASH_IF_STATUS_CODE_A_0K_TO_22K_W_UNLOCK_Pos);
+        region->sector = SIM_CODE_SECTOR;
+        region->row = SIM_CODE_ROW;
+    }
+    else if (addr >= data && addr < data + 8 * SIM_DATA_LOCK_REGION)
+    {
+        region->unlock = 0x1U << ((addr - data) / SIM_DATA_LOCK_REGION +
+                                  FLASH_IF_STATUS_DATA_A_0K_TO_5K_W_UNLOCK_Pos);
+        region->sector = SIM_DATA_SECTOR;
+        region->row = SIM_DATA_ROW;
+    }
+    else if (addr >= nvr && addr < nvr + 8 * SIM_NVR_LOCK_REGION)
+    {
+        region->unlock = 0x1U << ((addr - nvr) / SIM_NVR_LOCK_REGION +
+                                  FLASH_IF_STATUS_NVR0_W_UNLOCK_Pos);
+        region->sector = SIM_DATA_SECTOR;
+        region->row = SIM_DATA_ROW;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/* ----------------------------------------------------------------------------
+ * Flash arrays
+ * ------------------------------------------------------------------------- */
+static void Sim_PowerCut(void)
+{
+    sigjmp_buf *env = sim_cut_env;
+    Sim_PowerCycle();
+    siglongjmp(*env, 1);
+}
+
+/**
+ * @brief Count an array operation
+ * @return True if the power is cut during this operation
+ */
+static bool Sim_ArrayOp(void)
+{
+    sim_array_ops++;
+    return (sim_cut_step != 0) && (sim_array_ops == sim_cut_step);
+}
+
+/**
+ * @brief Check that an array operation is allowed on an address
+ */
+static bool Sim_ArrayAccess(unsigned int inst, uint32_t addr, struct sim_region *region)
+{
+    if (!Sim_Region(inst, addr, region) || ((sim_flash[inst].unlock & region->unlock) == 0))
+    {
+        sim_stats.locked_accesses++;
+        return false;
+    }
+    return true;
+}
+
+static void Sim_ProgramWord(unsigned int inst, uint32_t addr, uint32_t word,
+                            bool pre)
+{
+    FLASH_Type *flash = Sim_FlashRegs(inst);
+    struct sim_region region;
+
+    Sim_Elapse(sim_timing.program_word);
+    if (!Sim_ArrayAccess(inst, addr, &region))
+    {
+        return;
+    }
+    uint32_t *p = Sim_ArrayWord(addr);
+    uint8_t ecc = ((flash->ECC_CTRL & (0x1U << FLASH_ECC_CTRL_CMD_ECC_CTRL_Pos)) != 0) ?
+                  Sim_Ecc(word) : (uint8_t)(flash->DATA[1] & 0x3FU);
+    if (Sim_ArrayOp())
+    {
+        /* Only part of the bits reach 0 */
+        *p &= word | Sim_Random();
+        Sim_PowerCut();
+    }
+    if ((*p & word) != word)
+    {
+        sim_stats.overprograms++;
+    }
+    *p &= word;
+    sim_ecc[(addr - SIM_FLASH_BASE) / 4] &= ecc;
+    if (pre)
+    {
+        sim_stats.pre_programs++;
+    }
+    else
+    {
+        sim_stats.word_programs++;
+    }
+}
+
+static void Sim_EraseRange(uint32_t addr, uint32_t size, bool torn)
+{
+    for (uint32_t a = addr; a < addr + size; a += 4)
+    {
+        uint32_t *p = Sim_ArrayWord(a);
+        if (!torn)
+        {
+            *p = 0xFFFFFFFFU;
+            sim_ecc[(a - SIM_FLASH_BASE) / 4] = 0x3FU;
+        }
+        else
+        {
+            /* Words are left erased, untouched or with some bits erased */
+            switch (Sim_Random() % 3)
+            {
+                case 0:
+                    *p = 0xFFFFFFFFU;
+                    break;
+                case 1:
+                    break;
+                default:
+                    *p |= Sim_Random();
+                    break;
+            }
+        }
+    }
+}
+
+static void Sim_EraseSector(unsigned int inst, uint32_t addr)
+{
+    FLASH_Type *flash = Sim_FlashRegs(inst);
+    struct sim_region region;
+
+    Sim_Elapse((uint64_t)sim_timing.erase_pulse * flash->RESERVED0[3] / SIM_DELAY3_DEFAULT);
+    if (!Sim_ArrayAccess(inst, addr, &region))
+    {
+        return;
+    }
+    addr &= ~(region.sector - 1);
+    if (Sim_ArrayOp())
+    {
+        Sim_EraseRange(addr, region.sector, true);
+        Sim_PowerCut();
+    }
+    Sim_EraseRange(addr, region.sector, false);
+    sim_stats.sector_erases++;
+}
+
+static void Sim_EraseMass(unsigned int inst)
+{
+    uint32_t base[2] = { inst ? FLASH1_CODE_BASE : FLASH0_CODE_BASE,
+                         inst ? FLASH1_DATA_BASE : FLASH0_DATA_BASE };
+    uint32_t size[2] = { 4 * SIM_CODE_LOCK_REGION, 8 * SIM_DATA_LOCK_REGION };
+    uint32_t lock[2] = { SIM_CODE_LOCK_REGION, SIM_DATA_LOCK_REGION };
+    struct sim_region region;
+
+    Sim_Elapse(sim_timing.mass_erase);
+    bool torn = Sim_ArrayOp();
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        for (uint32_t a = base[i]; a < base[i] + size[i]; a += lock[i])
+        {
+            if (Sim_ArrayAccess(inst, a, &region))
+            {
+                Sim_EraseRange(a, lock[i], torn);
+            }
+        }
+    }
+    if (torn)
+    {
+        Sim_PowerCut();
+    }
+    sim_stats.mass_erases++;
+}
+
+/* ----------------------------------------------------------------------------
+ * CRC generator
+ * ------------------------------------------------------------------------- */
+static void Sim_CrcAdd(uint32_t data, unsigned int bits)
+{
+    CRC_Type *crc = Sim_CrcRegs();
+    bool crc32_b = (crc->CFG & (0x1U << CRC_CFG_CRC_TYPE_Pos)) != 0;
+    bool lsb_b = ((crc->CFG & (0x1U << CRC_CFG_BIT_ORDER_Pos)) != 0) != crc32_b;
+    bool big_b = (crc->CFG & (0x1U << CRC_CFG_BYTE_ORDER_Pos)) == CRC_BIG_ENDIAN;
+    uint32_t poly = crc32_b ? 0xEDB88320U : 0x8408U;
+    uint32_t value = crc->VALUE;
+
+    /* The value is kept with its bits reversed, as by Sys_CRC_SW_Update */
+    for (unsigned int i = 0; i < bits; i++)
+    {
+        unsigned int bit;
+        if (bits == 1)
+        {
+            bit = data & 0x1U;
+        }
+        else
+        {
+            unsigned int byte = big_b ? ((bits / 8) - 1 - (i / 8)) : (i / 8);
+            bit = lsb_b ? (i % 8) : (7 - (i % 8));
+            bit = (data >> (byte * 8 + bit)) & 0x1U;
+        }
+        value ^= bit;
+        value = (value & 0x1U) ? ((value >> 1) ^ poly) : (value >> 1);
+    }
+    crc->VALUE = value;
+    Sim_Elapse(sim_timing.crc_word);
+    sim_stats.crc_words++;
+}
+
+static uint32_t Sim_CrcFinal(void)
+{
+    CRC_Type *crc = Sim_CrcRegs();
+    bool crc32_b = (crc->CFG & (0x1U << CRC_CFG_CRC_TYPE_Pos)) != 0;
+    uint32_t value = crc->VALUE;
+
+    if (((crc->CFG & (0x1U << CRC_CFG_FINAL_CRC_REVERSE_Pos)) != 0) == crc32_b)
+    {
+        value = crc32_b ? __RBIT(value) : (__RBIT(value) >> 16);
+    }
+    if (((crc->CFG & (0x1U << CRC_CFG_FINAL_CRC_XOR_Pos)) != 0) != crc32_b)
+    {
+        value ^= crc32_b ? 0xFFFFFFFFU : 0xFFFFU;
+    }
+    return value;
+}
+
+/* ----------------------------------------------------------------------------
+ * Flash copier
+ * ------------------------------------------------------------------------- */
+static bool Sim_MemWrite(uint32_t addr, uint32_t value, unsigned int size);
+static bool Sim_MemRead(uint32_t addr, uint32_t *value, unsigned int size);
+
+static void Sim_Copier(unsigned int inst)
+{
+    FLASH_Type *flash = Sim_FlashRegs(inst);
+    struct sim_flash *f = &sim_flash[inst];
+    struct sim_region region;
+    uint32_t cfg = flash->COPY_CFG;
+    uint32_t src = flash->COPY_SRC_ADDR_PTR;
+    uint32_t dst = flash->COPY_DST_ADDR_PTR;
+    uint32_t count = flash->COPY_WORD_CNT & FLASH_COPY_WORD_CNT_COPY_WORD_CNT_Mask;
+    int32_t step = 4;
+    uint32_t i;
+
+    if ((cfg & COMPARATOR_MODE) != 0)
+    {
+        step = ((cfg & COMP_ADDR_STEP_2) != 0) ? 8 : 4;
+        step = ((cfg & COMP_ADDR_UP) != 0) ? step : -step;
+    }
+
+    f->copy_error = false;
+    for (i = 0; i < count; i++, src += step)
+    {
+        if (!Sim_Region(inst, src, &region))
+        {
+            f->copy_error = true;
+            break;
+        }
+        uint32_t word = *Sim_ArrayWord(src);
+        if ((cfg & COMPARATOR_MODE) != 0)
+        {
+            uint32_t expect = (((cfg & COMP_MODE_CHBK) != 0) && ((i & 1) != 0)) ?
+                              flash->DATA[1] : flash->DATA[0];
+            if (word != expect)
+            {
+                f->copy_error = true;
+                break;
+            }
+        }
+        else if ((cfg & COPY_TO_CRC) != 0)
+        {
+            Sim_CrcAdd(word, 32);
+        }
+        else
+        {
+            if (!Sim_MemWrite(dst, word, 4))
+            {
+                f->copy_error = true;
+                break;
+            }
+            dst += 4;
+        }
+    }
+    flash->COPY_SRC_ADDR_PTR = src & FLASH_COPY_SRC_ADDR_PTR_COPY_SRC_ADDR_PTR_Mask;
+    flash->COPY_DST_ADDR_PTR = dst;
+    f->copy_until = sim_stats.time_ns + (uint64_t)i * sim_timing.copy_word;
+    sim_stats.copier_words += i;
+}
+
+/* ----------------------------------------------------------------------------
+ * DMA channels
+ * ------------------------------------------------------------------------- */
+static unsigned int Sim_DmaSize(uint32_t code)
+{
+    switch (code)
+    {
+        case 0:
+            return 4;
+        case 2:
+            return 1;
+        case 4:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static int32_t Sim_DmaStep(uint32_t code, unsigned int size)
+{
+    return ((code < 8) ? (int32_t)code : ((int32_t)code - 16)) * (int32_t)size;
+}
+
+static void Sim_Dma(unsigned int ch)
+{
+    DMA_Type *dma = Sim_DmaRegs(ch);
+    uint32_t cfg = dma->CFG0;
+    uint32_t sizes = (cfg & DMA_CFG0_SRC_DEST_WORD_SIZE_Mask) >> DMA_CFG0_SRC_DEST_WORD_SIZE_Pos;
+    unsigned int src_size = Sim_DmaSize(sizes >> 3);
+    unsigned int dst_size = Sim_DmaSize(sizes & 0x7U);
+    uint32_t length = (dma->CFG1 & DMA_CFG1_TRANSFER_LENGTH_Mask) >> DMA_CFG1_TRANSFER_LENGTH_Pos;
+    uint32_t src = dma->SRC_ADDR;
+    uint32_t dst = dma->DEST_ADDR;
+    uint32_t i;
+
+    /* Only memory to memory transfers of equal word sizes are modelled */
+    if ((cfg & (DMA_CFG0_SRC_SELECT_Mask | DMA_CFG0_DEST_SELECT_Mask)) != 0 ||
+        src_size == 0 || src_size != dst_size)
+    {
+        fprintf(stderr, "flash_sim: DMA%u configuration 0x%08x not modelled\n", ch, cfg);
+        return;
+    }
+
+    int32_t src_step = Sim_DmaStep((cfg & DMA_CFG0_SRC_ADDR_STEP_Mask) >> DMA_CFG0_SRC_ADDR_STEP_Pos,
+                                   src_size);
+    int32_t dst_step = Sim_DmaStep((cfg & DMA_CFG0_DEST_ADDR_STEP_Mask) >> DMA_CFG0_DEST_ADDR_STEP_Pos,
+                                   dst_size);
+    for (i = 0; i < length; i++, src += src_step, dst += dst_step)
+    {
+        uint32_t value;
+        if (!Sim_MemRead(src, &value, src_size) || !Sim_MemWrite(dst, value, dst_size))
+        {
+            fprintf(stderr, "flash_sim: DMA%u bus error at 0x%08x/0x%08x\n", ch, src, dst);
+            break;
+        }
+    }
+    Sim_Elapse((uint64_t)i * sim_timing.dma_word);
+    sim_stats.dma_words += i;
+    dma->CNTS = i;
+    sim_dma_status[ch] |= DMA_COMPLETE_INT_TRUE;
+}
+
+/* ----------------------------------------------------------------------------
+ * Register accesses
+ * ------------------------------------------------------------------------- */
+static void Sim_FlashRefresh(unsigned int inst, uint32_t reg, bool poll)
+{
+    FLASH_Type *flash = Sim_FlashRegs(inst);
+    struct sim_flash *f = &sim_flash[inst];
+    uint64_t now = sim_stats.time_ns;
+
+    if (reg == offsetof(FLASH_Type, IF_STATUS))
+    {
+        uint32_t status = FLASH_TRIMMED | f->unlock;
+        if (f->seq)
+        {
+            status |= FLASH_IF_BUSY;
+            if (now >= f->req_time)
+            {
+                status |= FLASH_PROG_SEQ_REQ_NEW_DATA;
+            }
+            else if (poll)
+            {
+                /* Skip the polling loop to the data request */
+                sim_stats.time_ns = f->req_time;
+            }
+        }
+        else if (now < f->busy_until)
+        {
+            status |= FLASH_IF_BUSY;
+            if (poll)
+            {
+                sim_stats.time_ns = f->busy_until;
+            }
+        }
+        *(volatile uint32_t *)&flash->IF_STATUS = status;
+    }
+    else if (reg == offsetof(FLASH_Type, CMD_CTRL))
+    {
+        flash->CMD_CTRL = f->seq ? f->seq_cmd : CMD_IDLE;
+    }
+    else if (reg == offsetof(FLASH_Type, COPY_CTRL))
+    {
+        uint32_t ctrl = f->copy_error ? COPY_ERROR : COPY_NO_ERROR;
+        if (now < f->copy_until)
+        {
+            ctrl |= COPY_BUSY;
+            if (poll)
+            {
+                sim_stats.time_ns = f->copy_until;
+            }
+        }
+        flash->COPY_CTRL = ctrl;
+    }
+}
+
+static void Sim_FlashCommand(unsigned int inst, uint32_t value)
+{
+    FLASH_Type *flash = Sim_FlashRegs(inst);
+    struct sim_flash *f = &sim_flash[inst];
+    uint32_t cmd = value & FLASH_CMD_CTRL_COMMAND_Mask;
+
+    sim_stats.commands++;
+    if ((value & CMD_END) != 0)
+    {
+        if (f->seq)
+        {
+            f->seq = false;
+        }
+        f->busy_until = sim_stats.time_ns + sim_timing.command;
+        return;
+    }
+
+    switch (cmd)
+    {
+        case CMD_PROGRAM_SEQ:
+        case CMD_PRE_PROGRAM_SEQ:
+            f->seq = true;
+            f->seq_cmd = cmd;
+            f->req_time = sim_stats.time_ns;
+            /* The first word is in DATA[0] */
+            __attribute__((fallthrough));
+        case CMD_PROGRAM_NOSEQ:
+        case CMD_PRE_PROGRAM_NOSEQ:
+        {
+            uint32_t addr = flash->ADDR;
+            Sim_ProgramWord(inst, addr, flash->DATA[0],
+                            cmd == CMD_PRE_PROGRAM_SEQ || cmd == CMD_PRE_PROGRAM_NOSEQ);
+            if (f->seq)
+            {
+                struct sim_region region;
+                if (Sim_Region(inst, addr, &region))
+                {
+                    /* The address wraps at the end of a row */
+                    flash->ADDR = (addr & ~(region.row - 1)) | ((addr + 4) & (region.row - 1));
+                }
+                f->req_time = sim_stats.time_ns;
+            }
+            else
+            {
+                f->busy_until = sim_stats.time_ns;
+            }
+            break;
+        }
+
+        case CMD_SECTOR_ERASE:
+            Sim_EraseSector(inst, flash->ADDR);
+            f->busy_until = sim_stats.time_ns;
+            break;
+
+        case CMD_MASS_ERASE:
+            Sim_EraseMass(inst);
+            f->busy_until = sim_stats.time_ns;
+            break;
+
+        case CMD_READ:
+        {
+            struct sim_region region;
+            if (Sim_Region(inst, flash->ADDR, &region))
+            {
+                flash->DATA[0] = *Sim_ArrayWord(flash->ADDR);
+                flash->DATA[1] = sim_ecc[(flash->ADDR - SIM_FLASH_BASE) / 4];
+            }
+            f->busy_until = sim_stats.time_ns + sim_timing.command;
+            break;
+        }
+
+        default:
+            /* Wake up, trim, recall, VREAD1 and low power mode commands */
+            f->busy_until = sim_stats.time_ns + sim_timing.command;
+            break;
+    }
+}
+
+static void Sim_FlashWrite(unsigned int inst, uint32_t reg, uint32_t value)
+{
+    FLASH_Type *flash = Sim_FlashRegs(inst);
+    struct sim_flash *f = &sim_flash[inst];
+
+    switch (reg)
+    {
+        case offsetof(FLASH_Type, IF_CTRL):
+            /* Changes of VREAD1, RECALL or LP_MODE are commands */
+            f->busy_until = sim_stats.time_ns + sim_timing.command;
+            break;
+
+        case offsetof(FLASH_Type, DELAY_CTRL):
+            flash->RESERVED0[3] = SIM_DELAY3_DEFAULT;
+            break;
+
+        case offsetof(FLASH_Type, MAIN_WRITE_UNLOCK):
+            if (value == FLASH_MAIN_KEY)
+            {
+                f->unlock = (f->unlock & ~SIM_MAIN_UNLOCK_MASK) |
+                            (flash->MAIN_CTRL & SIM_MAIN_UNLOCK_MASK);
+            }
+            break;
+
+        case offsetof(FLASH_Type, NVR_WRITE_UNLOCK):
+            if (value == FLASH_NVR_KEY)
+            {
+                f->unlock = (f->unlock & ~SIM_NVR_UNLOCK_MASK) |
+                            ((flash->NVR_CTRL << FLASH_IF_STATUS_NVR0_W_UNLOCK_Pos) &
+                             SIM_NVR_UNLOCK_MASK);
+            }
+            break;
+
+        case offsetof(FLASH_Type, CMD_CTRL):
+            Sim_FlashCommand(inst, value);
+            Sim_FlashRefresh(inst, reg, false);
+            break;
+
+        case offsetof(FLASH_Type, DATA[0]):
+            if (f->seq)
+            {
+                /* Sequential programming data: stall until requested */
+                if (sim_stats.time_ns < f->req_time)
+                {
+                    sim_stats.time_ns = f->req_time;
+                }
+                uint32_t addr = flash->ADDR;
+                struct sim_region region;
+                Sim_ProgramWord(inst, addr, value, f->seq_cmd == CMD_PRE_PROGRAM_SEQ);
+                if (Sim_Region(inst, addr, &region))
+                {
+                    flash->ADDR = (addr & ~(region.row - 1)) | ((addr + 4) & (region.row - 1));
+                }
+                f->req_time = sim_stats.time_ns;
+            }
+            break;
+
+        case offsetof(FLASH_Type, COPY_CTRL):
+            if ((value & COPY_START) != 0)
+            {
+                Sim_Copier(inst);
+            }
+            else if ((value & COPY_STOP) != 0)
+            {
+                f->copy_until = sim_stats.time_ns;
+            }
+            Sim_FlashRefresh(inst, reg, false);
+            break;
+
+        case offsetof(FLASH_Type, IF_STATUS):
+            Sim_FlashRefresh(inst, reg, false);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void Sim_DmaWrite(unsigned int ch, uint32_t reg, uint32_t value)
+{
+    DMA_Type *dma = Sim_DmaRegs(ch);
+
+    /* Transfers from or to a peripheral are run by the attached device */
+    if (sim_device != NULL &&
+        (dma->CFG0 & (DMA_CFG0_SRC_SELECT_Mask | DMA_CFG0_DEST_SELECT_Mask)) != 0)
+    {
+        return;
+    }
+
+    switch (reg)
+    {
+        case offsetof(DMA_Type, CTRL):
+            if ((value & DMA_CLEAR_CNTS) != 0)
+            {
+                dma->CNTS = 0;
+            }
+            if ((value & DMA_CTRL_MODE_ENABLE_Mask) == DMA_ENABLE)
+            {
+                Sim_Dma(ch);
+            }
+            else if ((value & DMA_CTRL_MODE_ENABLE_Mask) != DMA_DISABLE)
+            {
+                fprintf(stderr, "flash_sim: DMA%u mode 0x%x not modelled\n", ch,
+                        value & DMA_CTRL_MODE_ENABLE_Mask);
+            }
+            break;
+
+        case offsetof(DMA_Type, STATUS):
+            if ((value & DMA_COMPLETE_INT_CLEAR) != 0)
+            {
+                sim_dma_status[ch] &= ~DMA_COMPLETE_INT_TRUE;
+            }
+            dma->STATUS = sim_dma_status[ch];
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Update a register before the firmware reads it
+ * @param [in] addr Register address
+ * @param [in] poll True for a read, which moves the modelled time to the
+ *                  end of the operation the register reports as busy
+ */
+static void Sim_RegRefresh(uint32_t addr, bool poll)
+{
+    if (addr >= FLASH0_BASE && addr < FLASH1_BASE + (FLASH1_BASE - FLASH0_BASE))
+    {
+        Sim_FlashRefresh((addr - FLASH0_BASE) / (FLASH1_BASE - FLASH0_BASE),
+                         (addr - FLASH0_BASE) % (FLASH1_BASE - FLASH0_BASE), poll);
+    }
+    else if (addr >= DMA0_BASE && addr < DMA0_BASE + SIM_DMA_NUM * (DMA1_BASE - DMA0_BASE))
+    {
+        unsigned int ch = (addr - DMA0_BASE) / (DMA1_BASE - DMA0_BASE);
+        if ((addr - DMA0_BASE) % (DMA1_BASE - DMA0_BASE) == offsetof(DMA_Type, STATUS))
+        {
+            Sim_DmaRegs(ch)->STATUS = sim_dma_status[ch];
+        }
+    }
+    else if (addr == (uint32_t)(uintptr_t)&CRC->FINAL)
+    {
+        *(volatile uint32_t *)&Sim_CrcRegs()->FINAL = Sim_CrcFinal();
+    }
+}
+
+/**
+ * @brief Apply a register write to the model
+ * @param [in] addr  Register address
+ * @param [in] value Value written
+ */
+static void Sim_RegWrite(uint32_t addr, uint32_t value)
+{
+    if (addr >= FLASH0_BASE && addr < FLASH1_BASE + (FLASH1_BASE - FLASH0_BASE))
+    {
+        Sim_FlashWrite((addr - FLASH0_BASE) / (FLASH1_BASE - FLASH0_BASE),
+                       (addr - FLASH0_BASE) % (FLASH1_BASE - FLASH0_BASE), value);
+    }
+    else if (addr >= DMA0_BASE && addr < DMA0_BASE + SIM_DMA_NUM * (DMA1_BASE - DMA0_BASE))
+    {
+        Sim_DmaWrite((addr - DMA0_BASE) / (DMA1_BASE - DMA0_BASE),
+                     (addr - DMA0_BASE) % (DMA1_BASE - DMA0_BASE), value);
+    }
+    else if (addr >= CRC_BASE && addr <= (uint32_t)(uintptr_t)&CRC->ADD_32)
+    {
+        switch (addr - CRC_BASE)
+        {
+            case offsetof(CRC_Type, ADD_1):
+                Sim_CrcAdd(value, 1);
+                break;
+            case offsetof(CRC_Type, ADD_8):
+                Sim_CrcAdd(value, 8);
+                break;
+            case offsetof(CRC_Type, ADD_16):
+                Sim_CrcAdd(value, 16);
+                break;
+            case offsetof(CRC_Type, ADD_24):
+                Sim_CrcAdd(value, 24);
+                break;
+            case offsetof(CRC_Type, ADD_32):
+                Sim_CrcAdd(value, 32);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static bool Sim_MemRead(uint32_t addr, uint32_t *value, unsigned int size)
+{
+    const uint8_t *p;
+
+    if (addr >= SIM_PERIPH_BASE && addr < SIM_PERIPH_BASE + SIM_PERIPH_SIZE)
+    {
+        Sim_RegRefresh(addr & ~0x3U, false);
+        p = (const uint8_t *)Sim_Reg(addr & ~0x3U) + (addr & 0x3U);
+    }
+    else if (addr >= SIM_FLASH_BASE && addr < SIM_FLASH_BASE + SIM_FLASH_SIZE)
+    {
+        p = sim_array + (addr - SIM_FLASH_BASE);
+    }
+    else if (addr >= SIM_DRAM_BASE && addr < SIM_DRAM_BASE + SIM_DRAM_SIZE)
+    {
+        p = (const uint8_t *)(uintptr_t)addr;
+    }
+    else
+    {
+        return false;
+    }
+    *value = 0;
+    memcpy(value, p, size);
+    return true;
+}
+
+static bool Sim_MemWrite(uint32_t addr, uint32_t value, unsigned int size)
+{
+    if (addr >= SIM_PERIPH_BASE && addr < SIM_PERIPH_BASE + SIM_PERIPH_SIZE)
+    {
+        memcpy((uint8_t *)Sim_Reg(addr & ~0x3U) + (addr & 0x3U), &value, size);
+        Sim_RegWrite(addr & ~0x3U, *Sim_Reg(addr & ~0x3U));
+    }
+    else if (addr >= SIM_DRAM_BASE && addr < SIM_DRAM_BASE + SIM_DRAM_SIZE)
+    {
+        memcpy((void *)(uintptr_t)addr, &value, size);
+    }
+    else
+    {
+        /* Flash arrays are not writable from the bus */
+        return false;
+    }
+    return true;
+}
+
+/* ----------------------------------------------------------------------------
+ * Access trapping
+ * ------------------------------------------------------------------------- */
+static void Sim_Segv(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+
+    if (sim_trap_pending || addr < SIM_PERIPH_BASE ||
+        addr >= SIM_PERIPH_BASE + SIM_PERIPH_SIZE)
+    {
+        /* Not a register access: crash */
+        fprintf(stderr, "flash_sim: bad access at %p\n", info->si_addr);
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    sim_trap_off = (uint32_t)addr & ~0x3U;
+    sim_trap_write = (uc->uc_mcontext.gregs[REG_ERR] & SIM_PF_WRITE) != 0;
+    Sim_Elapse(sim_timing.reg_access);
+    if (sim_trap_write)
+    {
+        sim_stats.reg_writes++;
+        Sim_RegRefresh(sim_trap_off, false);
+    }
+    else
+    {
+        sim_stats.reg_reads++;
+        Sim_RegRefresh(sim_trap_off, true);
+        if (sim_device != NULL)
+        {
+            sim_device->read(sim_trap_off);
+        }
+    }
+
+    /* Let the instruction complete, and trap right after it */
+    mprotect(sim_periph, SIM_PERIPH_SIZE, PROT_READ | PROT_WRITE);
+    sim_trap_pending = true;
+    uc->uc_mcontext.gregs[REG_EFL] |= SIM_EFLAGS_TF;
+}
+
+static void Sim_Trap(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    (void)sig;
+    (void)info;
+    if (!sim_trap_pending)
+    {
+        return;
+    }
+    uc->uc_mcontext.gregs[REG_EFL] &= ~SIM_EFLAGS_TF;
+    mprotect(sim_periph, SIM_PERIPH_SIZE, PROT_NONE);
+    sim_trap_pending = false;
+    if (sim_trap_write)
+    {
+        Sim_RegWrite(sim_trap_off, *Sim_Reg(sim_trap_off));
+        if (sim_device != NULL)
+        {
+            sim_device->write(sim_trap_off, *Sim_Reg(sim_trap_off));
+        }
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * Public functions
+ * ------------------------------------------------------------------------- */
+static void * Sim_Map(uintptr_t addr, size_t size, int prot, int fd)
+{
+    void *p = mmap((void *)addr, size, prot,
+                   ((fd < 0) ? (MAP_PRIVATE | MAP_ANONYMOUS) : MAP_SHARED) |
+                   ((addr != 0) ? MAP_FIXED_NOREPLACE : 0), fd, 0);
+    if (p == MAP_FAILED || (addr != 0 && p != (void *)addr))
+    {
+        fprintf(stderr, "flash_sim: cannot map 0x%08lx\n", (unsigned long)addr);
+        exit(2);
+    }
+    return p;
+}
+
+void Sim_Init(void)
+{
+    struct sigaction sa;
+    int fd;
+
+    fd = memfd_create("flash_sim_array", 0);
+    if (fd < 0 || ftruncate(fd, SIM_FLASH_SIZE) != 0)
+    {
+        perror("flash_sim");
+        exit(2);
+    }
+    sim_array = Sim_Map(0, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, fd);
+    Sim_Map(SIM_FLASH_BASE, SIM_FLASH_SIZE, PROT_READ, fd);
+    close(fd);
+
+    fd = memfd_create("flash_sim_regs", 0);
+    if (fd < 0 || ftruncate(fd, SIM_PERIPH_SIZE) != 0)
+    {
+        perror("flash_sim");
+        exit(2);
+    }
+    sim_regs = Sim_Map(0, SIM_PERIPH_SIZE, PROT_READ | PROT_WRITE, fd);
+    Sim_Map(SIM_PERIPH_BASE, SIM_PERIPH_SIZE, PROT_NONE, fd);
+    close(fd);
+
+    Sim_Map(SIM_DRAM_BASE, SIM_DRAM_SIZE, PROT_READ | PROT_WRITE, -1);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = Sim_Segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = Sim_Trap;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    memset(sim_array, 0xFF, SIM_FLASH_SIZE);
+    memset(sim_ecc, 0x3F, sizeof(sim_ecc));
+    Sim_PowerCycle();
+    Sim_ResetStats();
+}
+
+void Sim_PowerCycle(void)
+{
+    memset(sim_regs, 0, SIM_PERIPH_SIZE);
+    memset(sim_flash, 0, sizeof(sim_flash));
+    memset(sim_dma_status, 0, sizeof(sim_dma_status));
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        Sim_FlashRegs(i)->RESERVED0[3] = SIM_DELAY3_DEFAULT;
+    }
+    sim_trap_pending = false;
+    sim_cut_step = 0;
+    sim_primask = 0;
+}
+
+SimTiming_t * Sim_Timing(void)
+{
+    return &sim_timing;
+}
+
+SimStats_t * Sim_Stats(void)
+{
+    return &sim_stats;
+}
+
+/**
+ * @brief Move a deadline of the model to the new time origin
+ * @param [in,out] deadline Absolute modelled time
+ * @param [in]     origin   Current time, which becomes time 0
+ */
+static void Sim_Rebase(uint64_t *deadline, uint64_t origin)
+{
+    *deadline = (*deadline > origin) ? (*deadline - origin) : 0;
+}
+
+void Sim_ResetStats(void)
+{
+    uint64_t origin = sim_stats.time_ns;
+
+    /* Pending deadlines are kept relative to the new time origin */
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        Sim_Rebase(&sim_flash[i].busy_until, origin);
+        Sim_Rebase(&sim_flash[i].req_time, origin);
+        Sim_Rebase(&sim_flash[i].copy_until, origin);
+    }
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+void Sim_SetPowerCut(uint32_t step, sigjmp_buf *env)
+{
+    sim_cut_step = step;
+    sim_cut_env = env;
+    sim_array_ops = 0;
+}
+
+uint32_t Sim_ArrayOps(void)
+{
+    return sim_array_ops;
+}
+
+void * Sim_DramAlloc(uint32_t size)
+{
+    size = (size + 3U) & ~0x3U;
+    if (sim_dram_used + size > SIM_DRAM_SIZE)
+    {
+        fprintf(stderr, "flash_sim: out of DRAM\n");
+        exit(2);
+    }
+    void *p = (void *)(uintptr_t)(SIM_DRAM_BASE + sim_dram_used);
+    sim_dram_used += size;
+    return p;
+}
+
+void Sim_FlashPoke(uint32_t addr, const uint32_t *words, uint32_t count)
+{
+    memcpy(Sim_ArrayWord(addr), words, count * sizeof(uint32_t));
+}
+
+void Sim_AttachDevice(const SimDevice_t *device)
+{
+    sim_device = device;
+}
+
+volatile uint32_t * Sim_Register(uint32_t addr)
+{
+    return Sim_Reg(addr);
+}
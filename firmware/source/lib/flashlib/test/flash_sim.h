@@ -0,0 +1,172 @@
+/**
+ * @file flash_sim.h
+ * @brief Host simulator of the flash interface, CRC and DMA peripherals
+ *
+ * The simulator maps the flash arrays, DRAM and the peripheral registers at
+ * their device addresses, so that the flash library and the hardware
+ * abstraction layer run unmodified on a Linux host. Register accesses are
+ * trapped and applied to a behavioural model of the FLASH_Type, CRC_Type and
+ * DMA_Type blocks, which keeps a modelled time from configurable operation
+ * latencies and counts the erase and program operations.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef FLASH_SIM_H_
+#define FLASH_SIM_H_
+
+#include <stdint.h>
+#include <setjmp.h>
+
+/**
+ * @brief Modelled latencies, in nanoseconds
+ */
+typedef struct
+{
+    uint32_t reg_access;            /**< Any peripheral register access */
+    uint32_t command;               /**< Flash command without array access
+                                     *   (IF_CTRL change, read, CMD_END) */
+    uint32_t program_word;          /**< Program of one word, sequential or not */
+    uint32_t erase_pulse;           /**< Sector erase pulse with the default
+                                     *   delay register 3 value */
+    uint32_t mass_erase;            /**< Mass erase of a flash instance */
+    uint32_t copy_word;             /**< One word read, compared or CRC'ed by
+                                     *   the flash copier */
+    uint32_t crc_word;              /**< One word added to the CRC generator */
+    uint32_t dma_word;              /**< One word moved by a DMA channel */
+} SimTiming_t;
+
+/**
+ * @brief Modelled time and operation counters
+ */
+typedef struct
+{
+    uint64_t time_ns;               /**< Modelled time */
+    uint32_t reg_reads;             /**< Peripheral register reads */
+    uint32_t reg_writes;            /**< Peripheral register writes */
+    uint32_t commands;              /**< Commands written to CMD_CTRL */
+    uint32_t word_programs;         /**< Words programmed */
+    uint32_t pre_programs;          /**< Words pre-programmed (endurance) */
+    uint32_t sector_erases;         /**< Sector erase pulses */
+    uint32_t mass_erases;           /**< Mass erases */
+    uint32_t copier_words;          /**< Words handled by the flash copier */
+    uint32_t crc_words;             /**< Words added to the CRC generator */
+    uint32_t dma_words;             /**< Words moved by the DMA channels */
+    uint32_t locked_accesses;       /**< Program or erase of a locked region */
+    uint32_t overprograms;          /**< Programs of a word which needed a bit
+                                     *   to go from 0 to 1 */
+} SimStats_t;
+
+/**
+ * @brief Model of peripherals outside of the simulator, see Sim_AttachDevice
+ */
+typedef struct
+{
+    /** Called before the firmware reads the register at @p addr */
+    void (*read)(uint32_t addr);
+
+    /** Called once the firmware has written @p value to the register at
+     *  @p addr */
+    void (*write)(uint32_t addr, uint32_t value);
+} SimDevice_t;
+
+/**
+ * @brief Map the simulated memories and peripherals and reset them
+ * @note  Flash arrays are erased. Must be called once, before any other
+ *        simulator or flash library function.
+ */
+void Sim_Init(void);
+
+/**
+ * @brief Reset the peripherals as after a power cycle
+ * @note  Flash contents and counters are kept; pending power cut is cleared.
+ */
+void Sim_PowerCycle(void);
+
+/**
+ * @brief Get the modelled latencies, which can be changed at any time
+ * @return Pointer to the modelled latencies
+ */
+SimTiming_t * Sim_Timing(void);
+
+/**
+ * @brief Get the modelled time and operation counters
+ * @return Pointer to the counters
+ */
+SimStats_t * Sim_Stats(void);
+
+/**
+ * @brief Reset the modelled time and operation counters
+ */
+void Sim_ResetStats(void);
+
+/**
+ * @brief Cut the power at a flash array operation
+ *
+ * The array operation (word program or erase) with number @p step, counted
+ * from 1 after this call, is torn: a programmed word gets only part of its
+ * zero bits and an erased sector is left partially erased. The simulator
+ * then returns to @p env with siglongjmp and a value of 1, after resetting
+ * the peripherals with Sim_PowerCycle.
+ *
+ * @param [in] step Number of the array operation to tear, 0 to disable
+ * @param [in] env  Context saved with sigsetjmp(env, 1)
+ */
+void Sim_SetPowerCut(uint32_t step, sigjmp_buf *env);
+
+/**
+ * @brief Number of flash array operations since the last Sim_SetPowerCut
+ * @return Number of word programs and erases
+ */
+uint32_t Sim_ArrayOps(void);
+
+/**
+ * @brief Allocate a buffer in the simulated DRAM
+ *
+ * Addresses passed to the flash copier and DMA channels are 32 bits wide,
+ * so buffers used as their source or destination must be allocated here.
+ *
+ * @param [in] size Size in bytes
+ * @return Word aligned buffer, never freed
+ */
+void * Sim_DramAlloc(uint32_t size);
+
+/**
+ * @brief Write directly to a simulated flash array, bypassing the model
+ * @param [in] addr  Flash address
+ * @param [in] words Words to store
+ * @param [in] count Number of words
+ */
+void Sim_FlashPoke(uint32_t addr, const uint32_t *words, uint32_t count);
+
+/**
+ * @brief Attach a model of other peripherals to the simulator
+ *
+ * The device sees all the register accesses of the firmware, after the
+ * simulator has applied them to its own model. DMA channels which select
+ * a peripheral as source or destination are then left to the device: the
+ * simulator does not run them.
+ *
+ * @param [in] device Device model, NULL to detach it
+ */
+void Sim_AttachDevice(const SimDevice_t *device);
+
+/**
+ * @brief Get the backing store of a peripheral register, which the device
+ *        model can read and write without being trapped
+ * @param [in] addr Register address
+ * @return Pointer to the register value
+ */
+volatile uint32_t * Sim_Register(uint32_t addr);
+
+#endif    /* FLASH_SIM_H_ */
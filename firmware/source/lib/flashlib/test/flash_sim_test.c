@@ -0,0 +1,419 @@
+/**
+ * @file flash_sim_test.c
+ * @brief Tests and benchmark of the flash library on the flash simulator
+ *
+ * Usage: flash_sim_test [-b] [-t name=ns]...
+ *   -b           print the modelled time and operation counts of the main
+ *                flash library operations, and the host time of a flash
+ *                region lookup
+ *   -t name=ns   change a modelled latency (reg_access, command,
+ *                program_word, erase_pulse, mass_erase, copy_word, crc_word,
+ *                dma_word)
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <flash.h>
+#include <flash_internal.h>
+#include "flash_sim.h"
+
+/* Test addresses: one data sector, one code sector */
+#define TEST_DATA_ADDR                  (FLASH0_DATA_BASE + 0x1000U)
+#define TEST_CODE_ADDR                  (FLASH1_CODE_BASE + 0x1800U)
+#define TEST_DATA_WORDS                 64
+#define TEST_CODE_WORDS                 512
+
+/** Number of region lookups of each benchmark */
+#define BENCH_LOOKUPS                   1000000
+
+static unsigned int failures;
+
+#define CHECK(expr)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(expr))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+static uint32_t words[TEST_CODE_WORDS];
+
+static void Test_Fill(uint32_t seed, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        words[i] = seed ^ (i * 0x9E3779B9U);
+    }
+}
+
+static uint32_t Test_Unlocked(void)
+{
+    return FLASH0->IF_STATUS & 0x007FFFFFU;
+}
+
+static void Test_Init(void)
+{
+    CHECK(Flash_Initialize(0, FLASH_CLOCK_16MHZ) == FLASH_ERR_NONE);
+    CHECK(Flash_Initialize(1, FLASH_CLOCK_16MHZ) == FLASH_ERR_NONE);
+}
+
+static void Test_WriteRead(void)
+{
+    uint32_t *buf = Sim_DramAlloc(TEST_DATA_WORDS * sizeof(uint32_t));
+    uint32_t unlocked = Test_Unlocked();
+
+    Sim_ResetStats();
+    CHECK(Flash_EraseSector(TEST_DATA_ADDR, false) == FLASH_ERR_NONE);
+    CHECK(Flash_BlankCheck(TEST_DATA_ADDR, TEST_DATA_WORDS) == FLASH_ERR_NONE);
+
+    Test_Fill(0x12345678U, TEST_DATA_WORDS);
+    CHECK(Flash_WriteBuffer(TEST_DATA_ADDR, TEST_DATA_WORDS, words, false) == FLASH_ERR_NONE);
+    CHECK(memcmp((void *)TEST_DATA_ADDR, words, TEST_DATA_WORDS * sizeof(uint32_t)) == 0);
+    CHECK(Flash_BlankCheck(TEST_DATA_ADDR, TEST_DATA_WORDS) != FLASH_ERR_NONE);
+
+    CHECK(Flash_ReadBuffer(TEST_DATA_ADDR, (uint32_t)(uintptr_t)buf,
+                           TEST_DATA_WORDS) == FLASH_ERR_NONE);
+    CHECK(memcmp(buf, words, TEST_DATA_WORDS * sizeof(uint32_t)) == 0);
+
+    uint32_t word;
+    CHECK(Flash_ReadWord(TEST_DATA_ADDR + 4 * 33, &word) == FLASH_ERR_NONE);
+    CHECK(word == words[33]);
+
+    CHECK(Sim_Stats()->word_programs == TEST_DATA_WORDS);
+    CHECK(Sim_Stats()->sector_erases == 1);
+    CHECK(Sim_Stats()->locked_accesses == 0);
+    CHECK(Sim_Stats()->overprograms == 0);
+
+    /* Write access is restored after each operation */
+    CHECK(Test_Unlocked() == unlocked);
+}
+
+static void Test_RowCrossing(void)
+{
+    /* Start in the middle of a row, and end in the middle of another */
+    uint32_t addr = TEST_DATA_ADDR + 0x74U;
+
+    CHECK(Flash_EraseSector(TEST_DATA_ADDR, false) == FLASH_ERR_NONE);
+    Test_Fill(0xCAFEF00DU, 40);
+    CHECK(Flash_WriteBuffer(addr, 40, words, false) == FLASH_ERR_NONE);
+    CHECK(memcmp((void *)addr, words, 40 * sizeof(uint32_t)) == 0);
+    CHECK(*(uint32_t *)(addr - 4) == 0xFFFFFFFFU);
+    CHECK(*(uint32_t *)(addr + 40 * 4) == 0xFFFFFFFFU);
+}
+
+static void Test_CodeEndurance(void)
+{
+    Sim_ResetStats();
+    CHECK(Flash_EraseSector(TEST_CODE_ADDR, true) == FLASH_ERR_NONE);
+    Test_Fill(0x0BADBEEFU, TEST_CODE_WORDS);
+    CHECK(Flash_WriteBuffer(TEST_CODE_ADDR, TEST_CODE_WORDS, words, true) == FLASH_ERR_NONE);
+    CHECK(memcmp((void *)TEST_CODE_ADDR, words, TEST_CODE_WORDS * sizeof(uint32_t)) == 0);
+    CHECK(Sim_Stats()->pre_programs == TEST_CODE_WORDS);
+    CHECK(Sim_Stats()->word_programs == TEST_CODE_WORDS);
+    CHECK(Sim_Stats()->locked_accesses == 0);
+}
+
+static void Test_Overprogram(void)
+{
+    CHECK(Flash_EraseSector(TEST_DATA_ADDR, false) == FLASH_ERR_NONE);
+    Test_Fill(0x0F0F0F0FU, 8);
+    CHECK(Flash_WriteBuffer(TEST_DATA_ADDR, 8, words, false) == FLASH_ERR_NONE);
+
+    /* Bits cannot go back to 1 without an erase: the CRC check fails */
+    Sim_ResetStats();
+    Test_Fill(0xF0F0F0F0U, 8);
+    CHECK(Flash_WriteBuffer(TEST_DATA_ADDR, 8, words, false) == FLASH_ERR_CRC_CHECK);
+    CHECK(Sim_Stats()->overprograms > 0);
+}
+
+static void Test_Double(void)
+{
+    uint32_t in[2] = { 0x89ABCDEFU, 0x15U };
+    uint32_t out[2];
+
+    CHECK(Flash_EraseSector(TEST_DATA_ADDR, false) == FLASH_ERR_NONE);
+    CHECK(Flash_WriteDouble(TEST_DATA_ADDR + 8, in, false) == FLASH_ERR_NONE);
+    CHECK(Flash_ReadDouble(TEST_DATA_ADDR + 8, out) == FLASH_ERR_NONE);
+    CHECK(out[0] == in[0] && out[1] == in[1]);
+}
+
+/** Bitwise CRC-32 of a buffer, as the reference of the CRC generator */
+static uint32_t Test_Crc32(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint32_t crc = 0xFFFFFFFFU;
+
+    while (len-- > 0)
+    {
+        crc ^= *p++;
+        for (unsigned int i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1U));
+        }
+    }
+    return ~crc;
+}
+
+static void Test_Copier(void)
+{
+    uint32_t crc;
+
+    CHECK(Flash_EraseSector(TEST_DATA_ADDR, false) == FLASH_ERR_NONE);
+    CHECK(Sys_Flash_Compare(FLASH0, COMP_MODE_CONSTANT | COMP_ADDR_UP | COMP_ADDR_STEP_1,
+                            TEST_DATA_ADDR, TEST_DATA_WORDS,
+                            0xFFFFFFFFU, 0xFFFFFFFFU) == 0);
+
+    Test_Fill(0x5A5AA5A5U, TEST_DATA_WORDS);
+    CHECK(Flash_WriteBuffer(TEST_DATA_ADDR, TEST_DATA_WORDS, words, false) == FLASH_ERR_NONE);
+    CHECK(Sys_Flash_Compare(FLASH0, COMP_MODE_CONSTANT | COMP_ADDR_UP | COMP_ADDR_STEP_1,
+                            TEST_DATA_ADDR, TEST_DATA_WORDS,
+                            0xFFFFFFFFU, 0xFFFFFFFFU) == 1);
+
+    /* The copier CRC matches the software CRC of the same bytes */
+    CHECK(Sys_Flash_CalculateCRC(FLASH0, TEST_DATA_ADDR, TEST_DATA_WORDS, &crc) == 0);
+    CHECK(crc == Test_Crc32(words, TEST_DATA_WORDS * sizeof(uint32_t)));
+
+    uint32_t *buf = Sim_DramAlloc(TEST_DATA_WORDS * sizeof(uint32_t));
+    Sys_Flash_Copy(FLASH0, TEST_DATA_ADDR, (uint32_t)(uintptr_t)buf, TEST_DATA_WORDS, COPY_TO_MEM);
+    while ((FLASH0->COPY_CTRL & COPY_BUSY) != 0);
+    CHECK(memcmp(buf, words, TEST_DATA_WORDS * sizeof(uint32_t)) == 0);
+}
+
+/** CRC of a buffer computed by the CRC generator, fed byte by byte */
+static uint32_t Test_CrcGenerator(uint32_t config, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    Sys_Set_CRC_Config(CRC, config);
+    if ((config & (0x1U << CRC_CFG_CRC_TYPE_Pos)) != 0)
+    {
+        Sys_CRC_32InitValue(CRC);
+    }
+    else
+    {
+        Sys_CRC_CCITTInitValue(CRC);
+    }
+    while (len-- > 0)
+    {
+        Sys_CRC_Add(CRC, *p++, 8);
+    }
+    return Sys_CRC_GetFinalValue(CRC);
+}
+
+static void Test_Crc(void)
+{
+    static const char check[] = "123456789";
+
+    /* Standard check values */
+    CHECK(Test_CrcGenerator(CRC_32 | CRC_LITTLE_ENDIAN, check, 9) == 0xCBF43926U);
+    CHECK(Test_Crc32(check, 9) == 0xCBF43926U);
+    CHECK(Test_CrcGenerator(CRC_CCITT | CRC_LITTLE_ENDIAN, check, 9) == 0x29B1U);
+}
+
+static unsigned int async_done;
+static FlashStatus_t async_status;
+
+static void Test_AsyncCallback(FlashStatus_t status, void *context)
+{
+    (void)context;
+    async_done++;
+    async_status = status;
+}
+
+static void Test_Async(void)
+{
+    uint32_t word;
+
+    Test_Fill(0x600DF00DU, TEST_CODE_WORDS);
+    async_done = 0;
+    CHECK(Flash_EraseSectorAsync(TEST_CODE_ADDR, true, Test_AsyncCallback, NULL) == FLASH_ERR_NONE);
+    CHECK(Flash_WriteBufferAsync(TEST_CODE_ADDR, TEST_CODE_WORDS, words, false,
+                                 Test_AsyncCallback, NULL) == FLASH_ERR_NONE);
+
+    /* Synchronous functions do not terminate the erase pulse in progress */
+    CHECK(Flash_ProcessJobs());
+    CHECK(Flash_IsErasing(TEST_CODE_ADDR));
+    CHECK(!Flash_IsErasing(TEST_DATA_ADDR));
+    CHECK(Flash_EraseSector(TEST_CODE_ADDR + 0x800U, false) == FLASH_ERR_BUSY);
+    CHECK(Flash_ReadWord(TEST_CODE_ADDR, &word) == FLASH_ERR_BUSY);
+    CHECK(Flash_EraseSector(TEST_DATA_ADDR, false) == FLASH_ERR_NONE);
+    CHECK(Flash_IsErasing(TEST_CODE_ADDR));
+    while (Flash_ProcessJobs());
+    CHECK(async_done == 2);
+    CHECK(async_status == FLASH_ERR_NONE);
+    CHECK(memcmp((void *)TEST_CODE_ADDR, words, TEST_CODE_WORDS * sizeof(uint32_t)) == 0);
+}
+
+static void Bench_Print(const char *name)
+{
+    const SimStats_t *s = Sim_Stats();
+    printf("%-28s %10.1f %6u %6u %7u %6u %6u\n", name, s->time_ns / 1000.0,
+           s->sector_erases, s->pre_programs + s->word_programs, s->copier_words,
+           s->commands, s->reg_reads + s->reg_writes);
+    Sim_ResetStats();
+}
+
+static void Bench(void)
+{
+    uint32_t *buf = Sim_DramAlloc(TEST_CODE_WORDS * sizeof(uint32_t));
+
+    printf("%-28s %10s %6s %6s %7s %6s %6s\n", "operation", "time(us)", "erase",
+           "prog", "copier", "cmds", "regs");
+    Test_Fill(0x1234U, TEST_CODE_WORDS);
+    Sim_ResetStats();
+
+    Flash_EraseSector(TEST_DATA_ADDR, false);
+    Bench_Print("EraseSector data");
+    Flash_EraseSector(TEST_DATA_ADDR, true);
+    Bench_Print("EraseSector data, endur.");
+    Flash_WriteBuffer(TEST_DATA_ADDR, TEST_DATA_WORDS, words, false);
+    Bench_Print("WriteBuffer 64 words");
+    Flash_EraseSector(TEST_DATA_ADDR, false);
+    Sim_ResetStats();
+    Flash_WriteBuffer(TEST_DATA_ADDR, TEST_DATA_WORDS, words, true);
+    Bench_Print("WriteBuffer 64 words, endur.");
+    for (unsigned int i = 0; i < TEST_DATA_WORDS; i++)
+    {
+        Flash_ReadWord(TEST_DATA_ADDR + 4 * i, &buf[i]);
+    }
+    Bench_Print("ReadWord x64");
+    Flash_ReadBuffer(TEST_DATA_ADDR, (uint32_t)(uintptr_t)buf, TEST_DATA_WORDS);
+    Bench_Print("ReadBuffer 64 words");
+    Flash_EraseSector(TEST_CODE_ADDR, false);
+    Bench_Print("EraseSector code");
+    Flash_WriteBuffer(TEST_CODE_ADDR, TEST_CODE_WORDS, words, false);
+    Bench_Print("WriteBuffer 512 words");
+    Flash_ReadBuffer(TEST_CODE_ADDR, (uint32_t)(uintptr_t)buf, TEST_CODE_WORDS);
+    Bench_Print("ReadBuffer 512 words");
+    Flash_BlankCheck(TEST_CODE_ADDR, TEST_CODE_WORDS);
+    Bench_Print("BlankCheck 512 words");
+}
+
+/**
+ * Returns the host time of a region lookup, in ns, for consecutive words
+ * starting at addr, or for words alternating between addr and other so that
+ * the last region found never matches and all regions are walked, as they
+ * were for each word before the lookup kept the last region found.
+ */
+static double Bench_Lookup(uint32_t addr, uint32_t other)
+{
+    struct timespec start, end;
+    struct info info;
+    uint32_t found = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        uint32_t word = addr + 4 * (i % TEST_DATA_WORDS);
+        if ((other != 0) && ((i & 1U) != 0))
+        {
+            word = other;
+        }
+        found += (Sys_Flash_GetAddrInfo(word, &info) == FLASH_ERR_NONE) ? 1 : 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    CHECK(found == BENCH_LOOKUPS);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_LOOKUPS;
+}
+
+static void Bench_Lookups(void)
+{
+    /* FLASH1 data and NVR0 are the last regions walked */
+    printf("\n%-28s %10s\n", "region lookup", "host(ns)");
+    printf("%-28s %10.1f\n", "FLASH1 data, last region", Bench_Lookup(FLASH1_DATA_BASE, 0));
+    printf("%-28s %10.1f\n", "FLASH1 data/NVR0, walk", Bench_Lookup(FLASH1_DATA_BASE, FLASH1_NVR0_BASE));
+    printf("%-28s %10.1f\n", "FLASH0 code, last region", Bench_Lookup(FLASH0_CODE_BASE, 0));
+}
+
+static void Timing_Set(const char *arg)
+{
+    SimTiming_t *t = Sim_Timing();
+    static const struct
+    {
+        const char *name;
+        size_t offset;
+    } fields[] =
+    {
+        { "reg_access",   offsetof(SimTiming_t, reg_access) },
+        { "command",      offsetof(SimTiming_t, command) },
+        { "program_word", offsetof(SimTiming_t, program_word) },
+        { "erase_pulse",  offsetof(SimTiming_t, erase_pulse) },
+        { "mass_erase",   offsetof(SimTiming_t, mass_erase) },
+        { "copy_word",    offsetof(SimTiming_t, copy_word) },
+        { "crc_word",     offsetof(SimTiming_t, crc_word) },
+        { "dma_word",     offsetof(SimTiming_t, dma_word) },
+    };
+    const char *eq = strchr(arg, '=');
+
+    for (unsigned int i = 0; eq != NULL && i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        if (strlen(fields[i].name) == (size_t)(eq - arg) &&
+            strncmp(arg, fields[i].name, eq - arg) == 0)
+        {
+            *(uint32_t *)((char *)t + fields[i].offset) = strtoul(eq + 1, NULL, 0);
+            return;
+        }
+    }
+    fprintf(stderr, "unknown latency: %s\n", arg);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    bool bench = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-b") == 0)
+        {
+            bench = true;
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            Timing_Set(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-b] [-t name=ns]...\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Sim_Init();
+    Test_Init();
+    if (bench)
+    {
+        Bench();
+        Bench_Lookups();
+        return 0;
+    }
+
+    Test_WriteRead();
+    Test_RowCrossing();
+    Test_CodeEndurance();
+    Test_Overprogram();
+    Test_Double();
+    Test_Copier();
+    Test_Crc();
+    Test_Async();
+
+    printf("flash_sim_test: %s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file hw.h
+ * @brief Host replacement of the device header, used to build the flash
+ *        library against the flash simulator
+ *
+ * Provides the register definitions and the hardware abstraction layer
+ * headers used by the flash library, without the Cortex-M33 core support
+ * which cannot be built on the host. The core intrinsics used by the
+ * library are provided by flash_sim.c.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef HW_H
+#define HW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* CMSIS qualifiers and inline keywords */
+#define __I                             volatile const
+#define __O                             volatile
+#define __IO                            volatile
+#define __IM                            volatile const
+#define __OM                            volatile
+#define __IOM                           volatile
+#define __STATIC_INLINE                 static inline
+#define __STATIC_FORCEINLINE            static inline __attribute__((always_inline))
+
+#include <montana_vectors.h>
+#include <montana_hw.h>
+#include <montana_map.h>
+
+/* Core intrinsics, see flash_sim.c */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+    uint32_t result = 0;
+    for (unsigned int i = 0; i < 32; i++, value >>= 1)
+    {
+        result = (result << 1) | (value & 0x1U);
+    }
+    return result;
+}
+
+#include <sassert.h>
+#include <crc.h>
+#include <dma.h>
+#include <flash_copier.h>
+
+#endif    /* HW_H */
@@ -65,6 +65,30 @@ extern "C" {
 #endif /* (SWM_TRACE_TYPE == SWM_TRACE_SEGGER_RTT_BLOCKING) */
 #endif /* (SWM_TRACE_TYPE == SWM_TRACE_SEGGER_RTT_NON_BLOCKING) */
 
+/**
+ * @brief Marker byte starting each binary log frame. As text output is
+ * plain ASCII, this allows the host to separate frames from text.
+ */
+#define SWM_LOG_BINARY_SYNC         0xA5U
+
+/**
+ * @brief Size of the binary log frame header: sync byte, level byte,
+ * payload length byte and the 32-bit format string address.
+ */
+#define SWM_LOG_BINARY_HEADER_SIZE  7U
+
+/**
+ * @brief Maximum size of a binary log frame, including the header. Arguments
+ * which do not fit are dropped and the frame is marked as truncated.
+ */
+#define SWM_LOG_BINARY_FRAME_SIZE   64U
+
+/**
+ * @brief Flag set in the level byte of a binary log frame when some of the
+ * arguments did not fit in the frame.
+ */
+#define SWM_LOG_BINARY_TRUNCATED    0x80U
+
 
 /**
  * @brief An internal initialization function, this is used to perform
@@ -82,6 +106,17 @@ extern "C" {
  */
 void swmTrace_internal_init(const uint32_t *configuration, uint32_t size);
 
+/**
+ * @brief Abstract function, provided by the specific implementation to
+ * output a block of raw bytes without any formatting.
+ * @param [in] data Pointer to the bytes to output.
+ * @param [in] len Number of bytes to output.
+ * @note
+ * This is used to send binary log frames, and needs to be provided when
+ * implementing a new logger.
+ */
+void swmTrace_write(const uint8_t *data, uint32_t len);
+
 #ifdef __cplusplus
     }
 #endif
@@ -33,6 +33,17 @@ void swmTrace_vprintf(const char *sFormat, va_list *pParamList)
     SEGGER_RTT_vprintf(0, sFormat, pParamList);
 }
 
+void swmTrace_write(const uint8_t *data, uint32_t len)
+{
+    SEGGER_RTT_Write(0, data, len);
+}
+
+bool swmTrace_getStats(swmTrace_stats_t *stats)
+{
+    // not implemented, no statistics collected
+    return false;
+}
+
 bool swmTrace_getch(char *ch)
 {
     // not implemented, return no data available
@@ -36,6 +36,17 @@ void swmTrace_vprintf(const char *sFormat, va_list *pParamList)
     vprintf(sFormat, *pParamList);
 }
 
+void swmTrace_write(const uint8_t *data, uint32_t len)
+{
+    fwrite(data, 1, len, stdout);
+}
+
+bool swmTrace_getStats(swmTrace_stats_t *stats)
+{
+    // not implemented, no statistics collected
+    return false;
+}
+
 bool swmTrace_getch(char *ch)
 {
     // not implemented, return no data available
@@ -18,6 +18,8 @@
  * @endparblock
  */
 
+#include <string.h>
+
 #include "swmTrace_int.h"
 
 /**
@@ -27,6 +29,19 @@
  */
 static uint32_t swmTrace_LogLevel = SWM_LOG_LEVEL_WARNING;
 
+/**
+ * @brief Defines the log level selected for each module, or 0 where the
+ * module uses swmTrace_LogLevel.
+ */
+static uint32_t swmTrace_ModuleLevel[SWM_LOG_MODULE_COUNT];
+
+/**
+ * @brief Flag indicating if log messages are sent as binary frames rather
+ * than formatted text. This can be configured during the logging
+ * initialization.
+ */
+static bool swmTrace_LogBinary = false;
+
 /**
  * @brief Helper method to mark the different log levels so they can be
  * easily identified at the trace target.
@@ -64,6 +79,193 @@ static void swmLogPrintMarker(uint32_t level)
     }
 }
 
+/**
+ * @brief Helper method to append an argument value to a binary log frame.
+ * @param frame The frame being built.
+ * @param len Pointer to the current frame length, updated on success.
+ * @param value Pointer to the value to append.
+ * @param size Size of the value in bytes.
+ * @return True if the value fitted in the frame; false otherwise.
+ */
+static bool swmLogAppend(uint8_t *frame, uint32_t *len, const void *value,
+                         uint32_t size)
+{
+    if ((*len + size) > SWM_LOG_BINARY_FRAME_SIZE)
+    {
+        return false;
+    }
+    memcpy(&frame[*len], value, size);
+    *len += size;
+    return true;
+}
+
+/**
+ * @brief Helper method to append a string argument, including its
+ * terminating zero, to a binary log frame. Strings that do not fit are cut
+ * short, and nothing is appended to a full frame.
+ * @param frame The frame being built.
+ * @param len Pointer to the current frame length, updated on return.
+ * @param str The string to append.
+ * @return True if the whole string fitted in the frame; false otherwise.
+ */
+static bool swmLogAppendString(uint8_t *frame, uint32_t *len, const char *str)
+{
+    if (*len >= SWM_LOG_BINARY_FRAME_SIZE)
+    {
+        return false;
+    }
+
+    if (str == NULL)
+    {
+        str = "(null)";
+    }
+
+    while (*len < (SWM_LOG_BINARY_FRAME_SIZE - 1))
+    {
+        frame[(*len)++] = *str;
+        if (*str++ == '\0')
+        {
+            return true;
+        }
+    }
+
+    frame[(*len)++] = '\0';
+    return false;
+}
+
+/**
+ * @brief Sends a log message as a binary frame.
+ * @details
+ * The frame holds the log level, the address of the format string and the
+ * raw argument values in the order they are consumed by the format string:
+ * 32-bit words for integers, characters and pointers, 64-bit words for
+ * long long integers and doubles, and zero terminated copies of strings.
+ * No formatting takes place on the target; the format string is only
+ * scanned to know the size of each argument.
+ * @param level The level of this log message.
+ * @param sFormat The format of the output string, as per printf.
+ * @param pParamList Pointer to the arguments of the message.
+ */
+static void swmLogBinary(uint32_t level, const char *sFormat,
+                         va_list *pParamList)
+{
+    uint8_t frame[SWM_LOG_BINARY_FRAME_SIZE];
+    uint32_t len = SWM_LOG_BINARY_HEADER_SIZE;
+    uint32_t address = (uint32_t) sFormat;
+    bool fits = true;
+    const char *fmt = sFormat;
+
+    while (fits && (*fmt != '\0'))
+    {
+        if (*fmt++ != '%')
+        {
+            continue;
+        }
+
+        /* Skip the flags */
+        while ((*fmt == '-') || (*fmt == '+') || (*fmt == ' ') ||
+               (*fmt == '#') || (*fmt == '0'))
+        {
+            fmt++;
+        }
+
+        /* Width and precision, either of which may be passed as argument */
+        for (uint32_t field = 0; field < 2; field++)
+        {
+            if (*fmt == '*')
+            {
+                int value = va_arg(*pParamList, int);
+                fits = fits && swmLogAppend(frame, &len, &value, sizeof(value));
+                fmt++;
+            }
+            while ((*fmt >= '0') && (*fmt <= '9'))
+            {
+                fmt++;
+            }
+            if ((field == 0) && (*fmt == '.'))
+            {
+                fmt++;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        /* Length modifiers, only the 64-bit ones change the argument size */
+        bool wide = false;
+        while ((*fmt == 'h') || (*fmt == 'l') || (*fmt == 'L') ||
+               (*fmt == 'j') || (*fmt == 'z') || (*fmt == 't'))
+        {
+            wide = wide || (*fmt == 'j') || ((*fmt == 'l') && (fmt[1] == 'l'));
+            fmt += ((*fmt == 'l') && (fmt[1] == 'l')) ? 2 : 1;
+        }
+
+        switch (*fmt++)
+        {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (wide)
+            {
+                long long value = va_arg(*pParamList, long long);
+                fits = fits && swmLogAppend(frame, &len, &value, sizeof(value));
+            }
+            else
+            {
+                int value = va_arg(*pParamList, int);
+                fits = fits && swmLogAppend(frame, &len, &value, sizeof(value));
+            }
+            break;
+        case 'p':
+        {
+            uint32_t value = (uint32_t) va_arg(*pParamList, void *);
+            fits = fits && swmLogAppend(frame, &len, &value, sizeof(value));
+            break;
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+        {
+            double value = va_arg(*pParamList, double);
+            fits = fits && swmLogAppend(frame, &len, &value, sizeof(value));
+            break;
+        }
+        case 's':
+            fits = fits && swmLogAppendString(frame, &len,
+                                              va_arg(*pParamList, const char *));
+            break;
+        case 'n':
+            (void) va_arg(*pParamList, void *);
+            break;
+        case '%':
+            break;
+        default:
+            /* Unknown conversion, the host stops decoding at the same point */
+            fmt--;
+            fits = (*fmt == '\0');
+            break;
+        }
+    }
+
+    frame[0] = SWM_LOG_BINARY_SYNC;
+    frame[1] = (uint8_t) (level - SWM_LOG_LEVEL_VERBOSE);
+    frame[1] |= fits ? 0 : SWM_LOG_BINARY_TRUNCATED;
+    frame[2] = (uint8_t) (len - SWM_LOG_BINARY_HEADER_SIZE);
+    memcpy(&frame[3], &address, sizeof(address));
+
+    swmTrace_write(frame, len);
+}
+
 void swmTrace_internal_init(const uint32_t *configuration, uint32_t size)
 {
     while (size-- > 0)
@@ -79,6 +281,12 @@ void swmTrace_internal_init(const uint32_t *configuration, uint32_t size)
         case SWM_LOG_TEST_FAIL:
             swmTrace_LogLevel = *configuration;
             break;
+        case SWM_LOG_FORMAT_TEXT:
+            swmTrace_LogBinary = false;
+            break;
+        case SWM_LOG_FORMAT_BINARY:
+            swmTrace_LogBinary = true;
+            break;
         default:
             // If we don't recognize an option, just ignore it
             break;
@@ -95,15 +303,59 @@ void swmTrace_printf(const char *sFormat, ...)
     va_end(args);
 }
 
+/**
+ * @brief Outputs a log message at the given level, in the selected format.
+ * @param level The level of this log message.
+ * @param sFormat The format of the output string, as per printf.
+ * @param pParamList Pointer to the arguments of the message.
+ */
+static void swmLogOutput(uint32_t level, const char *sFormat,
+                         va_list *pParamList)
+{
+    if (swmTrace_LogBinary)
+    {
+        swmLogBinary(level, sFormat, pParamList);
+    }
+    else
+    {
+        swmLogPrintMarker(level);
+        swmTrace_vprintf(sFormat, pParamList);
+    }
+}
+
 void swmLog(uint32_t level, const char *sFormat, ...)
 {
     if (level >= swmTrace_LogLevel)
     {
-        swmLogPrintMarker(level);
         va_list args;
         va_start(args, sFormat);
-        swmTrace_vprintf(sFormat, &args);
+        swmLogOutput(level, sFormat, &args);
+        va_end(args);
+    }
+}
+
+void swmLogModule(uint32_t module, uint32_t level, const char *sFormat, ...)
+{
+    uint32_t threshold = swmTrace_LogLevel;
+
+    if ((module < SWM_LOG_MODULE_COUNT) && (swmTrace_ModuleLevel[module] != 0))
+    {
+        threshold = swmTrace_ModuleLevel[module];
+    }
+
+    if (level >= threshold)
+    {
+        va_list args;
+        va_start(args, sFormat);
+        swmLogOutput(level, sFormat, &args);
         va_end(args);
     }
 }
 
+void swmTrace_setModuleLevel(uint32_t module, uint32_t level)
+{
+    if (module < SWM_LOG_MODULE_COUNT)
+    {
+        swmTrace_ModuleLevel[module] = level;
+    }
+}
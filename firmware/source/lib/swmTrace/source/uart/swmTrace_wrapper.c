@@ -60,22 +60,37 @@ void swmTrace_UART_init(bool enable_rx)
 /**
  * @brief Helper routine which sends the next character if it exists in
  * our trace queue.
+ * @details
+ * This runs with interrupts masked, so a producer discarding old messages
+ * cannot move the data while the next character is taken.
  * @note
  * When there are no more characters to be sent, this
  * clears the tx_in_progress flag.
  */
 void swmTrace_send(void)
 {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
     if (tx_r_ptr != tx_w_ptr)
     {
         char value = tx_buffer[tx_r_ptr];
         tx_r_ptr = swmTrace_next(tx_r_ptr, UART_TX_BUFFER_MASK);
+        tx_transfers++;
         UART[SWM_UART_SOURCE].TX_DATA = value;
     }
     else
     {
         tx_in_progress = false;
+
+        /* A producer may have committed data after the check above */
+        if (tx_r_ptr != tx_w_ptr)
+        {
+            swmTrace_start();
+        }
     }
+
+    __set_PRIMASK(primask);
 }
 
 #if SWM_UART_SOURCE == 0
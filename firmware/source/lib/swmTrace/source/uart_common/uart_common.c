@@ -39,12 +39,47 @@ volatile uint32_t tx_r_ptr;
 /** @brief Transmit write pointer */
 volatile uint32_t tx_w_ptr;
 
+/**
+ * @brief Transmit claim state: the index following the last reserved byte in
+ * the lower half word, and the number of producers which have reserved
+ * space but not yet committed it in the upper half word. Both are kept in one
+ * word so they are updated together with a single exclusive access.
+ */
+static volatile uint32_t tx_claim;
+
+/**
+ * @brief Number of bytes from tx_r_ptr handed to the transmitter and not yet
+ * sent.
+ */
+volatile uint32_t tx_in_flight;
+
+/** @brief Number of transfers handed to the transmitter */
+volatile uint32_t tx_transfers;
+
+/** @brief Number of bytes accepted into the transmit buffer */
+static volatile uint32_t tx_bytes_queued;
+
+/** @brief Number of bytes discarded because the transmit buffer was full */
+static volatile uint32_t tx_bytes_dropped;
+
+/** @brief Highest number of bytes held in the transmit buffer */
+static volatile uint32_t tx_high_water;
+
+/** @brief Selected transmit buffer overflow policy */
+static uint32_t tx_overflow_policy = SWM_UART_OVERFLOW_DROP_NEWEST;
+
 /** @brief Flag indicating if a transmission is in progress */
 volatile bool     tx_in_progress;
 
 /** @brief Buffer for messages being transmitted */
 char tx_buffer[UART_TX_BUFFER_SIZE];
 
+/**
+ * @brief One bit per transmit buffer byte, set where a message starts. Used
+ * to discard whole messages only.
+ */
+static volatile uint32_t tx_msg_start[UART_TX_BUFFER_SIZE / 32];
+
 /** @brief Receive read pointer */
 volatile uint32_t rx_r_ptr;
 
@@ -66,8 +101,15 @@ static void UART_common_init(int txpin, int rxpin)
     SYS_GPIO_CONFIG(txpin, (GPIO_MODE_DISABLE | GPIO_NO_PULL));
     tx_r_ptr = 0;
     tx_w_ptr = 0;
+    tx_claim = 0;
+    tx_in_flight = 0;
+    tx_transfers = 0;
+    tx_bytes_queued = 0;
+    tx_bytes_dropped = 0;
+    tx_high_water = 0;
     tx_in_progress = false;
     memset(tx_buffer, 0, UART_TX_BUFFER_SIZE);
+    memset((void *) tx_msg_start, 0, sizeof(tx_msg_start));
 
     /* configure RX */
     SYS_GPIO_CONFIG(rxpin, (GPIO_MODE_DISABLE | GPIO_NO_PULL));
@@ -113,6 +155,12 @@ void swmTrace_init(const uint32_t *configuration, uint32_t size)
         {
             use_rx = true;
         }
+        if ((*configuration == SWM_UART_OVERFLOW_DROP_NEWEST) ||
+            (*configuration == SWM_UART_OVERFLOW_DROP_OLDEST) ||
+            (*configuration == SWM_UART_OVERFLOW_BLOCK))
+        {
+            tx_overflow_policy = *configuration;
+        }
         configuration++;
     }
 
@@ -122,28 +170,315 @@ void swmTrace_init(const uint32_t *configuration, uint32_t size)
     UART[SWM_UART_SOURCE].CTRL = UART_ENABLE;
 }
 
-void swmTrace_vprintf(const char *sFormat, va_list *pParamList)
+/**
+ * @brief Atomically adds a value to one of the transmit statistics counters.
+ * @param counter Pointer to the counter.
+ * @param value Value to add.
+ */
+static void swmTrace_count(volatile uint32_t *counter, uint32_t value)
+{
+    uint32_t total;
+
+    do
+    {
+        total = __LDREXW(counter) + value;
+    } while (__STREXW(total, counter) != 0);
+}
+
+/**
+ * @brief Records the boundaries of a message in the transmit buffer.
+ * @details
+ * Sets the start bit of the first byte and clears those of the following
+ * bytes. Neighbouring messages may share a bitmap word, so each word is
+ * updated with an exclusive access.
+ * @param start Index of the first byte of the message.
+ * @param len Number of bytes of the message.
+ */
+static void swmTrace_markMessage(uint32_t start, uint32_t len)
+{
+    uint32_t index = start;
+
+    while (len > 0)
+    {
+        uint32_t bit = index & 31U;
+        uint32_t count = ((32U - bit) < len) ? (32U - bit) : len;
+        uint32_t mask = (count == 32U) ? 0xFFFFFFFFU :
+                        (((1U << count) - 1U) << bit);
+        uint32_t set = (index == start) ? (1U << bit) : 0;
+        uint32_t value;
+
+        do
+        {
+            value = (__LDREXW(&tx_msg_start[index >> 5]) & ~mask) | set;
+        } while (__STREXW(value, &tx_msg_start[index >> 5]) != 0);
+
+        len -= count;
+        index = (index + count) & UART_TX_BUFFER_MASK;
+    }
+}
+
+/**
+ * @brief Indicates if a message starts at a transmit buffer index.
+ * @param index Transmit buffer index.
+ * @return True if a message starts at index; false otherwise.
+ */
+static bool swmTrace_isMessageStart(uint32_t index)
+{
+    return ((tx_msg_start[index >> 5] >> (index & 31U)) & 1U) != 0;
+}
+
+/**
+ * @brief Reserves a contiguous range of the transmit buffer for a message.
+ * @details
+ * The reservation is made with an exclusive load/store pair, so any number of
+ * producers in thread and interrupt context can reserve space concurrently
+ * without locking. Each producer then fills its own range undisturbed.
+ * @param len Number of bytes to reserve.
+ * @param start Returns the index of the first reserved byte.
+ * @return True if the space was reserved; false if the buffer is too full.
+ */
+static bool swmTrace_reserve(uint32_t len, uint32_t *start)
+{
+    uint32_t claim;
+    uint32_t index;
+
+    do
+    {
+        claim = __LDREXW(&tx_claim);
+        index = claim & TX_CLAIM_INDEX_MASK;
+        if (len > ((tx_r_ptr - index - 1) & UART_TX_BUFFER_MASK))
+        {
+            __CLREX();
+            return false;
+        }
+        claim = (claim & ~TX_CLAIM_INDEX_MASK) + TX_CLAIM_WRITER;
+        claim |= (index + len) & UART_TX_BUFFER_MASK;
+    } while (__STREXW(claim, &tx_claim) != 0);
+
+    /* Track the highest fill level of the buffer */
+    uint32_t used = ((index + len) - tx_r_ptr) & UART_TX_BUFFER_MASK;
+    uint32_t high_water;
+    do
+    {
+        high_water = __LDREXW(&tx_high_water);
+        if (used <= high_water)
+        {
+            __CLREX();
+            break;
+        }
+    } while (__STREXW(used, &tx_high_water) != 0);
+
+    swmTrace_markMessage(index, len);
+
+    *start = index;
+    return true;
+}
+
+/**
+ * @brief Commits a range previously reserved with swmTrace_reserve.
+ * @details
+ * The write pointer seen by the transmitter is only moved when no other
+ * producer is still filling a range, so a producer interrupted half way
+ * through its message can never have a partly written message sent. The last
+ * producer to commit publishes all the ranges reserved so far.
+ */
+static void swmTrace_commit(void)
+{
+    uint32_t claim;
+
+    do
+    {
+        claim = __LDREXW(&tx_claim) - TX_CLAIM_WRITER;
+    } while (__STREXW(claim, &tx_claim) != 0);
+
+    /* Make sure the message is in memory before the DMA can see it */
+    __DMB();
+
+    do
+    {
+        (void) __LDREXW(&tx_w_ptr);
+        claim = tx_claim;
+        if ((claim & ~TX_CLAIM_INDEX_MASK) != 0)
+        {
+            /* An interrupted producer publishes when it commits */
+            __CLREX();
+            return;
+        }
+    } while (__STREXW(claim & TX_CLAIM_INDEX_MASK, &tx_w_ptr) != 0);
+}
+
+void swmTrace_start(void)
+{
+    do
+    {
+        if (__LDREXB((volatile uint8_t *) &tx_in_progress) != 0)
+        {
+            __CLREX();
+            return;
+        }
+    } while (__STREXB(1, (volatile uint8_t *) &tx_in_progress) != 0);
+
+    swmTrace_send();
+}
+
+/**
+ * @brief Discards the oldest unsent messages to make room for a new message.
+ * @details
+ * Data handed to the transmitter, and the rest of a message it has started
+ * to send, are kept. Whole messages queued behind them are discarded, and the
+ * newer messages are moved down over them, so the space freed joins the free
+ * end of the buffer. This runs with interrupts masked, as it moves data and
+ * pointers owned by the transmitter and the producers, and gives up while
+ * another producer is still filling a reserved range.
+ * @param len Number of bytes the new message needs.
+ * @return True if there is now room for the message; false otherwise.
+ */
+static bool swmTrace_dropOldest(uint32_t len)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t dropped = 0;
+    bool fits = false;
+
+    __disable_irq();
+    if (((tx_claim & ~TX_CLAIM_INDEX_MASK) == 0) && (len < UART_TX_BUFFER_SIZE))
+    {
+        uint32_t w_ptr = tx_claim & TX_CLAIM_INDEX_MASK;
+        uint32_t space = (tx_r_ptr - w_ptr - 1) & UART_TX_BUFFER_MASK;
+        uint32_t from = (tx_r_ptr + tx_in_flight) & UART_TX_BUFFER_MASK;
+        uint32_t to;
+
+        /* Skip to the first message not yet handed to the transmitter */
+        while ((from != w_ptr) && !swmTrace_isMessageStart(from))
+        {
+            from = swmTrace_next(from, UART_TX_BUFFER_MASK);
+        }
+
+        /* Take as few whole messages as needed */
+        to = from;
+        while (((space + dropped) < len) && (to != w_ptr))
+        {
+            do
+            {
+                to = swmTrace_next(to, UART_TX_BUFFER_MASK);
+            } while ((to != w_ptr) && !swmTrace_isMessageStart(to));
+            dropped = (to - from) & UART_TX_BUFFER_MASK;
+        }
+
+        fits = (len <= (space + dropped));
+        if (!fits)
+        {
+            dropped = 0;
+        }
+        else if (dropped != 0)
+        {
+            /* Move the newer messages down over the discarded ones */
+            while (to != w_ptr)
+            {
+                uint32_t bit = 1U << (from & 31U);
+
+                tx_buffer[from] = tx_buffer[to];
+                if (swmTrace_isMessageStart(to))
+                {
+                    tx_msg_start[from >> 5] |= bit;
+                }
+                else
+                {
+                    tx_msg_start[from >> 5] &= ~bit;
+                }
+                from = swmTrace_next(from, UART_TX_BUFFER_MASK);
+                to = swmTrace_next(to, UART_TX_BUFFER_MASK);
+            }
+            tx_claim = from;
+            tx_w_ptr = from;
+        }
+    }
+    __set_PRIMASK(primask);
+
+    if (dropped != 0)
+    {
+        swmTrace_count(&tx_bytes_dropped, dropped);
+    }
+    return fits;
+}
+
+/**
+ * @brief Handles a message which does not fit in the transmit buffer, as
+ * per the selected overflow policy.
+ * @param len Number of bytes the message needs.
+ * @return True if room may have been made, so the reservation should be
+ * attempted again; false if the message has to be discarded.
+ */
+static bool swmTrace_overflow(uint32_t len)
+{
+    switch (tx_overflow_policy)
+    {
+    case SWM_UART_OVERFLOW_DROP_OLDEST:
+        return swmTrace_dropOldest(len);
+
+    case SWM_UART_OVERFLOW_BLOCK:
+        /* Only wait where the transmitter can make progress */
+        if ((len >= UART_TX_BUFFER_SIZE) || (__get_IPSR() != 0) ||
+            (__get_PRIMASK() != 0))
+        {
+            return false;
+        }
+        swmTrace_start();
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void swmTrace_write(const uint8_t *data, uint32_t len)
 {
-    static char buffer[UART_TX_BUFFER_SIZE];
-    vsnprintf(buffer, UART_TX_BUFFER_SIZE - 1, sFormat, *pParamList);
+    uint32_t start;
 
-    char *ptr = buffer;
+    if (len == 0)
+    {
+        return;
+    }
 
-    while (*ptr != '\0')
+    while (!swmTrace_reserve(len, &start))
     {
-        uint32_t index = swmTrace_next(tx_w_ptr, UART_TX_BUFFER_MASK);
-        if (index != tx_r_ptr)
+        if (!swmTrace_overflow(len))
         {
-            tx_buffer[tx_w_ptr] = *ptr;
-            tx_w_ptr = index;
+            swmTrace_count(&tx_bytes_dropped, len);
+            return;
         }
-        ptr++;
     }
 
-    if (! tx_in_progress)
+    /* Copy in at most two segments, splitting at the end of the buffer */
+    uint32_t first = UART_TX_BUFFER_SIZE - start;
+    if (first >= len)
     {
-        tx_in_progress = true;
-        swmTrace_send();
+        memcpy(&tx_buffer[start], data, len);
+    }
+    else
+    {
+        memcpy(&tx_buffer[start], data, first);
+        memcpy(&tx_buffer[0], &data[first], len - first);
+    }
+
+    swmTrace_commit();
+    swmTrace_count(&tx_bytes_queued, len);
+    swmTrace_start();
+}
+
+void swmTrace_vprintf(const char *sFormat, va_list *pParamList)
+{
+    /* On the stack, as this can be interrupted by another producer */
+    char buffer[UART_TX_LINE_SIZE];
+    int len = vsnprintf(buffer, UART_TX_LINE_SIZE, sFormat, *pParamList);
+
+    if (len > (int) (UART_TX_LINE_SIZE - 1))
+    {
+        len = UART_TX_LINE_SIZE - 1;
+    }
+
+    if (len > 0)
+    {
+        swmTrace_write((const uint8_t *) buffer, (uint32_t) len);
     }
 }
 
@@ -169,6 +504,15 @@ bool swmTrace_txInProgress(void)
     return tx_in_progress;
 }
 
+bool swmTrace_getStats(swmTrace_stats_t *stats)
+{
+    stats->bytes_queued = tx_bytes_queued;
+    stats->bytes_dropped = tx_bytes_dropped;
+    stats->high_water = tx_high_water;
+    stats->transfers = tx_transfers;
+    return true;
+}
+
 #if SWM_UART_SOURCE == 0
 /**
  * @brief Interrupt Service Routine for the UART0 RX. This is invoked on
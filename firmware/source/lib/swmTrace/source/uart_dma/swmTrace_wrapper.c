@@ -103,19 +103,30 @@ void swmTrace_UART_init(bool enable_rx)
  * @details
  * In cases where the range of characters to be sent wraps round the end of
  * the circular buffer, the transaction will be split into two operations.
+ * The characters stay in the queue, accounted in tx_in_flight, until the DMA
+ * has completed, so they cannot be overwritten while being sent.
+ * The transfer is set up with interrupts masked, so a producer discarding
+ * old messages cannot move the data between the pointers being read and the
+ * DMA being started.
  * @note
  * When there are no more characters to be sent, this will
  * clear the tx_in_progress flag.
  */
 void swmTrace_send(void)
 {
-    if (tx_r_ptr != tx_w_ptr)
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t w_ptr = tx_w_ptr;
+
+    if (tx_r_ptr != w_ptr)
     {
-        uint32_t count = (tx_w_ptr > tx_r_ptr) ? tx_w_ptr : UART_TX_BUFFER_SIZE;
+        uint32_t count = (w_ptr > tx_r_ptr) ? w_ptr : UART_TX_BUFFER_SIZE;
         count -= tx_r_ptr;
 
         uint32_t start = (uint32_t) &tx_buffer[tx_r_ptr];
-        tx_r_ptr = (tx_r_ptr + count) & UART_TX_BUFFER_MASK;
+        tx_in_flight = count;
+        tx_transfers++;
 
         /* Clear buffer and counter, re-enable TX DMA for next transmission */
         DMA[SWM_DMA_SOURCE].SRC_ADDR = start;
@@ -126,7 +137,15 @@ void swmTrace_send(void)
     else
     {
         tx_in_progress = false;
+
+        /* A producer may have committed data after the check above */
+        if (tx_r_ptr != tx_w_ptr)
+        {
+            swmTrace_start();
+        }
     }
+
+    __set_PRIMASK(primask);
 }
 
 /**
@@ -139,6 +158,10 @@ static void send_dma(void)
         // Clear interrupt flag
         DMA[SWM_DMA_SOURCE].STATUS = DMA_COMPLETE_INT_CLEAR;
 
+        // Release the characters which have been sent
+        tx_r_ptr = (tx_r_ptr + tx_in_flight) & UART_TX_BUFFER_MASK;
+        tx_in_flight = 0;
+
         // Check if any more data should be sent
         swmTrace_send();
     }
@@ -0,0 +1,80 @@
+/**
+ * @file hw.h
+ * @brief Host replacement of the device header, used to build the swmTrace
+ *        UART backend against the interrupt model of swmTrace_ring_test.c
+ *
+ * Provides the register definitions and the hardware abstraction layer
+ * headers used by the backend, without the Cortex-M33 core support which
+ * cannot be built on the host. The peripherals used by the backend are
+ * mapped to variables of the test, and the core intrinsics, including the
+ * exclusive accesses, are provided by swmTrace_ring_test.c.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef HW_H
+#define HW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* CMSIS qualifiers and inline keywords */
+#define __I                             volatile const
+#define __O                             volatile
+#define __IO                            volatile
+#define __IM                            volatile const
+#define __OM                            volatile
+#define __IOM                           volatile
+#define __STATIC_INLINE                 static inline
+#define __STATIC_FORCEINLINE            static inline __attribute__((always_inline))
+
+#include <montana_vectors.h>
+#include <montana_hw.h>
+#include <montana_map.h>
+
+/* Peripherals of the test */
+extern UART_Type sim_uart[2];
+extern GPIO_Type sim_gpio;
+extern CLK_Type sim_clk;
+
+#undef UART
+#undef GPIO
+#undef CLK
+#define UART                            (&sim_uart[0])
+#define GPIO                            (&sim_gpio)
+#define CLK                             (&sim_clk)
+
+extern uint32_t SystemCoreClock;
+
+/* Core intrinsics, see swmTrace_ring_test.c */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+uint32_t __get_IPSR(void);
+uint32_t __LDREXW(volatile uint32_t *addr);
+uint32_t __STREXW(uint32_t value, volatile uint32_t *addr);
+uint8_t __LDREXB(volatile uint8_t *addr);
+uint32_t __STREXB(uint8_t value, volatile uint8_t *addr);
+void __CLREX(void);
+void __DMB(void);
+void NVIC_EnableIRQ(IRQn_Type irq);
+
+/* GPIO pads, see montana.h */
+#define GPIO_PAD_COUNT                  16
+
+#include <sassert.h>
+#include <gpio.h>
+#include <uart.h>
+
+#endif    /* HW_H */
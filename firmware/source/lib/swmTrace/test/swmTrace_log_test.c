@@ -0,0 +1,281 @@
+/**
+ * @file swmTrace_log_test.c
+ * @brief Host test and benchmark of the binary log mode of swmTrace
+ *
+ * Usage: swmTrace_log_test FRAMES EXPECTED
+ *        swmTrace_log_test -b
+ *   FRAMES       file receiving the binary log frames of the cases
+ *   EXPECTED     file receiving the text the frames have to decode to
+ *   -b           print the cost per call and the bytes per message of the
+ *                text and binary log modes
+ *
+ * swmTrace.c is built against a backend which captures its output, and
+ * formats text the same way as uart_common.c. Each case logs a message in
+ * the text mode, then in the binary mode. The frames are checked here, and
+ * make check decodes them with swmTrace_decode.py and compares the result
+ * with the text, which includes messages too long for a frame.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "swmTrace_int.h"
+
+/** Longest formatted message, as UART_TX_LINE_SIZE in uart_common.h */
+#define TEST_LINE_SIZE                  256
+
+/** Size of the output capture */
+#define TEST_OUT_SIZE                   1024
+
+/** Number of calls of each benchmarked message */
+#define BENCH_CALLS                     200000
+
+static unsigned int failures;
+
+#define CHECK(expr)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(expr))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+/* Output of the backend */
+static uint8_t out[TEST_OUT_SIZE];
+static uint32_t out_len;
+static uint32_t out_writes;
+
+/* Outputs of the cases */
+static FILE *frames;
+static FILE *expected;
+
+void swmTrace_write(const uint8_t *data, uint32_t len)
+{
+    if ((out_len + len) <= TEST_OUT_SIZE)
+    {
+        memcpy(&out[out_len], data, len);
+    }
+    out_len += len;
+    out_writes++;
+}
+
+void swmTrace_vprintf(const char *sFormat, va_list *pParamList)
+{
+    char buffer[TEST_LINE_SIZE];
+    int len = vsnprintf(buffer, TEST_LINE_SIZE, sFormat, *pParamList);
+
+    if (len > (int) (TEST_LINE_SIZE - 1))
+    {
+        len = TEST_LINE_SIZE - 1;
+    }
+
+    if (len > 0)
+    {
+        swmTrace_write((const uint8_t *) buffer, (uint32_t) len);
+    }
+}
+
+void swmTrace_init(const uint32_t *configuration, uint32_t size)
+{
+    swmTrace_internal_init(configuration, size);
+}
+
+static void Test_Mode(uint32_t format)
+{
+    const uint32_t options[] = { SWM_LOG_LEVEL_VERBOSE, format };
+
+    swmTrace_init(options, sizeof(options) / sizeof(options[0]));
+    out_len = 0;
+    out_writes = 0;
+}
+
+/**
+ * Records the text output of a case, or the given text where the message
+ * does not fit in a frame, as that is all the host can rebuild.
+ */
+static void Test_Text(const char *text)
+{
+    CHECK(out_len < TEST_OUT_SIZE);
+    if (text != NULL)
+    {
+        fputs(text, expected);
+    }
+    else
+    {
+        fwrite(out, 1, out_len, expected);
+    }
+}
+
+/** Checks the binary frame of a case and records it */
+static void Test_Frame(const char *format, bool truncated, int line)
+{
+    uint32_t address;
+
+    memcpy(&address, &out[3], sizeof(address));
+    if ((out_writes != 1) || (out_len > SWM_LOG_BINARY_FRAME_SIZE) ||
+        (out[0] != SWM_LOG_BINARY_SYNC) ||
+        (out[2] != (out_len - SWM_LOG_BINARY_HEADER_SIZE)) ||
+        (address != (uint32_t) (uintptr_t) format) ||
+        ((out[1] & SWM_LOG_BINARY_TRUNCATED) != (truncated ? SWM_LOG_BINARY_TRUNCATED : 0)))
+    {
+        printf("%s:%d: bad frame for \"%s\" (%u bytes in %u writes)\n",
+               __FILE__, line, format, out_len, out_writes);
+        failures++;
+        return;
+    }
+    fwrite(out, 1, out_len, frames);
+}
+
+/**
+ * Logs a message in both modes. For messages which do not fit in a frame,
+ * text is what the host rebuilds from the frame, and NULL otherwise.
+ */
+#define TEST_CASE(text, format, ...)                                          \
+    do                                                                        \
+    {                                                                         \
+        static const char fmt[] = format;                                     \
+        Test_Mode(SWM_LOG_FORMAT_TEXT);                                       \
+        swmLog(SWM_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__);                       \
+        Test_Text(text);                                                      \
+        Test_Mode(SWM_LOG_FORMAT_BINARY);                                     \
+        swmLog(SWM_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__);                       \
+        Test_Frame(fmt, (text) != NULL, __LINE__);                            \
+    } while (0)
+
+static void Test_Conversions(void)
+{
+    TEST_CASE(NULL, "No arguments\n");
+    TEST_CASE(NULL, "%d %i %u %x %X %o\n", -5, 42, 3000000000U, 0xBEEF, 0xBEEF, 8);
+    TEST_CASE(NULL, "%hd %hhu %c%c%c\n", (short) -2, (unsigned char) 200, 'a', 'b', 'c');
+    TEST_CASE(NULL, "%lld %llu %llx\n", -1234567890123LL, 18446744073709551615ULL,
+              0x123456789ABCDEFULL);
+    TEST_CASE(NULL, "[%5d|%-5d|%05d|%#x|%+d|% d]\n", 42, 42, 42, 255, 7, 7);
+    TEST_CASE(NULL, "%*d|%-*d|%.*f\n", 6, 12, 4, 3, 2, 3.14159);
+    TEST_CASE(NULL, "%f %e %g %.2f %E %G\n", 1.5, -12345.678, 0.0001, 2.005, 6.02e23, 1e-10);
+    TEST_CASE(NULL, "%s and %s, %.3s\n", "one", "two", "three");
+    TEST_CASE(NULL, "%s\n", (const char *) NULL);
+    TEST_CASE(NULL, "100%% done\n");
+    TEST_CASE(NULL, "Empty string: '%s'\n", "");
+}
+
+static void Test_Truncation(void)
+{
+    static const char s52[] = "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
+    static const char s55[] = "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAACCC";
+    static const char s100[] = "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB"
+                               "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB";
+
+    /* The integer fills the frame, and the second string must not be
+     * appended past its end */
+    TEST_CASE("-I-AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA7 <truncated>\n",
+              "%s%d%s\n", s52, 7, "tail");
+    CHECK(out_len == SWM_LOG_BINARY_FRAME_SIZE);
+
+    /* A string ending one byte short of the frame end is cut to an empty
+     * one */
+    TEST_CASE("-I-AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAACCC <truncated>\n",
+              "%s%s\n", s55, "tail");
+    CHECK(out_len == SWM_LOG_BINARY_FRAME_SIZE);
+    CHECK(out[SWM_LOG_BINARY_FRAME_SIZE - 1] == '\0');
+
+    /* A long string is cut short and stays terminated */
+    TEST_CASE("-I-BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB <truncated>\n",
+              "%s\n", s100);
+    CHECK(out_len == SWM_LOG_BINARY_FRAME_SIZE);
+    CHECK(out[SWM_LOG_BINARY_FRAME_SIZE - 1] == '\0');
+
+    /* Arguments which do not fit are dropped whole */
+    TEST_CASE("-I-1 2 3 4 5 6 7 8 9 10 11 12 13 14  <truncated>\n",
+              "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n",
+              1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    CHECK(out_len == (SWM_LOG_BINARY_HEADER_SIZE + (14 * sizeof(int))));
+    TEST_CASE("-I-1.5 2.5 3.5 4.5 5.5 6.5 7.5  <truncated>\n",
+              "%g %g %g %g %g %g %g %g\n", 1.5, 2.5, 3.5, 4.5, 5.5, 6.5, 7.5, 8.5);
+}
+
+/** Returns the average cost of a call of a log macro, in ns */
+#define BENCH_CALL(format, ...)                                               \
+    ({                                                                        \
+        struct timespec start, end;                                           \
+        clock_gettime(CLOCK_MONOTONIC, &start);                               \
+        for (unsigned int i = 0; i < BENCH_CALLS; i++)                        \
+        {                                                                     \
+            out_len = 0;                                                      \
+            swmLog(SWM_LOG_LEVEL_INFO, format, ##__VA_ARGS__);                \
+        }                                                                     \
+        clock_gettime(CLOCK_MONOTONIC, &end);                                 \
+        ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / \
+        BENCH_CALLS;                                                          \
+    })
+
+#define BENCH_MESSAGE(name, format, ...)                                      \
+    do                                                                        \
+    {                                                                         \
+        Test_Mode(SWM_LOG_FORMAT_TEXT);                                       \
+        double text_ns = BENCH_CALL(format, ##__VA_ARGS__);                   \
+        uint32_t text_bytes = out_len;                                        \
+        Test_Mode(SWM_LOG_FORMAT_BINARY);                                     \
+        double binary_ns = BENCH_CALL(format, ##__VA_ARGS__);                 \
+        uint32_t binary_bytes = out_len;                                      \
+        printf("%-12s %10.1f %10.1f %8u %8u\n", name, text_ns, binary_ns,    \
+               text_bytes, binary_bytes);                                     \
+    } while (0)
+
+static void Bench(void)
+{
+    printf("%-12s %10s %10s %8s %8s\n", "message", "text ns", "binary ns",
+           "text B", "binary B");
+    BENCH_MESSAGE("constant", "Advertising started\n");
+    BENCH_MESSAGE("integers", "Connection %d: interval %u, latency %u, timeout %u\n",
+                  1, 24, 0, 400);
+    BENCH_MESSAGE("hex", "GATT write handle 0x%04x, length %d, status 0x%02x\n",
+                  0x2A, 20, 0);
+    BENCH_MESSAGE("string", "Device name %s, RSSI %d dBm\n", "ble_peripheral", -67);
+    BENCH_MESSAGE("double", "Battery %.2f V, temperature %.1f C\n", 3.05, 24.5);
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc == 2) && (strcmp(argv[1], "-b") == 0))
+    {
+        Bench();
+        return 0;
+    }
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s FRAMES EXPECTED | -b\n", argv[0]);
+        return 2;
+    }
+
+    frames = fopen(argv[1], "wb");
+    expected = fopen(argv[2], "wb");
+    if ((frames == NULL) || (expected == NULL))
+    {
+        perror(argv[0]);
+        return 2;
+    }
+
+    Test_Conversions();
+    Test_Truncation();
+
+    fclose(frames);
+    fclose(expected);
+
+    printf("swmTrace_log_test: %s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,596 @@
+/**
+ * @file swmTrace_ring_test.c
+ * @brief Host stress test of the swmTrace UART transmit ring with
+ *        preempting producers
+ *
+ * Usage: swmTrace_ring_test [-n messages] [-s seed]
+ *   -n messages  number of messages sent by each producer (default 5000)
+ *   -s seed      seed of the interrupt delays
+ *
+ * uart_common.c and the UART backend run on the main thread of the test,
+ * which models a single Cortex-M33 core: the signals of three timers, each
+ * restarted with a random delay, are its interrupts. A producer at a low
+ * and a high interrupt priority, and the UART TX interrupt, preempt the
+ * thread producer and each other as per their priorities. An interrupt is
+ * also taken at random before the exclusive accesses and barriers of the
+ * ring, where preemption matters most. PRIMASK masks the signals, and
+ * interrupt entry and return clear the exclusive monitor.
+ *
+ * Each producer sends numbered messages of varying length; the thread
+ * producer formats them with swmTrace_printf. The bytes written to the
+ * UART are checked to be whole messages, in order for each producer and
+ * without duplicates. In the first run the producers only send messages
+ * the buffer has room for, and none may be lost. In the next runs they
+ * send as fast as they can with each overflow policy, and messages may only
+ * be dropped whole. The transmit statistics have to account for each byte
+ * dropped, and the thread producer loses none with the blocking policy.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hw.h"
+#include "swmTrace_int.h"
+#include "uart_common.h"
+
+/** Interrupts, in increasing priority order */
+#define IRQ_LOW                         0
+#define IRQ_TX                          1
+#define IRQ_HIGH                        2
+#define IRQ_NUM                         3
+
+/** Producers: thread, low and high priority interrupts */
+#define PRODUCER_NUM                    3
+
+/** Longest padding of a message */
+#define MSG_PAD_MAX                     40
+
+/** Longest message: producer, 6 digit number, padding and new line */
+#define MSG_MAX                         (1 + 6 + MSG_PAD_MAX + 1)
+
+/** Bytes sent by the UART per TX interrupt signal */
+#define TX_BYTES_PER_IRQ                4
+
+/** Value of TX_DATA while no byte is being sent */
+#define TX_IDLE                         0xFFFFFFFFU
+
+UART_Type sim_uart[2];
+GPIO_Type sim_gpio;
+CLK_Type sim_clk;
+uint32_t SystemCoreClock = 16000000;
+
+void UART0_TX_IRQHandler(void);
+
+static unsigned int failures;
+
+#define CHECK(expr)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(expr))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);   \
+            failures++;                                                       \
+        }                                                                     \
+    } while (0)
+
+static const char names[PRODUCER_NUM] = { 'T', 'L', 'H' };
+static const char pads[PRODUCER_NUM][MSG_PAD_MAX + 1] = {
+    "tttttttttttttttttttttttttttttttttttttttt",
+    "llllllllllllllllllllllllllllllllllllllll",
+    "hhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhhh"
+};
+
+/** Signals of the interrupts */
+static const int irq_signal[IRQ_NUM] = { SIGUSR1, SIGALRM, SIGUSR2 };
+
+/** Longest delay between two requests of each interrupt, in ns */
+static const long irq_delay[IRQ_NUM] = { 30000, 8000, 60000 };
+
+/* Core */
+static sigset_t irq_signals;
+static sigset_t irq_unmasked;
+static volatile uint32_t primask;
+static volatile uint32_t ipsr;
+static volatile bool excl_valid;
+static volatile uintptr_t excl_addr;
+static volatile uint32_t excl_value;
+
+/* Interrupt sources */
+static timer_t irq_timer[IRQ_NUM];
+static unsigned int irq_seed[IRQ_NUM];
+static volatile bool irq_stop = true;
+static unsigned int irq_preempt_seed;
+static unsigned int seed;
+
+/* Producers */
+static volatile bool paced;
+static uint32_t overflow_policy;
+static uint32_t limit;
+static volatile uint32_t produced[PRODUCER_NUM];
+static volatile uint32_t claimed;
+static volatile uint32_t irq_count;
+static volatile uint32_t irq_nested;
+
+/* Line */
+static char *line;
+static uint32_t line_size;
+static volatile uint32_t line_len;
+
+uint32_t __get_PRIMASK(void)
+{
+    return primask;
+}
+
+void __disable_irq(void)
+{
+    if (primask == 0)
+    {
+        sigset_t previous;
+
+        sigprocmask(SIG_BLOCK, &irq_signals, &previous);
+        irq_unmasked = previous;
+        primask = 1;
+    }
+}
+
+void __set_PRIMASK(uint32_t value)
+{
+    if (value != 0)
+    {
+        __disable_irq();
+    }
+    else if (primask != 0)
+    {
+        primask = 0;
+        sigprocmask(SIG_SETMASK, &irq_unmasked, NULL);
+    }
+}
+
+uint32_t __get_IPSR(void)
+{
+    return ipsr;
+}
+
+/** Takes an interrupt at random, before an exclusive access or a barrier */
+static void Test_Preempt(void)
+{
+    uint32_t r = (uint32_t) rand_r(&irq_preempt_seed);
+
+    if (!irq_stop && ((r & 3U) == 0))
+    {
+        raise(irq_signal[(r >> 2) % IRQ_NUM]);
+    }
+}
+
+/*
+ * The exclusive monitor is cleared on interrupt entry and return. A store
+ * which overlaps an interrupt checks the value loaded, as the store itself
+ * can be interrupted on the host.
+ */
+uint32_t __LDREXW(volatile uint32_t *addr)
+{
+    uint32_t value;
+
+    Test_Preempt();
+    value = *addr;
+
+    excl_addr = (uintptr_t) addr;
+    excl_value = value;
+    excl_valid = true;
+    return value;
+}
+
+uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+    Test_Preempt();
+
+    uintptr_t monitored = excl_addr;
+    uint32_t expected = excl_value;
+    bool valid = excl_valid;
+
+    excl_valid = false;
+    if (!valid || (monitored != (uintptr_t) addr))
+    {
+        return 1;
+    }
+    return __atomic_compare_exchange_n(addr, &expected, value, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? 0 : 1;
+}
+
+uint8_t __LDREXB(volatile uint8_t *addr)
+{
+    uint8_t value;
+
+    Test_Preempt();
+    value = *addr;
+
+    excl_addr = (uintptr_t) addr;
+    excl_value = value;
+    excl_valid = true;
+    return value;
+}
+
+uint32_t __STREXB(uint8_t value, volatile uint8_t *addr)
+{
+    Test_Preempt();
+
+    uintptr_t monitored = excl_addr;
+    uint8_t expected = (uint8_t) excl_value;
+    bool valid = excl_valid;
+
+    excl_valid = false;
+    if (!valid || (monitored != (uintptr_t) addr))
+    {
+        return 1;
+    }
+    return __atomic_compare_exchange_n(addr, &expected, value, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? 0 : 1;
+}
+
+void __CLREX(void)
+{
+    Test_Preempt();
+    excl_valid = false;
+}
+
+void __DMB(void)
+{
+    Test_Preempt();
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+    (void)irq;
+}
+
+/** Builds message seq of a producer, returns its length */
+static uint32_t Test_Message(uint32_t producer, uint32_t seq, char *msg)
+{
+    uint32_t pad = ((seq * 7U) + (producer * 13U)) % (MSG_PAD_MAX + 1U);
+    uint32_t len = 0;
+
+    msg[len++] = names[producer];
+    for (uint32_t digit = 100000; digit > 0; digit /= 10)
+    {
+        msg[len++] = (char) ('0' + ((seq / digit) % 10U));
+    }
+    memcpy(&msg[len], pads[producer], pad);
+    len += pad;
+    msg[len++] = '\n';
+    return len;
+}
+
+/**
+ * In the paced run, claims room in the transmit buffer for a message. The
+ * bytes claimed and not yet sent are at least the bytes held in the buffer,
+ * including those reserved by interrupted producers.
+ */
+static bool Test_Claim(uint32_t len)
+{
+    uint32_t bytes = claimed;
+
+    do
+    {
+        if (((bytes - line_len) + len) > UART_TX_BUFFER_MASK)
+        {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&claimed, &bytes, bytes + len, false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+    return true;
+}
+
+/** Sends the next message of an interrupt producer */
+static void Test_IrqProduce(uint32_t producer)
+{
+    char msg[MSG_MAX];
+    uint32_t seq = produced[producer];
+    uint32_t len;
+
+    if (seq >= limit)
+    {
+        return;
+    }
+    len = Test_Message(producer, seq, msg);
+    if (paced && !Test_Claim(len))
+    {
+        return;
+    }
+    produced[producer] = seq + 1;
+    swmTrace_write((const uint8_t *) msg, len);
+}
+
+/** Completes the bytes being sent by the UART */
+static void Test_IrqTx(void)
+{
+    for (uint32_t i = 0; (i < TX_BYTES_PER_IRQ) && (UART->TX_DATA != TX_IDLE); i++)
+    {
+        if (line_len < line_size)
+        {
+            line[line_len] = (char) UART->TX_DATA;
+        }
+        line_len++;
+        UART->TX_DATA = TX_IDLE;
+        UART0_TX_IRQHandler();
+    }
+}
+
+/** Requests an interrupt after a random delay */
+static void Test_IrqArm(uint32_t irq)
+{
+    struct itimerspec when = { 0 };
+
+    when.it_value.tv_nsec = 1000 + (rand_r(&irq_seed[irq]) % irq_delay[irq]);
+    timer_settime(irq_timer[irq], 0, &when, NULL);
+}
+
+static void Test_Irq(int sig)
+{
+    uint32_t preempted = ipsr;
+    uint32_t irq = IRQ_LOW;
+
+    while (irq_signal[irq] != sig)
+    {
+        irq++;
+    }
+
+    irq_count++;
+    irq_nested += (preempted != 0) ? 1 : 0;
+    excl_valid = false;
+    switch (irq)
+    {
+    case IRQ_LOW:
+        ipsr = 16 + TIMER0_IRQn;
+        Test_IrqProduce(1);
+        break;
+    case IRQ_TX:
+        ipsr = 16 + UART0_TX_IRQn;
+        Test_IrqTx();
+        break;
+    default:
+        ipsr = 16 + TIMER1_IRQn;
+        Test_IrqProduce(2);
+        break;
+    }
+    ipsr = preempted;
+    excl_valid = false;
+
+    if (!irq_stop)
+    {
+        Test_IrqArm(irq);
+    }
+}
+
+static void Test_Init(void)
+{
+    struct sigaction action;
+
+    sigemptyset(&irq_signals);
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = Test_Irq;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    /* Each interrupt masks itself and the lower priorities */
+    for (uint32_t irq = IRQ_LOW; irq < IRQ_NUM; irq++)
+    {
+        struct sigevent event = { 0 };
+
+        sigaddset(&irq_signals, irq_signal[irq]);
+        sigaddset(&action.sa_mask, irq_signal[irq]);
+        sigaction(irq_signal[irq], &action, NULL);
+
+        event.sigev_notify = SIGEV_SIGNAL;
+        event.sigev_signo = irq_signal[irq];
+        timer_create(CLOCK_MONOTONIC, &event, &irq_timer[irq]);
+        irq_seed[irq] = seed + irq;
+    }
+    irq_preempt_seed = seed;
+
+    line_size = PRODUCER_NUM * limit * MSG_MAX;
+    line = malloc(line_size);
+}
+
+/** Runs the producers until they have all sent their messages */
+static double Test_Run(bool pace, uint32_t policy)
+{
+    const uint32_t options[] = { SWM_UART_TX_PIN | 6, SWM_UART_RX_PIN | 5, policy };
+    struct timespec start, end;
+
+    swmTrace_init(options, sizeof(options) / sizeof(options[0]));
+    UART->TX_DATA = TX_IDLE;
+    memset((void *) produced, 0, sizeof(produced));
+    line_len = 0;
+    claimed = 0;
+    irq_count = 0;
+    irq_nested = 0;
+    paced = pace;
+    overflow_policy = policy;
+    irq_stop = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t irq = IRQ_LOW; irq < IRQ_NUM; irq++)
+    {
+        Test_IrqArm(irq);
+    }
+    while (produced[0] < limit)
+    {
+        char msg[MSG_MAX];
+        uint32_t seq = produced[0];
+        uint32_t len = Test_Message(0, seq, msg);
+
+        if (paced && !Test_Claim(len))
+        {
+            continue;
+        }
+        produced[0] = seq + 1;
+        swmTrace_printf("%c%06u%.*s\n", names[0], (unsigned int) seq,
+                        (int) (len - 8), pads[0]);
+    }
+
+    /* Let the interrupt producers finish, then the UART */
+    while ((produced[1] < limit) || (produced[2] < limit) ||
+           tx_in_progress || (tx_r_ptr != tx_w_ptr))
+    {
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    irq_stop = true;
+    for (uint32_t irq = IRQ_LOW; irq < IRQ_NUM; irq++)
+    {
+        struct itimerspec never = { 0 };
+
+        timer_settime(irq_timer[irq], 0, &never, NULL);
+    }
+
+    return (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+/**
+ * Checks the line holds whole messages, in order for each producer, and
+ * that the statistics account for the messages lost
+ */
+static void Test_Check(const char *name, bool lossless, double seconds)
+{
+    uint32_t next[PRODUCER_NUM] = { 0 };
+    uint32_t lost[PRODUCER_NUM] = { 0 };
+    uint32_t lost_num = 0;
+    uint32_t lost_bytes = 0;
+    uint32_t received = 0;
+    uint32_t pos = 0;
+    swmTrace_stats_t stats;
+
+    CHECK(line_len <= line_size);
+    while ((pos < line_len) && (line_len <= line_size))
+    {
+        char msg[MSG_MAX];
+        uint32_t producer = 0;
+        uint32_t seq = 0;
+        uint32_t len;
+
+        while ((producer < PRODUCER_NUM) && (names[producer] != line[pos]))
+        {
+            producer++;
+        }
+        for (uint32_t i = 1; (i <= 6) && ((pos + i) < line_len); i++)
+        {
+            seq = (seq * 10U) + (uint32_t) (line[pos + i] - '0');
+        }
+        if ((producer == PRODUCER_NUM) || (seq >= limit))
+        {
+            printf("%s: unexpected bytes at %u\n", name, pos);
+            failures++;
+            return;
+        }
+
+        len = Test_Message(producer, seq, msg);
+        if (((pos + len) > line_len) || (memcmp(&line[pos], msg, len) != 0))
+        {
+            printf("%s: torn message %c%06u at %u\n", name, names[producer], seq, pos);
+            failures++;
+            return;
+        }
+        if (seq < next[producer])
+        {
+            printf("%s: message %c%06u after %c%06u\n", name, names[producer], seq,
+                   names[producer], next[producer] - 1);
+            failures++;
+            return;
+        }
+
+        lost[producer] += seq - next[producer];
+        while (next[producer] < seq)
+        {
+            lost_bytes += Test_Message(producer, next[producer]++, msg);
+        }
+        next[producer] = seq + 1;
+        received++;
+        pos += len;
+    }
+
+    for (uint32_t producer = 0; producer < PRODUCER_NUM; producer++)
+    {
+        char msg[MSG_MAX];
+
+        lost[producer] += produced[producer] - next[producer];
+        while (next[producer] < produced[producer])
+        {
+            lost_bytes += Test_Message(producer, next[producer]++, msg);
+        }
+        lost_num += lost[producer];
+    }
+    if (lossless)
+    {
+        CHECK(lost_num == 0);
+    }
+    if (overflow_policy == SWM_UART_OVERFLOW_BLOCK)
+    {
+        CHECK(lost[0] == 0);
+    }
+
+    CHECK(swmTrace_getStats(&stats));
+    CHECK(stats.bytes_dropped == lost_bytes);
+    CHECK(stats.transfers == line_len);
+    CHECK(stats.high_water < UART_TX_BUFFER_SIZE);
+
+    printf("%-12s %6u messages sent, %6u lost, %7u bytes in %.2f s (%.0f kB/s), "
+           "%u interrupts (%u nested)\n", name, received, lost_num, line_len, seconds,
+           line_len / seconds / 1000, irq_count, irq_nested);
+}
+
+int main(int argc, char **argv)
+{
+    limit = 5000;
+    seed = (unsigned int) time(NULL);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc))
+        {
+            limit = (uint32_t) strtoul(argv[++i], NULL, 0);
+        }
+        else if ((strcmp(argv[i], "-s") == 0) && ((i + 1) < argc))
+        {
+            seed = (unsigned int) strtoul(argv[++i], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n messages] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    if ((limit == 0) || (limit > 1000000))
+    {
+        fprintf(stderr, "%s: 1 to 1000000 messages\n", argv[0]);
+        return 2;
+    }
+
+    printf("seed %u\n", seed);
+    Test_Init();
+
+    double seconds = Test_Run(true, SWM_UART_OVERFLOW_DROP_NEWEST);
+    Test_Check("paced", true, seconds);
+    seconds = Test_Run(false, SWM_UART_OVERFLOW_DROP_NEWEST);
+    Test_Check("drop newest", false, seconds);
+    seconds = Test_Run(false, SWM_UART_OVERFLOW_DROP_OLDEST);
+    Test_Check("drop oldest", false, seconds);
+    seconds = Test_Run(false, SWM_UART_OVERFLOW_BLOCK);
+    Test_Check("block", false, seconds);
+
+    printf("swmTrace_ring_test: %s (%u failures)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
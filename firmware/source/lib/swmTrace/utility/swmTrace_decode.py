@@ -0,0 +1,240 @@
+# ----------------------------------------------------------------------------
+# Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+# onsemi), All Rights Reserved
+#
+# This code is the property of onsemi and may not be redistributed
+# in any form without prior written permission from onsemi.
+# The terms of use and warranty for this code are covered by contractual
+# agreements between onsemi and the licensee.
+#
+# This is Reusable Code.
+#
+# ----------------------------------------------------------------------------
+# swmTrace_decode.py
+#!/usr/bin/env python
+""" swmTrace Binary Log Decoder.
+
+    Rebuilds the text of log messages sent with the SWM_LOG_FORMAT_BINARY
+    option, using the format strings stored in the application ELF file.
+    Plain text output (swmTrace_printf) is passed through unchanged.
+
+    Prerequisites:
+    - installed Python, version >=2.7 or >=3.4
+    - installed module pyserial, version >=3.2 (only to read from a COM port)
+"""
+# ----------------------------------------------------------------------------
+
+from __future__ import print_function
+
+
+__version__ = '1.0.0'
+
+import re
+import sys
+import struct
+
+
+# Binary frame layout, see swmTrace_int.h
+SYNC = 0xA5
+HEADER_FMT = struct.Struct("<BBBL")
+TRUNCATED = 0x80
+
+MARKERS = ["-V-", "-I-", "-W-", "-E-", "-F-", "-PASS-", "-FAIL-"]
+
+# printf conversion specification, split in flags/width/precision,
+# length modifier and conversion character
+CONV_RE = re.compile(r"%([-+ #0]*)(\*|\d*)(?:\.(\*|\d*))?(hh|h|ll|l|L|j|z|t)?(.)?", re.S)
+
+
+class ElfStrings(object):
+    """ Read-only access to the allocated sections of a little-endian ELF file.
+
+        32-bit files are produced by the target builds, 64-bit files by the
+        host builds of the library tests.
+    """
+    def __init__(self, file):
+        elf = file.read()
+        assert elf[:4] == b"\x7fELF" and elf[4:5] in (b"\x01", b"\x02") and elf[5:6] == b"\x01", \
+               "Not a little-endian ELF file"
+        if elf[4:5] == b"\x01":
+            e_shoff, = struct.unpack_from("<L", elf, 0x20)
+            e_shentsize, e_shnum = struct.unpack_from("<HH", elf, 0x2E)
+            section_fmt = "<6L"
+        else:
+            e_shoff, = struct.unpack_from("<Q", elf, 0x28)
+            e_shentsize, e_shnum = struct.unpack_from("<HH", elf, 0x3A)
+            section_fmt = "<2L4Q"
+        self.sections = []
+        for index in range(e_shnum):
+            (name, type, flags, addr,
+             offset, size) = struct.unpack_from(section_fmt, elf, e_shoff + index * e_shentsize)
+            SHT_PROGBITS = 1
+            SHF_ALLOC = 2
+            if type == SHT_PROGBITS and flags & SHF_ALLOC and size > 0:
+                self.sections.append((addr, elf[offset:offset + size]))
+
+    def string(self, address):
+        for addr, data in self.sections:
+            if addr <= address < addr + len(data):
+                end = data.find(b"\x00", address - addr)
+                if end < 0:
+                    end = len(data)
+                return data[address - addr:end].decode('ascii', 'replace')
+        return None
+
+
+class Payload(object):
+    """ Sequential reader of the argument values of a frame. """
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+
+    def take(self, fmt):
+        value, = struct.unpack_from(fmt, self.data, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return value
+
+    def string(self):
+        end = self.data.find(b"\x00", self.offset)
+        if end < 0:
+            raise struct.error("unterminated string")
+        value = self.data[self.offset:end].decode('ascii', 'replace')
+        self.offset = end + 1
+        return value
+
+
+def format_message(fmt, payload, truncated=False):
+    """ Formats a message the same way the target would with vsnprintf.
+
+        The arguments of a truncated frame stop short, in which case the
+        message is formatted up to the first missing argument.
+    """
+    out = []
+    pos = 0
+    for match in CONV_RE.finditer(fmt):
+        out.append(fmt[pos:match.start()])
+        pos = match.end()
+        flags, width, precision, length, conv = match.groups()
+        if conv is None:
+            break
+        if conv == "%":
+            out.append("%")
+            continue
+        try:
+            args = []
+            if width == "*":
+                args.append(payload.take("<i"))
+            if precision == "*":
+                args.append(payload.take("<i"))
+            spec = "%" + flags + width + ("." + precision if precision is not None else "")
+            wide = length in ("ll", "j")
+            if conv in "di":
+                args.append(payload.take("<q" if wide else "<i"))
+            elif conv in "uoxX":
+                args.append(payload.take("<Q" if wide else "<I"))
+            elif conv == "c":
+                args.append(chr(payload.take("<q" if wide else "<i") & 0xFF))
+            elif conv == "p":
+                spec, conv = "0x%08", "x"
+                args.append(payload.take("<I"))
+            elif conv in "fFeEgGaA":
+                if conv in "aA":
+                    conv = "e" if conv == "a" else "E"
+                args.append(payload.take("<d"))
+            elif conv == "s":
+                args.append(payload.string())
+            elif conv == "n":
+                continue
+            else:
+                out.append(match.group(0))
+                break
+        except struct.error:
+            if not truncated:
+                raise
+            break
+        out.append((spec + conv) % tuple(args))
+    else:
+        out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode(stream, elf, output):
+    """ Decodes a stream of text and binary frames until end of input. """
+    text = bytearray()
+    while True:
+        octet = stream.read(1)
+        if not octet:
+            break
+        if ord(octet) != SYNC:
+            text += octet
+            if octet == b"\n":
+                output.write(text.decode('ascii', 'replace'))
+                output.flush()
+                del text[:]
+            continue
+        header = stream.read(HEADER_FMT.size - 1)
+        if len(header) < HEADER_FMT.size - 1:
+            break
+        _, level, length, address = HEADER_FMT.unpack(octet + header)
+        data = stream.read(length)
+        fmt = elf.string(address)
+        marker = MARKERS[level & ~TRUNCATED] if (level & ~TRUNCATED) < len(MARKERS) else "-?-"
+        if fmt is None:
+            message = "<unknown format string at 0x{0:08X}>\n".format(address)
+        else:
+            try:
+                message = format_message(fmt, Payload(data), (level & TRUNCATED) != 0)
+            except (struct.error, TypeError, ValueError):
+                message = "<bad arguments for \"{0}\">\n".format(fmt)
+            if level & TRUNCATED:
+                message = message.rstrip("\n") + " <truncated>\n"
+        output.write(text.decode('ascii', 'replace') + marker + message)
+        output.flush()
+        del text[:]
+    output.write(text.decode('ascii', 'replace'))
+
+
+class PortReader(object):
+    """ Blocking single byte reader on a COM port. """
+    def __init__(self, port, baudrate):
+        try:
+            import serial
+        except ImportError:
+            print("The module 'pyserial' is not installed! Please install it with 'pip install pyserial'.", file=sys.stderr)
+            sys.exit(1)
+        self.com = serial.Serial(port, baudrate)
+
+    def read(self, size):
+        return self.com.read(size)
+
+
+if __name__ == "__main__":
+
+    import argparse
+
+    parser = argparse.ArgumentParser(description='Decodes swmTrace binary log frames.')
+    parser.add_argument('-v', '--version', action='version', version="%(prog)s " + __version__)
+    parser.add_argument('-b', '--baudrate', type=int, default=115200,
+                        help="COM port baud rate (default 115200)")
+    parser.add_argument('elf', metavar='ELF', type=argparse.FileType('rb'),
+                        help="application ELF file the log was produced by")
+    parser.add_argument('input', metavar='INPUT', type=str, nargs='?', default='-',
+                        help="COM port, or file holding a captured log, "
+                             "standard input if omitted")
+    args = parser.parse_args()
+
+    with args.elf:
+        elf = ElfStrings(args.elf)
+
+    if args.input == '-':
+        stream = getattr(sys.stdin, 'buffer', sys.stdin)
+    else:
+        try:
+            stream = open(args.input, 'rb')
+        except IOError:
+            stream = PortReader(args.input, args.baudrate)
+
+    try:
+        decode(stream, elf, sys.stdout)
+    except KeyboardInterrupt:
+        pass
@@ -141,6 +141,14 @@ void ProcessCmd(void)
         break;
     #endif /* if (CFG_READ_SUPPORT) */
 
+    #if (CFG_SECTOR_CRC_SUPPORT)
+        case SECTOR_CRC:
+        {
+            ProcessSectorCrc(cmd_p);
+        }
+        break;
+    #endif /* if (CFG_SECTOR_CRC_SUPPORT) */
+
         case RESTART:
         {
             ProcessRestart();
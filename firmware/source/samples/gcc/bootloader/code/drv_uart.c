@@ -508,23 +508,27 @@ void ProcessHello(void)
  * Description   : Processes the PROG command.
  * Inputs        : arg_p            - pointer to PROG command message
  * Outputs       : None
- * Assumptions   :
+ * Assumptions   : A PROG command starting after the beginning of the
+ *                 download area updates some sectors of the image already
+ *                 there, as selected by the host from the SECTOR_CRC
+ *                 response.
  * ------------------------------------------------------------------------- */
 void ProcessProg(prog_cmd_arg_t *arg_p)
 {
     uint_fast32_t current_adr   = arg_p->adr;
     uint_fast32_t remaining_len = arg_p->length;
     uint_fast32_t sector_len    = MIN(remaining_len, FLASH_SECTOR_SIZE);
+    bool          partial       = (arg_p->adr > DOWNLOAD_BASE_ADDR);
     err_t resp_code = NO_ERROR;
     image_dscr_t image;
     uint32_t    *data_p;
 
     /* Check start address and length of image */
-    if ((arg_p->adr != DOWNLOAD_BASE_ADDR && arg_p->adr != BOOT_BASE_ADR)              ||
+    if ((arg_p->adr < DOWNLOAD_BASE_ADDR && arg_p->adr != BOOT_BASE_ADR)               ||
         arg_p->adr + arg_p->length                 > DOWNLOAD_BASE_ADDR + APP_MAX_SIZE ||
         arg_p->adr    % FLASH_SECTOR_SIZE         != 0                           ||
         arg_p->length % (2 * sizeof(uint32_t))    != 0                           ||
-        arg_p->length                              < APP_MIN_SIZE)
+        arg_p->length                              < (partial ? 2 * sizeof(uint32_t) : APP_MIN_SIZE))
     {
         SendError(INVALID_CMD);
         return;
@@ -613,6 +617,63 @@ void ProcessRead(cmd_msg_t *cmd_p)
 
 #endif /* if (CFG_READ_SUPPORT) */
 
+#if (CFG_SECTOR_CRC_SUPPORT)
+/* ----------------------------------------------------------------------------
+ * Function      : void ProcessSectorCrc(cmd_msg_t *cmd_p)
+ * ----------------------------------------------------------------------------
+ * Description   : Processes the SECTOR_CRC command: sends the CRC32 of each
+ *                 sector of a flash area, so that the host only sends the
+ *                 sectors of a new image which differ from the flash
+ *                 contents. The area is made of whole sectors of the
+ *                 download area, so that the CRCs cannot be used to read
+ *                 the flash; an area ending past the code flash is clamped
+ *                 to it, and fewer CRCs are sent.
+ * Inputs        : cmd_p            - pointer to SECTOR_CRC command message
+ * Outputs       : None
+ * Assumptions   :
+ * ------------------------------------------------------------------------- */
+void ProcessSectorCrc(cmd_msg_t *cmd_p)
+{
+    uint_fast32_t adr    = cmd_p->arg.sector_crc.adr;
+    uint_fast32_t length = cmd_p->arg.sector_crc.length;
+    uint_fast32_t end;
+    uint_fast32_t count  = 0;
+
+    /* we recycle the input buffer as output buffer */
+    crc32_t      *resp_p = (crc32_t *)cmd_p;
+
+    /* The area must be whole sectors of the download area */
+    if (length == 0                                                  ||
+        length % FLASH_SECTOR_SIZE               != 0                ||
+        adr    % FLASH_SECTOR_SIZE               != 0                ||
+        length / FLASH_SECTOR_SIZE * CRC32_SIZE   > FLASH_SECTOR_SIZE ||
+        adr    < DOWNLOAD_BASE_ADDR                                  ||
+        adr    > DOWNLOAD_BASE_ADDR + APP_MAX_SIZE                   ||
+        length > DOWNLOAD_BASE_ADDR + APP_MAX_SIZE - adr)
+    {
+        SendError(INVALID_CMD);
+        return;
+    }
+
+    /* An image larger than the download area ends past the code flash:
+     * only the CRCs of the sectors in the code flash are sent, and the host
+     * sends the other sectors */
+    end = MIN(adr + length, FLASH1_CODE_TOP + 1);
+
+    for (; adr < end; adr += FLASH_SECTOR_SIZE)
+    {
+        if (Sys_Flash_CalculateCRC(FLASH1, adr, FLASH_SECTOR_SIZE / sizeof(uint32_t),
+                                   &resp_p[count++]) != 0)
+        {
+            SendError(GENERAL_FLASH_FAILURE);
+            return;
+        }
+    }
+    Drv_Uart_StartSend(resp_p, count * CRC32_SIZE + sizeof(Drv_Uart_fcs_t), UART_WITH_FCS);
+}
+
+#endif /* if (CFG_SECTOR_CRC_SUPPORT) */
+
 /* ----------------------------------------------------------------------------
  * Function      : void ProcessRestart(void)
  * ----------------------------------------------------------------------------
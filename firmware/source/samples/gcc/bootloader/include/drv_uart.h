@@ -36,6 +36,7 @@
 
 #define CFG_TIMEOUT                     30  /* in seconds, 0 = no timeout */
 #define CFG_READ_SUPPORT                0
+#define CFG_SECTOR_CRC_SUPPORT          1
 
 #define NXT_TYPE                '\x55'
 #define END_TYPE                '\xAA'
@@ -82,12 +83,14 @@ typedef enum
     HELLO,
     PROG,
     READ,
-    RESTART
+    RESTART,
+    SECTOR_CRC
 } cmd_type_t;
 
 typedef struct
 {
-    uint32_t adr;                   /* start address of image
+    uint32_t adr;                   /* start address of image, or of the
+                                     * sectors to update in the download area
                                      * (must by a multiple of sector size) */
     uint32_t length;                /* image length in octets
                                      * (must by a multiple of 2) */
@@ -101,11 +104,22 @@ typedef struct
                                      * (max sector size) */
 } read_cmd_arg_t;
 
+typedef struct
+{
+    uint32_t adr;                   /* start address of the 1st sector,
+                                     * in the download area (must by a
+                                     * multiple of sector size) */
+    uint32_t length;                /* length in octets (must be a multiple
+                                     * of sector size, max sector size / 4
+                                     * sectors) */
+} sector_crc_cmd_arg_t;
+
 typedef union
 {
     /* HELLO cmd has no arguments */
     prog_cmd_arg_t prog;
     read_cmd_arg_t read;
+    sector_crc_cmd_arg_t sector_crc;
 
     /* RESTART cmd has no arguments */
 } cmd_arg_t;
@@ -336,6 +350,16 @@ void ProcessProg(prog_cmd_arg_t *arg_p);
  * ------------------------------------------------------------------------- */
 void ProcessRead(cmd_msg_t *cmd_p);
 
+/* ----------------------------------------------------------------------------
+ * Function      : void ProcessSectorCrc(cmd_msg_t *cmd_p)
+ * ----------------------------------------------------------------------------
+ * Description   : Processes the SECTOR_CRC command.
+ * Inputs        : cmd_p            - pointer to SECTOR_CRC command message
+ * Outputs       : None
+ * Assumptions   :
+ * ------------------------------------------------------------------------- */
+void ProcessSectorCrc(cmd_msg_t *cmd_p);
+
 /* ----------------------------------------------------------------------------
  * Function      : void ProcessRestart(void)
  * ----------------------------------------------------------------------------
@@ -0,0 +1,66 @@
+/**
+ * @file bootloader_flash.c
+ * @brief Flash library side of the bootloader host build
+ *
+ * Fills the jump table of the test rom_vect.h with the boot ROM functions
+ * of bootloader_host.c, and with the flash library functions, which run on
+ * the flash simulator of the flash library tests. Sector erases go through
+ * a wrapper counting them, to check which sectors an update programs.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#include <hw.h>
+#include <flash.h>
+#include <rom_vect.h>
+#include "bootloader_flash.h"
+
+/** Size of a code flash sector */
+#define TEST_SECTOR_SIZE                (CODE_SECTOR_LEN_WORDS * 4)
+
+static uint32_t sectorErases[(FLASH1_CODE_TOP + 1 - FLASH0_CODE_BASE) / TEST_SECTOR_SIZE];
+
+/**
+ * @brief Erase a sector, counting the erases of the code flash sectors
+ */
+static FlashStatus_t Test_EraseSector(uint32_t addr, bool enb_endurance)
+{
+    if ((addr >= FLASH0_CODE_BASE) && (addr <= FLASH1_CODE_TOP))
+    {
+        sectorErases[(addr - FLASH0_CODE_BASE) / TEST_SECTOR_SIZE]++;
+    }
+    return Flash_EraseSector(addr, enb_endurance);
+}
+
+void * const bootloader_rom[BOOTLOADER_ROM_COUNT] =
+{
+    [BOOTLOADER_ROM_SYS_DELAY]      = Host_Delay,
+    [BOOTLOADER_ROM_VALIDATE_APP]   = Host_ValidateApp,
+    [BOOTLOADER_ROM_START_APP]      = Host_StartApp,
+    [BOOTLOADER_ROM_INITIALIZE]     = Flash_Initialize,
+    [BOOTLOADER_ROM_WRITEWORD]      = Flash_WriteWord,
+    [BOOTLOADER_ROM_READWORD]       = Flash_ReadWord,
+    [BOOTLOADER_ROM_WRITEDOUBLE]    = Flash_WriteDouble,
+    [BOOTLOADER_ROM_READDOUBLE]     = Flash_ReadDouble,
+    [BOOTLOADER_ROM_WRITEBUFFER]    = Flash_WriteBuffer,
+    [BOOTLOADER_ROM_READBUFFER]     = Flash_ReadBuffer,
+    [BOOTLOADER_ROM_ERASEFLASHBANK] = Flash_EraseFlashBank,
+    [BOOTLOADER_ROM_ERASECHIP]      = Flash_EraseChip,
+    [BOOTLOADER_ROM_ERASESECTOR]    = Test_EraseSector,
+    [BOOTLOADER_ROM_BLANKCHECK]     = Flash_BlankCheck
+};
+
+uint32_t Test_SectorErases(uint32_t addr)
+{
+    return sectorErases[(addr - FLASH0_CODE_BASE) / TEST_SECTOR_SIZE];
+}
@@ -0,0 +1,41 @@
+/**
+ * @file bootloader_flash.h
+ * @brief Flash library side of the bootloader host build
+ *
+ * The bootloader is built against the ROM flash functions, whose types
+ * conflict with those of the flash library, so the flash library is reached
+ * through the jump table filled by bootloader_flash.c, and the erases it
+ * counts through these functions.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef BOOTLOADER_FLASH_H_
+#define BOOTLOADER_FLASH_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Number of erases of a code flash sector through the jump table
+ *        since the start of the host build
+ * @param [in] addr Address of the sector
+ * @return Number of erases
+ */
+uint32_t Test_SectorErases(uint32_t addr);
+
+/* Boot ROM functions of the jump table, see bootloader_host.c */
+void Host_Delay(uint32_t cycles);
+uint32_t Host_ValidateApp(uint32_t *app_addr);
+uint32_t Host_StartApp(uint32_t *app_addr);
+
+#endif    /* BOOTLOADER_FLASH_H_ */
@@ -0,0 +1,564 @@
+/**
+ * @file bootloader_host.c
+ * @brief Host target of the UART bootloader
+ *
+ * Replaces the target driver and the boot ROM of the bootloader, and models
+ * the UART and its DMA channels on a pseudo terminal, so that the bootloader
+ * runs unmodified on the flash simulator of the flash library tests and the
+ * Update Tool can be tested against it.
+ *
+ * The UART model sends and receives the octets at the baud rate of the UART
+ * configuration, and garbles them when the pseudo terminal is set to another
+ * rate or when the rate is above the highest rate of the line. Octets
+ * received while the RX DMA channel is disabled are lost, as on the device.
+ *
+ * Usage: bootloader_host [options] TTY
+ *   -f FILE  download area: loaded at start, and written with the contents
+ *            of the download area each time the bootloader validates its own
+ *            image (HELLO and RESTART commands)
+ *   -e FILE  written with the download area sectors erased, one address per
+ *            line, at the same time as the download area
+ *   -l MS    latency of the line from the bootloader to the host
+ *   -r RATE  highest baud rate of the line
+ *   -t SCALE run the flash operations in their modelled time, and the
+ *            bootloader SCALE times slower: its ticks, the line, the latency
+ *            and the flash operations, for the cost of the simulator traps
+ *            to be small against them
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "bootloader.h"
+#include "drv_targ.h"
+#include "drv_uart.h"
+#include "flash_sim.h"
+#include "bootloader_flash.h"
+
+/* ----------------------------------------------------------------------------
+ * Defines
+ * --------------------------------------------------------------------------*/
+
+#define MAX(a, b)                       ((a) > (b) ? (a) : (b))
+
+/* Distance between the DMA channels */
+#define HOST_DMA_STRIDE                 (DMA1_BASE - DMA0_BASE)
+
+/* Octets queued in each direction of the line */
+#define HOST_QUEUE_SIZE                 0x10000U
+
+/* Bits of a UART character, with the start and stop bits */
+#define HOST_CHAR_BITS                  10
+
+/* Divider of the UART clock set by the CNT_STEP field, see uart.c */
+#define HOST_UART_FACTOR_SHIFT          18
+
+/* Download area written to the -f file, in the code flash */
+#define HOST_DOWNLOAD_SIZE              (FLASH1_CODE_TOP + 1 - DOWNLOAD_BASE_ADDR)
+
+/* Octets XORed to the octets sent or received at a wrong rate */
+#define HOST_GARBLE                     0xA5U
+
+/* Bootloader image version, returned in the HELLO response */
+#define HOST_BOOT_VERSION_ADR           (BOOT_BASE_ADR + 0x100)
+
+/* ----------------------------------------------------------------------------
+ * Local variables and types
+ * --------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint64_t time[HOST_QUEUE_SIZE];     /* time at which the octet is
+                                         * received */
+    uint8_t  data[HOST_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} host_queue_t;
+
+static host_queue_t host_rx;            /* octets sent by the host */
+static host_queue_t host_tx;            /* octets sent by the bootloader */
+
+static struct
+{
+    int         fd;                     /* pseudo terminal */
+    const char *flash_path;             /* -f */
+    const char *erase_path;             /* -e */
+    uint64_t    latency;                /* -l, in ns */
+    uint32_t    max_rate;               /* -r, 0 = no limit */
+    bool        paced_b;                /* -t */
+    uint32_t    scale;                  /* -t, slow down of the modelled
+                                         * times */
+
+    uint64_t    rx_line_free;           /* end of the last octet received */
+    uint64_t    tx_line_free;           /* end of the last octet sent */
+    int         rx_ch;                  /* RX DMA channel, or -1 */
+    uint32_t    rx_pos;
+    uint32_t    rx_length;
+    uint32_t    rx_dest;
+    bool        rx_wrap_b;
+    int         tx_ch;                  /* TX DMA channel, or -1 */
+    bool        ready_b;                /* the RX DMA has been started */
+
+    uint64_t    device_time;            /* time of the flash operations */
+    uint64_t    sim_time;               /* modelled time already run */
+} host = { .fd = -1, .scale = 1, .rx_ch = -1, .tx_ch = -1 };
+
+uint32_t SystemCoreClock = 8000000;
+
+/* main of app.c */
+int Bootloader_Main(void);
+
+/* ----------------------------------------------------------------------------
+ * Line model
+ * --------------------------------------------------------------------------*/
+
+static uint64_t Host_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static volatile uint32_t * Host_DmaReg(int ch, volatile uint32_t *reg)
+{
+    return Sim_Register((uint32_t)(uintptr_t)reg + (uint32_t)ch * HOST_DMA_STRIDE);
+}
+
+/**
+ * @brief Baud rate of the UART configuration
+ */
+static uint32_t Host_UartRate(void)
+{
+    uint32_t step = *Sim_Register((uint32_t)(uintptr_t)&UART->CFG) & UART_CFG_CNT_STEP_Mask;
+
+    return (uint32_t)(((uint64_t)(step + 1) * UART_CLK_HZ) >> HOST_UART_FACTOR_SHIFT);
+}
+
+/**
+ * @brief Baud rate of the pseudo terminal, set by the host
+ */
+static uint32_t Host_LineRate(void)
+{
+    static const struct
+    {
+        speed_t  speed;
+        uint32_t rate;
+    } rates[] =
+    {
+        { B9600, 9600 }, { B19200, 19200 }, { B38400, 38400 }, { B57600, 57600 },
+        { B115200, 115200 }, { B230400, 230400 }, { B460800, 460800 },
+        { B500000, 500000 }, { B921600, 921600 }, { B1000000, 1000000 },
+        { B1500000, 1500000 }, { B2000000, 2000000 }, { B2500000, 2500000 },
+        { B3000000, 3000000 }, { B4000000, 4000000 }
+    };
+    struct termios tio;
+
+    if (tcgetattr(host.fd, &tio) == 0)
+    {
+        for (unsigned int i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+        {
+            if (rates[i].speed == cfgetospeed(&tio))
+            {
+                return rates[i].rate;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Octets are garbled when both ends do not use the same rate, within
+ *        2%, or when the line does not support the rate
+ */
+static uint8_t Host_Garble(void)
+{
+    uint32_t uart = Host_UartRate();
+    uint32_t line = Host_LineRate();
+    uint32_t diff = (uart > line) ? (uart - line) : (line - uart);
+
+    return (diff > uart / 50 || (host.max_rate != 0 && uart > host.max_rate)) ? HOST_GARBLE : 0;
+}
+
+static uint64_t Host_CharTime(uint32_t rate)
+{
+    return (rate == 0) ? 0 : (uint64_t)HOST_CHAR_BITS * 1000000000U * host.scale / rate;
+}
+
+static bool Host_QueuePush(host_queue_t *queue, uint64_t time, uint8_t data)
+{
+    if (queue->tail - queue->head == HOST_QUEUE_SIZE)
+    {
+        return false;
+    }
+    queue->time[queue->tail % HOST_QUEUE_SIZE] = time;
+    queue->data[queue->tail % HOST_QUEUE_SIZE] = data;
+    queue->tail++;
+    return true;
+}
+
+static bool Host_QueueReady(const host_queue_t *queue, uint64_t now)
+{
+    return queue->head != queue->tail && queue->time[queue->head % HOST_QUEUE_SIZE] <= now;
+}
+
+/**
+ * @brief Move the octets of the line which have been received by the time
+ *        @p now
+ */
+static void Host_Io(uint64_t now)
+{
+    uint8_t buffer[256];
+    ssize_t length;
+
+    /* Octets sent by the host arrive one character time after each other,
+     * from the time they are read from the pseudo terminal */
+    while (HOST_QUEUE_SIZE - (host_rx.tail - host_rx.head) >= sizeof(buffer) &&
+           (length = read(host.fd, buffer, sizeof(buffer))) > 0)
+    {
+        uint8_t  garble    = Host_Garble();
+        uint64_t char_time = Host_CharTime(Host_LineRate());
+
+        for (ssize_t i = 0; i < length; i++)
+        {
+            host.rx_line_free = MAX(host.rx_line_free, now) + char_time;
+            Host_QueuePush(&host_rx, host.rx_line_free, buffer[i] ^ garble);
+        }
+    }
+
+    while (Host_QueueReady(&host_rx, now))
+    {
+        uint8_t data = host_rx.data[host_rx.head++ % HOST_QUEUE_SIZE];
+
+        /* Octets received without RX DMA are lost */
+        if (host.rx_ch < 0)
+        {
+            continue;
+        }
+        ((uint8_t *)(uintptr_t)host.rx_dest)[host.rx_pos++] = data;
+        if (host.rx_pos == host.rx_length && host.rx_wrap_b)
+        {
+            host.rx_pos = 0;
+        }
+        *Host_DmaReg(host.rx_ch, &DMA->CNTS) = host.rx_pos;
+        if (host.rx_pos == host.rx_length)
+        {
+            *Host_DmaReg(host.rx_ch, &DMA->CTRL) = DMA_DISABLE;
+            host.rx_ch = -1;
+        }
+    }
+
+    while (Host_QueueReady(&host_tx, now) &&
+           write(host.fd, &host_tx.data[host_tx.head % HOST_QUEUE_SIZE], 1) == 1)
+    {
+        host_tx.head++;
+    }
+
+    /* The TX DMA channel is done once the last octet is sent */
+    if (host.tx_ch >= 0 && host.tx_line_free <= now)
+    {
+        *Host_DmaReg(host.tx_ch, &DMA->CTRL) = DMA_DISABLE;
+        host.tx_ch = -1;
+    }
+}
+
+/**
+ * @brief Wait until @p time, while the octets of the line are moved
+ */
+static void Host_WaitUntil(uint64_t time)
+{
+    uint64_t now;
+
+    while ((now = Host_Now()) < time)
+    {
+        uint64_t next = time;
+        struct pollfd pfd = { .fd = host.fd, .events = POLLIN };
+        struct timespec timeout;
+
+        Host_Io(now);
+        if (host_rx.head != host_rx.tail)
+        {
+            next = MIN(next, host_rx.time[host_rx.head % HOST_QUEUE_SIZE]);
+        }
+        if (host_tx.head != host_tx.tail)
+        {
+            next = MIN(next, host_tx.time[host_tx.head % HOST_QUEUE_SIZE]);
+        }
+        if (host.tx_ch >= 0)
+        {
+            next = MIN(next, host.tx_line_free);
+        }
+        next = MAX(next, now);
+        timeout.tv_sec = (next - now) / 1000000000U;
+        timeout.tv_nsec = (next - now) % 1000000000U;
+        ppoll(&pfd, 1, &timeout, NULL);
+    }
+    Host_Io(now);
+}
+
+/**
+ * @brief Run the line, and with -t, let the modelled time of the flash
+ *        operations elapse
+ */
+static void Host_Service(void)
+{
+    uint64_t now = Host_Now();
+    uint64_t sim_time = Sim_Stats()->time_ns;
+
+    if (host.paced_b)
+    {
+        host.device_time = MAX(host.device_time + (sim_time - host.sim_time) * host.scale, now);
+        host.sim_time = sim_time;
+        if (host.device_time > now)
+        {
+            Host_WaitUntil(host.device_time);
+            return;
+        }
+    }
+    Host_Io(now);
+}
+
+static void Host_RegRead(uint32_t addr)
+{
+    (void)addr;
+    Host_Service();
+}
+
+/**
+ * @brief Start or stop the DMA channels from or to the UART
+ */
+static void Host_RegWrite(uint32_t addr, uint32_t value)
+{
+    uint32_t offset = addr - DMA0_BASE;
+    int ch = offset / HOST_DMA_STRIDE;
+    uint32_t cfg, mode, length;
+
+    if (addr < DMA0_BASE || ch >= 4 || offset % HOST_DMA_STRIDE != offsetof(DMA_Type, CTRL))
+    {
+        return;
+    }
+    cfg = *Host_DmaReg(ch, &DMA->CFG0);
+    mode = value & DMA_CTRL_MODE_ENABLE_Mask;
+    length = (*Host_DmaReg(ch, &DMA->CFG1) & DMA_CFG1_TRANSFER_LENGTH_Mask) >>
+             DMA_CFG1_TRANSFER_LENGTH_Pos;
+
+    /* The clear bits read back as 0 */
+    *Host_DmaReg(ch, &DMA->CTRL) = mode;
+    if ((value & DMA_CLEAR_CNTS) != 0)
+    {
+        *Host_DmaReg(ch, &DMA->CNTS) = 0;
+    }
+
+    if ((cfg & DMA_CFG0_SRC_SELECT_Mask) == DMA_SRC_UART0)
+    {
+        Host_Io(Host_Now());
+        host.rx_pos = *Host_DmaReg(ch, &DMA->CNTS) & DMA_CNTS_TRANSFER_WORD_CNT_Mask;
+        host.rx_ch = (mode == DMA_DISABLE || length == 0) ? -1 : ch;
+        host.rx_length = length;
+        host.rx_dest = *Host_DmaReg(ch, &DMA->DEST_ADDR);
+        host.rx_wrap_b = (mode == DMA_ENABLE_WRAP);
+
+        /* The host can send its first command */
+        if (host.rx_ch >= 0 && !host.ready_b)
+        {
+            host.ready_b = true;
+            printf("ready\n");
+            fflush(stdout);
+        }
+    }
+    else if ((cfg & DMA_CFG0_DEST_SELECT_Mask) == DMA_DEST_UART0 && mode == DMA_ENABLE)
+    {
+        const uint8_t *src = (const uint8_t *)(uintptr_t)*Host_DmaReg(ch, &DMA->SRC_ADDR);
+        uint64_t now = Host_Now();
+        uint64_t char_time = Host_CharTime(Host_UartRate());
+        uint8_t garble = Host_Garble();
+
+        for (uint32_t i = 0; i < length; i++)
+        {
+            host.tx_line_free = MAX(host.tx_line_free, now) + char_time;
+            Host_QueuePush(&host_tx, host.tx_line_free + host.latency, src[i] ^ garble);
+        }
+        host.tx_ch = ch;
+        Host_Io(now);
+    }
+}
+
+static const SimDevice_t host_device =
+{
+    .read = Host_RegRead,
+    .write = Host_RegWrite
+};
+
+/* ----------------------------------------------------------------------------
+ * Download area files
+ * --------------------------------------------------------------------------*/
+
+static void Host_Load(void)
+{
+    static uint32_t words[HOST_DOWNLOAD_SIZE / sizeof(uint32_t)];
+    FILE *file = fopen(host.flash_path, "rb");
+    size_t count;
+
+    if (file == NULL)
+    {
+        return;
+    }
+    count = fread(words, sizeof(uint32_t), sizeof(words) / sizeof(uint32_t), file);
+    fclose(file);
+    Sim_FlashPoke(DOWNLOAD_BASE_ADDR, words, count);
+}
+
+static void Host_Save(void)
+{
+    FILE *file;
+
+    if (host.flash_path != NULL && (file = fopen(host.flash_path, "wb")) != NULL)
+    {
+        fwrite((const void *)DOWNLOAD_BASE_ADDR, 1, HOST_DOWNLOAD_SIZE, file);
+        fclose(file);
+    }
+    if (host.erase_path != NULL && (file = fopen(host.erase_path, "w")) != NULL)
+    {
+        for (uint32_t adr = DOWNLOAD_BASE_ADDR; adr <= FLASH1_CODE_TOP; adr += FLASH_SECTOR_SIZE)
+        {
+            if (Test_SectorErases(adr) != 0)
+            {
+                fprintf(file, "0x%06x\n", adr);
+            }
+        }
+        fclose(file);
+    }
+}
+
+/* ----------------------------------------------------------------------------
+ * Boot ROM
+ * --------------------------------------------------------------------------*/
+
+void Host_Delay(uint32_t cycles)
+{
+    Host_WaitUntil(Host_Now() + (uint64_t)cycles * 1000000000U * host.scale / SystemCoreClock);
+}
+
+uint32_t Host_ValidateApp(uint32_t *app_addr)
+{
+    /* The bootloader has a valid image, which the RESTART command validates
+     * before the download area is copied */
+    if ((uint32_t)(uintptr_t)app_addr == BOOT_BASE_ADR)
+    {
+        Host_Save();
+        return BOOTROM_ERR_NONE;
+    }
+    return Bootloader_is_image_bootable((uint32_t)(uintptr_t)app_addr) ? BOOTROM_ERR_NONE
+                                                                       : BOOTROM_ERR_BAD_RESET_VECT;
+}
+
+uint32_t Host_StartApp(uint32_t *app_addr)
+{
+    /* Let the last response reach the host */
+    Host_WaitUntil(host.tx_line_free + host.latency);
+    printf("start 0x%06x\n", (uint32_t)(uintptr_t)app_addr);
+    exit(EXIT_SUCCESS);
+}
+
+/* ----------------------------------------------------------------------------
+ * Target driver
+ * --------------------------------------------------------------------------*/
+
+void Drv_Targ_Init(void)
+{
+}
+
+void Drv_Targ_Poll(void)
+{
+}
+
+void Drv_Targ_Reset(void)
+{
+    printf("reset\n");
+    exit(EXIT_FAILURE);
+}
+
+uint_fast32_t Drv_Targ_GetTicks(void)
+{
+    return Host_Now() / 1000000U / host.scale;
+}
+
+bool CheckUpdatePin(void)
+{
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    static const Sys_Boot_app_version_t boot_version = { VER_ID, BOOT_VER_ENCODE(VER_MAJOR, VER_MINOR,
+                                                                                 VER_REVISION) };
+    uint32_t version_adr = HOST_BOOT_VERSION_ADR;
+    uint32_t version[2];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:f:l:r:t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'e':
+                host.erase_path = optarg;
+                break;
+            case 'f':
+                host.flash_path = optarg;
+                break;
+            case 'l':
+                host.latency = (uint64_t)(atof(optarg) * 1000000);
+                break;
+            case 'r':
+                host.max_rate = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                host.paced_b = true;
+                host.scale = MAX(strtoul(optarg, NULL, 0), 1);
+                break;
+            default:
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc ||
+        (host.fd = open(argv[optind], O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0)
+    {
+        fprintf(stderr, "usage: %s [-f FILE] [-e FILE] [-l MS] [-r RATE] [-t SCALE] TTY\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    host.latency *= host.scale;
+    Sim_Init();
+    Flash_Initialize(0, FLASH_CLOCK_8MHZ);
+    Flash_Initialize(1, FLASH_CLOCK_8MHZ);
+    if (host.flash_path != NULL)
+    {
+        Host_Load();
+    }
+
+    /* Version of the bootloader image */
+    memcpy(version, &boot_version, sizeof(boot_version));
+    Sim_FlashPoke(BOOTVECT_GET_VERSION(BOOT_BASE_ADR), &version_adr, 1);
+    Sim_FlashPoke(HOST_BOOT_VERSION_ADR, version, 2);
+
+    Sim_AttachDevice(&host_device);
+    return Bootloader_Main();
+}
@@ -0,0 +1,67 @@
+/**
+ * @file hw.h
+ * @brief Host replacement of the device header, used to build the UART
+ *        bootloader against the flash simulator of the flash library
+ *
+ * Provides the register definitions and the hardware abstraction layer
+ * headers used by the bootloader, without the Cortex-M33 core support which
+ * cannot be built on the host. The peripherals stay at their device
+ * addresses, where the simulator traps the accesses; the UART and its DMA
+ * channels are modelled by bootloader_host.c.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef HW_H
+#define HW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* CMSIS qualifiers and inline keywords */
+#define __I                             volatile const
+#define __O                             volatile
+#define __IO                            volatile
+#define __IM                            volatile const
+#define __OM                            volatile
+#define __IOM                           volatile
+#define __STATIC_INLINE                 static inline
+#define __STATIC_FORCEINLINE            static inline __attribute__((always_inline))
+#define __WEAK                          __attribute__((weak))
+
+#include <montana_vectors.h>
+#include <montana_hw.h>
+#include <montana_map.h>
+#include <rom_vect.h>
+
+extern uint32_t SystemCoreClock;
+
+/* Core intrinsics, see flash_sim.c */
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+/* GPIO pads, see montana.h */
+#define GPIO_PAD_COUNT                  16
+#define GPIO_EVENT_CHANNEL_COUNT        8
+
+#include <sassert.h>
+#include <crc.h>
+#include <dma.h>
+#include <flash_copier.h>
+#include <gpio.h>
+#include <uart.h>
+#include <watchdog.h>
+
+#endif    /* HW_H */
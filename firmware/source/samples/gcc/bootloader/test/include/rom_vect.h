@@ -0,0 +1,95 @@
+/**
+ * @file rom_vect.h
+ * @brief Host replacement of the ROM jump table, used to run the bootloader
+ *        on the flash simulator
+ *
+ * The entries of the jump table are read from bootloader_rom, which
+ * bootloader_flash.c fills with the flash library functions run by the
+ * flash simulator of the flash library tests, and with the boot ROM
+ * functions of bootloader_host.c.
+ *
+ * @copyright @parblock
+ * Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+ * onsemi), All Rights Reserved
+ *
+ * This code is the property of onsemi and may not be redistributed
+ * in any form without prior written permission from onsemi.
+ * The terms of use and warranty for this code are covered by contractual
+ * agreements between onsemi and the licensee.
+ *
+ * This is Reusable Code.
+ * @endparblock
+ */
+
+#ifndef ROMVECT_H_
+#define ROMVECT_H_
+
+#include <stdint.h>
+
+/** Entries of the jump table, in the order of the ROM */
+typedef enum
+{
+    BOOTLOADER_ROM_SYS_DELAY,
+    BOOTLOADER_ROM_VALIDATE_APP,
+    BOOTLOADER_ROM_START_APP,
+    BOOTLOADER_ROM_INITIALIZE,
+    BOOTLOADER_ROM_WRITEWORD,
+    BOOTLOADER_ROM_READWORD,
+    BOOTLOADER_ROM_WRITEDOUBLE,
+    BOOTLOADER_ROM_READDOUBLE,
+    BOOTLOADER_ROM_WRITEBUFFER,
+    BOOTLOADER_ROM_READBUFFER,
+    BOOTLOADER_ROM_ERASEFLASHBANK,
+    BOOTLOADER_ROM_ERASECHIP,
+    BOOTLOADER_ROM_ERASESECTOR,
+    BOOTLOADER_ROM_BLANKCHECK,
+    BOOTLOADER_ROM_COUNT
+} BootloaderRom_t;
+
+/** Jump table, see bootloader_flash.c */
+extern void * const bootloader_rom[BOOTLOADER_ROM_COUNT];
+
+/* Program ROM flash library version, not read by the test */
+#define FLASHVERSION_BASEADDR               0x00000018U
+
+/* Boot ROM functions */
+#define ROMVECT_SYS_DELAY                   (&bootloader_rom[BOOTLOADER_ROM_SYS_DELAY])
+#define ROMVECT_VALIDATE_APP                (&bootloader_rom[BOOTLOADER_ROM_VALIDATE_APP])
+#define ROMVECT_START_APP                   (&bootloader_rom[BOOTLOADER_ROM_START_APP])
+
+/* Flash library functions */
+#define ROMVECT_FLASH_INITIALIZE            (&bootloader_rom[BOOTLOADER_ROM_INITIALIZE])
+#define ROMVECT_FLASH_WRITEWORD             (&bootloader_rom[BOOTLOADER_ROM_WRITEWORD])
+#define ROMVECT_FLASH_READWORD              (&bootloader_rom[BOOTLOADER_ROM_READWORD])
+#define ROMVECT_FLASH_WRITEDOUBLE           (&bootloader_rom[BOOTLOADER_ROM_WRITEDOUBLE])
+#define ROMVECT_FLASH_READDOUBLE            (&bootloader_rom[BOOTLOADER_ROM_READDOUBLE])
+#define ROMVECT_FLASH_WRITEBUFFER           (&bootloader_rom[BOOTLOADER_ROM_WRITEBUFFER])
+#define ROMVECT_FLASH_READBUFFER            (&bootloader_rom[BOOTLOADER_ROM_READBUFFER])
+#define ROMVECT_FLASH_ERASEFLASHBANK        (&bootloader_rom[BOOTLOADER_ROM_ERASEFLASHBANK])
+#define ROMVECT_FLASH_ERASECHIP             (&bootloader_rom[BOOTLOADER_ROM_ERASECHIP])
+#define ROMVECT_FLASH_ERASESECTOR           (&bootloader_rom[BOOTLOADER_ROM_ERASESECTOR])
+#define ROMVECT_FLASH_BLANKCHECK            (&bootloader_rom[BOOTLOADER_ROM_BLANKCHECK])
+
+/** @brief Define the return status values from ROM functions */
+typedef enum
+{
+    BOOTROM_ERR_NONE = 0x0,
+    BOOTROM_ERR_BAD_ALIGN = 0x1,
+    BOOTROM_ERR_BAD_SP = 0x2,
+    BOOTROM_ERR_BAD_RESET_VECT = 0x3,
+    BOOTROM_ERR_FAILED_START_APP = 0x6,
+    BOOTROM_ERR_BAD_CRC = 0x7
+} BootROMStatus;
+
+/** @brief Provide a type definition for the application validation function. */
+typedef BootROMStatus (*BOOTROM_ValidateApp_t)(uint32_t* app_addr);
+
+/** @brief Provide a type definition for the application start function. */
+typedef BootROMStatus (*BOOTROM_StartApp_t)(uint32_t* app_addr);
+
+/* ROM functions, as in the device header */
+#define Sys_Delay(cycles)               (*((void(**)(uint32_t))ROMVECT_SYS_DELAY))(cycles)
+#define Sys_ValidateApp(app_addr)       (*((BOOTROM_ValidateApp_t *) ROMVECT_VALIDATE_APP))(app_addr)
+#define Sys_StartApp(app_addr)          (*((BOOTROM_StartApp_t *) ROMVECT_START_APP))(app_addr)
+
+#endif    /* ROMVECT_H_ */
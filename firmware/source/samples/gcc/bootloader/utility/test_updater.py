@@ -0,0 +1,293 @@
+# ----------------------------------------------------------------------------
+# Copyright (c) 2021 Semiconductor Components Industries, LLC (d/b/a
+# onsemi), All Rights Reserved
+#
+# This code is the property of onsemi and may not be redistributed
+# in any form without prior written permission from onsemi.
+# The terms of use and warranty for this code are covered by contractual
+# agreements between onsemi and the licensee.
+#
+# This is Reusable Code.
+#
+# ----------------------------------------------------------------------------
+# test_updater.py
+#!/usr/bin/env python3
+""" Loopback test of the Update Tool.
+
+    updater.update() is run against the bootloader built for the host
+    (../test/bootloader_host, built by make in ../test), on the other end of
+    a pseudo terminal. The host build runs drv_uart.c and bootloader.c on
+    the flash simulator of the flash library tests, and writes the download
+    area, and the sectors it erased, to files which the tests check.
+
+    Prerequisites:
+    - Linux (pseudo terminals at the UART baud rates), Python >= 3.4
+    - pyserial is not needed
+    - the host build: make -C ../test
+
+    Usage: python3 test_updater.py [-v]
+    The BOOTLOADER_HOST environment variable overrides the path of the host
+    build.
+"""
+# ----------------------------------------------------------------------------
+
+import contextlib
+import ctypes
+import io
+import os
+import select
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import termios
+import time
+import tty
+import types
+import unittest
+
+# updater.py uses the CP210x runtime DLL and pyserial, neither is used here
+ctypes.WinDLL = ctypes.windll = None
+import ctypes.wintypes
+if 'serial' not in sys.modules:
+    try:
+        import serial
+    except ImportError:
+        sys.modules['serial'] = types.SimpleNamespace(Serial=object)
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, HERE)
+import updater as upd
+
+
+BLINKY = os.path.join(HERE, "blinky.bin")
+BOOTLOADER_HOST = os.environ.get("BOOTLOADER_HOST",
+                                 os.path.join(HERE, "..", "test", "bootloader_host"))
+
+SECT_SIZE = 2048
+DOWNLOAD_BASE = 0x158000        # FLASH1_CODE_BASE
+CODE_TOP = 0x1AFFFF             # FLASH1_CODE_TOP
+APP_MAX_SIZE = 0xA8000
+APP_BASE = 0x108000
+
+BAUD_SPEEDS = {rate: getattr(termios, "B{0}".format(rate))
+               for rate in (1000000, 1500000, 2000000)}
+
+
+class PtyPort(object):
+    """ Subset of serial.Serial used by updater.py, on a pseudo terminal.
+        The baud rate is that of the terminal, which the host build reads. """
+
+    def __init__(self, fd, timeout=0.2):
+        self.fd = fd
+        self.timeout = timeout
+        self.baudrate = 1000000
+
+    @property
+    def baudrate(self):
+        return self._baudrate
+
+    @baudrate.setter
+    def baudrate(self, rate):
+        attrs = termios.tcgetattr(self.fd)
+        attrs[4] = attrs[5] = BAUD_SPEEDS[rate]
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self._baudrate = rate
+
+    def read(self, size):
+        data = b''
+        while len(data) < size:
+            if not select.select([self.fd], [], [], self.timeout)[0]:
+                break
+            data += os.read(self.fd, size - len(data))
+        return data
+
+    def write(self, data):
+        view = memoryview(data)
+        while view:
+            view = view[os.write(self.fd, view):]
+
+    def reset_input_buffer(self):
+        termios.tcflush(self.fd, termios.TCIFLUSH)
+
+    def reset_output_buffer(self):
+        termios.tcflush(self.fd, termios.TCOFLUSH)
+
+    def write_latch(self, mask, latch):
+        pass
+
+
+class HostBootloader(object):
+    """ The host build of the bootloader, on the slave side of a pseudo
+        terminal. flash is written to the download area before it starts,
+        latency is that of the responses in seconds, and max_rate the
+        highest baud rate of the line. With scale, the flash operations take
+        their modelled time, and they, the line and the latency run scale
+        times slower. """
+
+    def __init__(self, flash=b'', latency=0.001, max_rate=None, scale=None):
+        self.dir = tempfile.mkdtemp()
+        self.flash_path = os.path.join(self.dir, "flash.bin")
+        self.erase_path = os.path.join(self.dir, "erased.txt")
+        with open(self.flash_path, "wb") as file:
+            file.write(bytes(flash) + b'\xFF' * (-len(flash) % 4))
+        self.master, self.slave = os.openpty()
+        tty.setraw(self.master)
+        self.port = PtyPort(self.master, timeout=0.2 * (scale or 1))
+        args = [BOOTLOADER_HOST, "-f", self.flash_path, "-e", self.erase_path,
+                "-l", str(latency * 1000)]
+        if max_rate:
+            args += ["-r", str(max_rate)]
+        if scale:
+            args += ["-t", str(scale)]
+        self.process = subprocess.Popen(args + [os.ttyname(self.slave)], stdout=subprocess.PIPE)
+        # the commands sent before the UART reception is started are lost
+        assert self.process.stdout.readline() == b"ready\n", "host build not started"
+
+    def close(self):
+        if self.process.poll() is None:
+            self.process.kill()
+        self.process.wait()
+        self.process.stdout.close()
+        os.close(self.slave)
+        os.close(self.master)
+        shutil.rmtree(self.dir)
+
+    def wait(self, timeout=5):
+        """ Returns the exit code and the output of the host build once it
+            exits, after a RESTART command. """
+        output = self.process.communicate(timeout=timeout)[0]
+        return self.process.returncode, output.decode()
+
+    @property
+    def flash(self):
+        """ Download area, as of the last HELLO or RESTART command. """
+        with open(self.flash_path, "rb") as file:
+            return file.read()
+
+    @property
+    def erased(self):
+        """ Sectors of the download area erased, as of the last HELLO or
+            RESTART command. """
+        with open(self.erase_path) as file:
+            return set(int(line, 16) for line in file)
+
+
+def make_image(size=None, seed=0):
+    """ Returns blinky.bin, grown to size octets with pseudo-random data. """
+    with open(BLINKY, "rb") as file:
+        img = bytearray(file.read())
+    if size is not None:
+        state = seed
+        while len(img) < size:
+            state = (state * 1103515245 + 12345) & 0xFFFFFFFF
+            img += struct.pack("<L", state)
+        del img[size:]
+        # descriptor size word, so that the whole file is the image
+        (img_start, ) = struct.unpack_from("<L", img, 4)
+        img_start -= img_start % SECT_SIZE
+        (dscr_ptr, ) = struct.unpack_from("<L", img, 9 * 4)
+        struct.pack_into("<L", img, dscr_ptr - img_start, size)
+    return img
+
+
+def patch(img, offsets):
+    img = bytearray(img)
+    for offset in offsets:
+        img[offset] ^= 0x5A
+    return img
+
+
+
+
+class UpdaterTest(unittest.TestCase):
+
+    def start(self, **kwargs):
+        dev = HostBootloader(**kwargs)
+        self.addCleanup(dev.close)
+        return dev
+
+    def update(self, dev, img, **kwargs):
+        with contextlib.redirect_stdout(io.StringIO()):
+            upd.update(dev.port, io.BytesIO(bytes(img)), **kwargs)
+        # the download area is copied to the application area and started
+        self.assertEqual(dev.wait(), (0, "start 0x{0:06x}\n".format(APP_BASE)))
+
+    def hello(self, dev):
+        with contextlib.redirect_stdout(io.StringIO()):
+            return upd.do_hello(dev.port)
+
+    def check_flash(self, dev, img):
+        img = bytes(img) + b'\xFF' * (-len(img) % 8)
+        self.assertEqual(dev.flash[:len(img)], img)
+
+    def test_full(self):
+        img = make_image()
+        dev = self.start()
+        self.update(dev, img, full=True)
+        self.check_flash(dev, img)
+
+    def test_step_prog(self):
+        img = bytes(make_image(64 * 1024))
+        dev = self.start()
+        self.hello(dev)
+        upd.do_step_prog(dev.port, DOWNLOAD_BASE, len(img), img, SECT_SIZE)
+        self.hello(dev)
+        self.check_flash(dev, img)
+
+    def test_delta(self):
+        old = make_image(100 * 1024)
+        new = patch(old, [100, 40 * 1024 + 3, 41 * 1024, 99 * 1024])
+        dev = self.start(flash=old)
+        self.update(dev, new)
+        self.check_flash(dev, new)
+        self.assertEqual(dev.erased, set(DOWNLOAD_BASE + offset for offset in
+                                         (0, 40 * 1024, 98 * 1024)))
+
+    def test_delta_last_sector(self):
+        # the last sector of the image is compared erased past its end, so
+        # that it is not sent again
+        old = make_image(10 * 1024 + 8)
+        new = patch(old, [100])
+        dev = self.start(flash=old)
+        self.update(dev, new)
+        self.check_flash(dev, new)
+        self.assertEqual(dev.erased, set([DOWNLOAD_BASE]))
+
+    def sector_crc(self, dev, adr, length):
+        upd.send_sector_crc(dev.port, adr, length)
+        return upd.recv_sector_crc(dev.port, max(1, length // SECT_SIZE))
+
+    def test_sector_crc(self):
+        img = bytes(make_image(8 * 1024))
+        dev = self.start(flash=img)
+        self.hello(dev)
+        resp, crc_list = self.sector_crc(dev, DOWNLOAD_BASE, 4 * SECT_SIZE)
+        self.assertEqual(resp, (upd.END_TYPE, upd.NO_ERROR))
+        self.assertEqual(list(crc_list), [upd.hash(img[offset:offset + SECT_SIZE])
+                                          for offset in range(0, len(img), SECT_SIZE)])
+        # the area ending past the code flash is clamped to it
+        resp, crc_list = self.sector_crc(dev, CODE_TOP + 1 - SECT_SIZE, 2 * SECT_SIZE)
+        self.assertEqual(resp, (upd.END_TYPE, upd.NO_ERROR))
+        self.assertEqual(list(crc_list), [upd.hash(b'\xFF' * SECT_SIZE)])
+
+    def test_sector_crc_rejected(self):
+        # the CRCs of any other area would let the host read the flash
+        dev = self.start()
+        self.hello(dev)
+        for adr, length in ((DOWNLOAD_BASE, 4),
+                            (DOWNLOAD_BASE, SECT_SIZE + 4),
+                            (DOWNLOAD_BASE + 4, SECT_SIZE),
+                            (DOWNLOAD_BASE, 0),
+                            (APP_BASE, SECT_SIZE),
+                            (DOWNLOAD_BASE - SECT_SIZE, 2 * SECT_SIZE),
+                            (DOWNLOAD_BASE + APP_MAX_SIZE, SECT_SIZE),
+                            (DOWNLOAD_BASE + APP_MAX_SIZE - SECT_SIZE, 2 * SECT_SIZE),
+                            (DOWNLOAD_BASE, (SECT_SIZE // 4 + 1) * SECT_SIZE)):
+            self.assertEqual(self.sector_crc(dev, adr, length),
+                             ((upd.END_TYPE, upd.INVALID_CMD), None), hex(adr))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -25,7 +25,7 @@
 from __future__ import print_function
 
 
-__version__ = '2.0.0'
+__version__ = '2.1.0'
 
 from ctypes import WinDLL, windll, byref
 from ctypes.wintypes import HANDLE, WORD, BYTE
@@ -200,6 +200,7 @@ HELLO = 0
 PROG = 1
 READ = 2
 RESTART = 3
+SECTOR_CRC = 4
 
 # Response types
 NXT_TYPE = 0x55
@@ -208,7 +209,7 @@ END_TYPE = 0xAA
 NO_ERROR = 0
 BAD_MSG = 1
 UNKNOWN_CMD = 2
-INVALID_CMD = 2
+INVALID_CMD = 3
 GENERAL_FLASH_FAILURE = 4
 WRITE_FLASH_NOT_ENABLED = 5
 BAD_FLASH_ADDRESS = 6
@@ -307,6 +308,66 @@ def do_prog(com, img_start, img_size, img_data, sect_size, show_progress=False):
     print_progress(show_progress, "\n")
     check_resp(END_TYPE, *recv_resp(com))
 
+def send_sector_crc(com, adr, length):
+    send(com, CMD_FMT.pack(SECTOR_CRC, adr, length, 0))
+
+def recv_sector_crc(com, count):
+    data = recv(com, count * 4 + 2, fcs=False)
+    if len(data) == RESP_FMT.size:
+        return RESP_FMT.unpack(data), None
+    data = check_fcs(data)
+    return (END_TYPE, NO_ERROR), struct.unpack("<{0}L".format(len(data) // 4), data)
+
+def do_sector_crc(com, adr, length, sect_size):
+    """ Returns the CRC32 of each sector of a flash area, or None if the
+        bootloader does not support the SECTOR_CRC command or the area.
+        The area is rounded up to whole sectors. The list is shorter than the
+        area when it ends past the code flash. """
+    count = (length + sect_size - 1) // sect_size
+    send_sector_crc(com, adr, count * sect_size)
+    # allow for the time taken to compute the CRCs of the whole area
+    timeout, com.timeout = com.timeout, max(com.timeout, 1.0)
+    try:
+        (type, code), crc_list = recv_sector_crc(com, count)
+    finally:
+        com.timeout = timeout
+    if type == END_TYPE and code in (UNKNOWN_CMD, INVALID_CMD):
+        return None
+    check_resp(END_TYPE, type, code)
+    return crc_list
+
+def changed_runs(img_data, sect_size, crc_list):
+    """ Returns the (offset, length) of each run of consecutive sectors of
+        the image which differ from the flash contents. The run holding the
+        1st sector is last, so that the image only becomes valid once all
+        the other sectors are programmed. The CRC of the last sector is
+        that of the whole sector, erased past the end of the image. """
+    runs = []
+    for index, offset in enumerate(range(0, len(img_data), sect_size)):
+        sector = img_data[offset:offset + sect_size]
+        padded = sector + b'\xFF' * (sect_size - len(sector))
+        if crc_list is not None and index < len(crc_list) and hash(padded) == crc_list[index]:
+            continue
+        if runs and runs[-1][0] + runs[-1][1] == offset:
+            runs[-1] = (runs[-1][0], runs[-1][1] + len(sector))
+        else:
+            runs.append((offset, len(sector)))
+    if runs and runs[0][0] == 0:
+        runs.append(runs.pop(0))
+    return runs
+
+def do_delta_prog(com, img_start, img_size, img_data, sect_size, show_progress=False):
+    """ Programs only the sectors of the image which differ from the flash contents. """
+    crc_list = do_sector_crc(com, img_start, img_size, sect_size)
+    if crc_list is None:
+        do_prog(com, img_start, img_size, img_data, sect_size, show_progress)
+        return img_size
+    runs = changed_runs(img_data, sect_size, crc_list)
+    for offset, length in runs:
+        do_prog(com, img_start + offset, length, img_data[offset:offset + length],
+                sect_size, show_progress)
+    return sum(length for offset, length in runs)
+
 def send_read(com, adr, length):
     send(com, CMD_FMT.pack(READ, adr, length, 0))
 
@@ -343,7 +404,7 @@ def do_restart(com):
         check_resp(END_TYPE, type, code)
 
 
-def update(com, file, overwrite=False):
+def update(com, file, overwrite=False, full=False):
     MAX_RETRIES = 2
     img_start, img_size, img, id = load_image(file)
     if img_start < APP_BASE_ADR:
@@ -357,10 +418,15 @@ def update(com, file, overwrite=False):
     while True:
         try:
             start = time()
-            do_prog(com, img_start, img_size, img, sect_size, show_progress=True)
+            if full or img_start < APP_BASE_ADR:
+                sent_size = img_size
+                do_prog(com, img_start, img_size, img, sect_size, show_progress=True)
+            else:
+                sent_size = do_delta_prog(com, img_start, img_size, img, sect_size, show_progress=True)
+                print("{0} of {1} octets sent".format(sent_size, img_size))
             finish = time()
             do_restart(com)
-            return img_size / (finish - start)
+            return sent_size / (finish - start)
         except AssertionError:
             if retries >= MAX_RETRIES:
                 break
@@ -434,6 +500,9 @@ if __name__ == "__main__":
     parser.add_argument('-v', '--version', action='version', version="%(prog)s " + __version__)
     parser.add_argument('--force', action='store_true',
                         help="force overwrite of the bootloader")
+    parser.add_argument('--full', action='store_true',
+                        help="send the whole image, instead of only the sectors "
+                             "which differ from the download area")
     parser.add_argument('port', metavar='PORT', type=str,
                         help="COM port")
     parser.add_argument('file', metavar='FILE', type=argparse.FileType('rb'), nargs='?',
@@ -444,7 +513,7 @@ if __name__ == "__main__":
     with ComPort(args.port) as com:
         if args.file:
             with args.file:
-                update(com, args.file, args.force)
+                update(com, args.file, args.force, args.full)
         else:
             info(com)
     
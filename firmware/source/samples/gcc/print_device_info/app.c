@@ -155,6 +155,40 @@ void App_Clock_Config(void)
 }
 
 
+/* Check if a slot holds a complete record in a marked sector. Sectors which
+ * are not marked hold the former layout, converted on next BondList_Init. */
+static bool bondIsComplete(unsigned int slot)
+{
+    uint32_t check = *(const uint32_t *)BOND_INFO_CHECK_ADDR(slot);
+
+    return (*(const uint32_t *)BOND_INFO_MARK_ADDR(slot / BOND_INFO_PER_SECTOR) == BOND_INFO_SECTOR_MARK)
+           && (check != 0) && (check != 0xFFFFFFFF);
+}
+
+/* Check if a slot holds the current copy of a bond: a bond can be found in
+ * two slots after a reset interrupted its move, the one with the newest
+ * sequence number being used. */
+static bool bondIsCurrent(unsigned int slot)
+{
+    const BondInfo_t *bond = (const BondInfo_t *)BOND_INFO_SLOT_ADDR(slot);
+
+    if (!bondIsComplete(slot))
+    {
+        return false;
+    }
+    for (unsigned int e = 0; e < BONDLIST_SLOT_COUNT; e++)
+    {
+        const BondInfo_t *other = (const BondInfo_t *)BOND_INFO_SLOT_ADDR(e);
+
+        if ((e != slot) && (other->state == bond->state) && bondIsComplete(e)
+            && ((int16_t)(other->seq - bond->seq) > 0))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 void printBondInfo(void)
 {
     uint8_t found = 0;
@@ -165,27 +199,29 @@ void printBondInfo(void)
      * exist in the ble abstraction source location. */
     printf("Bluetooth bonding list:\n");
     found = 0;
-    for (unsigned int e = 0; e < BONDLIST_MAX_SIZE; e++)
+    for (unsigned int e = 0; e < BONDLIST_SLOT_COUNT; e++)
     {
-        tmp = ((BondInfo_t *)BOND_INFO_BASE)[e].state;
-        if (BOND_INFO_STATE_VALID(tmp))
+        const BondInfo_t *bond = (const BondInfo_t *)BOND_INFO_SLOT_ADDR(e);
+
+        tmp = bond->state;
+        if (BOND_INFO_STATE_VALID(tmp) && bondIsCurrent(e))
         {
             printf("  Entry %u\n", e);
             printf("    STATE: 0x%02lX\n", tmp);
             printf("    LTK (Long Term Key): 0x");
             for (signed int i = 15; i >= 0; i--)
             {
-                printf("%02X", ((BondInfo_t *)BOND_INFO_BASE)[e].ltk[i]);
+                printf("%02X", bond->ltk[i]);
             }
             printf("\n");
             printf("    EDIV (Encrypted Diversifier): 0x%04X\n",
-                   ((BondInfo_t *)BOND_INFO_BASE)[e].ediv);
+                   bond->ediv);
             printf("    Address: 0x");
             for (signed int i = 6; i >= 0; i--)
             {
-                printf("%02X", ((BondInfo_t *)BOND_INFO_BASE)[e].addr[i]);
+                printf("%02X", bond->addr[i]);
             }
-            tmp = ((BondInfo_t *)BOND_INFO_BASE)[e].addr_type;
+            tmp = bond->addr_type;
             printf("    ADDR_TYPE: 0x%02lX ", tmp);
             if (tmp == BD_TYPE_PUBLIC)
             {
@@ -202,19 +238,19 @@ void printBondInfo(void)
             printf("    CSRK (Connection Signature Resolving Key): 0x");
             for (signed int i = 15; i >= 0; i--)
             {
-                printf("%02X", ((BondInfo_t *)BOND_INFO_BASE)[e].csrk[i]);
+                printf("%02X", bond->csrk[i]);
             }
             printf("\n");
             printf("    IRK (Identity Resolving Key): 0x");
             for (signed int i = 15; i >= 0; i--)
             {
-                printf("%02X", ((BondInfo_t *)BOND_INFO_BASE)[e].irk[i]);
+                printf("%02X", bond->irk[i]);
             }
             printf("\n");
             printf("    RAND (Random Key): 0x");
             for (signed int i = 7; i >= 0; i--)
             {
-                printf("%02X", ((BondInfo_t *)BOND_INFO_BASE)[e].rand[i]);
+                printf("%02X", bond->rand[i]);
             }
             printf("\n");
             found = 1;
@@ -32,7 +32,7 @@ typedef struct
     uint8_t   reserved0[2];
     uint8_t   ltk[16];
     uint16_t  ediv;
-    uint8_t   reserved1[2];
+    uint16_t  seq;
     uint8_t   addr[6];
     uint8_t   addr_type;
     uint8_t   reserved2;
@@ -56,13 +56,28 @@ typedef struct
 #define BOND_INFO_FLASH_SECTORS_COUNT      8
 #endif
 
-#if BOND_INFO_FLASH_SECTORS_COUNT < 1
-    #error "The number of flash sectors should be greater than 1"
+#if BOND_INFO_FLASH_SECTORS_COUNT < 2
+    #error "The number of flash sectors should be at least 2"
 #endif
 
 #define FLASH_SECTOR_SIZE               256
-/* For 8 sectors (2KB) there is about 28 bond elements */
-#define BONDLIST_MAX_SIZE               ((FLASH_SECTOR_SIZE * BOND_INFO_FLASH_SECTORS_COUNT) / sizeof(BondInfo_t))
+/* Bond records do not cross sector boundaries, and are followed by a sector
+ * marker and a check word per record */
+#define BOND_INFO_PER_SECTOR            ((FLASH_SECTOR_SIZE - 4) / (sizeof(BondInfo_t) + 4))
+#define BONDLIST_SLOT_COUNT             (BOND_INFO_PER_SECTOR * BOND_INFO_FLASH_SECTORS_COUNT)
+#define BOND_INFO_SLOT_ADDR(slot)       (BOND_INFO_BASE + ((slot) / BOND_INFO_PER_SECTOR) * FLASH_SECTOR_SIZE \
+                                         + ((slot) % BOND_INFO_PER_SECTOR) * sizeof(BondInfo_t))
+/* Value written after the last record of a sector of the current layout */
+#define BOND_INFO_SECTOR_MARK           0x424F4E44
+#define BOND_INFO_MARK_ADDR(sector)     (BOND_INFO_BASE + (sector) * FLASH_SECTOR_SIZE \
+                                         + BOND_INFO_PER_SECTOR * sizeof(BondInfo_t))
+/* Check word of a record, erased until the record is complete and cleared
+ * when it is invalidated */
+#define BOND_INFO_CHECK_ADDR(slot)      (BOND_INFO_MARK_ADDR((slot) / BOND_INFO_PER_SECTOR) + 4 \
+                                         + ((slot) % BOND_INFO_PER_SECTOR) * 4)
+/* For 8 sectors (2KB) there are 21 bond elements, one sector being kept erased
+ * (the former layout held 28) */
+#define BONDLIST_MAX_SIZE               (BOND_INFO_PER_SECTOR * (BOND_INFO_FLASH_SECTORS_COUNT - 1))
 #define BOND_INFO_STATE_INVALID         0x00
 #define BOND_INFO_STATE_EMPTY           0xFFFF
 #define BOND_INFO_STATE_VALID(state)    ((state != BOND_INFO_STATE_INVALID) && \